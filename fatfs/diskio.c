@@ -10,8 +10,8 @@
 #include "ff.h"         /* Obtains integer types */
 #include "diskio.h"     /* Declarations of disk functions */
 #include "cyhal.h"
-#include "sd_card.h"
-#include <stdio.h>
+#include "storage.h"
+#include "log.h"
 
 /* Definitions of physical drive number for each drive */
 #define DEV_SD        0    /* Example: Map SD to physical drive 0 */
@@ -51,14 +51,14 @@ DSTATUS disk_initialize (
 )
 {
     DSTATUS stat = RES_OK;
-    cy_rslt_t result;
+    blk_dev_result_t result;
 
     switch (pdrv) {
     case DEV_SD :
         if (0U == SD_initVar) {
-            /* Initialize the SD card */
-            result = sd_card_init();
-            if(result != CY_RSLT_SUCCESS) {
+            /* Initialize the storage */
+            result = blk_dev_init(storage_get_dev(STORAGE_UNIT_FS));
+            if(result != BLK_DEV_OK) {
                 return STA_NOINIT;
             }
             SD_initVar = 1U;
@@ -82,16 +82,17 @@ DRESULT disk_read (
 )
 {
     DRESULT res = RES_OK;
-    cy_rslt_t result;
+    blk_dev_result_t result;
+    uint32_t length = count;
 
     switch (pdrv) {
     case DEV_SD :
         if (0U == SD_initVar) {
             return RES_NOTRDY;
         }
-        result = sd_card_read(sector, buff, (uint32_t *)&count);
-        if (result != CY_RSLT_SUCCESS) {
-            printf("sd_card_read error: sector=%d count=%d\r\n", (int)sector, (int)count);
+        result = blk_dev_read(storage_get_dev(STORAGE_UNIT_FS), (uint32_t)sector, buff, &length);
+        if ((result != BLK_DEV_OK) || (length != count)) {
+            LOG_ERROR("blk_dev_read error: sector=%d count=%d\r\n", (int)sector, (int)count);
             return RES_ERROR;
         }
         return res;
@@ -116,16 +117,17 @@ DRESULT disk_write (
 )
 {
     DRESULT res = RES_OK;
-    cy_rslt_t result;
+    blk_dev_result_t result;
+    uint32_t length = count;
 
     switch (pdrv) {
     case DEV_SD :
         if (0U == SD_initVar) {
             return RES_NOTRDY;
         }
-        result = sd_card_write(sector, buff, (uint32_t *)&count);
-        if (result != CY_RSLT_SUCCESS) {
-            printf("sd_card_write error: sector=%d count=%d\r\n", (int)sector, (int)count);
+        result = blk_dev_write(storage_get_dev(STORAGE_UNIT_FS), (uint32_t)sector, buff, &length);
+        if ((result != BLK_DEV_OK) || (length != count)) {
+            LOG_ERROR("blk_dev_write error: sector=%d count=%d\r\n", (int)sector, (int)count);
             return RES_ERROR;
         }
         return res;
@@ -161,16 +163,19 @@ DRESULT disk_ioctl (
             return RES_NOTRDY;
         }
         switch(cmd) {
-            case CTRL_SYNC:
+            case CTRL_SYNC: /* Flush the buffered writes of the stack */
+                if (blk_dev_sync(storage_get_dev(STORAGE_UNIT_FS)) != BLK_DEV_OK) {
+                    res = RES_ERROR;
+                }
                 break;
             case GET_SECTOR_COUNT: /* Get media size */
-                *(DWORD *) buff = sd_card_max_sector_num();
+                *(LBA_t *) buff = blk_dev_block_num(storage_get_dev(STORAGE_UNIT_FS));
                 break;
             case GET_SECTOR_SIZE: /* Get sector size */
-                *(WORD *) buff = sd_card_sector_size();
+                *(WORD *) buff = blk_dev_block_size(storage_get_dev(STORAGE_UNIT_FS));
                 break;
-            case GET_BLOCK_SIZE: /* Get erase block size */
-                *(DWORD *) buff = 8;
+            case GET_BLOCK_SIZE: /* Get erase block size (4 KB) */
+                *(DWORD *) buff = (4096u + STORAGE_BLOCK_SIZE - 1u) / STORAGE_BLOCK_SIZE;
                 break;
             default:
                 res = RES_PARERR;
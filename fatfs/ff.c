@@ -273,6 +273,13 @@
 #endif
 
 
+/* Sector write-back cache */
+#if FF_USE_WCACHE && (FF_WCACHE_SECTORS < 1 || FF_WCACHE_SECTORS > 32)
+#error Wrong FF_WCACHE_SECTORS setting
+#endif
+#define WCACHE    (FF_USE_WCACHE && !FF_FS_READONLY && !FF_FS_TINY)
+
+
 /* File lock controls */
 #if FF_FS_LOCK != 0
 #if FF_FS_READONLY
@@ -1065,6 +1072,142 @@ static void clear_lock (    /* Clear lock entries of the volume */
 
 
 
+#if WCACHE
+/*-----------------------------------------------------------------------*/
+/* Sector write-back cache behind the disk access window                 */
+/*-----------------------------------------------------------------------*/
+/* The cache keeps FF_WCACHE_SECTORS recently used sectors of the window.
+/  A window moved away is parked in the cache instead of being written
+/  back, and a sector found in the cache is loaded without reading the
+/  medium. Dirty sectors are written in ascending LBA order by
+/  sync_window(), or when the least recently used slot is evicted. */
+
+#define WC_BIT(i)    ((DWORD)1 << (i))
+#define WC_BUF(fs, i)    ((fs)->wc_buf + (UINT)(i) * FF_MAX_SS)
+
+static BYTE WCache[FF_VOLUMES][FF_WCACHE_SECTORS * FF_MAX_SS];    /* Write-back cache buffers */
+
+
+static void wcache_init (
+    FATFS* fs,        /* Filesystem object */
+    UINT vol        /* Logical drive number */
+)
+{
+    UINT i;
+
+
+    fs->wc_buf = WCache[vol];
+    for (i = 0; i < FF_WCACHE_SECTORS; i++) fs->wc_sect[i] = (LBA_t)0 - 1;
+    fs->wc_dirty = 0;
+    fs->wc_tick = 0;
+}
+
+
+static UINT wcache_find (    /* Returns the slot holding the sector, FF_WCACHE_SECTORS if not cached */
+    FATFS* fs,        /* Filesystem object */
+    LBA_t sect        /* Sector to find */
+)
+{
+    UINT i;
+
+
+    for (i = 0; i < FF_WCACHE_SECTORS && fs->wc_sect[i] != sect; i++) ;
+    return i;
+}
+
+
+static void wcache_drop (
+    FATFS* fs,        /* Filesystem object */
+    LBA_t sect,        /* Top of the sectors overwritten on the medium */
+    UINT count        /* Number of sectors */
+)
+{
+    UINT i;
+
+
+    for (i = 0; i < FF_WCACHE_SECTORS; i++) {
+        if (fs->wc_sect[i] - sect < count) {    /* Discard the slot */
+            fs->wc_sect[i] = (LBA_t)0 - 1;
+            fs->wc_dirty &= ~WC_BIT(i);
+        }
+    }
+}
+
+
+static FRESULT wcache_flush (    /* Returns FR_OK or FR_DISK_ERR */
+    FATFS* fs        /* Filesystem object */
+)
+{
+    DWORD todo[2];
+    LBA_t sect, min;
+    UINT i, c, si, sc;
+
+
+    todo[0] = fs->wc_dirty; todo[1] = 0;    /* Slots to be written into the 1st and 2nd FAT copy */
+    for (i = 0; i < FF_WCACHE_SECTORS; i++) {
+        if ((todo[0] & WC_BIT(i)) && fs->n_fats == 2 && fs->wc_sect[i] - fs->fatbase < fs->fsize) todo[1] |= WC_BIT(i);
+    }
+    while (todo[0] | todo[1]) {    /* Write the dirty sectors in ascending LBA order */
+        min = (LBA_t)0 - 1; si = sc = 0;
+        for (c = 0; c < 2; c++) {
+            for (i = 0; i < FF_WCACHE_SECTORS; i++) {
+                if (!(todo[c] & WC_BIT(i))) continue;
+                sect = fs->wc_sect[i] + (c ? fs->fsize : 0);
+                if (sect <= min) {
+                    min = sect; si = i; sc = c;
+                }
+            }
+        }
+        if (disk_write(fs->pdrv, WC_BUF(fs, si), min, 1) != RES_OK && sc == 0) return FR_DISK_ERR;
+        todo[sc] &= ~WC_BIT(si);
+        if (sc == 0) fs->wc_dirty &= ~WC_BIT(si);
+    }
+    return FR_OK;
+}
+
+
+static FRESULT wcache_park (    /* Returns FR_OK or FR_DISK_ERR */
+    FATFS* fs        /* Filesystem object */
+)
+{
+    UINT i, lru;
+
+
+    if (fs->winsect == (LBA_t)0 - 1) return FR_OK;    /* Window is not valid */
+    i = wcache_find(fs, fs->winsect);
+    if (i == FF_WCACHE_SECTORS) {    /* Not cached: take a blank or the least recently used slot */
+        for (i = lru = 0; i < FF_WCACHE_SECTORS; i++) {
+            if (fs->wc_sect[i] == (LBA_t)0 - 1) {
+                lru = i; break;
+            }
+            if (fs->wc_tick - fs->wc_used[i] > fs->wc_tick - fs->wc_used[lru]) lru = i;
+        }
+        i = lru;
+        if (fs->wc_dirty & WC_BIT(i)) {    /* Write back the evicted sector */
+            if (disk_write(fs->pdrv, WC_BUF(fs, i), fs->wc_sect[i], 1) != RES_OK) return FR_DISK_ERR;
+            if (fs->n_fats == 2 && fs->wc_sect[i] - fs->fatbase < fs->fsize) {    /* Reflect it to 2nd FAT if needed */
+                disk_write(fs->pdrv, WC_BUF(fs, i), fs->wc_sect[i] + fs->fsize, 1);
+            }
+            fs->wc_dirty &= ~WC_BIT(i);
+        }
+        fs->wc_sect[i] = fs->winsect;
+        mem_cpy(WC_BUF(fs, i), fs->win, SS(fs));
+    } else if (fs->wflag) {
+        mem_cpy(WC_BUF(fs, i), fs->win, SS(fs));
+    }
+    if (fs->wflag) {
+        fs->wc_dirty |= WC_BIT(i);
+        fs->wflag = 0;
+    }
+    fs->wc_used[i] = ++fs->wc_tick;
+    return FR_OK;
+}
+
+#endif    /* WCACHE */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Move/Flush disk access window in the filesystem object                */
 /*-----------------------------------------------------------------------*/
@@ -1076,6 +1219,10 @@ static FRESULT sync_window (    /* Returns FR_OK or FR_DISK_ERR */
     FRESULT res = FR_OK;
 
 
+#if WCACHE
+    res = wcache_park(fs);        /* Park the window and write back the cache */
+    if (res == FR_OK) res = wcache_flush(fs);
+#else
     if (fs->wflag) {    /* Is the disk access window dirty? */
         if (disk_write(fs->pdrv, fs->win, fs->winsect, 1) == RES_OK) {    /* Write it back into the volume */
             fs->wflag = 0;    /* Clear window dirty flag */
@@ -1086,6 +1233,7 @@ static FRESULT sync_window (    /* Returns FR_OK or FR_DISK_ERR */
             res = FR_DISK_ERR;
         }
     }
+#endif
     return res;
 }
 #endif
@@ -1100,7 +1248,18 @@ static FRESULT move_window (    /* Returns FR_OK or FR_DISK_ERR */
 
 
     if (sect != fs->winsect) {    /* Window offset changed? */
-#if !FF_FS_READONLY
+#if WCACHE
+        UINT i;
+
+        res = wcache_park(fs);        /* Park the window in the cache */
+        i = wcache_find(fs, sect);
+        if (res == FR_OK && i < FF_WCACHE_SECTORS) {    /* Load the sector from the cache if it is there */
+            mem_cpy(fs->win, WC_BUF(fs, i), SS(fs));
+            fs->wc_used[i] = ++fs->wc_tick;
+            fs->winsect = sect;
+            return FR_OK;
+        }
+#elif !FF_FS_READONLY
         res = sync_window(fs);        /* Flush the window */
 #endif
         if (res == FR_OK) {            /* Fill sector window with new data */
@@ -1141,6 +1300,9 @@ static FRESULT sync_fs (    /* Returns FR_OK or FR_DISK_ERR */
             st_dword(fs->win + FSI_Nxt_Free, fs->last_clst);
             /* Write it into the FSInfo sector */
             fs->winsect = fs->volbase + 1;
+#if WCACHE
+            wcache_drop(fs, fs->winsect, 1);
+#endif
             disk_write(fs->pdrv, fs->win, fs->winsect, 1);
             fs->fsi_flag = 0;
         }
@@ -1248,6 +1410,162 @@ static DWORD get_fat (        /* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7
 
 
 
+#if FF_USE_FREEMAP && !FF_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* FAT: Free cluster map                                                 */
+/*-----------------------------------------------------------------------*/
+/* The map holds one bit per cluster (set: in use) when it fits in
+/  FF_FREEMAP_SIZE bytes. Else, on FAT32, it holds the number of free
+/  entries in each FAT sector, so the full FAT sectors are skipped without
+/  reading them. It is built at the first allocation or f_getfree() call
+/  after the volume is mounted, and maintained by put_fat(). */
+
+#define FMAP_NONE    0    /* Not built yet */
+#define FMAP_BITS    1    /* One bit per cluster */
+#define FMAP_COUNT   2    /* Number of free entries per FAT sector */
+#define FMAP_OFF     3    /* Does not fit in the buffer */
+
+static BYTE FreeMap[FF_VOLUMES][FF_FREEMAP_SIZE];    /* Free cluster map buffers */
+
+
+static FRESULT fmap_build (    /* FR_OK(0):succeeded, !=0:error */
+    FATFS* fs        /* Filesystem object */
+)
+{
+    FRESULT res = FR_OK;
+    FFOBJID obj;
+    DWORD clst, nfree = 0, stat;
+    UINT i, vol, epc, n;
+    BYTE mode;
+
+
+    for (vol = 0; vol < FF_VOLUMES && FatFs[vol] != fs; vol++) ;
+    if (vol >= FF_VOLUMES) return FR_INT_ERR;
+    fs->fmap = FreeMap[vol];
+
+    if ((fs->n_fatent + 7) / 8 <= FF_FREEMAP_SIZE) {    /* Select the map mode */
+        mode = FMAP_BITS;
+    } else if (fs->fs_type == FS_FAT32 && fs->fsize <= FF_FREEMAP_SIZE && SS(fs) / 4 < 256) {
+        mode = FMAP_COUNT;
+    } else {
+        fs->fmap_mode = FMAP_OFF;
+        return FR_OK;
+    }
+    mem_set(fs->fmap, 0, FF_FREEMAP_SIZE);
+
+    if (fs->fs_type == FS_FAT12) {    /* FAT12: Read each bit field entry */
+        obj.fs = fs;
+        fs->fmap[0] = 0x03;            /* Clusters 0 and 1 are not allocatable */
+        for (clst = 2; clst < fs->n_fatent; clst++) {
+            stat = get_fat(&obj, clst);
+            if (stat == 0xFFFFFFFF) return FR_DISK_ERR;
+            if (stat == 1) return FR_INT_ERR;
+            if (stat == 0) {
+                nfree++;
+            } else {
+                fs->fmap[clst / 8] |= (BYTE)(1 << (clst % 8));
+            }
+        }
+    } else {                        /* FAT16/32: Scan the FAT sector by sector */
+        epc = SS(fs) / ((fs->fs_type == FS_FAT16) ? 2 : 4);    /* Entries per FAT sector */
+        clst = 0;
+        for (n = 0; n < fs->fsize && clst < fs->n_fatent; n++) {
+            res = move_window(fs, fs->fatbase + n);
+            if (res != FR_OK) return res;
+            for (i = 0; i < epc && clst < fs->n_fatent; i++, clst++) {
+                stat = (fs->fs_type == FS_FAT16) ? ld_word(fs->win + i * 2) : (ld_dword(fs->win + i * 4) & 0x0FFFFFFF);
+                if (clst < 2) stat = 1;        /* Clusters 0 and 1 are not allocatable */
+                if (mode == FMAP_BITS) {
+                    if (stat != 0) fs->fmap[clst / 8] |= (BYTE)(1 << (clst % 8));
+                } else {
+                    if (stat == 0) fs->fmap[n]++;
+                }
+                if (stat == 0) nfree++;
+            }
+        }
+    }
+
+    fs->fmap_mode = mode;
+    fs->free_clst = nfree;            /* Now free_clst is valid */
+    fs->fsi_flag |= 1;                /* FAT32: FSInfo is to be updated */
+    return res;
+}
+
+
+static void fmap_put (
+    FATFS* fs,        /* Filesystem object */
+    DWORD clst,        /* Cluster number changed */
+    int was_free,    /* 1:Entry was free, 0:in use, -1:unknown */
+    DWORD val        /* New value of the entry */
+)
+{
+    BYTE mask;
+
+
+    if (fs->fmap_mode == FMAP_BITS) {
+        mask = (BYTE)(1 << (clst % 8));
+        if (val == 0) {
+            fs->fmap[clst / 8] &= (BYTE)~mask;
+        } else {
+            fs->fmap[clst / 8] |= mask;
+        }
+    } else if (fs->fmap_mode == FMAP_COUNT && was_free >= 0) {
+        if (was_free && val != 0) fs->fmap[clst / (SS(fs) / 4)]--;
+        if (!was_free && val == 0) fs->fmap[clst / (SS(fs) / 4)]++;
+    }
+}
+
+
+static DWORD fmap_find (    /* 0:No free cluster, 1:Map not available, 0xFFFFFFFF:Disk error, >=2:Free cluster# */
+    FATFS* fs,        /* Filesystem object */
+    DWORD scl        /* Cluster to start to find after */
+)
+{
+    DWORD clst, n, nsect, sect;
+    UINT i, epc;
+
+
+    if (fs->fmap_mode == FMAP_NONE && fmap_build(fs) != FR_OK) return 0xFFFFFFFF;
+    if (fs->free_clst == 0) return 0;
+
+    if (fs->fmap_mode == FMAP_BITS) {        /* Find the next clear bit, skipping full bytes */
+        clst = scl;
+        for (n = fs->n_fatent; n; n--) {
+            if (++clst >= fs->n_fatent) clst = 2;
+            if (clst % 8 == 0 && fs->fmap[clst / 8] == 0xFF && n >= 8) {
+                clst += 7; n -= 7;
+                continue;
+            }
+            if (clst < fs->n_fatent && !(fs->fmap[clst / 8] & (1 << (clst % 8)))) return clst;
+        }
+        return 0;
+    }
+
+    if (fs->fmap_mode == FMAP_COUNT) {    /* Find the next FAT sector with free entries */
+        epc = SS(fs) / 4;
+        nsect = (fs->n_fatent + epc - 1) / epc;
+        clst = (scl + 1 < fs->n_fatent) ? scl + 1 : 2;
+        for (n = 0; n <= nsect; n++) {
+            sect = (clst / epc + n) % nsect;
+            if (fs->fmap[sect] == 0) continue;
+            if (move_window(fs, fs->fatbase + sect) != FR_OK) return 0xFFFFFFFF;
+            for (i = (n == 0) ? clst % epc : 0; i < epc; i++) {
+                if (sect * epc + i >= 2 && sect * epc + i < fs->n_fatent && (ld_dword(fs->win + i * 4) & 0x0FFFFFFF) == 0) {
+                    return sect * epc + i;
+                }
+            }
+        }
+        return 0;
+    }
+
+    return 1;
+}
+
+#endif /* FF_USE_FREEMAP && !FF_FS_READONLY */
+
+
+
+
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* FAT access - Change value of a FAT entry                              */
@@ -1278,11 +1596,17 @@ static FRESULT put_fat (    /* FR_OK(0):succeeded, !=0:error */
             p = fs->win + bc % SS(fs);
             *p = (clst & 1) ? (BYTE)(val >> 4) : ((*p & 0xF0) | ((BYTE)(val >> 8) & 0x0F));    /* Update 2nd byte */
             fs->wflag = 1;
+#if FF_USE_FREEMAP
+            fmap_put(fs, clst, -1, val);
+#endif
             break;
 
         case FS_FAT16 :
             res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 2)));
             if (res != FR_OK) break;
+#if FF_USE_FREEMAP
+            fmap_put(fs, clst, ld_word(fs->win + clst * 2 % SS(fs)) == 0, val & 0xFFFF);
+#endif
             st_word(fs->win + clst * 2 % SS(fs), (WORD)val);    /* Simple WORD array */
             fs->wflag = 1;
             break;
@@ -1294,6 +1618,9 @@ static FRESULT put_fat (    /* FR_OK(0):succeeded, !=0:error */
             res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)));
             if (res != FR_OK) break;
             if (!FF_FS_EXFAT || fs->fs_type != FS_EXFAT) {
+#if FF_USE_FREEMAP
+                fmap_put(fs, clst, (ld_dword(fs->win + clst * 4 % SS(fs)) & 0x0FFFFFFF) == 0, val & 0x0FFFFFFF);
+#endif
                 val = (val & 0x0FFFFFFF) | (ld_dword(fs->win + clst * 4 % SS(fs)) & 0xF0000000);
             }
             st_dword(fs->win + clst * 4 % SS(fs), val);
@@ -1601,6 +1928,12 @@ static DWORD create_chain (    /* 0:No free cluster, 1:Internal error, 0xFFFFFFF
             }
         }
         if (ncl == 0) {    /* The new cluster cannot be contiguous and find another fragment */
+#if FF_USE_FREEMAP
+            ncl = fmap_find(fs, scl);            /* Find a free cluster in the free cluster map */
+            if (ncl == 0 || ncl == 0xFFFFFFFF) return ncl;    /* No free cluster or hard error? */
+        }
+        if (ncl == 1) {    /* The free cluster map is not available, scan the FAT */
+#endif
             ncl = scl;    /* Start cluster */
             for (;;) {
                 ncl++;                            /* Next cluster */
@@ -1683,6 +2016,9 @@ static FRESULT dir_clear (    /* Returns FR_OK or FR_DISK_ERR */
 
     if (sync_window(fs) != FR_OK) return FR_DISK_ERR;    /* Flush disk access window */
     sect = clst2sect(fs, clst);        /* Top of the cluster */
+#if WCACHE
+    wcache_drop(fs, sect, fs->csize);    /* Discard the cached sectors to be cleared */
+#endif
     fs->winsect = sect;                /* Set window to top of the cluster */
     mem_set(fs->win, 0, sizeof fs->win);    /* Clear window buffer */
 #if FF_USE_LFN == 3        /* Quick table clear by using multi-secter write */
@@ -3410,6 +3746,12 @@ static FRESULT mount_volume (    /* FR_OK(0): successful, !=0: an error occurred
     /* Following code attempts to mount the volume. (find a FAT volume, analyze the BPB and initialize the filesystem object) */
 
     fs->fs_type = 0;                    /* Clear the filesystem object */
+#if FF_USE_FREEMAP && !FF_FS_READONLY
+    fs->fmap_mode = FMAP_NONE;            /* Free cluster map is to be rebuilt */
+#endif
+#if WCACHE
+    wcache_init(fs, (UINT)vol);            /* Discard the cached sectors */
+#endif
     fs->pdrv = LD2PD(vol);                /* Volume hosting physical drive */
     stat = disk_initialize(fs->pdrv);    /* Initialize the physical drive */
     if (stat & STA_NOINIT) {             /* Check if the initialization succeeded */
@@ -4799,6 +5141,12 @@ FRESULT f_getfree (
     res = mount_volume(&path, &fs, 0);
     if (res == FR_OK) {
         *fatfs = fs;                /* Return ptr to the fs object */
+#if FF_USE_FREEMAP && !FF_FS_READONLY
+        if (fs->fs_type != FS_EXFAT && fs->fmap_mode == FMAP_NONE) {
+            res = fmap_build(fs);    /* Build the free cluster map, it also counts the free clusters */
+            if (res != FR_OK) LEAVE_FF(fs, res);
+        }
+#endif
         /* If free_clst is valid, return it without full FAT scan */
         if (fs->free_clst <= fs->n_fatent - 2) {
             *nclst = fs->free_clst;
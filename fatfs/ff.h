@@ -153,6 +153,17 @@ typedef struct {
 #if !FF_FS_READONLY
     DWORD    last_clst;     /* Last allocated cluster */
     DWORD    free_clst;     /* Number of free clusters */
+#if FF_USE_FREEMAP
+    BYTE     fmap_mode;     /* Free cluster map mode (0:not built, 1:bits, 2:count per FAT sector, 3:off) */
+    BYTE*    fmap;          /* Free cluster map */
+#endif
+#if FF_USE_WCACHE && !FF_FS_TINY
+    DWORD    wc_dirty;      /* Write-back cache dirty flags (bit n: slot n) */
+    DWORD    wc_tick;       /* Write-back cache access counter */
+    LBA_t    wc_sect[FF_WCACHE_SECTORS];    /* Sector held in each slot (invalid: (LBA_t)0 - 1) */
+    DWORD    wc_used[FF_WCACHE_SECTORS];    /* Access counter at the last use of each slot */
+    BYTE*    wc_buf;        /* Write-back cache buffer (FF_WCACHE_SECTORS sectors) */
+#endif
 #endif
 #if FF_FS_RPATH
     DWORD    cdir;          /* Current directory start cluster (0:root) */
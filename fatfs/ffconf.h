@@ -46,11 +46,11 @@
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_EXPAND    0
+#define FF_USE_EXPAND    1
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_CHMOD    0
+#define FF_USE_CHMOD    1
 /* This option switches attribute manipulation functions, f_chmod() and f_utime().
 /  (0:Disable or 1:Enable) Also FF_FS_READONLY needs to be 0 to enable this option. */
 
@@ -190,17 +190,23 @@
 /  funciton will be available. */
 
 
+#ifdef STORAGE_BLOCK_SIZE
+#define FF_MIN_SS        STORAGE_BLOCK_SIZE
+#define FF_MAX_SS        STORAGE_BLOCK_SIZE
+#else
 #define FF_MIN_SS        512
 #define FF_MAX_SS        512
+#endif
 /* This set of options configures the range of sector size to be supported. (512,
 /  1024, 2048 or 4096) Always set both 512 for most systems, generic memory card and
 /  harddisk. But a larger value may be required for on-board flash memory and some
 /  type of optical media. When FF_MAX_SS is larger than FF_MIN_SS, FatFs is configured
 /  for variable sector size mode and disk_ioctl() function needs to implement
-/  GET_SECTOR_SIZE command. */
+/  GET_SECTOR_SIZE command. Both follow STORAGE_BLOCK_SIZE when the build
+/  defines it. */
 
 
-#define FF_LBA64        0
+#define FF_LBA64        1
 /* This option switches support for 64-bit LBA. (0:Disable or 1:Enable)
 /  To enable the 64-bit LBA, also exFAT needs to be enabled. (FF_FS_EXFAT == 1) */
 
@@ -228,7 +234,31 @@
 /  buffer in the filesystem object (FATFS) is used for the file data transfer. */
 
 
-#define FF_FS_EXFAT        0
+#ifndef FF_USE_FREEMAP
+#define FF_USE_FREEMAP    1
+#endif
+#ifndef FF_FREEMAP_SIZE
+#define FF_FREEMAP_SIZE   8192
+#endif
+/* This option switches the RAM free cluster map for FAT12/16/32 volumes.
+/  (0:Disable or 1:Enable) The map has one bit per cluster when it fits in
+/  FF_FREEMAP_SIZE bytes per volume, else, on FAT32, one byte per FAT sector
+/  holding its number of free entries. The map is built at the first cluster
+/  allocation or f_getfree() call after mount, and speeds up both. Both options
+/  can be given on the command line, as tools/fatfs/fmap_bench.c does. */
+
+
+#define FF_USE_WCACHE     1
+#define FF_WCACHE_SECTORS (FF_MAX_SS == 512 ? 8 : 2)
+/* This option switches the sector write-back cache behind the window of each
+/  volume. (0:Disable or 1:Enable) It holds FF_WCACHE_SECTORS (1 to 32) recently
+/  used FAT and directory sectors, so the moves of the window between them do
+/  not read or write the medium. Dirty sectors are written in ascending LBA
+/  order at sync, or when evicted as the least recently used one. It is not
+/  used at the tiny buffer configuration. */
+
+
+#define FF_FS_EXFAT        1
 /* This option switches support for exFAT filesystem. (0:Disable or 1:Enable)
 /  To enable exFAT, also LFN needs to be enabled. (FF_USE_LFN >= 1)
 /  Note that enabling exFAT discards ANSI C (C89) compatibility. */
@@ -87,10 +87,18 @@
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS           0
+#define configGENERATE_RUN_TIME_STATS           1
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    0
 
+/* Run time counter based on the DWT cycle counter, implemented in stats.c */
+#if !defined(__IAR_SYSTEMS_ASM__) && !defined(__ASSEMBLER__)
+extern void stats_run_time_init(void);
+extern uint32_t stats_run_time(void);
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() stats_run_time_init()
+#define portGET_RUN_TIME_COUNTER_VALUE()        stats_run_time()
+
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES                   0
 #define configMAX_CO_ROUTINE_PRIORITIES         1
@@ -157,7 +165,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelay                      1
 #define INCLUDE_xTaskGetSchedulerState          1
 #define INCLUDE_xTaskGetCurrentTaskHandle       1
-#define INCLUDE_uxTaskGetStackHighWaterMark     0
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
 #define INCLUDE_xTaskGetIdleTaskHandle          0
 #define INCLUDE_eTaskGetState                   0
 #define INCLUDE_xEventGroupSetBitFromISR        1
@@ -0,0 +1,331 @@
+/*****************************************************************************
+* File Name: audio_dsp.c
+*
+* Description:
+*  This file contains the conditioning stage of the PCM samples, run in
+*  place on the PCM ring before the encoding: a DC blocker, a biquad
+*  high-pass filter and a gain with saturation. The Cortex-M4 path computes
+*  two samples of a channel at a time with the dual 16-bit multiply-
+*  accumulate instructions of the DSP extension. The scalar reference path
+*  gives the same samples, bit for bit.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "audio_dsp.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis_compiler.h"
+#endif
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_DSP_PI                3.14159265f
+
+/* Butterworth quality factor of the high-pass filter */
+#define AUDIO_DSP_HP_QUALITY        0.70710678f
+
+#define AUDIO_DSP_SAT16(x)          (((x) > INT16_MAX) ? INT16_MAX : (((x) < INT16_MIN) ? INT16_MIN : (x)))
+
+/* Halves of a pair of samples, the older one in the bottom half */
+#define AUDIO_DSP_LO(w)             ((int32_t) (int16_t) (w))
+#define AUDIO_DSP_HI(w)             ((int32_t) (int16_t) ((w) >> 16))
+
+/* Dual 16-bit instructions of the Cortex-M4, or their C equivalents to
+ * check the path on a host (AUDIO_DSP_SIMD_EMULATE) */
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define AUDIO_DSP_SIMD              1
+#define AUDIO_DSP_SMLAD(a, b, acc)  ((int32_t) __SMLAD((a), (b), (uint32_t) (acc)))
+#define AUDIO_DSP_SMLADX(a, b, acc) ((int32_t) __SMLADX((a), (b), (uint32_t) (acc)))
+#define AUDIO_DSP_PKHBT(a, b, s)    __PKHBT((a), (b), (s))
+#define AUDIO_DSP_PKHTB(a, b, s)    __PKHTB((a), (b), (s))
+#define AUDIO_DSP_SSAT16(x)         __SSAT((x), 16)
+#elif defined(AUDIO_DSP_SIMD_EMULATE)
+#define AUDIO_DSP_SIMD              1
+#define AUDIO_DSP_SMLAD(a, b, acc)  ((int32_t) ((uint32_t) (acc) + \
+                                    (uint32_t) (AUDIO_DSP_LO(a) * AUDIO_DSP_LO(b)) + \
+                                    (uint32_t) (AUDIO_DSP_HI(a) * AUDIO_DSP_HI(b))))
+#define AUDIO_DSP_SMLADX(a, b, acc) ((int32_t) ((uint32_t) (acc) + \
+                                    (uint32_t) (AUDIO_DSP_LO(a) * AUDIO_DSP_HI(b)) + \
+                                    (uint32_t) (AUDIO_DSP_HI(a) * AUDIO_DSP_LO(b))))
+#define AUDIO_DSP_PKHBT(a, b, s)    (((uint32_t) (a) & 0x0000FFFFu) | (((uint32_t) (b) << (s)) & 0xFFFF0000u))
+#define AUDIO_DSP_PKHTB(a, b, s)    (((uint32_t) (a) & 0xFFFF0000u) | ((uint32_t) ((int32_t) (b) >> (s)) & 0x0000FFFFu))
+#define AUDIO_DSP_SSAT16(x)         AUDIO_DSP_SAT16(x)
+#endif
+
+/*******************************************************************************
+* Function Name: audio_dsp_step
+********************************************************************************
+* Summary:
+*   Condition a sample of a channel, the reference arithmetic.
+*
+*******************************************************************************/
+static inline int16_t audio_dsp_step(const audio_dsp_t *dsp, audio_dsp_channel_t *ch, int32_t x)
+{
+    int32_t acc;
+    int32_t d;
+    int32_t y;
+
+    /* DC blocker: d = x - x[-1] + pole * d[-1] */
+    acc = ch->dc_err + ((x - ch->x[1]) * (1 << AUDIO_DSP_DC_Q)) + (dsp->dc_pole * ch->d[1]);
+    d = acc >> AUDIO_DSP_DC_Q;
+    d = AUDIO_DSP_SAT16(d);
+    ch->dc_err = acc & ((1 << AUDIO_DSP_DC_Q) - 1);
+
+    /* Biquad high-pass, direct form I */
+    acc = ch->hp_err + (dsp->b[0] * d) + (dsp->b[1] * ch->d[1]) + (dsp->b[2] * ch->d[0]) +
+          (dsp->a[0] * ch->y[1]) + (dsp->a[1] * ch->y[0]);
+    y = acc >> AUDIO_DSP_HP_Q;
+    y = AUDIO_DSP_SAT16(y);
+    ch->hp_err = acc & ((1 << AUDIO_DSP_HP_Q) - 1);
+
+    ch->x[0] = ch->x[1];
+    ch->x[1] = (int16_t) x;
+    ch->d[0] = ch->d[1];
+    ch->d[1] = (int16_t) d;
+    ch->y[0] = ch->y[1];
+    ch->y[1] = (int16_t) y;
+
+    /* Gain, rounded */
+    acc = ((y * dsp->gain) + (1 << (AUDIO_DSP_GAIN_Q - 1u))) >> AUDIO_DSP_GAIN_Q;
+    return (int16_t) AUDIO_DSP_SAT16(acc);
+}
+
+#if defined(AUDIO_DSP_SIMD)
+/*******************************************************************************
+* Function Name: audio_dsp_pair
+********************************************************************************
+* Summary:
+*   Condition two consecutive samples of a channel, packed in a word, with
+*   the dual multiply-accumulates: a pair of taps in one instruction, the
+*   exchanged form for the second output.
+*
+*******************************************************************************/
+static inline uint32_t audio_dsp_pair(const audio_dsp_t *dsp, audio_dsp_channel_t *ch, uint32_t x)
+{
+    uint32_t dc_coef = (uint32_t) (1u << AUDIO_DSP_DC_Q) | ((uint32_t) -(1 << AUDIO_DSP_DC_Q) << 16);
+    uint32_t b01 = (uint16_t) dsp->b[0] | ((uint32_t) (uint16_t) dsp->b[1] << 16);
+    uint32_t a21 = (uint16_t) dsp->a[1] | ((uint32_t) (uint16_t) dsp->a[0] << 16);
+    uint32_t xp;
+    uint32_t dp;
+    uint32_t yp;
+    uint32_t d;
+    uint32_t y;
+    int32_t acc;
+    int32_t out0;
+    int32_t out1;
+
+    memcpy(&xp, ch->x, sizeof(xp));
+    memcpy(&dp, ch->d, sizeof(dp));
+    memcpy(&yp, ch->y, sizeof(yp));
+
+    /* DC blocker: (x0, x[-1]) then exchanged (x0, x1) against (1, -1) */
+    acc = AUDIO_DSP_SMLAD(AUDIO_DSP_PKHBT(x, xp, 0), dc_coef, ch->dc_err) + (dsp->dc_pole * AUDIO_DSP_HI(dp));
+    out0 = AUDIO_DSP_SSAT16(acc >> AUDIO_DSP_DC_Q);
+    ch->dc_err = acc & ((1 << AUDIO_DSP_DC_Q) - 1);
+    acc = AUDIO_DSP_SMLADX(x, dc_coef, ch->dc_err) + (dsp->dc_pole * out0);
+    out1 = AUDIO_DSP_SSAT16(acc >> AUDIO_DSP_DC_Q);
+    ch->dc_err = acc & ((1 << AUDIO_DSP_DC_Q) - 1);
+    d = AUDIO_DSP_PKHBT((uint32_t) out0, (uint32_t) out1, 16);
+
+    /* High-pass: (d0, d[-1]) and (y[-2], y[-1]) pairs, then (d1, d0) and
+     * (y[-1], y0) */
+    acc = AUDIO_DSP_SMLAD(AUDIO_DSP_PKHBT(d, dp, 0), b01, ch->hp_err) + (dsp->b[2] * AUDIO_DSP_LO(dp));
+    acc = AUDIO_DSP_SMLAD(yp, a21, acc);
+    out0 = AUDIO_DSP_SSAT16(acc >> AUDIO_DSP_HP_Q);
+    ch->hp_err = acc & ((1 << AUDIO_DSP_HP_Q) - 1);
+    acc = AUDIO_DSP_SMLADX(d, b01, ch->hp_err) + (dsp->b[2] * AUDIO_DSP_HI(dp));
+    acc = AUDIO_DSP_SMLAD(AUDIO_DSP_PKHTB((uint32_t) out0 << 16, yp, 16), a21, acc);
+    out1 = AUDIO_DSP_SSAT16(acc >> AUDIO_DSP_HP_Q);
+    ch->hp_err = acc & ((1 << AUDIO_DSP_HP_Q) - 1);
+    y = AUDIO_DSP_PKHBT((uint32_t) out0, (uint32_t) out1, 16);
+
+    memcpy(ch->x, &x, sizeof(x));
+    memcpy(ch->d, &d, sizeof(d));
+    memcpy(ch->y, &y, sizeof(y));
+
+    /* Gain, rounded */
+    out0 = AUDIO_DSP_SSAT16(((out0 * dsp->gain) + (1 << (AUDIO_DSP_GAIN_Q - 1u))) >> AUDIO_DSP_GAIN_Q);
+    out1 = AUDIO_DSP_SSAT16(((out1 * dsp->gain) + (1 << (AUDIO_DSP_GAIN_Q - 1u))) >> AUDIO_DSP_GAIN_Q);
+    return AUDIO_DSP_PKHBT((uint32_t) out0, (uint32_t) out1, 16);
+}
+#endif /* AUDIO_DSP_SIMD */
+
+/*******************************************************************************
+* Function Name: audio_dsp_init
+********************************************************************************
+* Summary:
+*   Set up the stage for a record. The stage is off without high-pass
+*   filter and gain; otherwise the DC blocker always runs, so the gain does
+*   not amplify the offset of the microphone.
+*
+* Parameters:
+*   dsp = stage state
+*   sample_rate = frame rate in Hertz
+*   channels = 1 or 2, interleaved
+*   high_pass_hz = cutoff of the high-pass filter, 0 for none
+*   gain_db = gain, clamped to the supported range
+*
+*******************************************************************************/
+void audio_dsp_init(audio_dsp_t *dsp, uint32_t sample_rate, uint32_t channels, uint32_t high_pass_hz,
+                    int32_t gain_db)
+{
+    float w0;
+    float alpha;
+    float a0;
+    float cosw;
+
+    memset(dsp, 0, sizeof(audio_dsp_t));
+    dsp->channels = channels;
+
+    gain_db = (gain_db < AUDIO_DSP_GAIN_DB_MIN) ? AUDIO_DSP_GAIN_DB_MIN :
+              ((gain_db > AUDIO_DSP_GAIN_DB_MAX) ? AUDIO_DSP_GAIN_DB_MAX : gain_db);
+    if ((high_pass_hz * 4u) >= sample_rate)
+    {
+        high_pass_hz = 0;
+    }
+    dsp->enabled = (high_pass_hz != 0u) || (gain_db != 0);
+
+    dsp->dc_pole = (int16_t) ((1 << AUDIO_DSP_DC_Q) - (1 << (AUDIO_DSP_DC_Q - AUDIO_DSP_DC_SHIFT)));
+    dsp->gain = (int16_t) AUDIO_DSP_SAT16(lrintf(powf(10.0f, (float) gain_db / 20.0f) * (1 << AUDIO_DSP_GAIN_Q)));
+
+    if (high_pass_hz == 0u)
+    {
+        dsp->b[0] = (int16_t) (1 << AUDIO_DSP_HP_Q);
+        return;
+    }
+
+    /* Butterworth high-pass of the audio EQ cookbook */
+    w0 = 2.0f * AUDIO_DSP_PI * (float) high_pass_hz / (float) sample_rate;
+    cosw = cosf(w0);
+    alpha = sinf(w0) / (2.0f * AUDIO_DSP_HP_QUALITY);
+    a0 = 1.0f + alpha;
+    dsp->b[0] = (int16_t) lrintf(((1.0f + cosw) / 2.0f) / a0 * (1 << AUDIO_DSP_HP_Q));
+    dsp->b[1] = (int16_t) -(2 * dsp->b[0]);
+    dsp->b[2] = dsp->b[0];
+    dsp->a[0] = (int16_t) lrintf((2.0f * cosw) / a0 * (1 << AUDIO_DSP_HP_Q));
+    dsp->a[1] = (int16_t) lrintf(-(1.0f - alpha) / a0 * (1 << AUDIO_DSP_HP_Q));
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_process
+********************************************************************************
+* Summary:
+*   Condition PCM samples in place, two frames at a time with the DSP
+*   extension.
+*
+* Parameters:
+*   dsp = stage state
+*   buf = interleaved 16-bit samples
+*   len = length of the samples in bytes, a multiple of the frame size
+*
+*******************************************************************************/
+void audio_dsp_process(audio_dsp_t *dsp, uint8_t *buf, uint32_t len)
+{
+#if defined(AUDIO_DSP_SIMD)
+    uint32_t frame_size = dsp->channels * sizeof(int16_t);
+    uint32_t pairs = len / (2u * frame_size);
+    uint32_t left;
+    uint32_t right;
+    uint32_t word[2];
+
+    if (!dsp->enabled)
+    {
+        return;
+    }
+
+    for (; pairs > 0u; pairs--)
+    {
+        if (dsp->channels == 1u)
+        {
+            memcpy(&word[0], buf, sizeof(uint32_t));
+            word[0] = audio_dsp_pair(dsp, &dsp->state[0], word[0]);
+            memcpy(buf, &word[0], sizeof(uint32_t));
+        }
+        else
+        {
+            /* Split the two frames in a pair of each channel, and back */
+            memcpy(word, buf, sizeof(word));
+            left = audio_dsp_pair(dsp, &dsp->state[0], AUDIO_DSP_PKHBT(word[0], word[1], 16));
+            right = audio_dsp_pair(dsp, &dsp->state[1], AUDIO_DSP_PKHTB(word[1], word[0], 16));
+            word[0] = AUDIO_DSP_PKHBT(left, right, 16);
+            word[1] = AUDIO_DSP_PKHTB(right, left, 16);
+            memcpy(buf, word, sizeof(word));
+        }
+        buf += 2u * frame_size;
+    }
+
+    /* Odd frame */
+    audio_dsp_process_ref(dsp, buf, len % (2u * frame_size));
+#else
+    audio_dsp_process_ref(dsp, buf, len);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_process_ref
+********************************************************************************
+* Summary:
+*   Condition PCM samples in place, one sample at a time.
+*
+* Parameters:
+*   dsp = stage state
+*   buf = interleaved 16-bit samples
+*   len = length of the samples in bytes, a multiple of the frame size
+*
+*******************************************************************************/
+void audio_dsp_process_ref(audio_dsp_t *dsp, uint8_t *buf, uint32_t len)
+{
+    uint32_t samples = len / sizeof(int16_t);
+    uint32_t index;
+    int16_t sample;
+
+    if (!dsp->enabled)
+    {
+        return;
+    }
+
+    for (index = 0; index < samples; index++)
+    {
+        memcpy(&sample, &buf[index * sizeof(int16_t)], sizeof(sample));
+        sample = audio_dsp_step(dsp, &dsp->state[index % dsp->channels], sample);
+        memcpy(&buf[index * sizeof(int16_t)], &sample, sizeof(sample));
+    }
+}
+
+/* [] END OF FILE */
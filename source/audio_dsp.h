@@ -0,0 +1,101 @@
+/*****************************************************************************
+* File Name: audio_dsp.h
+*
+* Description:
+*  This file contains the constants, data types and function prototypes
+*  of the conditioning stage of the PCM samples (audio_dsp.c).
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef AUDIO_DSP_H_
+#define AUDIO_DSP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_DSP_CHANNELS_MAX      2u
+
+/* Fixed-point formats: DC blocker pole, high-pass coefficients and gain */
+#define AUDIO_DSP_DC_Q              14u
+#define AUDIO_DSP_HP_Q              13u
+#define AUDIO_DSP_GAIN_Q            12u
+
+/* DC blocker pole at 1 - 2^-10, a 7.5 Hz corner at 48 kHz */
+#define AUDIO_DSP_DC_SHIFT          10u
+
+/* Gain range in dB, limited by the Q12 format */
+#define AUDIO_DSP_GAIN_DB_MIN       (-12)
+#define AUDIO_DSP_GAIN_DB_MAX       18
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Filter state of a channel, the older sample first. The remainders of the
+ * outputs are fed back to the next ones, so the rounding noise is not
+ * amplified by the poles near DC. */
+typedef struct
+{
+    int16_t x[2];               /* Input */
+    int16_t d[2];               /* DC blocker output */
+    int16_t y[2];               /* High-pass output */
+    int32_t dc_err;
+    int32_t hp_err;
+} audio_dsp_channel_t;
+
+typedef struct
+{
+    bool enabled;
+    uint32_t channels;
+    int16_t dc_pole;            /* Q14 */
+    int16_t b[3];               /* Q13 high-pass numerator */
+    int16_t a[2];               /* Q13 high-pass denominator, negated */
+    int16_t gain;               /* Q12 */
+    audio_dsp_channel_t state[AUDIO_DSP_CHANNELS_MAX];
+} audio_dsp_t;
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void audio_dsp_init(audio_dsp_t *dsp, uint32_t sample_rate, uint32_t channels, uint32_t high_pass_hz,
+                    int32_t gain_db);
+void audio_dsp_process(audio_dsp_t *dsp, uint8_t *buf, uint32_t len);
+void audio_dsp_process_ref(audio_dsp_t *dsp, uint8_t *buf, uint32_t len);
+
+#endif /* AUDIO_DSP_H_ */
+
+/* [] END OF FILE */
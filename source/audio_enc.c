@@ -0,0 +1,755 @@
+/*****************************************************************************
+* File Name: audio_enc.c
+*
+* Description:
+*  This file contains the encoding stage of the recorder, between the PCM
+*  ring and the record file. The IMA-ADPCM encoder works in place: the
+*  4-bit codes of a ring block are written over its samples, so it needs
+*  no buffer of its own. The codes lag the samples, except for the first
+*  frames of a call when a block header and a partial group are pending,
+*  which are read from a copy. The record is a WAV file (format 0x11)
+*  whose header is rewritten with the final sizes when it is saved.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "audio_enc.h"
+
+#include <string.h>
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis_compiler.h"
+#endif
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_ENC_IMA_INDEX_MAX     88
+#define AUDIO_ENC_WAV_FORMAT_IMA    0x0011u
+
+/* Frames read from a copy at the start of a call, enough for the codes to
+ * lag the samples afterwards */
+#define AUDIO_ENC_LEAD_FRAMES       AUDIO_ENC_IMA_GROUP
+
+/* Zero bytes at the end of a block, up to the next header, taken as memory
+ * never written in a damaged record */
+#define AUDIO_ENC_IMA_ZERO_TAIL     32u
+
+/* Saturate to 16 bits, with the SSAT instruction of the Cortex-M4 DSP
+ * extension when available */
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define AUDIO_ENC_SAT16(x)          __SSAT((x), 16)
+#else
+#define AUDIO_ENC_SAT16(x)          (((x) > INT16_MAX) ? INT16_MAX : (((x) < INT16_MIN) ? INT16_MIN : (x)))
+#endif
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static const int16_t audio_enc_ima_steps[AUDIO_ENC_IMA_INDEX_MAX + 1] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t audio_enc_ima_index_adjust[8] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const char *const audio_enc_names[AUDIO_ENC_NUM] =
+{
+    "raw",
+    "adpcm",
+    "flac",
+};
+
+static const char *const audio_enc_exts[AUDIO_ENC_NUM] =
+{
+    "raw",
+    "wav",
+    "flac",
+};
+
+/*******************************************************************************
+* Function Name: audio_enc_ima_code
+********************************************************************************
+* Summary:
+*   Encode a sample in a 4-bit IMA-ADPCM code and update the predictor.
+*
+*******************************************************************************/
+static inline uint8_t audio_enc_ima_code(audio_enc_ima_t *ima, int32_t sample)
+{
+    int32_t step = audio_enc_ima_steps[ima->index];
+    int32_t diff = sample - ima->predictor;
+    int32_t delta = step >> 3;
+    int32_t index;
+    uint8_t code = 0;
+
+    if (diff < 0)
+    {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step)
+    {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        code |= 1;
+        delta += step;
+    }
+
+    diff = (code & 8) ? (ima->predictor - delta) : (ima->predictor + delta);
+    ima->predictor = (int16_t) AUDIO_ENC_SAT16(diff);
+
+    index = ima->index + audio_enc_ima_index_adjust[code & 7];
+    ima->index = (uint8_t) ((index < 0) ? 0 : ((index > AUDIO_ENC_IMA_INDEX_MAX) ? AUDIO_ENC_IMA_INDEX_MAX : index));
+
+    return code;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_ima_frame
+********************************************************************************
+* Summary:
+*   Encode a frame: it starts a block with its header, or joins the group of
+*   frames whose codes are written together.
+*
+* Return:
+*   Number of bytes written to out.
+*
+*******************************************************************************/
+static uint32_t audio_enc_ima_frame(audio_enc_t *enc, const int16_t *frame, uint8_t *out)
+{
+    uint32_t channel;
+    uint32_t index;
+    uint32_t pos = 0;
+    const int16_t *sample;
+
+    if (enc->block_pos == 0)
+    {
+        /* Block header: the first sample is stored as is */
+        for (channel = 0; channel < enc->channels; channel++)
+        {
+            enc->ima[channel].predictor = frame[channel];
+            out[pos++] = (uint8_t) frame[channel];
+            out[pos++] = (uint8_t) ((uint16_t) frame[channel] >> 8);
+            out[pos++] = enc->ima[channel].index;
+            out[pos++] = 0;
+        }
+        enc->block_pos = 1;
+        return pos;
+    }
+
+    memcpy(&enc->group[enc->group_frames * enc->channels], frame, enc->channels * sizeof(int16_t));
+    enc->group_frames++;
+    if (enc->group_frames < AUDIO_ENC_IMA_GROUP)
+    {
+        return 0;
+    }
+
+    /* Group: 4 bytes of codes per channel, the first sample in the low nibble */
+    for (channel = 0; channel < enc->channels; channel++)
+    {
+        sample = &enc->group[channel];
+        for (index = 0; index < AUDIO_ENC_IMA_GROUP; index += 2u)
+        {
+            out[pos] = audio_enc_ima_code(&enc->ima[channel], sample[index * enc->channels]);
+            out[pos++] |= (uint8_t) (audio_enc_ima_code(&enc->ima[channel], sample[(index + 1u) * enc->channels]) << 4);
+        }
+    }
+    enc->group_frames = 0;
+    enc->block_pos += AUDIO_ENC_IMA_GROUP;
+    if (enc->block_pos == enc->block_frames)
+    {
+        enc->block_pos = 0;
+    }
+    return pos;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_ima_check
+********************************************************************************
+* Summary:
+*   Check a block found in a damaged record against the header of the next
+*   one: the headers must be valid, and the step index carried from one block
+*   to the next must match the codes of the block. A block running into
+*   zeros, as left by an erased memory, is not valid: real audio gives them
+*   only in digital silence.
+*
+* Parameters:
+*   enc = encoder state, giving the channels
+*   block = candidate block, followed by the header of the next one
+*
+* Return:
+*   True if the block is valid.
+*
+*******************************************************************************/
+static bool audio_enc_ima_check(const audio_enc_t *enc, const uint8_t *block)
+{
+    const uint8_t *next = &block[enc->block_align];
+    const uint8_t *codes;
+    uint32_t channel;
+    uint32_t group;
+    uint32_t pos;
+    uint8_t any = 0;
+    int32_t index;
+
+    for (pos = enc->block_align - AUDIO_ENC_IMA_ZERO_TAIL; pos < (enc->block_align + (enc->channels * 4u)); pos++)
+    {
+        any |= block[pos];
+    }
+    if (any == 0u)
+    {
+        return false;
+    }
+
+    for (channel = 0; channel < enc->channels; channel++)
+    {
+        if ((block[(channel * 4u) + 2u] > AUDIO_ENC_IMA_INDEX_MAX) || (block[(channel * 4u) + 3u] != 0u) ||
+            (next[(channel * 4u) + 2u] > AUDIO_ENC_IMA_INDEX_MAX) || (next[(channel * 4u) + 3u] != 0u))
+        {
+            return false;
+        }
+
+        /* Groups of 4 bytes of codes per channel after the headers */
+        index = block[(channel * 4u) + 2u];
+        for (group = 0; group < ((enc->block_frames - 1u) / AUDIO_ENC_IMA_GROUP); group++)
+        {
+            codes = &block[(enc->channels * 4u) + (((group * enc->channels) + channel) * 4u)];
+            for (pos = 0; pos < 8u; pos++)
+            {
+                index += audio_enc_ima_index_adjust[(codes[pos / 2u] >> ((pos & 1u) * 4u)) & 7u];
+                index = (index < 0) ? 0 : ((index > AUDIO_ENC_IMA_INDEX_MAX) ? AUDIO_ENC_IMA_INDEX_MAX : index);
+            }
+        }
+
+        if (index != next[(channel * 4u) + 2u])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_flac_process
+********************************************************************************
+* Summary:
+*   Encode PCM samples in FLAC frames. The samples of a frame are copied
+*   before it is encoded, and the encoded data moves in place up to the
+*   samples copied. A frame larger than its samples leaves the excess pending
+*   for the next call. The room of the samples copied by an earlier call is
+*   lost, so the calls should hold whole FLAC frames, as the PCM blocks do.
+*
+* Return:
+*   Length of the encoded data at the start of buf.
+*
+*******************************************************************************/
+static uint32_t audio_enc_flac_process(audio_enc_t *enc, uint8_t *buf, uint32_t len)
+{
+    uint32_t frame_size = enc->channels * sizeof(int16_t);
+    uint32_t in = 0;
+    uint32_t out = 0;
+    uint32_t count;
+
+    while (in < len)
+    {
+        count = (AUDIO_FLAC_BLOCK_FRAMES - enc->flac_frames) * frame_size;
+        count = ((len - in) < count) ? (len - in) : count;
+        memcpy(&enc->flac_pcm[enc->flac_frames * enc->channels], &buf[in], count);
+        enc->flac_frames += count / frame_size;
+        in += count;
+
+        if (enc->flac_frames == AUDIO_FLAC_BLOCK_FRAMES)
+        {
+            if ((enc->flac_pending_len + AUDIO_FLAC_FRAME_SIZE_MAX) > AUDIO_ENC_FLAC_PENDING_SIZE)
+            {
+                /* Incompressible samples for seconds, the frame is dropped */
+                enc->overflow = true;
+            }
+            else
+            {
+                enc->flac_pending_len += audio_flac_frame(&enc->flac, enc->flac_pcm, AUDIO_FLAC_BLOCK_FRAMES,
+                                                          &enc->flac_pending[enc->flac_pending_len]);
+            }
+            enc->flac_frames = 0;
+        }
+
+        count = ((in - out) < enc->flac_pending_len) ? (in - out) : enc->flac_pending_len;
+        memcpy(&buf[out], enc->flac_pending, count);
+        memmove(enc->flac_pending, &enc->flac_pending[count], enc->flac_pending_len - count);
+        enc->flac_pending_len -= count;
+        out += count;
+    }
+
+    return out;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_flac_flush
+********************************************************************************
+* Summary:
+*   Encode the frames received as a shorter FLAC frame, after the data still
+*   pending.
+*
+* Parameters:
+*   enc = encoder state
+*
+* Return:
+*   Length of the data pending.
+*
+*******************************************************************************/
+static uint32_t audio_enc_flac_flush(audio_enc_t *enc)
+{
+    uint32_t out;
+
+    if ((enc->flac_frames > 0u) &&
+        ((enc->flac_pending_len + AUDIO_FLAC_FRAME_SIZE_MAX) <= AUDIO_ENC_FLAC_PENDING_SIZE))
+    {
+        enc->flac_pending_len += audio_flac_frame(&enc->flac, enc->flac_pcm, enc->flac_frames,
+                                                  &enc->flac_pending[enc->flac_pending_len]);
+    }
+    out = enc->flac_pending_len;
+    enc->flac_frames = 0;
+    enc->flac_pending_len = 0;
+    enc->data_size += out;
+
+    return out;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_init
+********************************************************************************
+* Summary:
+*   Start the encoding of a record.
+*
+* Parameters:
+*   enc = encoder state
+*   format = encoding of the record
+*   sample_rate = frame rate in Hertz
+*   channels = 1 or 2, interleaved
+*
+*******************************************************************************/
+void audio_enc_init(audio_enc_t *enc, audio_enc_format_t format, uint32_t sample_rate, uint32_t channels)
+{
+    memset(enc, 0, sizeof(audio_enc_t));
+    enc->format = format;
+    enc->sample_rate = sample_rate;
+    enc->channels = channels;
+    enc->block_align = AUDIO_ENC_IMA_BLOCK_SIZE * channels;
+    enc->block_frames = ((AUDIO_ENC_IMA_BLOCK_SIZE - 4u) * 2u) + 1u;
+    audio_flac_init(&enc->flac, sample_rate, channels);
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_process
+********************************************************************************
+* Summary:
+*   Encode PCM samples in place.
+*
+* Parameters:
+*   enc = encoder state
+*   buf = interleaved 16-bit samples, replaced by the encoded data
+*   len = length of the samples in bytes, a multiple of the frame size
+*
+* Return:
+*   Length of the encoded data at the start of buf.
+*
+*******************************************************************************/
+uint32_t audio_enc_process(audio_enc_t *enc, uint8_t *buf, uint32_t len)
+{
+    int16_t lead[AUDIO_ENC_LEAD_FRAMES * AUDIO_ENC_CHANNELS_MAX];
+    int16_t frame[AUDIO_ENC_CHANNELS_MAX];
+    uint32_t frame_size = enc->channels * sizeof(int16_t);
+    uint32_t frames = len / frame_size;
+    uint32_t lead_frames = (frames < AUDIO_ENC_LEAD_FRAMES) ? frames : AUDIO_ENC_LEAD_FRAMES;
+    uint32_t out = 0;
+    uint32_t index;
+
+    if (enc->format == AUDIO_ENC_RAW)
+    {
+        enc->frames += frames;
+        enc->data_size += len;
+        return len;
+    }
+
+    if (enc->format == AUDIO_ENC_FLAC)
+    {
+        out = audio_enc_flac_process(enc, buf, len);
+        enc->frames += frames;
+        enc->data_size += out;
+        return out;
+    }
+
+    memcpy(lead, buf, lead_frames * frame_size);
+    for (index = 0; index < frames; index++)
+    {
+        if (index < lead_frames)
+        {
+            out += audio_enc_ima_frame(enc, &lead[index * enc->channels], &buf[out]);
+        }
+        else
+        {
+            /* The frame is copied before its codes may overwrite it */
+            memcpy(frame, &buf[index * frame_size], frame_size);
+            out += audio_enc_ima_frame(enc, frame, &buf[out]);
+        }
+    }
+
+    enc->frames += frames;
+    enc->data_size += out;
+    return out;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_finish
+********************************************************************************
+* Summary:
+*   Complete the last block by repeating the last frame. The padding is not
+*   counted in the fact chunk, so the players drop it. A FLAC record ends
+*   with a shorter frame, after the data still pending.
+*
+* Parameters:
+*   enc = encoder state
+*   buf = destination, at least one block or AUDIO_ENC_FLAC_PENDING_SIZE
+*
+* Return:
+*   Length of the data written to buf.
+*
+*******************************************************************************/
+uint32_t audio_enc_finish(audio_enc_t *enc, uint8_t *buf)
+{
+    int16_t frame[AUDIO_ENC_CHANNELS_MAX];
+    uint32_t out = 0;
+    uint32_t channel;
+
+    if (enc->format == AUDIO_ENC_FLAC)
+    {
+        out = audio_enc_flac_flush(enc);
+        memcpy(buf, enc->flac_pending, out);
+        return out;
+    }
+
+    if ((enc->format == AUDIO_ENC_RAW) || ((enc->block_pos == 0) && (enc->group_frames == 0)))
+    {
+        return 0;
+    }
+
+    /* Last frame received, or the last predicted if the group is empty */
+    for (channel = 0; channel < enc->channels; channel++)
+    {
+        frame[channel] = (enc->group_frames > 0) ? enc->group[((enc->group_frames - 1u) * enc->channels) + channel] :
+                                                   enc->ima[channel].predictor;
+    }
+
+    while ((enc->block_pos != 0) || (enc->group_frames != 0))
+    {
+        out += audio_enc_ima_frame(enc, frame, &buf[out]);
+    }
+
+    enc->data_size += out;
+    return out;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_split
+********************************************************************************
+* Summary:
+*   End a segment of the record, and start the next one without gap. The last
+*   block or frame of the segment is completed in the pending buffer of the
+*   encoder, so no buffer of the caller is needed, and the header is built
+*   with the sizes of the segment. The sizes and the FLAC stream then start
+*   over.
+*
+* Parameters:
+*   enc = encoder state
+*   header = destination, AUDIO_ENC_HEADER_SIZE_MAX bytes
+*   header_len = set to the length of the header, 0 for raw records
+*   data = set to the end of the segment, valid until the next block is
+*          encoded
+*
+* Return:
+*   Length of the end of the segment.
+*
+*******************************************************************************/
+uint32_t audio_enc_split(audio_enc_t *enc, uint8_t *header, uint32_t *header_len, const uint8_t **data)
+{
+    uint32_t out;
+
+    /* The pending buffer is not used by IMA-ADPCM, and holds a block */
+    if (enc->format == AUDIO_ENC_FLAC)
+    {
+        out = audio_enc_flac_flush(enc);
+    }
+    else
+    {
+        out = audio_enc_finish(enc, enc->flac_pending);
+    }
+    *data = enc->flac_pending;
+    *header_len = audio_enc_header(enc, header);
+
+    enc->frames = 0;
+    enc->data_size = 0;
+    audio_flac_init(&enc->flac, enc->sample_rate, enc->channels);
+
+    return out;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_header
+********************************************************************************
+* Summary:
+*   Build the header of the record file with the current sizes.
+*
+* Parameters:
+*   enc = encoder state
+*   header = destination, AUDIO_ENC_HEADER_SIZE_MAX bytes
+*
+* Return:
+*   Length of the header, 0 for raw records.
+*
+*******************************************************************************/
+uint32_t audio_enc_header(const audio_enc_t *enc, uint8_t *header)
+{
+    uint32_t fields[] =
+    {
+        0x46464952u,                                /* "RIFF" */
+        AUDIO_ENC_WAV_HEADER_SIZE - 8u + enc->data_size,
+        0x45564157u,                                /* "WAVE" */
+        0x20746D66u,                                /* "fmt " */
+        20u,
+        AUDIO_ENC_WAV_FORMAT_IMA | (enc->channels << 16),
+        enc->sample_rate,
+        (uint32_t) (((uint64_t) enc->sample_rate * enc->block_align) / enc->block_frames),
+        enc->block_align | (4u << 16),              /* 4 bits per sample */
+        2u | (enc->block_frames << 16),             /* Extra size, frames per block */
+        0x74636166u,                                /* "fact" */
+        4u,
+        enc->frames,
+        0x61746164u,                                /* "data" */
+        enc->data_size,
+    };
+    uint32_t index;
+
+    if (enc->format == AUDIO_ENC_RAW)
+    {
+        return 0;
+    }
+
+    if (enc->format == AUDIO_ENC_FLAC)
+    {
+        return audio_flac_header(&enc->flac, header);
+    }
+
+    /* Little-endian fields */
+    for (index = 0; index < (sizeof(fields) / sizeof(fields[0])); index++)
+    {
+        header[(index * 4u) + 0u] = (uint8_t) fields[index];
+        header[(index * 4u) + 1u] = (uint8_t) (fields[index] >> 8);
+        header[(index * 4u) + 2u] = (uint8_t) (fields[index] >> 16);
+        header[(index * 4u) + 3u] = (uint8_t) (fields[index] >> 24);
+    }
+    return AUDIO_ENC_WAV_HEADER_SIZE;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_parse_header
+********************************************************************************
+* Summary:
+*   Start the encoder state of a record from its file header, to check and
+*   complete a damaged record.
+*
+* Parameters:
+*   enc = encoder state
+*   format = encoding of the record, other than raw
+*   header = file header
+*   len = bytes available at header
+*
+* Return:
+*   Length of the header, 0 if it is not a header of the encoder.
+*
+*******************************************************************************/
+uint32_t audio_enc_parse_header(audio_enc_t *enc, audio_enc_format_t format, const uint8_t *header, uint32_t len)
+{
+    uint32_t sample_rate;
+    uint32_t channels;
+
+    if ((format == AUDIO_ENC_FLAC) && (len >= AUDIO_FLAC_HEADER_SIZE) && (memcmp(header, "fLaC", 4u) == 0))
+    {
+        /* STREAMINFO: 20 bits of sample rate, then 3 bits of channels - 1 */
+        sample_rate = ((uint32_t) header[18] << 12) | ((uint32_t) header[19] << 4) | (header[20] >> 4);
+        channels = ((header[20] >> 1) & 0x7u) + 1u;
+        len = AUDIO_FLAC_HEADER_SIZE;
+    }
+    else if ((format == AUDIO_ENC_IMA_ADPCM) && (len >= AUDIO_ENC_WAV_HEADER_SIZE) &&
+             (memcmp(header, "RIFF", 4u) == 0) && (memcmp(&header[8], "WAVE", 4u) == 0) &&
+             (header[20] == AUDIO_ENC_WAV_FORMAT_IMA))
+    {
+        channels = header[22];
+        sample_rate = (uint32_t) header[24] | ((uint32_t) header[25] << 8) | ((uint32_t) header[26] << 16);
+        len = AUDIO_ENC_WAV_HEADER_SIZE;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if ((channels == 0u) || (channels > AUDIO_ENC_CHANNELS_MAX) || (sample_rate == 0u))
+    {
+        return 0;
+    }
+
+    audio_enc_init(enc, format, sample_rate, channels);
+
+    return len;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_check
+********************************************************************************
+* Summary:
+*   Check the FLAC frame or IMA-ADPCM block found in a damaged record. A unit
+*   is valid only if the next one follows it, so the last one in the data
+*   never is. The sizes of the encoder are updated to end after the unit.
+*
+* Parameters:
+*   enc = encoder state, from audio_enc_parse_header()
+*   pos = offset of the unit in the encoded data
+*   data = candidate unit
+*   len = bytes available at data, AUDIO_ENC_CHECK_SIZE to check any unit
+*
+* Return:
+*   Length of the unit, 0 if it is not valid.
+*
+*******************************************************************************/
+uint32_t audio_enc_check(audio_enc_t *enc, uint32_t pos, const uint8_t *data, uint32_t len)
+{
+    uint32_t num;
+    uint32_t frames;
+    uint32_t size = 0;
+
+    if (enc->format == AUDIO_ENC_FLAC)
+    {
+        size = audio_flac_check(&enc->flac, data, len, &num, &frames);
+        if (size > 0u)
+        {
+            enc->frames = (num * AUDIO_FLAC_BLOCK_FRAMES) + frames;
+            enc->flac.frames = enc->frames;
+            enc->flac.frame_num = num + 1u;
+        }
+    }
+    else if ((enc->format == AUDIO_ENC_IMA_ADPCM) && ((pos % enc->block_align) == 0u) &&
+             (len >= (enc->block_align + (enc->channels * 4u))) && audio_enc_ima_check(enc, data))
+    {
+        size = enc->block_align;
+        enc->frames = ((pos / enc->block_align) + 1u) * enc->block_frames;
+    }
+
+    if (size > 0u)
+    {
+        enc->data_size = pos + size;
+    }
+
+    return size;
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_name
+********************************************************************************
+* Summary:
+*   Name of an encoding in config.txt.
+*
+*******************************************************************************/
+const char *audio_enc_name(audio_enc_format_t format)
+{
+    return audio_enc_names[format];
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_ext
+********************************************************************************
+* Summary:
+*   File extension of the records of an encoding.
+*
+*******************************************************************************/
+const char *audio_enc_ext(audio_enc_format_t format)
+{
+    return audio_enc_exts[format];
+}
+
+/*******************************************************************************
+* Function Name: audio_enc_parse
+********************************************************************************
+* Summary:
+*   Find the encoding named at the start of a string.
+*
+* Return:
+*   False if the name is unknown.
+*
+*******************************************************************************/
+bool audio_enc_parse(const char *str, audio_enc_format_t *format)
+{
+    uint32_t index;
+
+    for (index = 0; index < AUDIO_ENC_NUM; index++)
+    {
+        if (strncmp(str, audio_enc_names[index], strlen(audio_enc_names[index])) == 0)
+        {
+            *format = (audio_enc_format_t) index;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* [] END OF FILE */
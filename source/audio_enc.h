@@ -0,0 +1,134 @@
+/*****************************************************************************
+* File Name: audio_enc.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the audio_enc.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef AUDIO_ENC_H_
+#define AUDIO_ENC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_flac.h"
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_ENC_CHANNELS_MAX      2u
+
+/* IMA-ADPCM block per channel: a 4-byte header holding the first sample,
+ * then 4-bit codes for the others, 1017 samples in 512 bytes */
+#define AUDIO_ENC_IMA_BLOCK_SIZE    512u
+#define AUDIO_ENC_IMA_GROUP         8u
+
+/* RIFF, fmt, fact and data chunk headers of a WAV file */
+#define AUDIO_ENC_WAV_HEADER_SIZE   60u
+
+/* Largest header of the encodings */
+#define AUDIO_ENC_HEADER_SIZE_MAX   AUDIO_ENC_WAV_HEADER_SIZE
+
+/* Data needed by audio_enc_check() to check any unit: a FLAC frame, or an
+ * IMA-ADPCM block, and the header of the next one */
+#define AUDIO_ENC_CHECK_SIZE        (AUDIO_FLAC_FRAME_SIZE_MAX + 16u)
+
+/* Encoded FLAC frames waiting for the room of their samples in place: one
+ * frame, and the excess of the frames larger than their samples. Also
+ * holds the last IMA-ADPCM block of a segment */
+#define AUDIO_ENC_FLAC_PENDING_SIZE (2u * AUDIO_FLAC_FRAME_SIZE_MAX)
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Record encodings, selected with ENCODING in config.txt */
+typedef enum
+{
+    AUDIO_ENC_RAW = 0,          /* 16-bit PCM without header */
+    AUDIO_ENC_IMA_ADPCM,        /* 4-bit IMA-ADPCM in a WAV file */
+    AUDIO_ENC_FLAC,             /* Lossless, FLAC subset */
+    AUDIO_ENC_NUM
+} audio_enc_format_t;
+
+typedef struct
+{
+    int16_t predictor;
+    uint8_t index;
+} audio_enc_ima_t;
+
+/* Encoder state, kept between the PCM blocks of a record */
+typedef struct
+{
+    audio_enc_format_t format;
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t block_align;       /* Bytes per block, all channels */
+    uint32_t block_frames;      /* Frames per block */
+    uint32_t block_pos;         /* Frames encoded in the current block */
+    audio_enc_ima_t ima[AUDIO_ENC_CHANNELS_MAX];
+    int16_t group[AUDIO_ENC_IMA_GROUP * AUDIO_ENC_CHANNELS_MAX];
+    uint32_t group_frames;      /* Frames waiting for a full group */
+    uint32_t frames;            /* Frames received */
+    uint32_t data_size;         /* Bytes produced */
+
+    /* Lossless encoding: the samples of the FLAC frame being filled, and
+     * the encoded data not yet written in place */
+    audio_flac_t flac;
+    int16_t flac_pcm[AUDIO_FLAC_BLOCK_FRAMES * AUDIO_ENC_CHANNELS_MAX];
+    uint32_t flac_frames;
+    uint8_t flac_pending[AUDIO_ENC_FLAC_PENDING_SIZE];
+    uint32_t flac_pending_len;
+    bool overflow;              /* Samples dropped, the record must stop */
+} audio_enc_t;
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void        audio_enc_init(audio_enc_t *enc, audio_enc_format_t format, uint32_t sample_rate, uint32_t channels);
+uint32_t    audio_enc_process(audio_enc_t *enc, uint8_t *buf, uint32_t len);
+uint32_t    audio_enc_finish(audio_enc_t *enc, uint8_t *buf);
+uint32_t    audio_enc_split(audio_enc_t *enc, uint8_t *header, uint32_t *header_len, const uint8_t **data);
+uint32_t    audio_enc_header(const audio_enc_t *enc, uint8_t *header);
+uint32_t    audio_enc_parse_header(audio_enc_t *enc, audio_enc_format_t format, const uint8_t *header, uint32_t len);
+uint32_t    audio_enc_check(audio_enc_t *enc, uint32_t pos, const uint8_t *data, uint32_t len);
+const char *audio_enc_name(audio_enc_format_t format);
+const char *audio_enc_ext(audio_enc_format_t format);
+bool        audio_enc_parse(const char *str, audio_enc_format_t *format);
+
+#endif /* AUDIO_ENC_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,922 @@
+/*****************************************************************************
+* File Name: audio_flac.c
+*
+* Description:
+*  This file contains the lossless encoder of the records, a subset of FLAC:
+*  fixed linear predictors of order 0 to 4, with the stereo decorrelation
+*  modes, Rice-coded residuals in partitions, and a CRC-8 and a CRC-16 in
+*  each frame. The frames start with a sync code and their number, so a
+*  decoder can seek in a record, and the STREAMINFO block holds the totals.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "audio_flac.h"
+
+#include <string.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_FLAC_BPS              16u
+#define AUDIO_FLAC_PUT_BITS_MAX     24u
+
+/* 4-bit Rice parameters, 15 is the escape code */
+#define AUDIO_FLAC_RICE_PARAM_MAX   14u
+
+/* Subframe types */
+#define AUDIO_FLAC_TYPE_CONSTANT    0x00u
+#define AUDIO_FLAC_TYPE_VERBATIM    0x01u
+#define AUDIO_FLAC_TYPE_FIXED       0x08u
+
+/* Frame header fields */
+#define AUDIO_FLAC_SYNC             0xFFF8u
+#define AUDIO_FLAC_SAMPLE_SIZE_16   0x4u
+#define AUDIO_FLAC_BLOCK_SIZE_8BIT  0x6u
+#define AUDIO_FLAC_BLOCK_SIZE_16BIT 0x7u
+#define AUDIO_FLAC_RATE_KHZ         0xCu
+#define AUDIO_FLAC_RATE_HZ          0xDu
+#define AUDIO_FLAC_RATE_10HZ        0xEu
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Signals coded in the subframes */
+typedef enum
+{
+    AUDIO_FLAC_LEFT = 0,            /* Also the single channel of mono */
+    AUDIO_FLAC_RIGHT,
+    AUDIO_FLAC_SIDE,                /* Left - right, 17 bits */
+    AUDIO_FLAC_MID,                 /* (Left + right) / 2 */
+    AUDIO_FLAC_SIGNAL_NUM
+} audio_flac_signal_t;
+
+/* MSB-first bit writer */
+typedef struct
+{
+    uint8_t *buf;
+    uint32_t pos;
+    uint32_t acc;
+    uint32_t bits;
+} audio_flac_bits_t;
+
+/* Coding chosen for a subframe */
+typedef struct
+{
+    uint8_t  type;
+    uint8_t  order;
+    uint8_t  partition;
+    uint8_t  params[1u << AUDIO_FLAC_PARTITION_MAX];
+    uint32_t bits;
+} audio_flac_subframe_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+/* Stereo channel assignments, and their signals in subframe order */
+static const struct
+{
+    uint8_t code;
+    uint8_t signals[AUDIO_FLAC_CHANNELS_MAX];
+} audio_flac_assignments[] =
+{
+    { 0x1u, { AUDIO_FLAC_LEFT, AUDIO_FLAC_RIGHT } },
+    { 0x8u, { AUDIO_FLAC_LEFT, AUDIO_FLAC_SIDE  } },
+    { 0x9u, { AUDIO_FLAC_SIDE, AUDIO_FLAC_RIGHT } },
+    { 0xAu, { AUDIO_FLAC_MID,  AUDIO_FLAC_SIDE  } },
+};
+
+/* Sample rates with a code of their own in the frame header */
+static const uint32_t audio_flac_rates[] =
+{
+    0u, 88200u, 176400u, 192000u, 8000u, 16000u, 22050u, 24000u, 32000u, 44100u, 48000u, 96000u
+};
+
+/* CRC-16 of the frames, polynomial 0x8005 */
+static const uint16_t audio_flac_crc16_table[256] =
+{
+    0x0000, 0x8005, 0x800F, 0x000A, 0x801B, 0x001E, 0x0014, 0x8011,
+    0x8033, 0x0036, 0x003C, 0x8039, 0x0028, 0x802D, 0x8027, 0x0022,
+    0x8063, 0x0066, 0x006C, 0x8069, 0x0078, 0x807D, 0x8077, 0x0072,
+    0x0050, 0x8055, 0x805F, 0x005A, 0x804B, 0x004E, 0x0044, 0x8041,
+    0x80C3, 0x00C6, 0x00CC, 0x80C9, 0x00D8, 0x80DD, 0x80D7, 0x00D2,
+    0x00F0, 0x80F5, 0x80FF, 0x00FA, 0x80EB, 0x00EE, 0x00E4, 0x80E1,
+    0x00A0, 0x80A5, 0x80AF, 0x00AA, 0x80BB, 0x00BE, 0x00B4, 0x80B1,
+    0x8093, 0x0096, 0x009C, 0x8099, 0x0088, 0x808D, 0x8087, 0x0082,
+    0x8183, 0x0186, 0x018C, 0x8189, 0x0198, 0x819D, 0x8197, 0x0192,
+    0x01B0, 0x81B5, 0x81BF, 0x01BA, 0x81AB, 0x01AE, 0x01A4, 0x81A1,
+    0x01E0, 0x81E5, 0x81EF, 0x01EA, 0x81FB, 0x01FE, 0x01F4, 0x81F1,
+    0x81D3, 0x01D6, 0x01DC, 0x81D9, 0x01C8, 0x81CD, 0x81C7, 0x01C2,
+    0x0140, 0x8145, 0x814F, 0x014A, 0x815B, 0x015E, 0x0154, 0x8151,
+    0x8173, 0x0176, 0x017C, 0x8179, 0x0168, 0x816D, 0x8167, 0x0162,
+    0x8123, 0x0126, 0x012C, 0x8129, 0x0138, 0x813D, 0x8137, 0x0132,
+    0x0110, 0x8115, 0x811F, 0x011A, 0x810B, 0x010E, 0x0104, 0x8101,
+    0x8303, 0x0306, 0x030C, 0x8309, 0x0318, 0x831D, 0x8317, 0x0312,
+    0x0330, 0x8335, 0x833F, 0x033A, 0x832B, 0x032E, 0x0324, 0x8321,
+    0x0360, 0x8365, 0x836F, 0x036A, 0x837B, 0x037E, 0x0374, 0x8371,
+    0x8353, 0x0356, 0x035C, 0x8359, 0x0348, 0x834D, 0x8347, 0x0342,
+    0x03C0, 0x83C5, 0x83CF, 0x03CA, 0x83DB, 0x03DE, 0x03D4, 0x83D1,
+    0x83F3, 0x03F6, 0x03FC, 0x83F9, 0x03E8, 0x83ED, 0x83E7, 0x03E2,
+    0x83A3, 0x03A6, 0x03AC, 0x83A9, 0x03B8, 0x83BD, 0x83B7, 0x03B2,
+    0x0390, 0x8395, 0x839F, 0x039A, 0x838B, 0x038E, 0x0384, 0x8381,
+    0x0280, 0x8285, 0x828F, 0x028A, 0x829B, 0x029E, 0x0294, 0x8291,
+    0x82B3, 0x02B6, 0x02BC, 0x82B9, 0x02A8, 0x82AD, 0x82A7, 0x02A2,
+    0x82E3, 0x02E6, 0x02EC, 0x82E9, 0x02F8, 0x82FD, 0x82F7, 0x02F2,
+    0x02D0, 0x82D5, 0x82DF, 0x02DA, 0x82CB, 0x02CE, 0x02C4, 0x82C1,
+    0x8243, 0x0246, 0x024C, 0x8249, 0x0258, 0x825D, 0x8257, 0x0252,
+    0x0270, 0x8275, 0x827F, 0x027A, 0x826B, 0x026E, 0x0264, 0x8261,
+    0x0220, 0x8225, 0x822F, 0x022A, 0x823B, 0x023E, 0x0234, 0x8231,
+    0x8213, 0x0216, 0x021C, 0x8219, 0x0208, 0x820D, 0x8207, 0x0202,
+};
+
+/*******************************************************************************
+* Function Name: audio_flac_put
+********************************************************************************
+* Summary:
+*   Append up to 24 bits to the bit writer.
+*
+*******************************************************************************/
+static inline void audio_flac_put(audio_flac_bits_t *bw, uint32_t value, uint32_t count)
+{
+    bw->acc = (bw->acc << count) | (value & ((1u << count) - 1u));
+    bw->bits += count;
+    while (bw->bits >= 8u)
+    {
+        bw->bits -= 8u;
+        bw->buf[bw->pos++] = (uint8_t) (bw->acc >> bw->bits);
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_put_rice
+********************************************************************************
+* Summary:
+*   Append a residual with its Rice code: the quotient in unary, then the
+*   low bits.
+*
+*******************************************************************************/
+static inline void audio_flac_put_rice(audio_flac_bits_t *bw, int32_t residual, uint32_t param)
+{
+    uint32_t value = ((uint32_t) residual << 1) ^ (uint32_t) (residual >> 31);
+    uint32_t quotient = value >> param;
+    uint32_t low = value & ((1u << param) - 1u);
+
+    if ((quotient + 1u + param) <= AUDIO_FLAC_PUT_BITS_MAX)
+    {
+        audio_flac_put(bw, (1u << param) | low, quotient + 1u + param);
+        return;
+    }
+
+    while (quotient >= AUDIO_FLAC_PUT_BITS_MAX)
+    {
+        audio_flac_put(bw, 0, AUDIO_FLAC_PUT_BITS_MAX);
+        quotient -= AUDIO_FLAC_PUT_BITS_MAX;
+    }
+    audio_flac_put(bw, 1u, quotient + 1u);
+    audio_flac_put(bw, low, param);
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_sample
+********************************************************************************
+* Summary:
+*   Sample of a signal, from the interleaved PCM frames.
+*
+*******************************************************************************/
+static inline int32_t audio_flac_sample(const int16_t *pcm, uint32_t channels, audio_flac_signal_t signal,
+                                        uint32_t index)
+{
+    const int16_t *frame = &pcm[index * channels];
+
+    switch (signal)
+    {
+        case AUDIO_FLAC_RIGHT:
+            return frame[1];
+        case AUDIO_FLAC_SIDE:
+            return (int32_t) frame[0] - frame[1];
+        case AUDIO_FLAC_MID:
+            return ((int32_t) frame[0] + frame[1]) >> 1;
+        default:
+            return frame[0];
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_fixed
+********************************************************************************
+* Summary:
+*   Residual of a fixed predictor, from the last samples, newest first.
+*
+*******************************************************************************/
+static inline int32_t audio_flac_fixed(const int32_t *history, uint32_t order)
+{
+    switch (order)
+    {
+        case 0:
+            return history[0];
+        case 1:
+            return history[0] - history[1];
+        case 2:
+            return history[0] - (2 * history[1]) + history[2];
+        case 3:
+            return history[0] - (3 * (history[1] - history[2])) - history[3];
+        default:
+            return history[0] - (4 * (history[1] + history[3])) + (6 * history[2]) + history[4];
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_rice_bits
+********************************************************************************
+* Summary:
+*   Find the Rice parameter coding a partition in the fewest bits. The sum
+*   of the quotients never exceeds the quotient of the sum, so the partition
+*   never takes more bits than counted.
+*
+* Parameters:
+*   sum = sum of the residuals mapped to unsigned values
+*   count = number of residuals
+*   param = best parameter
+*
+* Return:
+*   Bits of the residuals with the best parameter.
+*
+*******************************************************************************/
+static uint32_t audio_flac_rice_bits(uint64_t sum, uint32_t count, uint8_t *param)
+{
+    uint64_t bits;
+    uint64_t best = UINT64_MAX;
+    uint32_t index;
+
+    /* The size is convex in the parameter */
+    for (index = 0; index <= AUDIO_FLAC_RICE_PARAM_MAX; index++)
+    {
+        bits = ((uint64_t) count * (index + 1u)) + (sum >> index);
+        if (bits >= best)
+        {
+            break;
+        }
+        best = bits;
+        *param = (uint8_t) index;
+    }
+    return (uint32_t) best;
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_analyze
+********************************************************************************
+* Summary:
+*   Choose the predictor order of a signal, from the residuals of all the
+*   orders computed in a single pass, and estimate the subframe size.
+*
+* Return:
+*   Estimated bits of the subframe.
+*
+*******************************************************************************/
+static uint32_t audio_flac_analyze(const int16_t *pcm, uint32_t frames, uint32_t channels,
+                                   audio_flac_signal_t signal, audio_flac_subframe_t *sub)
+{
+    uint32_t sums[AUDIO_FLAC_ORDER_MAX + 1u] = { 0 };
+    int32_t last[AUDIO_FLAC_ORDER_MAX] = { 0 };
+    int32_t error[AUDIO_FLAC_ORDER_MAX + 1u];
+    uint32_t bps = AUDIO_FLAC_BPS + ((signal == AUDIO_FLAC_SIDE) ? 1u : 0u);
+    uint32_t index;
+    uint32_t order;
+    uint32_t bits;
+    uint8_t param;
+    bool constant = true;
+
+    for (index = 0; index < frames; index++)
+    {
+        /* Residual of each order is the difference of the previous order */
+        error[0] = audio_flac_sample(pcm, channels, signal, index);
+        for (order = 1; order <= AUDIO_FLAC_ORDER_MAX; order++)
+        {
+            error[order] = error[order - 1u] - last[order - 1u];
+        }
+        if (index > 0)
+        {
+            constant = constant && (error[1] == 0);
+        }
+        if (index >= AUDIO_FLAC_ORDER_MAX)
+        {
+            for (order = 0; order <= AUDIO_FLAC_ORDER_MAX; order++)
+            {
+                sums[order] += (uint32_t) ((error[order] < 0) ? -error[order] : error[order]);
+            }
+        }
+        memcpy(last, error, sizeof(last));
+    }
+
+    if (constant)
+    {
+        sub->type = AUDIO_FLAC_TYPE_CONSTANT;
+        sub->order = 0;
+        return 8u + bps;
+    }
+
+    sub->type = AUDIO_FLAC_TYPE_FIXED;
+    sub->order = 0;
+    for (order = 1; (order <= AUDIO_FLAC_ORDER_MAX) && (order < frames); order++)
+    {
+        if (sums[order] < sums[sub->order])
+        {
+            sub->order = (uint8_t) order;
+        }
+    }
+
+    /* Mapped to unsigned, the residuals double */
+    bits = 8u + 6u + 4u + (sub->order * bps) +
+           audio_flac_rice_bits(2u * (uint64_t) sums[sub->order], frames - sub->order, &param);
+    return (bits < (8u + (frames * bps))) ? bits : (8u + (frames * bps));
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_plan
+********************************************************************************
+* Summary:
+*   Choose the Rice partitions and parameters of a subframe from the sums of
+*   its residuals in the smallest partitions, merged two by two for the
+*   larger ones. The subframe is stored verbatim if the coding is larger.
+*
+*******************************************************************************/
+static void audio_flac_plan(const int16_t *pcm, uint32_t frames, uint32_t channels,
+                            audio_flac_signal_t signal, audio_flac_subframe_t *sub)
+{
+    uint64_t sums[1u << AUDIO_FLAC_PARTITION_MAX];
+    uint8_t params[1u << AUDIO_FLAC_PARTITION_MAX];
+    int32_t history[AUDIO_FLAC_ORDER_MAX + 1u] = { 0 };
+    uint32_t bps = AUDIO_FLAC_BPS + ((signal == AUDIO_FLAC_SIDE) ? 1u : 0u);
+    uint32_t partition;
+    uint32_t size;
+    uint32_t index;
+    uint32_t bits;
+    uint32_t best = UINT32_MAX;
+    int32_t residual;
+
+    if (sub->type == AUDIO_FLAC_TYPE_CONSTANT)
+    {
+        sub->bits = 8u + bps;
+        return;
+    }
+
+    /* Smallest partitions: the block splits evenly, and the first one holds
+     * more than the warm-up samples */
+    for (partition = AUDIO_FLAC_PARTITION_MAX; partition > 0u; partition--)
+    {
+        if (((frames & ((1u << partition) - 1u)) == 0u) && ((frames >> partition) > sub->order))
+        {
+            break;
+        }
+    }
+    size = frames >> partition;
+
+    memset(sums, 0, sizeof(sums));
+    for (index = 0; index < frames; index++)
+    {
+        memmove(&history[1], &history[0], AUDIO_FLAC_ORDER_MAX * sizeof(int32_t));
+        history[0] = audio_flac_sample(pcm, channels, signal, index);
+        if (index >= sub->order)
+        {
+            residual = audio_flac_fixed(history, sub->order);
+            sums[index / size] += ((uint32_t) residual << 1) ^ (uint32_t) (residual >> 31);
+        }
+    }
+
+    for (;;)
+    {
+        bits = 0;
+        for (index = 0; index < (1u << partition); index++)
+        {
+            bits += 4u + audio_flac_rice_bits(sums[index], (frames >> partition) - ((index == 0u) ? sub->order : 0u),
+                                             &params[index]);
+        }
+        if (bits < best)
+        {
+            best = bits;
+            sub->partition = (uint8_t) partition;
+            memcpy(sub->params, params, sizeof(params));
+        }
+        if (partition == 0u)
+        {
+            break;
+        }
+        partition--;
+        for (index = 0; index < (1u << partition); index++)
+        {
+            sums[index] = sums[2u * index] + sums[(2u * index) + 1u];
+        }
+    }
+
+    sub->bits = 8u + (sub->order * bps) + 6u + best;
+    if (sub->bits >= (8u + (frames * bps)))
+    {
+        sub->type = AUDIO_FLAC_TYPE_VERBATIM;
+        sub->order = 0;
+        sub->bits = 8u + (frames * bps);
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_subframe
+********************************************************************************
+* Summary:
+*   Write a subframe with the coding planned.
+*
+*******************************************************************************/
+static void audio_flac_subframe(audio_flac_bits_t *bw, const int16_t *pcm, uint32_t frames, uint32_t channels,
+                                audio_flac_signal_t signal, const audio_flac_subframe_t *sub)
+{
+    int32_t history[AUDIO_FLAC_ORDER_MAX + 1u] = { 0 };
+    uint32_t bps = AUDIO_FLAC_BPS + ((signal == AUDIO_FLAC_SIDE) ? 1u : 0u);
+    uint32_t size = frames >> sub->partition;
+    uint32_t partition;
+    uint32_t index = 0;
+    uint32_t end;
+
+    /* Zero padding bit, type, no wasted bits */
+    audio_flac_put(bw, (uint32_t) (sub->type | sub->order) << 1, 8u);
+
+    if (sub->type == AUDIO_FLAC_TYPE_CONSTANT)
+    {
+        audio_flac_put(bw, (uint32_t) audio_flac_sample(pcm, channels, signal, 0), bps);
+        return;
+    }
+
+    /* Verbatim samples, or the warm-up samples of the predictor */
+    end = (sub->type == AUDIO_FLAC_TYPE_VERBATIM) ? frames : sub->order;
+    for (; index < end; index++)
+    {
+        memmove(&history[1], &history[0], AUDIO_FLAC_ORDER_MAX * sizeof(int32_t));
+        history[0] = audio_flac_sample(pcm, channels, signal, index);
+        audio_flac_put(bw, (uint32_t) history[0], bps);
+    }
+    if (sub->type == AUDIO_FLAC_TYPE_VERBATIM)
+    {
+        return;
+    }
+
+    /* Rice coding with 4-bit parameters, then the partitions */
+    audio_flac_put(bw, sub->partition, 6u);
+    for (partition = 0; partition < (1u << sub->partition); partition++)
+    {
+        audio_flac_put(bw, sub->params[partition], 4u);
+        for (end = (partition + 1u) * size; index < end; index++)
+        {
+            memmove(&history[1], &history[0], AUDIO_FLAC_ORDER_MAX * sizeof(int32_t));
+            history[0] = audio_flac_sample(pcm, channels, signal, index);
+            audio_flac_put_rice(bw, audio_flac_fixed(history, sub->order), sub->params[partition]);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_crc8
+********************************************************************************
+* Summary:
+*   CRC-8 of the frame header, polynomial 0x07.
+*
+*******************************************************************************/
+static uint8_t audio_flac_crc8(const uint8_t *data, uint32_t len)
+{
+    uint32_t crc = 0;
+    uint32_t bit;
+
+    while (len-- > 0u)
+    {
+        crc ^= *data++;
+        for (bit = 0; bit < 8u; bit++)
+        {
+            crc = (crc & 0x80u) ? ((crc << 1) ^ 0x07u) : (crc << 1);
+        }
+    }
+    return (uint8_t) crc;
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_frame_header
+********************************************************************************
+* Summary:
+*   Parse a frame header as audio_flac_frame() writes it for the stream.
+*
+* Parameters:
+*   flac = stream state
+*   data = candidate frame
+*   len = bytes available at data
+*   num = frame number, set if valid
+*   frames = frames in the frame, set if valid
+*
+* Return:
+*   Length of the header, 0 if it is not a valid header of the stream.
+*
+*******************************************************************************/
+static uint32_t audio_flac_frame_header(const audio_flac_t *flac, const uint8_t *data, uint32_t len,
+                                        uint32_t *num, uint32_t *frames)
+{
+    uint32_t block_code;
+    uint32_t rate_code;
+    uint32_t channel_code;
+    uint32_t sample_rate;
+    uint32_t bytes;
+    uint32_t index;
+    uint32_t pos = 5u;
+
+    /* Longest header: 6 bytes of frame number, then 2 of block size and 2
+     * of sample rate */
+    if ((len < 16u) || (data[0] != (AUDIO_FLAC_SYNC >> 8)) || (data[1] != (AUDIO_FLAC_SYNC & 0xFFu)) ||
+        (data[3] != ((data[3] & 0xF0u) | (AUDIO_FLAC_SAMPLE_SIZE_16 << 1))))
+    {
+        return 0;
+    }
+
+    block_code = data[2] >> 4;
+    rate_code = data[2] & 0x0Fu;
+    channel_code = data[3] >> 4;
+
+    if (flac->channels == 1u)
+    {
+        if (channel_code != 0u)
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        for (index = 0; (index < (sizeof(audio_flac_assignments) / sizeof(audio_flac_assignments[0]))) &&
+                        (audio_flac_assignments[index].code != channel_code); index++)
+        {
+        }
+        if (index >= (sizeof(audio_flac_assignments) / sizeof(audio_flac_assignments[0])))
+        {
+            return 0;
+        }
+    }
+
+    /* Frame number, coded as UTF-8 */
+    if (data[4] < 0x80u)
+    {
+        *num = data[4];
+    }
+    else
+    {
+        for (bytes = 2u; (bytes < 7u) && ((data[4] & (0x80u >> bytes)) != 0u); bytes++)
+        {
+        }
+        if ((bytes > 6u) || ((data[4] & 0x40u) == 0u))
+        {
+            return 0;
+        }
+        *num = data[4] & (0x7Fu >> bytes);
+        for (index = 1u; index < bytes; index++)
+        {
+            if ((data[4u + index] & 0xC0u) != 0x80u)
+            {
+                return 0;
+            }
+            *num = (*num << 6) | (data[4u + index] & 0x3Fu);
+        }
+        pos = 4u + bytes;
+    }
+
+    if ((block_code >= 0x8u) && (block_code <= 0xFu))
+    {
+        *frames = 256u << (block_code - 0x8u);
+    }
+    else if (block_code == AUDIO_FLAC_BLOCK_SIZE_8BIT)
+    {
+        *frames = data[pos++] + 1u;
+    }
+    else if (block_code == AUDIO_FLAC_BLOCK_SIZE_16BIT)
+    {
+        *frames = ((uint32_t) data[pos] << 8) + data[pos + 1u] + 1u;
+        pos += 2u;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if ((rate_code > 0u) && (rate_code < (sizeof(audio_flac_rates) / sizeof(audio_flac_rates[0]))))
+    {
+        sample_rate = audio_flac_rates[rate_code];
+    }
+    else if (rate_code == AUDIO_FLAC_RATE_KHZ)
+    {
+        sample_rate = data[pos++] * 1000u;
+    }
+    else if (rate_code == AUDIO_FLAC_RATE_HZ)
+    {
+        sample_rate = ((uint32_t) data[pos] << 8) + data[pos + 1u];
+        pos += 2u;
+    }
+    else if (rate_code == AUDIO_FLAC_RATE_10HZ)
+    {
+        sample_rate = (((uint32_t) data[pos] << 8) + data[pos + 1u]) * 10u;
+        pos += 2u;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if ((sample_rate != flac->sample_rate) || (*frames > AUDIO_FLAC_BLOCK_FRAMES) ||
+        (audio_flac_crc8(data, pos) != data[pos]))
+    {
+        return 0;
+    }
+
+    return pos + 1u;
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_init
+********************************************************************************
+* Summary:
+*   Start the stream of a record.
+*
+* Parameters:
+*   flac = stream state
+*   sample_rate = frame rate in Hertz
+*   channels = 1 or 2, interleaved
+*
+*******************************************************************************/
+void audio_flac_init(audio_flac_t *flac, uint32_t sample_rate, uint32_t channels)
+{
+    memset(flac, 0, sizeof(audio_flac_t));
+    flac->sample_rate = sample_rate;
+    flac->channels = channels;
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_frame
+********************************************************************************
+* Summary:
+*   Encode a FLAC frame. The stereo mode coding the frame in the fewest bits
+*   is chosen from an estimate of each signal.
+*
+* Parameters:
+*   flac = stream state
+*   pcm = interleaved 16-bit samples
+*   frames = number of frames, AUDIO_FLAC_BLOCK_FRAMES except for the last
+*   out = destination, AUDIO_FLAC_FRAME_SIZE_MAX bytes
+*
+* Return:
+*   Length of the frame.
+*
+*******************************************************************************/
+uint32_t audio_flac_frame(audio_flac_t *flac, const int16_t *pcm, uint32_t frames, uint8_t *out)
+{
+    audio_flac_subframe_t subs[AUDIO_FLAC_SIGNAL_NUM];
+    uint32_t estimates[AUDIO_FLAC_SIGNAL_NUM];
+    audio_flac_bits_t bw = { out, 0, 0, 0 };
+    uint32_t assignment = 0;
+    uint32_t block_code;
+    uint32_t rate_code;
+    uint32_t signal;
+    uint32_t index;
+    uint32_t best = UINT32_MAX;
+    uint32_t crc = 0;
+    uint32_t num = flac->frame_num;
+    uint32_t bytes;
+
+    /* Stereo mode, the two channels as they are for mono */
+    for (signal = 0; signal < ((flac->channels == 1u) ? 1u : (uint32_t) AUDIO_FLAC_SIGNAL_NUM); signal++)
+    {
+        estimates[signal] = audio_flac_analyze(pcm, frames, flac->channels, (audio_flac_signal_t) signal,
+                                               &subs[signal]);
+    }
+    for (index = 0; (flac->channels > 1u) && (index < (sizeof(audio_flac_assignments) /
+                                                        sizeof(audio_flac_assignments[0]))); index++)
+    {
+        if ((estimates[audio_flac_assignments[index].signals[0]] +
+             estimates[audio_flac_assignments[index].signals[1]]) < best)
+        {
+            best = estimates[audio_flac_assignments[index].signals[0]] +
+                   estimates[audio_flac_assignments[index].signals[1]];
+            assignment = index;
+        }
+    }
+
+    /* Block size and sample rate codes, with their values after the frame
+     * number when they have no code of their own */
+    for (block_code = 0x8u; block_code <= 0xFu; block_code++)
+    {
+        if (frames == (256u << (block_code - 0x8u)))
+        {
+            break;
+        }
+    }
+    if (block_code > 0xFu)
+    {
+        block_code = (frames <= 256u) ? AUDIO_FLAC_BLOCK_SIZE_8BIT : AUDIO_FLAC_BLOCK_SIZE_16BIT;
+    }
+    for (rate_code = 1u; rate_code < (sizeof(audio_flac_rates) / sizeof(audio_flac_rates[0])); rate_code++)
+    {
+        if (flac->sample_rate == audio_flac_rates[rate_code])
+        {
+            break;
+        }
+    }
+    if (rate_code >= (sizeof(audio_flac_rates) / sizeof(audio_flac_rates[0])))
+    {
+        rate_code = (((flac->sample_rate % 1000u) == 0u) && (flac->sample_rate <= 255000u)) ? AUDIO_FLAC_RATE_KHZ :
+                    (flac->sample_rate <= 0xFFFFu) ? AUDIO_FLAC_RATE_HZ : AUDIO_FLAC_RATE_10HZ;
+    }
+
+    /* Frame header: sync code with the fixed block size strategy */
+    audio_flac_put(&bw, AUDIO_FLAC_SYNC, 16u);
+    audio_flac_put(&bw, (block_code << 4) | rate_code, 8u);
+    audio_flac_put(&bw, (((flac->channels == 1u) ? 0u : (uint32_t) audio_flac_assignments[assignment].code) << 4) |
+                        (AUDIO_FLAC_SAMPLE_SIZE_16 << 1), 8u);
+
+    /* Frame number, coded as UTF-8 */
+    if (num < 0x80u)
+    {
+        audio_flac_put(&bw, num, 8u);
+    }
+    else
+    {
+        for (bytes = 2u; (bytes < 6u) && (num >= (1u << ((5u * bytes) + 1u))); bytes++)
+        {
+        }
+        audio_flac_put(&bw, (0xFF00u >> bytes) | (num >> (6u * (bytes - 1u))), 8u);
+        for (index = bytes - 1u; index > 0u; index--)
+        {
+            audio_flac_put(&bw, 0x80u | ((num >> (6u * (index - 1u))) & 0x3Fu), 8u);
+        }
+    }
+
+    if (block_code == AUDIO_FLAC_BLOCK_SIZE_8BIT)
+    {
+        audio_flac_put(&bw, frames - 1u, 8u);
+    }
+    else if (block_code == AUDIO_FLAC_BLOCK_SIZE_16BIT)
+    {
+        audio_flac_put(&bw, frames - 1u, 16u);
+    }
+    if (rate_code == AUDIO_FLAC_RATE_KHZ)
+    {
+        audio_flac_put(&bw, flac->sample_rate / 1000u, 8u);
+    }
+    else if (rate_code == AUDIO_FLAC_RATE_HZ)
+    {
+        audio_flac_put(&bw, flac->sample_rate, 16u);
+    }
+    else if (rate_code == AUDIO_FLAC_RATE_10HZ)
+    {
+        audio_flac_put(&bw, flac->sample_rate / 10u, 16u);
+    }
+    audio_flac_put(&bw, audio_flac_crc8(out, bw.pos), 8u);
+
+    /* Subframes, then padding to a byte */
+    for (index = 0; index < flac->channels; index++)
+    {
+        signal = (flac->channels == 1u) ? (uint32_t) AUDIO_FLAC_LEFT : audio_flac_assignments[assignment].signals[index];
+        audio_flac_plan(pcm, frames, flac->channels, (audio_flac_signal_t) signal, &subs[signal]);
+        audio_flac_subframe(&bw, pcm, frames, flac->channels, (audio_flac_signal_t) signal, &subs[signal]);
+    }
+    audio_flac_put(&bw, 0, (8u - bw.bits) & 7u);
+
+    /* Frame footer */
+    for (index = 0; index < bw.pos; index++)
+    {
+        crc = ((crc << 8) ^ audio_flac_crc16_table[(crc >> 8) ^ out[index]]) & 0xFFFFu;
+    }
+    audio_flac_put(&bw, crc, 16u);
+
+    flac->frame_num++;
+    flac->frames += frames;
+    flac->frame_size_min = ((flac->frame_size_min == 0u) || (bw.pos < flac->frame_size_min)) ? bw.pos :
+                           flac->frame_size_min;
+    flac->frame_size_max = (bw.pos > flac->frame_size_max) ? bw.pos : flac->frame_size_max;
+
+    return bw.pos;
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_check
+********************************************************************************
+* Summary:
+*   Check a frame of the stream found in a damaged record. A CRC-16 matching
+*   by chance is not enough: the frame is valid only if the next frame starts
+*   right after it, so the last frame of the data is never valid.
+*
+* Parameters:
+*   flac = stream state, giving the sample rate and channels
+*   data = candidate frame
+*   len = bytes available at data, at least AUDIO_FLAC_FRAME_SIZE_MAX + 16
+*         to check any frame
+*   num = frame number, set if valid
+*   frames = frames in the frame, set if valid
+*
+* Return:
+*   Length of the frame, 0 if it is not valid.
+*
+*******************************************************************************/
+uint32_t audio_flac_check(const audio_flac_t *flac, const uint8_t *data, uint32_t len, uint32_t *num,
+                          uint32_t *frames)
+{
+    uint32_t crc = 0;
+    uint32_t pos;
+    uint32_t next_num;
+    uint32_t next_frames;
+
+    pos = audio_flac_frame_header(flac, data, len, num, frames);
+    if (pos == 0u)
+    {
+        return 0;
+    }
+
+    len = (len < (AUDIO_FLAC_FRAME_SIZE_MAX + 16u)) ? len : (AUDIO_FLAC_FRAME_SIZE_MAX + 16u);
+    for (pos = 0; pos < len; pos++)
+    {
+        crc = ((crc << 8) ^ audio_flac_crc16_table[(crc >> 8) ^ data[pos]]) & 0xFFFFu;
+
+        /* The CRC-16 of a frame followed by its CRC is 0 */
+        if ((crc == 0u) && (pos >= 8u) &&
+            (audio_flac_frame_header(flac, &data[pos + 1u], len - pos - 1u, &next_num, &next_frames) > 0u) &&
+            (next_num == (*num + 1u)) && (*frames == AUDIO_FLAC_BLOCK_FRAMES))
+        {
+            return pos + 1u;
+        }
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_flac_header
+********************************************************************************
+* Summary:
+*   Build the "fLaC" marker and the STREAMINFO block with the current totals.
+*   The MD5 signature is left at zero, meaning not computed.
+*
+* Parameters:
+*   flac = stream state
+*   header = destination, AUDIO_FLAC_HEADER_SIZE bytes
+*
+* Return:
+*   Length of the header.
+*
+*******************************************************************************/
+uint32_t audio_flac_header(const audio_flac_t *flac, uint8_t *header)
+{
+    audio_flac_bits_t bw = { header, 0, 0, 0 };
+
+    memcpy(header, "fLaC", 4u);
+    bw.pos = 4u;
+
+    /* Last metadata block, STREAMINFO, 34 bytes */
+    audio_flac_put(&bw, 0x80u, 8u);
+    audio_flac_put(&bw, 34u, 24u);
+
+    audio_flac_put(&bw, AUDIO_FLAC_BLOCK_FRAMES, 16u);
+    audio_flac_put(&bw, AUDIO_FLAC_BLOCK_FRAMES, 16u);
+    audio_flac_put(&bw, flac->frame_size_min, 24u);
+    audio_flac_put(&bw, flac->frame_size_max, 24u);
+    audio_flac_put(&bw, flac->sample_rate >> 4, 16u);
+    audio_flac_put(&bw, flac->sample_rate, 4u);
+    audio_flac_put(&bw, flac->channels - 1u, 3u);
+    audio_flac_put(&bw, AUDIO_FLAC_BPS - 1u, 5u);
+    audio_flac_put(&bw, (uint32_t) (flac->frames >> 32), 4u);
+    audio_flac_put(&bw, (uint32_t) (flac->frames >> 16), 16u);
+    audio_flac_put(&bw, (uint32_t) flac->frames, 16u);
+
+    /* MD5 signature */
+    memset(&header[bw.pos], 0, AUDIO_FLAC_HEADER_SIZE - bw.pos);
+
+    return AUDIO_FLAC_HEADER_SIZE;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,93 @@
+/*****************************************************************************
+* File Name: audio_flac.h
+*
+* Description:
+*  This file contains the constants, data types and function prototypes
+*  of the lossless encoder of the records (audio_flac.c).
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef AUDIO_FLAC_H_
+#define AUDIO_FLAC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_FLAC_CHANNELS_MAX     2u
+
+/* Frames per FLAC frame, the last frame of a record can be shorter */
+#define AUDIO_FLAC_BLOCK_FRAMES     1024u
+
+/* Fixed predictor orders, and Rice partition orders tried on each subframe */
+#define AUDIO_FLAC_ORDER_MAX        4u
+#define AUDIO_FLAC_PARTITION_MAX    4u
+
+/* "fLaC" marker and the STREAMINFO metadata block */
+#define AUDIO_FLAC_HEADER_SIZE      42u
+
+/* Largest FLAC frame: header, verbatim subframes of up to 17 bits per sample
+ * (side channel), and the CRC-16 */
+#define AUDIO_FLAC_FRAME_SIZE_MAX   (16u + (AUDIO_FLAC_CHANNELS_MAX * \
+                                    (1u + (((AUDIO_FLAC_BLOCK_FRAMES * 17u) + 7u) / 8u))) + 2u)
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Stream state, kept between the frames of a record */
+typedef struct
+{
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t frame_num;         /* Number of the next frame */
+    uint64_t frames;            /* Frames (samples per channel) encoded */
+    uint32_t frame_size_min;    /* Smallest and largest frames, in bytes */
+    uint32_t frame_size_max;
+} audio_flac_t;
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void     audio_flac_init(audio_flac_t *flac, uint32_t sample_rate, uint32_t channels);
+uint32_t audio_flac_frame(audio_flac_t *flac, const int16_t *pcm, uint32_t frames, uint8_t *out);
+uint32_t audio_flac_check(const audio_flac_t *flac, const uint8_t *data, uint32_t len, uint32_t *num,
+                          uint32_t *frames);
+uint32_t audio_flac_header(const audio_flac_t *flac, uint8_t *header);
+
+#endif /* AUDIO_FLAC_H_ */
+
+/* [] END OF FILE */
@@ -40,21 +40,254 @@
 * so agrees to indemnify Cypress against all liability.
 *****************************************************************************/
 #include "audio_fs.h"
+#include "buf_arena.h"
+#include "virt_file.h"
+#include "trace.h"
+#include "log.h"
+#include "record_cat.h"
+#include "record_journal.h"
+#include "usb_comm.h"
 #include "ff.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Record file, open from its creation to its save */
+typedef struct
+{
+    FIL fp;
+    uint32_t num;
+    char name[RECORD_CAT_NAME_SIZE];
+    bool is_open;
+    bool is_hidden;             /* Until its first audio */
+    bool is_prealloc;           /* Written in a reserved contiguous area */
+    uint32_t commit_size;       /* Audio written between two commits */
+    uint32_t uncommitted;       /* Audio written since the last commit */
+    FIL peak_fp;                /* Waveform overview, from its first page */
+    bool peak_open;
+    bool peak_failed;
+    bool peak_dirty;            /* Pages written since the last commit */
+} audio_fs_record_t;
+
 /*******************************************************************************
 * Global variables
 ********************************************************************************/
-static BYTE work[FF_MAX_SS];
 static const char config_content[CONFIG_FILE_SIZE] = CONFIG_FILE_TXT;
-static uint32_t file_record_num = 1;
-static char filename[32];  
 FATFS fs;
-FIL current_fp;
+
+/* The record being written, and the next one created ahead of the button
+ * press or of its segment */
+static audio_fs_record_t record_files[2];
+static audio_fs_record_t *record_cur = &record_files[0];
+static audio_fs_record_t *record_next = &record_files[1];
+
+/* First record of the session, naming its manifest and its index */
+static uint32_t session_num;
+static char session_name[RECORD_CAT_NAME_SIZE];
+
+/* Host write generation when the volume was mounted */
+static uint32_t fs_gen;
+
+/* Segments saved during the record, shown to the host once it ends */
+static bool fs_refresh = false;
+
+/* Settings parsed from the config file, and the file they were read from */
+static audio_fs_config_t config_cache;
+static bool config_valid = false;
+static uint32_t config_gen;
+static FILINFO config_info;
+
+/*******************************************************************************
+* Function Name: audio_fs_mkfs
+********************************************************************************
+* Summary:
+*   Create a FAT volume using a work area leased from the buffer arena. A large
+*   work area lets f_mkfs() write the FAT and root directory in fewer calls.
+*
+* Parameters:
+*   fs_param = format parameters
+*
+* Return:
+*   Result of f_mkfs().
+*
+*******************************************************************************/
+static FRESULT audio_fs_mkfs(const MKFS_PARM *fs_param)
+{
+    FRESULT result;
+    BYTE *work;
+
+    work = buf_arena_lease(BUF_ARENA_CLIENT_FS, FS_WORK_SIZE);
+    if (work == NULL)
+    {
+        return FR_NOT_ENOUGH_CORE;
+    }
+
+    result = f_mkfs("", fs_param, work, FS_WORK_SIZE);
+
+    buf_arena_release(BUF_ARENA_CLIENT_FS);
+
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_prealloc
+********************************************************************************
+* Summary:
+*   Reserve a contiguous area for the new record on exFAT volumes. The file is
+*   then written without FAT chain, so the allocation cost does not depend on
+*   the record length. The unused part is released when the record is saved.
+*
+* Parameters:
+*   fp = new record file
+*
+* Return:
+*   Return true if the area is reserved.
+*
+*******************************************************************************/
+static bool audio_fs_prealloc(FIL *fp)
+{
+    FSIZE_t size;
+
+    if (fs.fs_type != FS_EXFAT)
+    {
+        return false;
+    }
+
+    for (size = RECORD_PREALLOC_SIZE; size >= RECORD_PREALLOC_MIN; size /= 2u)
+    {
+        if (f_expand(fp, size, 1) == FR_OK)
+        {
+            return true;
+        }
+    }
+
+    LOG_WARN("No contiguous space for the record\n\r");
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_commit
+********************************************************************************
+* Summary:
+*   Sync the audio written to a record to the memory. The size of a
+*   preallocated record is in the journal, as its file size is the reserved
+*   area. The pages of the overview written since are synced with it.
+*
+* Parameters:
+*   record = open record
+*
+* Return:
+*   Result of f_sync().
+*
+*******************************************************************************/
+static FRESULT audio_fs_commit(audio_fs_record_t *record)
+{
+    FRESULT result = f_sync(&record->fp);
+
+    if ((result == FR_OK) && record->is_prealloc)
+    {
+        record_journal_commit(f_tell(&record->fp));
+    }
+    if (record->peak_dirty)
+    {
+        (void) f_sync(&record->peak_fp);
+        record->peak_dirty = false;
+    }
+    record->uncommitted = 0;
+
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_reload
+********************************************************************************
+* Summary:
+*   Mount the volume again if the host wrote to the memory, so the state cached
+*   by FatFs is not written over the host changes. Called while idle, before
+*   the next record is prepared, so a button press does not wait for it; put
+*   off while a record is written, until it ends. The prepared record is
+*   opened again, unless the host deleted or changed it. The catalog is kept,
+*   the records the host copied are found when a number is allocated. The
+*   host is then made to read the drive again if segments were saved during
+*   the last record. Must be called with the file system taken.
+*
+*******************************************************************************/
+void audio_fs_reload(void)
+{
+    FATFS *fs_ptr;
+    DWORD free_clst;
+    FSIZE_t size;
+    FSIZE_t pos;
+
+    if (record_cur->is_open)
+    {
+        return;
+    }
+
+    if (fs_gen != usb_comm_write_generation())
+    {
+        size = f_size(&record_next->fp);
+        pos = f_tell(&record_next->fp);
+
+        fs_gen = usb_comm_write_generation();
+        f_mount(&fs, "", 1);
+        record_journal_mount();
+
+        /* Build the free cluster map now, not at the next allocation */
+        (void) f_getfree("", &free_clst, &fs_ptr);
+
+        if (record_next->is_open &&
+            ((f_open(&record_next->fp, record_next->name, FA_OPEN_EXISTING | FA_WRITE) != FR_OK) ||
+             (f_size(&record_next->fp) != size) || (f_lseek(&record_next->fp, pos) != FR_OK)))
+        {
+            f_close(&record_next->fp);
+            record_next->is_open = false;
+        }
+    }
+
+    if (fs_refresh)
+    {
+        fs_refresh = false;
+        usb_comm_refresh();
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_drop_ready
+********************************************************************************
+* Summary:
+*   Delete a record created ahead of a button press that never came, left
+*   hidden by a reset. It is the last one of the catalog.
+*
+*******************************************************************************/
+static void audio_fs_drop_ready(void)
+{
+    char name[RECORD_CAT_NAME_SIZE];
+    uint32_t num = record_cat_last();
+    uint32_t format;
+    FILINFO info;
+
+    if (num == 0u)
+    {
+        return;
+    }
+
+    for (format = 0; format < AUDIO_ENC_NUM; format++)
+    {
+        record_cat_name(num, audio_enc_ext((audio_enc_format_t) format), name);
+        if ((f_stat(name, &info) == FR_OK) && ((info.fattrib & AM_HID) != 0u) &&
+            (f_unlink(name) == FR_OK))
+        {
+            record_cat_remove(num);
+            record_cat_sync();
+            break;
+        }
+    }
+}
 
 /*******************************************************************************
 * Function Name: audio_fs_init
@@ -68,9 +301,12 @@ void audio_fs_init(bool force_format)
 {
     FRESULT result;
     FIL   fp;
+    FATFS *fs_ptr;
+    DWORD free_clst;
+    uint8_t *work;
     const MKFS_PARM fs_param =
     {
-        .fmt = FM_FAT32,  /* Format option */
+        .fmt = FM_FAT32 | FM_EXFAT,  /* exFAT for SDXC cards (32 GB and more) */
         .n_fat = 1,       /* Number of FATs */
         .align = 0,
         .n_root = 0,
@@ -79,17 +315,17 @@ void audio_fs_init(bool force_format)
 
     if (force_format)
     {
-        printf("\n\rFormatting file system... ");
-        result = f_mkfs("", &fs_param, work, FF_MAX_SS);
+        LOG_INFO("\n\rFormatting file system... ");
+        result = audio_fs_mkfs(&fs_param);
         if (result == FR_OK)
         {
             f_mount(&fs, "", 1);
             f_setlabel(DRIVE_LABEL_NAME);
-            printf("done!\n\r");
+            LOG_INFO("done!\n\r");
         }
         else
         {
-            printf("not able to create a file system!\n\r");
+            LOG_ERROR("not able to create a file system!\n\r");
             return;
         }
     }
@@ -101,33 +337,41 @@ void audio_fs_init(bool force_format)
     {
         case FR_NO_FILESYSTEM:
             /* No file system, create a FAT system */
-            printf("\n\rNo file system, creating one... ");
-            result = f_mkfs("", &fs_param, work, FF_MAX_SS);
+            LOG_INFO("\n\rNo file system, creating one... ");
+            result = audio_fs_mkfs(&fs_param);
             if (result == FR_OK)
             {
                 f_mount(&fs, "", 1);
                 f_setlabel(DRIVE_LABEL_NAME);
-                printf("done!\n\r");             
+                LOG_INFO("done!\n\r");             
             }
             else
             {
-                printf("not able to create a file system!\n\r");
+                LOG_ERROR("not able to create a file system!\n\r");
                 return;
             }
             break;
         case FR_NOT_READY:
-            printf("\r\nSD Card not present! Insert one to the SD card slot\n\r");
+            LOG_ERROR("\r\nSD Card not present! Insert one to the SD card slot\n\r");
             break;
         default:
             break;
     }
 
+    /* Complete a record left open by a reset, before any allocation */
+    work = buf_arena_lease(BUF_ARENA_CLIENT_FS, RECORD_JOURNAL_WORK_SIZE);
+    record_journal_recover(work, RECORD_JOURNAL_WORK_SIZE);
+    if (work != NULL)
+    {
+        buf_arena_release(BUF_ARENA_CLIENT_FS);
+    }
+
     /* Check for the config file */
     result = f_open(&fp, CONFIG_FILE_NAME, FA_OPEN_EXISTING | FA_WRITE | FA_READ);
 
     if (result == FR_NO_FILE)
     {
-        printf("\n\rCreating a new %s file... ", CONFIG_FILE_NAME);
+        LOG_INFO("\n\rCreating a new %s file... ", CONFIG_FILE_NAME);
 
         /* Create a new file */
         result = f_open(&fp, CONFIG_FILE_NAME, FA_CREATE_NEW | FA_WRITE | FA_READ);
@@ -139,16 +383,16 @@ void audio_fs_init(bool force_format)
 
             if (result == FR_OK)
             {
-                printf("done!\n\r");
+                LOG_INFO("done!\n\r");
             }
             else
             {
-                printf("failed to write to the file!\n\r");
+                LOG_ERROR("failed to write to the file!\n\r");
             }
         }
         else
         {
-            printf("failed to create the file!\n\r");
+            LOG_ERROR("failed to create the file!\n\r");
         }
     }
     f_close(&fp);
@@ -158,33 +402,84 @@ void audio_fs_init(bool force_format)
 
     if ((result != FR_EXIST) && (result != FR_OK))
     {
-        printf("\n\rNot able to create %s folder!\n\r", RECORD_FOLDER_NAME);
+        LOG_ERROR("\n\rNot able to create %s folder!\n\r", RECORD_FOLDER_NAME);
     }
+
+    /* Load the catalog of records */
+    fs_gen = usb_comm_write_generation();
+    record_journal_mount();
+    record_cat_mount();
+    audio_fs_drop_ready();
+
+    /* Count the free space. On FAT, this also builds the free cluster map
+     * now instead of at the first allocation of a record */
+    if (f_getfree("", &free_clst, &fs_ptr) == FR_OK)
+    {
+        LOG_INFO("\n\rFree space: %lu MB\n\r",
+                 (unsigned long) (((uint64_t) free_clst * fs_ptr->csize * FF_MAX_SS) >> 20));
+    }
+
+    /* Map the virtual files to the drive */
+    virt_file_mount();
 }
 
 /*******************************************************************************
 * Function Name: audio_fs_get_config
 ********************************************************************************
 * Summary:
-*   Return the config file information.
+*   Return the config file information. The default values are kept for the
+*   missing or invalid settings. The file is parsed again only if the volume
+*   was mounted again after a host write, and the size or the time of the
+*   file changed.
 *
 * Parameters:
-*   sample_rate = frame rate in Hertz
-*   is_stereo = true if stereo, false if mono
+*   config = record settings
+*
+* Return:
+*   Return true if the file was parsed again.
 *
 *******************************************************************************/
-void audio_fs_get_config(uint32_t *sample_rate, bool *is_stereo)
+bool audio_fs_get_config(audio_fs_config_t *config)
 {
     FRESULT result;
+    FILINFO info;
     FIL fp;
     char line[32];
     char *str;
 
+    /* The cached settings are up to date, read since the last mount */
+    if (config_valid && (config_gen == fs_gen))
+    {
+        *config = config_cache;
+        return false;
+    }
+
+    config_gen = fs_gen;
+    if (f_stat(CONFIG_FILE_NAME, &info) != FR_OK)
+    {
+        memset(&info, 0, sizeof(info));
+    }
+
+    if (config_valid && (info.fsize == config_info.fsize) &&
+        (info.fdate == config_info.fdate) && (info.ftime == config_info.ftime))
+    {
+        *config = config_cache;
+        return false;
+    }
+
+    config_info = info;
+
     result = f_open(&fp, CONFIG_FILE_NAME, FA_OPEN_EXISTING | FA_READ);
 
     /* Load the default values */
-    *sample_rate = CONFIG_DEFAULT_SAMPLE_RATE;
-    *is_stereo   = CONFIG_DEFAULT_MODE; 
+    config->sample_rate  = CONFIG_DEFAULT_SAMPLE_RATE;
+    config->is_stereo    = CONFIG_DEFAULT_MODE;
+    config->encoding     = CONFIG_DEFAULT_ENCODING;
+    config->high_pass_hz = CONFIG_DEFAULT_HIGH_PASS;
+    config->gain_db      = CONFIG_DEFAULT_GAIN;
+    config->vad_db       = CONFIG_DEFAULT_VAD;
+    config->pre_trigger_ms = CONFIG_DEFAULT_PRE_TRIGGER;
+    config->segment_s    = CONFIG_DEFAULT_SEGMENT;
 
     if (result == FR_OK)
     {
@@ -195,76 +490,232 @@ void audio_fs_get_config(uint32_t *sample_rate, bool *is_stereo)
             str = strstr(line, STRING_SAMPLE_RATE);
             if (str != NULL)
             {
-                *sample_rate = strtol(line + sizeof(STRING_SAMPLE_RATE) - 1, &str, 10);                   
+                config->sample_rate = strtol(line + sizeof(STRING_SAMPLE_RATE) - 1, &str, 10);
             }     
-            else
+            else if (strstr(line, STRING_SAMPLE_MODE) != NULL)
             {
                 /* Check if has the SAMPLE_MODE info */
-                str = strstr(line, STRING_SAMPLE_MODE);
-                if (str != NULL)
+                config->is_stereo = (strstr(line, "mono") == NULL);
+            }
+            else if (strstr(line, STRING_HIGH_PASS) != NULL)
+            {
+                /* Check if has the HIGH_PASS_HZ info */
+                config->high_pass_hz = strtoul(strstr(line, STRING_HIGH_PASS) + sizeof(STRING_HIGH_PASS) - 1, &str, 10);
+            }
+            else if (strstr(line, STRING_GAIN) != NULL)
+            {
+                /* Check if has the GAIN_DB info */
+                config->gain_db = strtol(strstr(line, STRING_GAIN) + sizeof(STRING_GAIN) - 1, &str, 10);
+            }
+            else if (strstr(line, STRING_VAD) != NULL)
+            {
+                /* Check if has the VAD_DB info */
+                config->vad_db = strtoul(strstr(line, STRING_VAD) + sizeof(STRING_VAD) - 1, &str, 10);
+            }
+            else if (strstr(line, STRING_PRE_TRIGGER) != NULL)
+            {
+                /* Check if has the PRE_TRIGGER_MS info */
+                config->pre_trigger_ms = strtoul(strstr(line, STRING_PRE_TRIGGER) + sizeof(STRING_PRE_TRIGGER) - 1,
+                                                 &str, 10);
+            }
+            else if (strstr(line, STRING_SEGMENT) != NULL)
+            {
+                /* Check if has the SEGMENT_S info */
+                config->segment_s = strtoul(strstr(line, STRING_SEGMENT) + sizeof(STRING_SEGMENT) - 1, &str, 10);
+            }
+            else
+            {
+                /* Check if has the ENCODING info */
+                str = strstr(line, STRING_ENCODING);
+                if ((str != NULL) && !audio_enc_parse(str + sizeof(STRING_ENCODING) - 1, &config->encoding))
                 {
-                    str = strstr(line, "mono");
-                    if (str != NULL)
-                    {
-                        *is_stereo = false;
-                    }
-                    else
-                    {
-                        *is_stereo = true;
-                    }                  
-                }              
+                    LOG_WARN("Unknown encoding, recording raw\n\r");
+                }
             }                 
         }
     }
     else
     {
-        printf("Error opening file!\n\r");
+        LOG_ERROR("Error opening file!\n\r");
     }
-    
-    printf("SAMPLE_RATE = %lu\n\r", (unsigned long) *sample_rate); 
-    printf("SAMPLE_MODE = %s\n\r", (*is_stereo) ? "stereo" : "mono");
 
     f_close(&fp);
+
+    config_cache = *config;
+    config_valid = true;
+
+    return true;
 }
 
 /*******************************************************************************
 * Function Name: audio_fs_new_record
 ********************************************************************************
 * Summary:
-*   Create a new file to record audio data. The filename is based on the last
-*   file record number.
+*   Create the file of the next record, ahead of the button press or of its
+*   segment. The record number is allocated from the catalog. A record
+*   created earlier and not started is deleted first. The file is written to the
+*   memory and hidden until it gets audio, so the host sees a consistent
+*   volume meanwhile.
+*
+* Parameters:
+*   ext = file extension of the encoding
+*   header = file header, rewritten when the record is saved
+*   header_len = length of the header, 0 for none
 *
 * Return:
 *   Return true if success, false if error.
 *
 *******************************************************************************/
-bool audio_fs_new_record(void)
+bool audio_fs_new_record(const char *ext, const uint8_t *header, uint32_t header_len)
 {
-    FRESULT result;
-      
+    audio_fs_record_t *record = record_next;
+    FRESULT result = FR_DENIED;
+    UINT count = header_len;
+    bool retried = false;
+
+    if (record->is_open)
+    {
+        f_close(&record->fp);
+        if (f_unlink(record->name) == FR_OK)
+        {
+            record_cat_remove(record->num);
+        }
+        record->is_open = false;
+    }
+
     do {
+        record->num = record_cat_alloc();
+        if (record->num == 0)
+        {
+            break;
+        }
+
         /* Build the filename */
-        sprintf(filename, "%s/%s%.4lu.raw", RECORD_FOLDER_NAME, RECORD_FILE_NAME, (unsigned long) file_record_num);
+        record_cat_name(record->num, ext, record->name);
 
         /* Attempt to open */
-        result = f_open(&current_fp, filename, FA_CREATE_NEW | FA_WRITE);
+        result = f_open(&record->fp, record->name, FA_CREATE_NEW | FA_WRITE);
 
+        /* The catalog missed this record, add it and try the next number */
         if (result == FR_EXIST)
         {
-            f_close(&current_fp);
+            f_close(&record->fp);
+            record_cat_add(record->num);
+            if (retried)
+            {
+                break;
+            }
+            retried = true;
         }
-
-        file_record_num++;
     } 
-    while ((result == FR_EXIST) && (file_record_num != RECORD_MAX_NUM));
-    
-    if (result != FR_OK)
+    while (result == FR_EXIST);
+
+    if (result == FR_OK)
+    {
+        record_cat_add(record->num);
+        record->is_prealloc = audio_fs_prealloc(&record->fp);
+
+        /* Encoded records are committed at intervals, as the recovery
+         * checks their frames; raw samples cannot be checked */
+        record->commit_size = (header_len > 0u) ? RECORD_JOURNAL_COMMIT_SIZE : 0u;
+        record->uncommitted = 0;
+        record->peak_open = false;
+        record->peak_failed = false;
+        record->peak_dirty = false;
+
+        if (header_len > 0)
+        {
+            result = f_write(&record->fp, header, header_len, &count);
+        }
+    }
+
+    if (result == FR_OK)
+    {
+        result = f_sync(&record->fp);
+    }
+
+    if (result == FR_OK)
+    {
+        result = f_chmod(record->name, AM_HID, AM_HID);
+    }
+
+    if ((result != FR_OK) || (count != header_len))
+    {
+        LOG_ERROR("Can't create a new record\n\r");
+        f_close(&record->fp);
+        return false;
+    }
+
+    record->is_open = true;
+    record->is_hidden = true;
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_record_ready
+********************************************************************************
+* Summary:
+*   Check that the next record is created, so it can start right away. The
+*   volume is not checked for host writes here, see audio_fs_is_stale().
+*
+* Return:
+*   Return true if the record can start.
+*
+*******************************************************************************/
+bool audio_fs_record_ready(void)
+{
+    return record_next->is_open;
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_is_stale
+********************************************************************************
+* Summary:
+*   Check if the host wrote to the memory since the volume was mounted, so it
+*   must be reloaded before the next record is prepared.
+*
+* Return:
+*   Return true if the volume must be reloaded.
+*
+*******************************************************************************/
+bool audio_fs_is_stale(void)
+{
+    return (fs_gen != usb_comm_write_generation());
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_start_record
+********************************************************************************
+* Summary:
+*   Write the next record from now on. A record starts a session, named after
+*   it; a segment continues the session of the record before.
+*
+* Parameters:
+*   is_segment = next segment of the session
+*
+* Return:
+*   Return true if success, false if the next record is not ready.
+*
+*******************************************************************************/
+bool audio_fs_start_record(bool is_segment)
+{
+    audio_fs_record_t *record = record_next;
+
+    if (!audio_fs_record_ready())
     {
-        printf("Can't create a new record\n\r");
-        f_close(&current_fp);
         return false;
     }
 
+    record_next = record_cur;
+    record_cur = record;
+
+    if (!is_segment)
+    {
+        session_num = record->num;
+        memcpy(session_name, record->name, sizeof(session_name));
+    }
+
     return true;
 }
 
@@ -272,7 +723,10 @@ bool audio_fs_new_record(void)
 * Function Name: audio_fs_write
 ********************************************************************************
 * Summary:
-*   Write some audio data to the open file record.
+*   Write some audio data to the open file record. The record is named in the
+*   journal before its first audio, then shown to the host. The audio is
+*   committed to the memory at the first write, and then each time the commit
+*   interval of the record is reached.
 *
 * Parameters:
 *   buf = pointer to the buffer
@@ -282,21 +736,49 @@ bool audio_fs_new_record(void)
 *   Return true if success, false if error.
 *
 *******************************************************************************/
-bool audio_fs_write(uint8_t *buf, uint32_t len)
+bool audio_fs_write(const uint8_t *buf, uint32_t len)
 {
     FRESULT result;
     UINT count;
 
-    result = f_write(&current_fp, buf, len, &count);
-    result |= f_sync(&current_fp);
+    if (record_cur->is_hidden)
+    {
+        record_journal_begin(record_cur->name, record_cur->is_prealloc, f_tell(&record_cur->fp));
+    }
+
+    TRACE_BEGIN(TRACE_ID_AUDIO_WRITE, len / 1024u);
+
+    result = f_write(&record_cur->fp, buf, len, &count);
+    record_cur->uncommitted += len;
+    if ((result == FR_OK) && (record_cur->is_hidden || (record_cur->uncommitted >= record_cur->commit_size)))
+    {
+        result = audio_fs_commit(record_cur);
+    }
+
+    TRACE_END(TRACE_ID_AUDIO_WRITE, len / 1024u);
 
     if ((result != FR_OK) || (count != len))
     {
-        printf("Error writing to the record!\n\r");
-        f_close(&current_fp);
+        LOG_ERROR("Error writing to the record!\n\r");
+        f_truncate(&record_cur->fp);
+        f_close(&record_cur->fp);
+        if (record_cur->peak_open)
+        {
+            f_close(&record_cur->peak_fp);
+            record_cur->peak_open = false;
+        }
+        (void) f_chmod(record_cur->name, 0, AM_HID);
+        record_cur->is_open = false;
+        record_journal_end();
         return false;
     }
 
+    if (record_cur->is_hidden)
+    {
+        (void) f_chmod(record_cur->name, 0, AM_HID);
+        record_cur->is_hidden = false;
+    }
+
     return true;
 }
 
@@ -304,55 +786,270 @@ bool audio_fs_write(uint8_t *buf, uint32_t len)
 * Function Name: audio_fs_save
 ********************************************************************************
 * Summary:
-*   Close the file.
+*   Release the unused preallocated area, update the file header, close the
+*   file, show it to the host and persist the catalog.
+*
+* Parameters:
+*   header = file header with the final sizes
+*   header_len = length of the header, 0 for none
+*
+*******************************************************************************/
+void audio_fs_save(const uint8_t *header, uint32_t header_len)
+{
+    UINT count;
+
+    LOG_INFO("File created: %s\n\r", record_cur->name);
+    f_truncate(&record_cur->fp);
+
+    if ((header_len > 0) &&
+        ((f_lseek(&record_cur->fp, 0) != FR_OK) || (f_write(&record_cur->fp, header, header_len, &count) != FR_OK)))
+    {
+        LOG_ERROR("Error writing the record header!\n\r");
+    }
+
+    f_close(&record_cur->fp);
+    if (record_cur->is_hidden)
+    {
+        (void) f_chmod(record_cur->name, 0, AM_HID);
+        record_cur->is_hidden = false;
+    }
+    record_cur->is_open = false;
+    record_journal_end();
+
+    record_cat_sync();
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_save_segment
+********************************************************************************
+* Summary:
+*   Add the segment just saved to the manifest of the session, a playlist next
+*   to its first segment. The host reads the drive again once the record
+*   ends, see audio_fs_reload(): a refresh during the record would have the
+*   host write to the drive, and the volume could not be mounted again.
+*
+* Parameters:
+*   frames = length of the segment, in samples per channel
+*   sample_rate = frame rate in Hertz
+*
+*******************************************************************************/
+void audio_fs_save_segment(uint32_t frames, uint32_t sample_rate)
+{
+    char name[RECORD_CAT_NAME_SIZE];
+    const char *base = strrchr(record_cur->name, '/') + 1;
+    uint32_t shard = record_cur->num / RECORD_SHARD_SIZE;
+    uint32_t ms = (uint32_t) (((uint64_t) frames * 1000u) / sample_rate);
+    bool is_first = (record_cur->num == session_num);
+    FIL fp;
+
+    record_cat_name(session_num, RECORD_MANIFEST_EXT, name);
+    if (f_open(&fp, name, (is_first) ? (FA_CREATE_ALWAYS | FA_WRITE) : (FA_OPEN_APPEND | FA_WRITE)) != FR_OK)
+    {
+        LOG_ERROR("Can't write the record manifest\n\r");
+        return;
+    }
+
+    if (is_first)
+    {
+        f_printf(&fp, "#EXTM3U\r\n");
+    }
+    f_printf(&fp, "#EXTINF:%lu.%03lu,%s\r\n", (unsigned long) (ms / 1000u), (unsigned long) (ms % 1000u), base);
+
+    /* Segments past a thousand records are in the next subfolders */
+    if (shard == (session_num / RECORD_SHARD_SIZE))
+    {
+        f_printf(&fp, "%s\r\n", base);
+    }
+    else
+    {
+        record_cat_shard_path(shard, name);
+        f_printf(&fp, "../%s/%s\r\n", strrchr(name, '/') + 1, base);
+    }
+
+    if (f_close(&fp) != FR_OK)
+    {
+        LOG_ERROR("Error writing the record manifest!\n\r");
+    }
+
+    fs_refresh = true;
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_save_index
+********************************************************************************
+* Summary:
+*   Write the index of the segments kept in the last session, a text file
+*   next to its first record with the same number. Each line is the start of
+*   a segment in the session and its length, in samples per channel.
+*
+* Parameters:
+*   vad = activity detector of the record
+*
+*******************************************************************************/
+void audio_fs_save_index(const audio_vad_t *vad)
+{
+    char name[RECORD_CAT_NAME_SIZE];
+    uint32_t index;
+    FIL fp;
+
+    record_cat_name(session_num, RECORD_INDEX_EXT, name);
+    if (f_open(&fp, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+    {
+        LOG_ERROR("Can't create the record index\n\r");
+        return;
+    }
+
+    f_printf(&fp, "# Segments of %s at %lu Hz: start, length\r\n", strrchr(session_name, '/') + 1,
+             (unsigned long) vad->sample_rate);
+    for (index = 0; index < vad->segment_num; index++)
+    {
+        f_printf(&fp, "%lu,%lu\r\n", (unsigned long) vad->segments[index].start,
+                 (unsigned long) vad->segments[index].frames);
+    }
+
+    if (f_close(&fp) != FR_OK)
+    {
+        LOG_ERROR("Error writing the record index!\n\r");
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_write_peaks
+********************************************************************************
+* Summary:
+*   Write a page of the waveform overview of the record, to its sidecar file
+*   with the same number. The sidecar is created at the first page, with the
+*   header the overview has then. An error only ends the overview, the
+*   record goes on.
+*
+* Parameters:
+*   header = first page of the sidecar, used if it is created now
+*   page = next page of the sidecar, AUDIO_PEAK_PAGE_SIZE bytes
+*
+*******************************************************************************/
+void audio_fs_write_peaks(const uint8_t *header, const uint8_t *page)
+{
+    char name[RECORD_CAT_NAME_SIZE];
+    FRESULT result = FR_OK;
+    UINT count = AUDIO_PEAK_PAGE_SIZE;
+
+    if (record_cur->peak_failed)
+    {
+        return;
+    }
+
+    if (!record_cur->peak_open)
+    {
+        record_cat_name(record_cur->num, RECORD_PEAK_EXT, name);
+        result = f_open(&record_cur->peak_fp, name, FA_CREATE_ALWAYS | FA_WRITE);
+        if (result == FR_OK)
+        {
+            record_cur->peak_open = true;
+            result = f_write(&record_cur->peak_fp, header, AUDIO_PEAK_PAGE_SIZE, &count);
+        }
+    }
+
+    if ((result == FR_OK) && (count == AUDIO_PEAK_PAGE_SIZE))
+    {
+        result = f_write(&record_cur->peak_fp, page, AUDIO_PEAK_PAGE_SIZE, &count);
+        record_cur->peak_dirty = true;
+    }
+
+    if ((result != FR_OK) || (count != AUDIO_PEAK_PAGE_SIZE))
+    {
+        LOG_ERROR("Error writing the record overview!\n\r");
+        if (record_cur->peak_open)
+        {
+            f_close(&record_cur->peak_fp);
+            record_cur->peak_open = false;
+            record_cur->peak_dirty = false;
+        }
+        record_cur->peak_failed = true;
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_fs_save_peaks
+********************************************************************************
+* Summary:
+*   Complete the header of the waveform overview of the record, and close
+*   its sidecar file.
+*
+* Parameters:
+*   header = first page of the sidecar, with the final counts
 *
 *******************************************************************************/
-void audio_fs_save(void)
+void audio_fs_save_peaks(const uint8_t *header)
 {
-    printf("File created: %s\n\r", filename);
-    f_close(&current_fp);
+    FRESULT result;
+    UINT count = 0;
+
+    if (!record_cur->peak_open)
+    {
+        return;
+    }
+
+    result = f_lseek(&record_cur->peak_fp, 0);
+    if (result == FR_OK)
+    {
+        result = f_write(&record_cur->peak_fp, header, AUDIO_PEAK_PAGE_SIZE, &count);
+    }
+
+    if ((f_close(&record_cur->peak_fp) != FR_OK) || (result != FR_OK) || (count != AUDIO_PEAK_PAGE_SIZE))
+    {
+        LOG_ERROR("Error writing the record overview!\n\r");
+    }
+    record_cur->peak_open = false;
 }
 
 /*******************************************************************************
 * Function Name: audio_fs_list
 ********************************************************************************
 * Summary:
-*   List all files in the record folder. Update the latest record number.
+*   List all records. Only the subfolders holding records are scanned, and
+*   their count in the catalog is corrected on the way.
 *
 *******************************************************************************/
 void audio_fs_list(void)
 {
+    char path[RECORD_CAT_NAME_SIZE];
     FRESULT result;
     FILINFO fno;
     DIR dir;
-    char *str;
-    uint32_t record_num;
-
-    printf("\n\rList of records:\n\r");
+    uint32_t shard;
+    uint32_t count;
 
-    result = f_findfirst(&dir, &fno, RECORD_FOLDER_NAME, 
-                                     RECORD_PATTERN(RECORD_FILE_NAME, RECORD_FILE_EXT));
+    LOG_INFO_WAIT("\n\rList of records:\n\r");
 
-    if (fno.fname[0] == 0)
+    if (record_cat_count() == 0)
     {
-        printf("<Empty>\n\r");
-        file_record_num = 1;
+        LOG_INFO_WAIT("<Empty>\n\r");
     }
 
-    while ((result == FR_OK) && (fno.fname[0]))
+    for (shard = 0; shard <= (record_cat_last() / RECORD_SHARD_SIZE); shard++)
     {
-        /* Update the latest record */
-        record_num = strtol(fno.fname + sizeof(RECORD_FILE_NAME) - 1, &str, 10);
+        if (record_cat_shard_count(shard) == 0)
+        {
+            continue;
+        }
+
+        record_cat_shard_path(shard, path);
+        count = 0;
 
-        /* Find the latest record */
-        if (file_record_num < record_num)
+        result = f_findfirst(&dir, &fno, path, RECORD_FILE_PATTERN);
+
+        while ((result == FR_OK) && (fno.fname[0]))
         {
-            file_record_num = record_num;
+            if (record_cat_parse(fno.fname) != 0u)
+            {
+                LOG_INFO_WAIT("%s\n\r", fno.fname);
+                count++;
+            }
+            result = f_findnext(&dir, &fno);
         }
 
-        printf("%s\n\r", fno.fname);
-        result = f_findnext(&dir, &fno);       
-    }
+        f_closedir(&dir);
 
-    f_closedir(&dir);
+        record_cat_shard_update(shard, count);
+    }
 }
\ No newline at end of file
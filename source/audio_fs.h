@@ -43,6 +43,10 @@
 #ifndef AUDIO_FS_H_
 #define AUDIO_FS_H_
 
+#include "audio_enc.h"
+#include "audio_vad.h"
+#include "audio_peak.h"
+
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -52,43 +56,113 @@
 #define MODE_STEREO         1
 #define MODE_MONO           0
 
-#define RECORD_MAX_NUM      10000
+#define RECORD_MAX_NUM      1000000u
+
+/* Records are grouped by thousands in subfolders of the records folder */
+#define RECORD_SHARD_SIZE   1000u
+#define RECORD_SHARD_NUM    (RECORD_MAX_NUM / RECORD_SHARD_SIZE)
 
 /* Constant Names */
 #define RECORD_FOLDER_NAME  "PSOC_RECORDS"
 #define RECORD_FILE_NAME    "rec_"
-#define RECORD_FILE_EXT     "raw"
 #define CONFIG_FILE_NAME    "config.txt"
 
 #define RECORD_PATTERN(NAME, EXT)   NAME "*" EXT
 
+/* Records of all encodings, told apart by record_cat_parse() */
+#define RECORD_FILE_PATTERN RECORD_PATTERN(RECORD_FILE_NAME, ".*")
+
+/* Index of the segments kept in a record with activity gating */
+#define RECORD_INDEX_EXT    "idx"
+
+/* Playlist of the segments of a record split in segments */
+#define RECORD_MANIFEST_EXT "m3u"
+
+/* Waveform overview of a record, written during the capture */
+#define RECORD_PEAK_EXT     "pk"
+
 /* Default config file content */
 #define CONFIG_FILE_TXT     "# Set the sample rate in Hertz\r\n" \
                             "SAMPLE_RATE_HZ=48000\r\n" \
                             "\r\n# Sample mode (stereo, mono)\r\n" \
-                            "SAMPLE_MODE=stereo"
+                            "SAMPLE_MODE=stereo\r\n" \
+                            "\r\n# Encoding (raw, adpcm, flac)\r\n" \
+                            "ENCODING=raw\r\n" \
+                            "\r\n# High-pass cutoff in Hertz, 0 for none\r\n" \
+                            "HIGH_PASS_HZ=80\r\n" \
+                            "\r\n# Gain in dB (-12 to 18)\r\n" \
+                            "GAIN_DB=0\r\n" \
+                            "\r\n# Skip the silence: activity above the noise in dB, 0 for none\r\n" \
+                            "VAD_DB=0\r\n" \
+                            "\r\n# Audio kept from before the button press in ms, 0 for none\r\n" \
+                            "PRE_TRIGGER_MS=0\r\n" \
+                            "\r\n# Split the record every N seconds, 0 for none\r\n" \
+                            "SEGMENT_S=0"
 
 /* Default settings, if invalid config file */
 #define CONFIG_DEFAULT_SAMPLE_RATE  48000
 #define CONFIG_DEFAULT_MODE         MODE_STEREO
+#define CONFIG_DEFAULT_ENCODING     AUDIO_ENC_RAW
+#define CONFIG_DEFAULT_HIGH_PASS    80
+#define CONFIG_DEFAULT_GAIN         0
+#define CONFIG_DEFAULT_VAD          0
+#define CONFIG_DEFAULT_PRE_TRIGGER  0
+#define CONFIG_DEFAULT_SEGMENT      0
 
-#define CONFIG_FILE_SIZE    256u
+#define CONFIG_FILE_SIZE    512u
+
+/* Contiguous space reserved for a new record on exFAT, halved until it fits */
+#define RECORD_PREALLOC_SIZE    (1024ull * 1024ull * 1024ull)
+#define RECORD_PREALLOC_MIN     (16ull * 1024ull * 1024ull)
+
+/* Work area leased from the buffer arena to format the memory */
+#define FS_WORK_SIZE        (32u * 1024u)
 
 /* Config Strings */
 #define STRING_SAMPLE_RATE  "SAMPLE_RATE_HZ="
 #define STRING_SAMPLE_MODE  "SAMPLE_MODE="
+#define STRING_ENCODING     "ENCODING="
+#define STRING_HIGH_PASS    "HIGH_PASS_HZ="
+#define STRING_GAIN         "GAIN_DB="
+#define STRING_VAD          "VAD_DB="
+#define STRING_PRE_TRIGGER  "PRE_TRIGGER_MS="
+#define STRING_SEGMENT      "SEGMENT_S="
 
 /* Drive Label Name */
 #define DRIVE_LABEL_NAME    "PSoC Drive"
 
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Record settings read from the config file */
+typedef struct
+{
+    uint32_t sample_rate;
+    bool is_stereo;
+    audio_enc_format_t encoding;
+    uint32_t high_pass_hz;
+    int32_t gain_db;
+    uint32_t vad_db;
+    uint32_t pre_trigger_ms;
+    uint32_t segment_s;
+} audio_fs_config_t;
+
 /*******************************************************************************
 * Functions
 ********************************************************************************/
 void audio_fs_init(bool force_format);
-void audio_fs_get_config(uint32_t *sample_rate, bool *is_stereo);
-bool audio_fs_new_record(void);
-bool audio_fs_write(uint8_t *buf, uint32_t len);
-void audio_fs_save(void);
+void audio_fs_reload(void);
+bool audio_fs_is_stale(void);
+bool audio_fs_get_config(audio_fs_config_t *config);
+bool audio_fs_new_record(const char *ext, const uint8_t *header, uint32_t header_len);
+bool audio_fs_record_ready(void);
+bool audio_fs_start_record(bool is_segment);
+bool audio_fs_write(const uint8_t *buf, uint32_t len);
+void audio_fs_save(const uint8_t *header, uint32_t header_len);
+void audio_fs_save_segment(uint32_t frames, uint32_t sample_rate);
+void audio_fs_save_index(const audio_vad_t *vad);
+void audio_fs_write_peaks(const uint8_t *header, const uint8_t *page);
+void audio_fs_save_peaks(const uint8_t *header);
 void audio_fs_list(void);
 
 #endif /* AUDIO_FS_H_ */
\ No newline at end of file
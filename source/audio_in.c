@@ -40,6 +40,15 @@
 *****************************************************************************/
 #include "audio_in.h"
 #include "audio_fs.h"
+#include "audio_enc.h"
+#include "audio_dsp.h"
+#include "audio_src.h"
+#include "audio_vad.h"
+#include "audio_peak.h"
+#include "buf_arena.h"
+#include "stats.h"
+#include "trace.h"
+#include "log.h"
 #include "cyhal.h"
 #include "cybsp.h"
 
@@ -52,13 +61,27 @@
 * Constants
 ********************************************************************************/
 #define PDM_DECIMATION_RATE         32
-#define PDM_PCM_BUFFER_SIZE         32768u
+
+/* PCM ring leased from the buffer arena while recording, in blocks of
+ * PCM_BLOCK_SIZE (audio_in.h) */
+#define PCM_RING_BLOCKS             4u
+#define PCM_RING_SIZE               (PCM_BLOCK_SIZE * PCM_RING_BLOCKS)
+#define PCM_RING_BLOCK(index)       (&pcm_ring[((index) % PCM_RING_BLOCKS) * PCM_BLOCK_SIZE])
+
+/* Blocks kept from before the trigger, leaving one to flush them */
+#define PCM_PRETRIGGER_BLOCKS_MAX   (PCM_RING_BLOCKS - 2u)
 
 #define NOTIFY_BUTTON_PRESS         0x1
 #define NOTIFY_PCM_DATA             0x2
 
 #define DEBOUNCE_DELAY_MS           250
 
+/* Period to check for host writes while idle */
+#define HOST_CHECK_MS               1000
+
+/* Longest segment, its length in samples fits in 32 bits at 48 kHz */
+#define SEGMENT_MAX_S               86400u
+
 #ifndef CYBSP_PDM_DATA
     #define CYBSP_PDM_DATA          CYBSP_A5
 #endif
@@ -66,18 +89,73 @@
     #define CYBSP_PDM_CLK           CYBSP_A4
 #endif
 
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* What the ISR does with a captured block */
+typedef enum
+{
+    PCM_RING_RECORD,                /* Commit it, dropped if the ring is full */
+    PCM_RING_PRETRIGGER,            /* Commit it, the oldest dropped if full */
+    PCM_RING_HOLD,                  /* Capture again in the same block */
+} pcm_ring_mode_t;
+
+/* State of the PDM/PCM interface */
+typedef enum
+{
+    AUDIO_IN_CAPTURE_OFF,           /* Not configured */
+    AUDIO_IN_CAPTURE_READY,         /* Configured, stopped */
+    AUDIO_IN_CAPTURE_RUNNING,       /* Filling the PCM ring */
+} audio_in_capture_t;
+
 /*******************************************************************************
 * Global variables
 ********************************************************************************/
 cyhal_pdm_pcm_t pdm_pcm;
-uint8_t pdm_pcm_buf_0[PDM_PCM_BUFFER_SIZE];
-uint8_t pdm_pcm_buf_1[PDM_PCM_BUFFER_SIZE];
-volatile bool pdm_pcm_toggle = false;
-volatile uint32_t num_samples_transfer;
+uint8_t *pcm_ring = NULL;
+
+/* Free running block counters. The ISR fills blocks [tail, head) and the
+ * block at head is being transferred; the task consumes from the tail */
+volatile uint32_t pcm_ring_head;
+volatile uint32_t pcm_ring_tail;
+volatile uint32_t pcm_ring_overruns;
+volatile pcm_ring_mode_t pcm_ring_mode;
+
+/* The first block after a start is dropped while the PDM/PCM filters settle */
+static bool pcm_ring_warmup;
+
+/* Settings of the next record, and the capture configured for them */
+static audio_fs_config_t audio_config;
+static audio_in_capture_t capture_state = AUDIO_IN_CAPTURE_OFF;
+static uint32_t capture_rate;
+static bool capture_stereo;
+
+/* Conversion, conditioning, activity gating and encoding stages between the
+ * PCM ring and the record file, and the overview of the samples written */
+static audio_src_t audio_src;
+static audio_dsp_t audio_dsp;
+static audio_vad_t audio_vad;
+static audio_peak_t audio_peak;
+static audio_enc_t audio_enc;
+static uint8_t audio_enc_header_buf[AUDIO_ENC_HEADER_SIZE_MAX];
 
 /*******************************************************************************
 * Function prototypes
 ********************************************************************************/
+static bool audio_in_get_config(audio_fs_config_t *config);
+static void audio_in_prepare(void);
+static void audio_in_follow_host(void);
+static void audio_in_new_segment(void);
+static bool audio_in_roll(void);
+static void audio_in_peaks(const uint8_t *buf, uint32_t len);
+static void audio_in_save_peaks(void);
+static void audio_in_capture_init(uint32_t sample_rate, bool is_stereo);
+static void audio_in_capture_start(pcm_ring_mode_t mode);
+static void audio_in_capture_pause(void);
+static void audio_in_capture_free(void);
+static void audio_in_capture_pretrigger(void);
+static uint32_t audio_in_pretrigger_blocks(uint32_t pre_trigger_ms, uint32_t sample_rate, bool is_stereo);
+static uint32_t audio_in_block_ms(uint32_t sample_rate, bool is_stereo);
 static void audio_in_pdm_pcm_callback(void *arg, cyhal_pdm_pcm_event_t event);
 static void audio_in_button_callback(void *arg, cyhal_gpio_event_t event);
 
@@ -94,14 +172,24 @@ static void audio_in_button_callback(void *arg, cyhal_gpio_event_t event);
 void audio_in_task(void *arg)
 {
     bool is_recording = false;
-    bool first_time = false;
-    uint32_t sample_rate;
-    bool     sample_mode;
+    bool button_armed = true;
+    bool created_now;
+    bool dropout;
+    TickType_t button_time = 0;
+    TickType_t wait;
+    uint32_t header_len;
+    uint32_t preroll_blocks = 0;
+    uint32_t preroll_len = 0;
+    uint32_t trigger = 0;
+    uint32_t keep;
+    uint32_t segment_frames = 0;
+    bool segment_pending = false;
+    uint8_t *block;
     uint32_t notification_bits;
-    cyhal_pdm_pcm_cfg_t pdm_pcm_cfg;
 
     /* Check if other tasks are accessing the file system */
     xSemaphoreTake(rtos_fs_mutex, portMAX_DELAY);
+    stats_fs_mutex_taken();
 
     /* Init the audio file system. Force format if user button is pressed */
     audio_fs_init(cyhal_gpio_read(CYBSP_USER_BTN) == false);
@@ -115,7 +203,12 @@ void audio_in_task(void *arg)
     /* List all the record files */
     audio_fs_list();
 
+    /* Get the first record ready, and capture for its pre-trigger */
+    audio_in_prepare();
+    audio_in_capture_pretrigger();
+
     /* Release the file system to other tasks */
+    stats_fs_mutex_given();
     xSemaphoreGive(rtos_fs_mutex);
 
     /* Initialize the User LED */
@@ -127,79 +220,238 @@ void audio_in_task(void *arg)
     
     while (1)
     {
-        xTaskNotifyWait(0, ULONG_MAX, &notification_bits, portMAX_DELAY);
+        /* Wait for the next event, the end of the button debounce, or while
+         * idle the next check for host writes */
+        wait = (is_recording) ? portMAX_DELAY : pdMS_TO_TICKS(HOST_CHECK_MS);
+        if (!button_armed)
+        {
+            wait = xTaskGetTickCount() - button_time;
+            wait = (wait < pdMS_TO_TICKS(DEBOUNCE_DELAY_MS)) ? (pdMS_TO_TICKS(DEBOUNCE_DELAY_MS) - wait) : 0u;
+        }
 
-        /* Handle button presses */
-        if (notification_bits & NOTIFY_BUTTON_PRESS)
+        if (xTaskNotifyWait(0, ULONG_MAX, &notification_bits, wait) == pdFALSE)
         {
-            /* Add some delay to debounce the button presses */
-            vTaskDelay(pdMS_TO_TICKS(DEBOUNCE_DELAY_MS));
+            notification_bits = 0;
+        }
 
-            /* Re-enable the button event */
+        /* Re-enable the button event once the bounces are over */
+        if (!button_armed && ((xTaskGetTickCount() - button_time) >= pdMS_TO_TICKS(DEBOUNCE_DELAY_MS)))
+        {
             cyhal_gpio_enable_event(CYBSP_USER_BTN, CYHAL_GPIO_IRQ_FALL, CYHAL_ISR_PRIORITY_DEFAULT, true);
+            button_armed = true;
+        }
+
+        /* While idle, follow the host writes, so a button press finds the
+         * next record ready */
+        if (!is_recording && audio_fs_is_stale())
+        {
+            xSemaphoreTake(rtos_fs_mutex, portMAX_DELAY);
+            stats_fs_mutex_taken();
+            audio_in_follow_host();
+            stats_fs_mutex_given();
+            xSemaphoreGive(rtos_fs_mutex);
+        }
+
+        /* Handle button presses, on the first edge. The button event stays
+         * disabled for the debounce delay */
+        if (notification_bits & NOTIFY_BUTTON_PRESS)
+        {
+            /* Blocks completed before the press, for the pre-trigger */
+            trigger = pcm_ring_head;
+
+            button_time = xTaskGetTickCount();
+            button_armed = false;
 
             /* Check if recording */
             if (is_recording)
             {
-                printf("-- Record ended ---\n\r");
+                LOG_INFO("-- Record ended ---\n\r");
 
-                /* Stop the PDM/PCM interface */
-                cyhal_pdm_pcm_stop(&pdm_pcm);
-                cyhal_pdm_pcm_free(&pdm_pcm);
+                /* Keep capturing for the pre-trigger of the next record, the
+                 * ISR holding on its block meanwhile, or pause the PDM/PCM
+                 * interface. The blocks left are dropped */
+                if (audio_config.pre_trigger_ms != 0u)
+                {
+                    pcm_ring_mode = PCM_RING_HOLD;
+                    block = PCM_RING_BLOCK(pcm_ring_head + 1u);
+                }
+                else
+                {
+                    audio_in_capture_pause();
+                    block = PCM_RING_BLOCK(pcm_ring_tail);
+                }
+
+                /* Complete the last encoded block, in a ring block now
+                 * free, then return the PCM ring to the arena unless still
+                 * capturing */
+                header_len = audio_enc_finish(&audio_enc, block);
+                if (header_len > 0)
+                {
+                    (void) audio_fs_write(block, header_len);
+                }
+                if (capture_state == AUDIO_IN_CAPTURE_RUNNING)
+                {
+                    taskENTER_CRITICAL();
+                    pcm_ring_tail = pcm_ring_head;
+                    pcm_ring_mode = PCM_RING_PRETRIGGER;
+                    taskEXIT_CRITICAL();
+                }
+                else
+                {
+                    buf_arena_release(BUF_ARENA_CLIENT_AUDIO);
+                    pcm_ring = NULL;
+                }
 
                 /* Turn off LED*/
                 cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
 
-                /* Save the file */
-                audio_fs_save();
+                /* Save the file, with the final sizes in its header, and
+                 * its overview */
+                audio_in_save_peaks();
+                header_len = audio_enc_header(&audio_enc, audio_enc_header_buf);
+                audio_fs_save(audio_enc_header_buf, header_len);
+                if (segment_frames != 0u)
+                {
+                    audio_fs_save_segment(audio_enc.frames, audio_config.sample_rate);
+                }
+
+                /* Index of the segments kept, and the writes saved */
+                if (audio_vad.enabled)
+                {
+                    audio_fs_save_index(&audio_vad);
+                    LOG_INFO("Blocks written: %lu of %lu, %lu%% skipped\n\r", (unsigned long) audio_vad.blocks_kept,
+                             (unsigned long) audio_vad.blocks,
+                             (unsigned long) ((audio_vad.blocks == 0u) ? 0u :
+                                              (100u * (audio_vad.blocks - audio_vad.blocks_kept)) / audio_vad.blocks));
+                }
+
+                /* The trace of the first dropout is dumped once the file
+                 * system is released, the pre-trigger clears the count */
+                dropout = (pcm_ring_overruns != 0);
+                if (dropout)
+                {
+                    LOG_ERROR("PCM ring overruns: %u\n\r", (unsigned int) pcm_ring_overruns);
+                }
 
                 is_recording = false;
 
+                /* Get the next record ready */
+                audio_in_prepare();
+                audio_in_capture_pretrigger();
+
                 /* Release the file system to other tasks */
+                stats_fs_mutex_given();
                 xSemaphoreGive(rtos_fs_mutex);
+
+                /* Dump the trace without holding the file system during the
+                 * 32 KB of hexadecimal output */
+                if (dropout)
+                {
+                    TRACE_DUMP();
+                }
             }    
             else
             {
                 /* Check if other tasks are accessing the file system */
                 xSemaphoreTake(rtos_fs_mutex, portMAX_DELAY);
+                stats_fs_mutex_taken();
 
-                /* If not recording, create a new record */
-                if (audio_fs_new_record())
-                {
-                    cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
+                /* Restart the trace for this record, from the press */
+                TRACE_START();
+                TRACE_BEGIN(TRACE_ID_AUDIO_START, 0);
 
-                    printf("\n\rStarted a new record with:\n\r");
+                /* The record was prepared while idle. Create it now only if
+                 * that failed */
+                created_now = !audio_fs_record_ready();
+                if (created_now)
+                {
+                    audio_in_prepare();
+                }
 
-                    /* Get configuration */
-                    audio_fs_get_config(&sample_rate, &sample_mode);
+                /* Lease the PCM ring, unless capturing for the pre-trigger.
+                 * The MSC media buffer shrinks meanwhile */
+                if (pcm_ring == NULL)
+                {
+                    pcm_ring = buf_arena_lease(BUF_ARENA_CLIENT_AUDIO, PCM_RING_SIZE);
+                }
 
-                    /* Populate the config structure */
-                    pdm_pcm_cfg.mode = (sample_mode) ? CYHAL_PDM_PCM_MODE_STEREO : CYHAL_PDM_PCM_MODE_LEFT;
-                    pdm_pcm_cfg.decimation_rate = PDM_DECIMATION_RATE;
-                    pdm_pcm_cfg.sample_rate = sample_rate;
-                    pdm_pcm_cfg.word_length = 16;
-                    pdm_pcm_cfg.right_gain = 0;
-                    pdm_pcm_cfg.left_gain = 0;                   
+                if ((pcm_ring != NULL) && audio_fs_start_record(false))
+                {
+                    if (capture_state == AUDIO_IN_CAPTURE_RUNNING)
+                    {
+                        /* Keep the blocks completed within the pre-trigger
+                         * time before the press, and write them now */
+                        keep = audio_in_pretrigger_blocks(audio_config.pre_trigger_ms, capture_rate, capture_stereo);
+                        taskENTER_CRITICAL();
+                        if ((int32_t) (trigger - pcm_ring_tail) > (int32_t) keep)
+                        {
+                            pcm_ring_tail = trigger - keep;
+                        }
+                        keep = ((int32_t) (trigger - pcm_ring_tail) > 0) ? (trigger - pcm_ring_tail) : 0u;
+                        pcm_ring_overruns = 0;
+                        pcm_ring_mode = PCM_RING_RECORD;
+                        taskEXIT_CRITICAL();
+                        notification_bits |= NOTIFY_PCM_DATA;
+                    }
+                    else
+                    {
+                        audio_in_capture_start(PCM_RING_RECORD);
+                        keep = 0;
+                    }
+                    preroll_blocks = 0;
+                    is_recording = true;
 
-                    cyhal_pdm_pcm_init(&pdm_pcm, CYBSP_PDM_DATA, CYBSP_PDM_CLK, NULL, &pdm_pcm_cfg);
-                    cyhal_pdm_pcm_register_callback(&pdm_pcm, audio_in_pdm_pcm_callback, NULL);
-                    cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, true);
-                    cyhal_pdm_pcm_start(&pdm_pcm);
+                    /* Segments of the record, the next one created once the
+                     * ring is drained */
+                    segment_frames = ((audio_config.segment_s < SEGMENT_MAX_S) ? audio_config.segment_s : SEGMENT_MAX_S) *
+                                     audio_config.sample_rate;
+                    segment_pending = (segment_frames != 0u);
 
-                    pdm_pcm_toggle = false;           
+                    TRACE_END(TRACE_ID_AUDIO_START, created_now);
 
-                    /* Initial read request */
-                    cyhal_pdm_pcm_read_async(&pdm_pcm, pdm_pcm_buf_0, PDM_PCM_BUFFER_SIZE/2);    
+                    cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
 
-                    is_recording = true;
-                    first_time = true;
+                    LOG_INFO("\n\rStarted a new record with:\n\r");
+                    if (capture_rate != audio_config.sample_rate)
+                    {
+                        LOG_INFO("SAMPLE_RATE = %lu (captured at %lu)\n\r", (unsigned long) audio_config.sample_rate,
+                                 (unsigned long) capture_rate);
+                    }
+                    else
+                    {
+                        LOG_INFO("SAMPLE_RATE = %lu\n\r", (unsigned long) audio_config.sample_rate);
+                    }
+                    LOG_INFO("SAMPLE_MODE = %s\n\r", (audio_config.is_stereo) ? "stereo" : "mono");
+                    LOG_INFO("ENCODING = %s\n\r", audio_enc_name(audio_config.encoding));
+                    LOG_INFO("HIGH_PASS_HZ = %lu\n\r", (unsigned long) audio_config.high_pass_hz);
+                    LOG_INFO("GAIN_DB = %ld\n\r", (long) audio_config.gain_db);
+                    LOG_INFO("VAD_DB = %lu\n\r", (unsigned long) audio_config.vad_db);
+                    keep *= audio_in_block_ms(capture_rate, capture_stereo);
+                    if (keep != audio_config.pre_trigger_ms)
+                    {
+                        LOG_INFO("PRE_TRIGGER_MS = %lu (%lu kept)\n\r", (unsigned long) audio_config.pre_trigger_ms,
+                                 (unsigned long) keep);
+                    }
+                    else
+                    {
+                        LOG_INFO("PRE_TRIGGER_MS = %lu\n\r", (unsigned long) audio_config.pre_trigger_ms);
+                    }
+                    LOG_INFO("SEGMENT_S = %lu\n\r", (unsigned long) audio_config.segment_s);
                 }
                 else
                 {
                     /* Failed creating a record, turn off the LED */
                     cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
 
+                    /* The ring stays with the capture for the pre-trigger */
+                    if ((pcm_ring != NULL) && (capture_state != AUDIO_IN_CAPTURE_RUNNING))
+                    {
+                        buf_arena_release(BUF_ARENA_CLIENT_AUDIO);
+                        pcm_ring = NULL;
+                    }
+
                     /* Release the file system to other tasks */
+                    stats_fs_mutex_given();
                     xSemaphoreGive(rtos_fs_mutex);
                 }
             }
@@ -209,37 +461,518 @@ void audio_in_task(void *arg)
         if (notification_bits & NOTIFY_PCM_DATA)
         {
             /* Ignore the first batch of data to avoid noise in the PDM/PCM output */
-            if (first_time)
+            taskENTER_CRITICAL();
+            if (pcm_ring_warmup && (pcm_ring_tail != pcm_ring_head))
             {
-                first_time = false;
+                pcm_ring_tail++;
+                pcm_ring_warmup = false;
             }
-            else
+            taskEXIT_CRITICAL();
+
+            /* Convert, condition, encode and write all the filled blocks,
+             * contiguous ones in a single call. With activity gating, each
+             * block is decided alone, and the last silent one is held at the
+             * tail as the pre-roll of the next segment */
+            while (is_recording && ((pcm_ring_tail + preroll_blocks) != pcm_ring_head))
             {
-                if (is_recording)
+                uint32_t next = pcm_ring_tail + preroll_blocks;
+                uint32_t count = pcm_ring_head - next;
+                uint32_t to_end = PCM_RING_BLOCKS - (next % PCM_RING_BLOCKS);
+                uint32_t len;
+                bool kept;
+                bool written = true;
+
+                if ((count > to_end) || audio_vad.enabled)
                 {
-                    uint8_t *buf = (pdm_pcm_toggle) ? pdm_pcm_buf_0 : pdm_pcm_buf_1;
+                    count = (audio_vad.enabled) ? 1u : to_end;
+                }
 
-                    /* Write to the record file */
-                    if (audio_fs_write(buf, PDM_PCM_BUFFER_SIZE) == false)
+                /* Convert and condition in place, the blocks stay owned by
+                 * the task until the tail moves */
+                TRACE_BEGIN(TRACE_ID_AUDIO_SRC, count * PCM_BLOCK_SIZE / 1024u);
+                len = audio_src_process(&audio_src, PCM_RING_BLOCK(next), count * PCM_BLOCK_SIZE);
+                TRACE_END(TRACE_ID_AUDIO_SRC, count * PCM_BLOCK_SIZE / 1024u);
+                TRACE_BEGIN(TRACE_ID_AUDIO_DSP, len / 1024u);
+                audio_dsp_process(&audio_dsp, PCM_RING_BLOCK(next), len);
+                TRACE_END(TRACE_ID_AUDIO_DSP, len / 1024u);
+
+                if (audio_vad.enabled)
+                {
+                    TRACE_BEGIN(TRACE_ID_AUDIO_VAD, len / 1024u);
+                    kept = audio_vad_process(&audio_vad, PCM_RING_BLOCK(next), len);
+                    TRACE_END(TRACE_ID_AUDIO_VAD, len / 1024u);
+
+                    if (!kept)
                     {
-                        /* Error writing to the file, stop PDM/PCM interface */
-                        cyhal_pdm_pcm_stop(&pdm_pcm);
-                        cyhal_pdm_pcm_free(&pdm_pcm);
+                        /* Silence, the block replaces the pre-roll */
+                        pcm_ring_tail = next;
+                        preroll_blocks = 1u;
+                        preroll_len = len;
+                        continue;
+                    }
 
-                        /* Turn off LED */
-                        cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
+                    /* Activity after silence, the pre-roll goes first */
+                    if (preroll_blocks != 0u)
+                    {
+                        audio_in_peaks(PCM_RING_BLOCK(pcm_ring_tail), preroll_len);
+                        written = audio_fs_write(PCM_RING_BLOCK(pcm_ring_tail),
+                                                 audio_enc_process(&audio_enc, PCM_RING_BLOCK(pcm_ring_tail),
+                                                                   preroll_len));
+                        pcm_ring_tail = next;
+                        preroll_blocks = 0;
+                    }
+                }
 
-                        is_recording = false;
+                /* Add to the overview, encode in place, and write to the
+                 * record file */
+                if (written)
+                {
+                    audio_in_peaks(PCM_RING_BLOCK(next), len);
+                    len = audio_enc_process(&audio_enc, PCM_RING_BLOCK(next), len);
+                    written = audio_fs_write(PCM_RING_BLOCK(next), len);
+                }
+
+                if (written)
+                {
+                    pcm_ring_tail = next + count;
 
-                        /* Release the file system to other tasks */
-                        xSemaphoreGive(rtos_fs_mutex);
+                    /* Roll to the next segment at the end of this block, the
+                     * capture goes on in the ring meanwhile */
+                    if ((segment_frames != 0u) && (audio_enc.frames >= segment_frames))
+                    {
+                        written = audio_in_roll();
+                        segment_pending = true;
                     }
                 }
+
+                if (!written)
+                {
+                    /* Error writing to the file, pause PDM/PCM interface */
+                    audio_in_capture_pause();
+
+                    /* Return the PCM ring to the arena */
+                    buf_arena_release(BUF_ARENA_CLIENT_AUDIO);
+                    pcm_ring = NULL;
+
+                    /* Turn off LED */
+                    cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
+
+                    is_recording = false;
+
+                    /* Try to get the next record ready */
+                    audio_in_prepare();
+                    audio_in_capture_pretrigger();
+
+                    /* Release the file system to other tasks */
+                    stats_fs_mutex_given();
+                    xSemaphoreGive(rtos_fs_mutex);
+                }
+            }
+
+            /* Create the next segment while the ring is drained. The volume
+             * is not mounted again before the record ends */
+            if (is_recording && segment_pending)
+            {
+                if (!audio_fs_record_ready())
+                {
+                    audio_in_new_segment();
+                }
+                segment_pending = false;
+            }
+
+            /* The encoder dropped samples, end the record as the button does */
+            if (is_recording && audio_enc.overflow)
+            {
+                LOG_ERROR("The encoder can't keep up with the samples!\n\r");
+                xTaskNotify(rtos_audio_task, NOTIFY_BUTTON_PRESS, eSetBits);
             }
         }
     }    
 }
 
+/*******************************************************************************
+* Function Name: audio_in_get_config
+********************************************************************************
+* Summary:
+*   Get the record settings. Rates below the converter range are raised to
+*   its minimum.
+*
+* Parameters:
+*  config: settings read
+*
+* Return:
+*   True if the settings were read again from the config file.
+*
+*******************************************************************************/
+static bool audio_in_get_config(audio_fs_config_t *config)
+{
+    bool changed = audio_fs_get_config(config);
+
+    if (config->sample_rate < AUDIO_SRC_RATE_MIN)
+    {
+        config->sample_rate = AUDIO_SRC_RATE_MIN;
+    }
+
+    return changed;
+}
+
+/*******************************************************************************
+* Function Name: audio_in_prepare
+********************************************************************************
+* Summary:
+*   Get the next record ready while idle, so a button press only has to start
+*   the capture: read the settings, reset the conversion, conditioning,
+*   gating and encoding stages, create the record file with its header, and
+*   configure the PDM/PCM interface. A capture with other settings is stopped.
+*   The volume is mounted again first if the host wrote to it. Must be called
+*   with the file system taken.
+*
+*******************************************************************************/
+static void audio_in_prepare(void)
+{
+    uint32_t channels;
+    uint32_t header_len;
+    uint32_t rate;
+
+    audio_fs_reload();
+    (void) audio_in_get_config(&audio_config);
+    channels = (audio_config.is_stereo) ? 2u : 1u;
+    rate = audio_src_capture_rate(audio_config.sample_rate);
+
+    /* Start the converter from the capture rate, the conditioning and the
+     * encoder */
+    audio_src_init(&audio_src, rate, audio_config.sample_rate, channels);
+    audio_dsp_init(&audio_dsp, audio_config.sample_rate, channels, audio_config.high_pass_hz, audio_config.gain_db);
+    audio_vad_init(&audio_vad, audio_config.sample_rate, channels, audio_config.vad_db);
+    audio_peak_init(&audio_peak, audio_config.sample_rate, channels);
+    audio_enc_init(&audio_enc, audio_config.encoding, audio_config.sample_rate, channels);
+    header_len = audio_enc_header(&audio_enc, audio_enc_header_buf);
+
+    /* Create the record file, logging the error if any */
+    (void) audio_fs_new_record(audio_enc_ext(audio_config.encoding), audio_enc_header_buf, header_len);
+
+    /* Stop the capture without pre-trigger, or for other settings. The
+     * blocks captured are lost */
+    if ((capture_state == AUDIO_IN_CAPTURE_RUNNING) &&
+        ((audio_config.pre_trigger_ms == 0u) || (rate != capture_rate) || (audio_config.is_stereo != capture_stereo)))
+    {
+        if (audio_config.pre_trigger_ms != 0u)
+        {
+            LOG_INFO("\n\rCapture settings changed, no pre-trigger\n\r");
+        }
+        audio_in_capture_pause();
+        buf_arena_release(BUF_ARENA_CLIENT_AUDIO);
+        pcm_ring = NULL;
+    }
+
+    /* Configure the PDM/PCM interface for these settings */
+    if ((capture_state != AUDIO_IN_CAPTURE_OFF) &&
+        ((rate != capture_rate) || (audio_config.is_stereo != capture_stereo)))
+    {
+        audio_in_capture_free();
+    }
+    if (capture_state == AUDIO_IN_CAPTURE_OFF)
+    {
+        audio_in_capture_init(rate, audio_config.is_stereo);
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_in_follow_host
+********************************************************************************
+* Summary:
+*   Mount the volume again after the host wrote to it, while idle, and prepare
+*   the next record again if the host changed the settings or the record.
+*   Must be called with the file system taken.
+*
+*******************************************************************************/
+static void audio_in_follow_host(void)
+{
+    audio_fs_reload();
+
+    if (audio_in_get_config(&audio_config) || !audio_fs_record_ready())
+    {
+        audio_in_prepare();
+        audio_in_capture_pretrigger();
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_in_new_segment
+********************************************************************************
+* Summary:
+*   Create the file of the next segment of the record. Its header is rewritten
+*   when the segment is saved.
+*
+*******************************************************************************/
+static void audio_in_new_segment(void)
+{
+    uint32_t header_len = audio_enc_header(&audio_enc, audio_enc_header_buf);
+
+    (void) audio_fs_new_record(audio_enc_ext(audio_config.encoding), audio_enc_header_buf, header_len);
+}
+
+/*******************************************************************************
+* Function Name: audio_in_roll
+********************************************************************************
+* Summary:
+*   End the segment being written, and go on in the next one without gap: the
+*   encoder completes the last block of the segment and starts over. The next
+*   segment is created now if it is not ready yet. Must be called with the
+*   file system taken.
+*
+* Return:
+*   True if the record goes on, false if a write failed.
+*
+*******************************************************************************/
+static bool audio_in_roll(void)
+{
+    const uint8_t *data;
+    uint32_t frames = audio_enc.frames;
+    uint32_t header_len;
+    uint32_t len;
+
+    len = audio_enc_split(&audio_enc, audio_enc_header_buf, &header_len, &data);
+    if ((len > 0u) && !audio_fs_write(data, len))
+    {
+        return false;
+    }
+    audio_in_save_peaks();
+    audio_peak_init(&audio_peak, audio_peak.sample_rate, audio_peak.channels);
+    audio_fs_save(audio_enc_header_buf, header_len);
+    audio_fs_save_segment(frames, audio_config.sample_rate);
+
+    if (!audio_fs_record_ready())
+    {
+        audio_in_new_segment();
+    }
+
+    return audio_fs_start_record(true);
+}
+
+/*******************************************************************************
+* Function Name: audio_in_peaks
+********************************************************************************
+* Summary:
+*   Add samples about to be encoded to the overview of the record, and write
+*   its pages as they fill up. Must be called with the file system taken.
+*
+* Parameters:
+*  buf: interleaved 16-bit samples
+*  len: length of the samples in bytes
+*
+*******************************************************************************/
+static void audio_in_peaks(const uint8_t *buf, uint32_t len)
+{
+    const uint8_t *page;
+    uint32_t used;
+
+    do
+    {
+        TRACE_BEGIN(TRACE_ID_AUDIO_PEAK, len / 1024u);
+        used = audio_peak_process(&audio_peak, buf, len);
+        TRACE_END(TRACE_ID_AUDIO_PEAK, len / 1024u);
+        buf += used;
+        len -= used;
+
+        while ((page = audio_peak_page(&audio_peak)) != NULL)
+        {
+            audio_fs_write_peaks(audio_peak_header(&audio_peak), page);
+        }
+    }
+    while ((used > 0u) && (len > 0u));
+}
+
+/*******************************************************************************
+* Function Name: audio_in_save_peaks
+********************************************************************************
+* Summary:
+*   Write the last pages of the overview of the record, and its header with
+*   the final counts. Must be called before the record is saved.
+*
+*******************************************************************************/
+static void audio_in_save_peaks(void)
+{
+    const uint8_t *page;
+
+    audio_peak_finish(&audio_peak);
+    while ((page = audio_peak_page(&audio_peak)) != NULL)
+    {
+        audio_fs_write_peaks(audio_peak_header(&audio_peak), page);
+    }
+    audio_fs_save_peaks(audio_peak_header(&audio_peak));
+}
+
+/*******************************************************************************
+* Function Name: audio_in_capture_init
+********************************************************************************
+* Summary:
+*   Configure the PDM/PCM interface, without starting it.
+*
+* Parameters:
+*  sample_rate: capture rate
+*  is_stereo: both microphones, or the left one
+*
+*******************************************************************************/
+static void audio_in_capture_init(uint32_t sample_rate, bool is_stereo)
+{
+    cyhal_pdm_pcm_cfg_t pdm_pcm_cfg;
+
+    /* Populate the config structure */
+    pdm_pcm_cfg.mode = (is_stereo) ? CYHAL_PDM_PCM_MODE_STEREO : CYHAL_PDM_PCM_MODE_LEFT;
+    pdm_pcm_cfg.decimation_rate = PDM_DECIMATION_RATE;
+    pdm_pcm_cfg.sample_rate = sample_rate;
+    pdm_pcm_cfg.word_length = 16;
+    pdm_pcm_cfg.right_gain = 0;
+    pdm_pcm_cfg.left_gain = 0;
+
+    cyhal_pdm_pcm_init(&pdm_pcm, CYBSP_PDM_DATA, CYBSP_PDM_CLK, NULL, &pdm_pcm_cfg);
+    cyhal_pdm_pcm_register_callback(&pdm_pcm, audio_in_pdm_pcm_callback, NULL);
+    cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, true);
+
+    capture_rate = sample_rate;
+    capture_stereo = is_stereo;
+    capture_state = AUDIO_IN_CAPTURE_READY;
+}
+
+/*******************************************************************************
+* Function Name: audio_in_capture_start
+********************************************************************************
+* Summary:
+*   Start the configured PDM/PCM interface, filling the PCM ring from its
+*   first block. The first block is dropped while the filters settle.
+*
+* Parameters:
+*  mode: what the ISR does with the captured blocks
+*
+*******************************************************************************/
+static void audio_in_capture_start(pcm_ring_mode_t mode)
+{
+    pcm_ring_head = 0;
+    pcm_ring_tail = 0;
+    pcm_ring_overruns = 0;
+    pcm_ring_mode = mode;
+    pcm_ring_warmup = true;
+
+    cyhal_pdm_pcm_clear(&pdm_pcm);
+    cyhal_pdm_pcm_start(&pdm_pcm);
+
+    /* Initial read request */
+    cyhal_pdm_pcm_read_async(&pdm_pcm, PCM_RING_BLOCK(pcm_ring_head), PCM_BLOCK_SIZE/2);
+
+    capture_state = AUDIO_IN_CAPTURE_RUNNING;
+}
+
+/*******************************************************************************
+* Function Name: audio_in_capture_pause
+********************************************************************************
+* Summary:
+*   Stop the PDM/PCM interface, keeping its configuration.
+*
+*******************************************************************************/
+static void audio_in_capture_pause(void)
+{
+    cyhal_pdm_pcm_stop(&pdm_pcm);
+    cyhal_pdm_pcm_abort_async(&pdm_pcm);
+
+    capture_state = AUDIO_IN_CAPTURE_READY;
+}
+
+/*******************************************************************************
+* Function Name: audio_in_capture_free
+********************************************************************************
+* Summary:
+*   Stop the PDM/PCM interface and release it.
+*
+*******************************************************************************/
+static void audio_in_capture_free(void)
+{
+    if (capture_state == AUDIO_IN_CAPTURE_RUNNING)
+    {
+        audio_in_capture_pause();
+    }
+    cyhal_pdm_pcm_free(&pdm_pcm);
+
+    capture_state = AUDIO_IN_CAPTURE_OFF;
+}
+
+/*******************************************************************************
+* Function Name: audio_in_capture_pretrigger
+********************************************************************************
+* Summary:
+*   With a pre-trigger, capture until the button press: the PCM ring keeps
+*   the last blocks.
+*
+*******************************************************************************/
+static void audio_in_capture_pretrigger(void)
+{
+    uint32_t block_ms;
+
+    if ((audio_config.pre_trigger_ms == 0u) || (capture_state != AUDIO_IN_CAPTURE_READY))
+    {
+        return;
+    }
+
+    pcm_ring = buf_arena_lease(BUF_ARENA_CLIENT_AUDIO, PCM_RING_SIZE);
+    if (pcm_ring == NULL)
+    {
+        return;
+    }
+
+    audio_in_capture_start(PCM_RING_PRETRIGGER);
+
+    block_ms = audio_in_block_ms(capture_rate, capture_stereo);
+    if (audio_config.pre_trigger_ms > (PCM_PRETRIGGER_BLOCKS_MAX * block_ms))
+    {
+        LOG_WARN("\n\rPRE_TRIGGER_MS = %lu is more than the PCM ring holds\n\r",
+                 (unsigned long) audio_config.pre_trigger_ms);
+    }
+    LOG_INFO("\n\rCapturing %lu ms before the button press\n\r", (unsigned long)
+             (audio_in_pretrigger_blocks(audio_config.pre_trigger_ms, capture_rate, capture_stereo) * block_ms));
+}
+
+/*******************************************************************************
+* Function Name: audio_in_pretrigger_blocks
+********************************************************************************
+* Summary:
+*   Number of ring blocks covering the pre-trigger time, limited by the ring.
+*
+* Parameters:
+*  pre_trigger_ms: time kept before the button press
+*  sample_rate: capture rate
+*  is_stereo: both microphones, or the left one
+*
+* Return:
+*   Number of blocks.
+*
+*******************************************************************************/
+static uint32_t audio_in_pretrigger_blocks(uint32_t pre_trigger_ms, uint32_t sample_rate, bool is_stereo)
+{
+    uint32_t block_ms = audio_in_block_ms(sample_rate, is_stereo);
+    uint32_t blocks = (pre_trigger_ms + block_ms - 1u) / block_ms;
+
+    return (blocks < PCM_PRETRIGGER_BLOCKS_MAX) ? blocks : PCM_PRETRIGGER_BLOCKS_MAX;
+}
+
+/*******************************************************************************
+* Function Name: audio_in_block_ms
+********************************************************************************
+* Summary:
+*   Duration of a ring block, rounded down.
+*
+* Parameters:
+*  sample_rate: capture rate
+*  is_stereo: both microphones, or the left one
+*
+* Return:
+*   Duration in ms.
+*
+*******************************************************************************/
+static uint32_t audio_in_block_ms(uint32_t sample_rate, bool is_stereo)
+{
+    return (PCM_BLOCK_SIZE * 1000u) / (sample_rate * (is_stereo ? 4u : 2u));
+}
+
 /*******************************************************************************
 * Function Name: audio_in_button_callback
 ********************************************************************************
@@ -288,15 +1021,43 @@ static void audio_in_button_callback(void *arg, cyhal_gpio_event_t event)
 static void audio_in_pdm_pcm_callback(void *arg, cyhal_pdm_pcm_event_t event)
 {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    uint8_t *buf = (pdm_pcm_toggle) ? pdm_pcm_buf_0 : pdm_pcm_buf_1;
 
     (void) arg;
     (void) event;
 
-    /* Schedule the next read */
-    cyhal_pdm_pcm_read_async(&pdm_pcm, buf, PDM_PCM_BUFFER_SIZE/2);
+    /* Commit the block, unless the next one is still waiting to be written.
+     * In that case the ring is full and the block just captured is dropped,
+     * or the oldest one before the trigger */
+    if (pcm_ring_mode == PCM_RING_HOLD)
+    {
+        /* The task uses the other blocks */
+    }
+    else if (((pcm_ring_head + 1) - pcm_ring_tail) < PCM_RING_BLOCKS)
+    {
+        pcm_ring_head++;
+        if (pcm_ring_mode == PCM_RING_RECORD)
+        {
+            stats_pcm_block(pcm_ring_head - pcm_ring_tail, false);
+            TRACE_INSTANT(TRACE_ID_PDM_BLOCK, pcm_ring_head - pcm_ring_tail);
+        }
+    }
+    else if (pcm_ring_mode == PCM_RING_PRETRIGGER)
+    {
+        pcm_ring_tail++;
+        pcm_ring_head++;
+    }
+    else
+    {
+        pcm_ring_overruns++;
+        stats_pcm_block(pcm_ring_head - pcm_ring_tail, true);
 
-    pdm_pcm_toggle = !pdm_pcm_toggle;
+        /* Freeze the trace to keep the events leading to the dropout */
+        TRACE_INSTANT(TRACE_ID_PDM_OVERRUN, pcm_ring_head - pcm_ring_tail);
+        TRACE_STOP();
+    }
+
+    /* Schedule the next read */
+    cyhal_pdm_pcm_read_async(&pdm_pcm, PCM_RING_BLOCK(pcm_ring_head), PCM_BLOCK_SIZE/2);
 
     xTaskNotifyFromISR(rtos_audio_task, 
                        NOTIFY_PCM_DATA,
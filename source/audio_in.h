@@ -46,6 +46,9 @@
 /*******************************************************************************
 * Constants
 ********************************************************************************/
+/* Size of a PCM ring block, filled by one PDM/PCM transfer of 16-bit
+ * samples and passed whole to the processing and the file system */
+#define PCM_BLOCK_SIZE              16384u
 
 /*******************************************************************************
 * Functions
@@ -0,0 +1,333 @@
+/*****************************************************************************
+* File Name: audio_peak.c
+*
+* Description:
+*  This file contains the waveform overview of the recorder. The minimum,
+*  maximum and RMS of each channel are computed over bins of the samples
+*  written to the record, at several zoom levels, and stored in pages of a
+*  sidecar file next to the record, so a host can draw the record, or find
+*  its activity, by reading a few kilobytes instead of the whole file.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "audio_peak.h"
+
+#include <math.h>
+#include <string.h>
+
+/*******************************************************************************
+* Function Name: audio_peak_reset
+********************************************************************************
+* Summary:
+*   Start a new bin at a level.
+*
+*******************************************************************************/
+static void audio_peak_reset(audio_peak_level_t *level)
+{
+    uint32_t channel;
+
+    for (channel = 0; channel < AUDIO_PEAK_CHANNELS_MAX; channel++)
+    {
+        level->min[channel] = INT16_MAX;
+        level->max[channel] = INT16_MIN;
+        level->sum[channel] = 0;
+    }
+    level->frames = 0;
+    level->parts = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_peak_bin
+********************************************************************************
+* Summary:
+*   Complete the bin of a level: store it in the page of the level, and sum
+*   it in the bin of the level above.
+*
+* Parameters:
+*   peak = overview state
+*   index = level of the bin
+*
+*******************************************************************************/
+static void audio_peak_bin(audio_peak_t *peak, uint32_t index)
+{
+    audio_peak_level_t *level = &peak->levels[index];
+    audio_peak_level_t *up = (index < (AUDIO_PEAK_LEVELS - 1u)) ? &peak->levels[index + 1u] : NULL;
+    uint8_t *entry = &level->page[level->page_bins * peak->channels * AUDIO_PEAK_ENTRY_SIZE];
+    uint32_t channel;
+    uint16_t rms;
+
+    for (channel = 0; channel < peak->channels; channel++)
+    {
+        rms = (uint16_t) (sqrtf((float) level->sum[channel] / (float) level->frames) + 0.5f);
+        entry[0] = (uint8_t) level->min[channel];
+        entry[1] = (uint8_t) ((uint16_t) level->min[channel] >> 8);
+        entry[2] = (uint8_t) level->max[channel];
+        entry[3] = (uint8_t) ((uint16_t) level->max[channel] >> 8);
+        entry[4] = (uint8_t) rms;
+        entry[5] = (uint8_t) (rms >> 8);
+        entry += AUDIO_PEAK_ENTRY_SIZE;
+
+        if (up != NULL)
+        {
+            up->min[channel] = (level->min[channel] < up->min[channel]) ? level->min[channel] : up->min[channel];
+            up->max[channel] = (level->max[channel] > up->max[channel]) ? level->max[channel] : up->max[channel];
+            up->sum[channel] += level->sum[channel];
+        }
+    }
+
+    if (up != NULL)
+    {
+        up->frames += level->frames;
+        up->parts++;
+    }
+
+    level->bins++;
+    level->page_bins++;
+    level->page_ready = (level->page_bins == peak->page_bins);
+    audio_peak_reset(level);
+}
+
+/*******************************************************************************
+* Function Name: audio_peak_init
+********************************************************************************
+* Summary:
+*   Set up the overview for a record.
+*
+* Parameters:
+*   peak = overview state
+*   sample_rate = frame rate in Hertz
+*   channels = 1 or 2, interleaved
+*
+*******************************************************************************/
+void audio_peak_init(audio_peak_t *peak, uint32_t sample_rate, uint32_t channels)
+{
+    uint32_t index;
+
+    memset(peak, 0, sizeof(audio_peak_t));
+    peak->channels = channels;
+    peak->sample_rate = sample_rate;
+    peak->page_bins = AUDIO_PEAK_PAGE_SIZE / (channels * AUDIO_PEAK_ENTRY_SIZE);
+
+    for (index = 0; index < AUDIO_PEAK_LEVELS; index++)
+    {
+        audio_peak_reset(&peak->levels[index]);
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_peak_process
+********************************************************************************
+* Summary:
+*   Sum a block of samples in the bins. The bins of the coarser levels are
+*   completed with the last bin they hold. The samples are taken up to the
+*   end of a page, which must be written with audio_peak_page() before the
+*   rest is given.
+*
+* Parameters:
+*   peak = overview state
+*   buf = interleaved 16-bit samples
+*   len = length of the samples in bytes, a multiple of the frame size
+*
+* Return:
+*   Length of the samples taken, in bytes.
+*
+*******************************************************************************/
+uint32_t audio_peak_process(audio_peak_t *peak, const uint8_t *buf, uint32_t len)
+{
+    audio_peak_level_t *level = &peak->levels[0];
+    uint32_t channels = peak->channels;
+    uint32_t frames = len / (channels * sizeof(int16_t));
+    uint32_t done = 0;
+    uint32_t count;
+    uint32_t channel;
+    uint32_t index;
+    uint32_t end;
+    int16_t sample;
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+
+    while ((done < frames) && !level->page_ready)
+    {
+        /* Frames up to the end of the bin, one channel at a time */
+        count = ((frames - done) < (AUDIO_PEAK_BIN_FRAMES - level->frames)) ?
+                (frames - done) : (AUDIO_PEAK_BIN_FRAMES - level->frames);
+        end = (done + count) * channels;
+        for (channel = 0; channel < channels; channel++)
+        {
+            min = level->min[channel];
+            max = level->max[channel];
+            sum = 0;
+            for (index = (done * channels) + channel; index < end; index += channels)
+            {
+                memcpy(&sample, &buf[index * sizeof(int16_t)], sizeof(sample));
+                min = (sample < min) ? sample : min;
+                max = (sample > max) ? sample : max;
+                sum += (int32_t) sample * sample;
+            }
+            level->min[channel] = (int16_t) min;
+            level->max[channel] = (int16_t) max;
+            level->sum[channel] += (uint64_t) sum;
+        }
+        level->frames += count;
+        peak->frames += count;
+        done += count;
+
+        /* Complete the bin, and the bins above that it fills */
+        if (level->frames == AUDIO_PEAK_BIN_FRAMES)
+        {
+            audio_peak_bin(peak, 0);
+            for (index = 1; (index < AUDIO_PEAK_LEVELS) && (peak->levels[index].parts == AUDIO_PEAK_RATIO); index++)
+            {
+                audio_peak_bin(peak, index);
+            }
+            peak->pages += (level->page_ready) ? 1u : 0u;
+        }
+    }
+
+    return done * channels * sizeof(int16_t);
+}
+
+/*******************************************************************************
+* Function Name: audio_peak_page
+********************************************************************************
+* Summary:
+*   Take the next page to write to the sidecar, the finer levels first.
+*
+* Parameters:
+*   peak = overview state
+*
+* Return:
+*   Page of AUDIO_PEAK_PAGE_SIZE bytes, valid until the next samples are
+*   given, or NULL if none is full.
+*
+*******************************************************************************/
+const uint8_t *audio_peak_page(audio_peak_t *peak)
+{
+    uint32_t index;
+
+    for (index = 0; index < AUDIO_PEAK_LEVELS; index++)
+    {
+        if (peak->levels[index].page_ready)
+        {
+            peak->levels[index].page_ready = false;
+            peak->levels[index].page_bins = 0;
+            return peak->levels[index].page;
+        }
+    }
+
+    return NULL;
+}
+
+/*******************************************************************************
+* Function Name: audio_peak_finish
+********************************************************************************
+* Summary:
+*   Complete the bins left at the end of the record, shorter than the
+*   others, and leave the last page of each level to be written, even if
+*   not full. The pages must all have been taken before.
+*
+* Parameters:
+*   peak = overview state
+*
+*******************************************************************************/
+void audio_peak_finish(audio_peak_t *peak)
+{
+    audio_peak_level_t *level;
+    uint32_t index;
+
+    for (index = 0; index < AUDIO_PEAK_LEVELS; index++)
+    {
+        level = &peak->levels[index];
+        if (level->frames != 0u)
+        {
+            audio_peak_bin(peak, index);
+        }
+    }
+
+    for (index = 0; index < AUDIO_PEAK_LEVELS; index++)
+    {
+        level = &peak->levels[index];
+        level->page_ready = (level->page_bins != 0u);
+        memset(&level->page[level->page_bins * peak->channels * AUDIO_PEAK_ENTRY_SIZE], 0,
+               AUDIO_PEAK_PAGE_SIZE - (level->page_bins * peak->channels * AUDIO_PEAK_ENTRY_SIZE));
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_peak_header
+********************************************************************************
+* Summary:
+*   Build the header of the sidecar, at the start of its first page. The
+*   full pages of level 0 give the place of every page before the last
+*   ones; a sidecar left by a reset with the header of its creation holds
+*   only full pages.
+*
+* Parameters:
+*   peak = overview state
+*
+* Return:
+*   First page of the sidecar.
+*
+*******************************************************************************/
+const uint8_t *audio_peak_header(audio_peak_t *peak)
+{
+    uint32_t fields[] =
+    {
+        AUDIO_PEAK_MAGIC,
+        AUDIO_PEAK_VERSION | (peak->channels << 16),
+        peak->sample_rate,
+        peak->frames,
+        AUDIO_PEAK_BIN_FRAMES | (AUDIO_PEAK_RATIO << 16),
+        AUDIO_PEAK_LEVELS | (peak->page_bins << 16),
+        peak->pages,
+        peak->levels[0].bins,
+        peak->levels[1].bins,
+        peak->levels[2].bins,
+    };
+    uint32_t index;
+
+    /* Little-endian fields */
+    for (index = 0; index < (sizeof(fields) / sizeof(fields[0])); index++)
+    {
+        peak->header[(index * 4u) + 0u] = (uint8_t) fields[index];
+        peak->header[(index * 4u) + 1u] = (uint8_t) (fields[index] >> 8);
+        peak->header[(index * 4u) + 2u] = (uint8_t) (fields[index] >> 16);
+        peak->header[(index * 4u) + 3u] = (uint8_t) (fields[index] >> 24);
+    }
+    return peak->header;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,109 @@
+/*****************************************************************************
+* File Name: audio_peak.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the audio_peak.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef AUDIO_PEAK_H_
+#define AUDIO_PEAK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_PEAK_CHANNELS_MAX     2u
+
+/* Levels of the overview: bins of 1024 frames, each level 16 times coarser */
+#define AUDIO_PEAK_LEVELS           3u
+#define AUDIO_PEAK_BIN_FRAMES       1024u
+#define AUDIO_PEAK_RATIO            16u
+
+/* Bin of a channel: minimum, maximum and RMS, 16-bit little-endian */
+#define AUDIO_PEAK_ENTRY_SIZE       6u
+
+/* The sidecar is made of pages of one sector. The first one holds the
+ * header, then the pages of each level follow in the order they fill up:
+ * a page of level 0, and each time 16 of them are full, a page of level 1,
+ * and so on. The pages not full at the end follow, one per level */
+#define AUDIO_PEAK_PAGE_SIZE        512u
+#define AUDIO_PEAK_HEADER_SIZE      40u
+#define AUDIO_PEAK_MAGIC            0x4B414550u     /* "PEAK" */
+#define AUDIO_PEAK_VERSION          1u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Bin being summed at a level, and the page of the bins done */
+typedef struct
+{
+    int16_t min[AUDIO_PEAK_CHANNELS_MAX];
+    int16_t max[AUDIO_PEAK_CHANNELS_MAX];
+    uint64_t sum[AUDIO_PEAK_CHANNELS_MAX];      /* Sum of the squares */
+    uint32_t frames;
+    uint32_t parts;             /* Bins of the level below */
+    uint32_t bins;              /* Bins done */
+    uint32_t page_bins;
+    bool page_ready;
+    uint8_t page[AUDIO_PEAK_PAGE_SIZE];
+} audio_peak_level_t;
+
+typedef struct
+{
+    uint32_t channels;
+    uint32_t sample_rate;
+    uint32_t page_bins;         /* Bins per page */
+    uint32_t frames;
+    uint32_t pages;             /* Full pages of level 0, before the end */
+    audio_peak_level_t levels[AUDIO_PEAK_LEVELS];
+    uint8_t header[AUDIO_PEAK_PAGE_SIZE];
+} audio_peak_t;
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void audio_peak_init(audio_peak_t *peak, uint32_t sample_rate, uint32_t channels);
+uint32_t audio_peak_process(audio_peak_t *peak, const uint8_t *buf, uint32_t len);
+const uint8_t *audio_peak_page(audio_peak_t *peak);
+void audio_peak_finish(audio_peak_t *peak);
+const uint8_t *audio_peak_header(audio_peak_t *peak);
+
+#endif /* AUDIO_PEAK_H_ */
+
+/* [] END OF FILE */
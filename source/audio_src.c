@@ -0,0 +1,412 @@
+/*****************************************************************************
+* File Name: audio_src.c
+*
+* Description:
+*  This file contains the sample rate converter of the recorder. The
+*  PDM/PCM block captures at a rate its clock produces, and the converter
+*  resamples the blocks in place to the stored rate, by any rational ratio
+*  down to 1/AUDIO_SRC_RATIO_MAX. Each output is a polyphase FIR of the
+*  inputs around it: the coefficients come from a Kaiser-windowed sinc bank
+*  in flash, stretched to the output rate and interpolated between its
+*  phases. The timing of the outputs is exact, so the record length matches
+*  its rate.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "audio_src.h"
+
+#include <string.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_SRC_BANK_SIZE         (AUDIO_SRC_ZEROS * AUDIO_SRC_PHASES)
+#define AUDIO_SRC_GAIN_Q            20u
+#define AUDIO_SRC_COEF_Q            15u
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+/* Low-pass prototype with its cutoff at the output Nyquist rate, one side,
+ * Q15. Generated by tools/audio_src/src_table.py */
+static const int16_t audio_src_bank[AUDIO_SRC_BANK_SIZE + 1u] =
+{
+    32767, 32765, 32755, 32738, 32715, 32685, 32648, 32605, 32555, 32499, 32436, 32366,
+    32290, 32207, 32118, 32023, 31921, 31813, 31698, 31578, 31451, 31317, 31178, 31033,
+    30881, 30724, 30561, 30391, 30216, 30036, 29849, 29658, 29460, 29257, 29049, 28835,
+    28617, 28393, 28164, 27930, 27691, 27448, 27199, 26946, 26689, 26427, 26161, 25891,
+    25616, 25337, 25055, 24768, 24478, 24184, 23887, 23586, 23282, 22975, 22665, 22351,
+    22035, 21716, 21394, 21070, 20744, 20415, 20084, 19751, 19415, 19078, 18740, 18399,
+    18058, 17714, 17370, 17024, 16678, 16330, 15982, 15633, 15283, 14933, 14583, 14233,
+    13882, 13531, 13181, 12831, 12481, 12132, 11783, 11435, 11088, 10742, 10397, 10053,
+    9710, 9369, 9029, 8691, 8354, 8019, 7686, 7356, 7027, 6700, 6376, 6054,
+    5735, 5418, 5104, 4792, 4484, 4178, 3876, 3576, 3280, 2987, 2697, 2411,
+    2128, 1849, 1573, 1301, 1033, 769, 509, 252, 0, -248, -492, -732,
+    -968, -1199, -1426, -1649, -1867, -2081, -2290, -2495, -2695, -2890, -3081, -3267,
+    -3448, -3625, -3797, -3964, -4126, -4284, -4436, -4584, -4727, -4865, -4999, -5127,
+    -5250, -5369, -5483, -5592, -5696, -5795, -5890, -5979, -6064, -6144, -6219, -6290,
+    -6356, -6417, -6473, -6525, -6572, -6615, -6653, -6687, -6716, -6740, -6761, -6776,
+    -6788, -6795, -6798, -6797, -6792, -6783, -6770, -6753, -6731, -6706, -6678, -6645,
+    -6609, -6569, -6526, -6479, -6429, -6376, -6319, -6259, -6196, -6130, -6061, -5989,
+    -5914, -5836, -5755, -5672, -5587, -5499, -5408, -5315, -5220, -5123, -5024, -4922,
+    -4819, -4714, -4607, -4498, -4388, -4276, -4163, -4049, -3933, -3815, -3697, -3578,
+    -3458, -3336, -3214, -3092, -2968, -2844, -2720, -2595, -2469, -2344, -2218, -2092,
+    -1966, -1840, -1714, -1588, -1463, -1338, -1213, -1089, -965, -841, -719, -597,
+    -476, -355, -236, -117, 0, 116, 232, 346, 458, 570, 680, 789,
+    896, 1002, 1106, 1208, 1309, 1409, 1506, 1602, 1696, 1788, 1878, 1966,
+    2052, 2136, 2219, 2299, 2377, 2453, 2526, 2598, 2667, 2734, 2799, 2862,
+    2922, 2980, 3036, 3090, 3141, 3190, 3236, 3280, 3322, 3361, 3398, 3433,
+    3465, 3495, 3522, 3547, 3570, 3590, 3608, 3624, 3637, 3648, 3657, 3663,
+    3667, 3669, 3668, 3666, 3661, 3654, 3645, 3633, 3620, 3604, 3586, 3567,
+    3545, 3521, 3496, 3468, 3439, 3407, 3374, 3339, 3302, 3264, 3224, 3182,
+    3138, 3093, 3047, 2999, 2949, 2899, 2846, 2793, 2738, 2682, 2624, 2566,
+    2506, 2446, 2384, 2321, 2258, 2193, 2128, 2062, 1995, 1927, 1859, 1790,
+    1721, 1651, 1580, 1509, 1438, 1366, 1294, 1222, 1150, 1077, 1005, 932,
+    859, 787, 714, 641, 569, 497, 425, 353, 282, 211, 140, 70,
+    0, -69, -138, -206, -273, -340, -406, -472, -536, -600, -663, -725,
+    -786, -847, -906, -964, -1022, -1078, -1133, -1187, -1241, -1292, -1343, -1393,
+    -1441, -1488, -1534, -1579, -1622, -1664, -1705, -1744, -1782, -1819, -1854, -1888,
+    -1920, -1952, -1981, -2009, -2036, -2062, -2086, -2108, -2129, -2149, -2167, -2184,
+    -2199, -2213, -2225, -2236, -2246, -2254, -2261, -2266, -2270, -2272, -2273, -2272,
+    -2271, -2267, -2263, -2257, -2250, -2241, -2231, -2220, -2208, -2194, -2179, -2163,
+    -2145, -2127, -2107, -2086, -2064, -2041, -2017, -1992, -1965, -1938, -1910, -1880,
+    -1850, -1819, -1787, -1754, -1720, -1686, -1650, -1614, -1577, -1540, -1501, -1462,
+    -1423, -1383, -1342, -1301, -1259, -1217, -1174, -1131, -1087, -1043, -999, -955,
+    -910, -865, -820, -774, -729, -683, -637, -591, -545, -499, -453, -407,
+    -361, -316, -270, -224, -179, -134, -89, -44, 0, 44, 88, 131,
+    174, 217, 259, 301, 342, 383, 423, 463, 502, 541, 579, 616,
+    653, 689, 724, 759, 793, 826, 859, 891, 922, 952, 982, 1011,
+    1038, 1065, 1092, 1117, 1142, 1165, 1188, 1210, 1231, 1251, 1270, 1289,
+    1306, 1323, 1338, 1353, 1367, 1379, 1391, 1402, 1412, 1421, 1429, 1436,
+    1443, 1448, 1452, 1456, 1459, 1460, 1461, 1461, 1460, 1458, 1455, 1451,
+    1447, 1441, 1435, 1428, 1420, 1412, 1402, 1392, 1381, 1369, 1356, 1343,
+    1329, 1314, 1298, 1282, 1265, 1248, 1230, 1211, 1191, 1171, 1151, 1129,
+    1108, 1086, 1063, 1040, 1016, 992, 967, 942, 916, 891, 864, 838,
+    811, 784, 756, 728, 700, 672, 644, 615, 586, 557, 528, 499,
+    469, 440, 410, 381, 351, 321, 292, 262, 233, 203, 174, 145,
+    115, 86, 57, 29, 0, -28, -57, -84, -112, -140, -167, -194,
+    -220, -246, -272, -298, -323, -348, -372, -396, -420, -443, -466, -488,
+    -510, -531, -552, -573, -593, -612, -631, -649, -667, -685, -701, -718,
+    -733, -749, -763, -777, -791, -803, -816, -827, -838, -849, -859, -868,
+    -877, -885, -892, -899, -906, -911, -916, -921, -925, -928, -931, -933,
+    -934, -935, -936, -936, -935, -933, -931, -929, -926, -922, -918, -914,
+    -908, -903, -896, -890, -883, -875, -867, -858, -849, -839, -829, -819,
+    -808, -796, -785, -773, -760, -747, -734, -720, -706, -692, -677, -662,
+    -647, -632, -616, -600, -583, -567, -550, -533, -516, -499, -481, -463,
+    -445, -427, -409, -391, -372, -354, -335, -317, -298, -279, -260, -241,
+    -223, -204, -185, -166, -147, -129, -110, -91, -73, -55, -36, -18,
+    0, 18, 36, 53, 71, 88, 105, 122, 139, 155, 172, 188,
+    204, 219, 235, 250, 265, 279, 293, 307, 321, 334, 347, 360,
+    373, 385, 397, 408, 419, 430, 440, 451, 460, 470, 479, 487,
+    496, 503, 511, 518, 525, 531, 537, 543, 548, 553, 558, 562,
+    566, 569, 572, 575, 577, 579, 581, 582, 582, 583, 583, 583,
+    582, 581, 580, 578, 576, 573, 571, 568, 564, 560, 556, 552,
+    547, 542, 537, 532, 526, 520, 513, 507, 500, 493, 485, 478,
+    470, 462, 453, 445, 436, 427, 418, 408, 399, 389, 379, 369,
+    359, 349, 338, 328, 317, 306, 295, 284, 273, 262, 251, 240,
+    228, 217, 205, 194, 182, 171, 159, 148, 136, 125, 113, 101,
+    90, 79, 67, 56, 44, 33, 22, 11, 0, -11, -22, -32,
+    -43, -54, -64, -74, -84, -94, -104, -114, -123, -133, -142, -151,
+    -160, -169, -177, -186, -194, -202, -210, -217, -225, -232, -239, -246,
+    -252, -259, -265, -271, -276, -282, -287, -292, -297, -302, -306, -310,
+    -314, -318, -321, -325, -328, -331, -333, -335, -338, -339, -341, -342,
+    -344, -345, -345, -346, -346, -346, -346, -346, -345, -345, -344, -342,
+    -341, -339, -338, -336, -334, -331, -329, -326, -323, -320, -317, -313,
+    -310, -306, -302, -298, -294, -289, -285, -280, -276, -271, -266, -260,
+    -255, -250, -244, -239, -233, -227, -221, -215, -209, -203, -197, -191,
+    -185, -178, -172, -165, -159, -152, -146, -139, -132, -126, -119, -112,
+    -105, -99, -92, -85, -79, -72, -65, -58, -52, -45, -39, -32,
+    -26, -19, -13, -6, 0, 6, 12, 19, 25, 31, 37, 42,
+    48, 54, 59, 65, 70, 76, 81, 86, 91, 96, 101, 105,
+    110, 114, 119, 123, 127, 131, 135, 139, 142, 146, 149, 152,
+    156, 159, 161, 164, 167, 169, 172, 174, 176, 178, 180, 182,
+    183, 185, 186, 187, 188, 189, 190, 191, 191, 191, 192, 192,
+    192, 192, 192, 191, 191, 190, 190, 189, 188, 187, 186, 185,
+    183, 182, 181, 179, 177, 175, 174, 172, 169, 167, 165, 163,
+    160, 158, 155, 153, 150, 147, 144, 141, 138, 135, 132, 129,
+    126, 123, 120, 116, 113, 110, 106, 103, 99, 96, 92, 89,
+    85, 82, 78, 74, 71, 67, 63, 60, 56, 53, 49, 45,
+    42, 38, 35, 31, 27, 24, 20, 17, 14, 10, 7, 3,
+    0, -3, -7, -10, -13, -16, -19, -22, -25, -28, -31, -34,
+    -37, -39, -42, -45, -47, -50, -52, -55, -57, -59, -61, -64,
+    -66, -68, -70, -71, -73, -75, -77, -78, -80, -81, -83, -84,
+    -85, -86, -88, -89, -90, -91, -91, -92, -93, -94, -94, -95,
+    -95, -95, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96,
+    -95, -95, -95, -94, -94, -93, -92, -92, -91, -90, -89, -88,
+    -87, -87, -85, -84, -83, -82, -81, -80, -78, -77, -76, -74,
+    -73, -72, -70, -69, -67, -66, -64, -63, -61, -59, -58, -56,
+    -54, -53, -51, -49, -48, -46, -44, -42, -41, -39, -37, -35,
+    -34, -32, -30, -28, -27, -25, -23, -21, -20, -18, -16, -15,
+    -13, -11, -10, -8, -6, -5, -3, -2, 0, 2, 3, 5,
+    6, 7, 9, 10, 12, 13, 14, 15, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 29, 30, 31, 32,
+    33, 33, 34, 35, 35, 36, 37, 37, 38, 38, 39, 39,
+    39, 40, 40, 40, 41, 41, 41, 41, 41, 41, 41, 41,
+    41, 41, 41, 41, 41, 41, 41, 41, 41, 40, 40, 40,
+    40, 39, 39, 39, 38, 38, 37, 37, 37, 36, 36, 35,
+    35, 34, 33, 33, 32, 32, 31, 31, 30, 29, 29, 28,
+    27, 27, 26, 25, 25, 24, 23, 22, 22, 21, 20, 20,
+    19, 18, 17, 17, 16, 15, 15, 14, 13, 12, 12, 11,
+    10, 10, 9, 8, 8, 7, 6, 6, 5, 4, 4, 3,
+    2, 2, 1, 1, 0, -1, -1, -2, -2, -3, -3, -4,
+    -4, -5, -5, -6, -6, -6, -7, -7, -8, -8, -8, -9,
+    -9, -9, -10, -10, -10, -11, -11, -11, -11, -12, -12, -12,
+    -12, -12, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13,
+    -13, -13, -13, -14, -13, -13, -13, -13, -13, -13, -13, -13,
+    -13, -13, -13, -13, -13, -13, -13, -12, -12, -12, -12, -12,
+    -12, -11, -11, -11, -11, -11, -11, -10, -10, -10, -10, -10,
+    -9, -9, -9, -9, -9, -8, -8, -8, -8, -7, -7, -7,
+    -7, -7, -6, -6, -6, -6, -5, -5, -5, -5, -5, -4,
+    -4, -4, -4, -4, -3, -3, -3, -3, -3, -2, -2, -2,
+    -2, -2, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0,
+    0
+};
+
+/*******************************************************************************
+* Function Name: audio_src_gcd
+********************************************************************************
+* Summary:
+*   Greatest common divisor of two rates.
+*
+*******************************************************************************/
+static uint32_t audio_src_gcd(uint32_t a, uint32_t b)
+{
+    uint32_t r;
+
+    while (b != 0u)
+    {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/*******************************************************************************
+* Function Name: audio_src_coef
+********************************************************************************
+* Summary:
+*   Coefficient of the bank at a position, interpolated between two phases.
+*
+* Parameters:
+*   pos = Q16 position in the bank
+*
+*******************************************************************************/
+static inline int16_t audio_src_coef(uint32_t pos)
+{
+    uint32_t index = pos >> 16;
+    int32_t frac = (int32_t) ((pos >> 1) & 0x7FFFu);
+    int32_t h0;
+
+    if (index >= AUDIO_SRC_BANK_SIZE)
+    {
+        return 0;
+    }
+    h0 = audio_src_bank[index];
+    return (int16_t) (h0 + (((audio_src_bank[index + 1u] - h0) * frac) >> AUDIO_SRC_COEF_Q));
+}
+
+/*******************************************************************************
+* Function Name: audio_src_output
+********************************************************************************
+* Summary:
+*   Compute the frame at the current output position from the delay lines,
+*   whose newest input is the last tap.
+*
+* Parameters:
+*   src = converter state
+*   out = output frame
+*
+*******************************************************************************/
+static void audio_src_output(audio_src_t *src, int16_t *out)
+{
+    uint32_t taps = src->taps;
+    uint32_t left = (uint32_t) (((uint64_t) src->phase * (AUDIO_SRC_PHASES << 16)) / src->m);
+    uint32_t right = src->step - left;
+    uint32_t tap;
+    uint32_t channel;
+    const int16_t *x;
+    int64_t acc;
+    int64_t y;
+
+    /* Coefficients from the oldest input to the newest, shared by the
+     * channels */
+    for (tap = 0; tap < taps; tap++)
+    {
+        src->coef[taps - 1u - tap] = audio_src_coef(left + (tap * src->step));
+        src->coef[taps + tap] = audio_src_coef(right + (tap * src->step));
+    }
+
+    for (channel = 0; channel < src->channels; channel++)
+    {
+        x = &src->delay[channel][src->pos + AUDIO_SRC_DELAY - (2u * taps)];
+        acc = 0;
+        for (tap = 0; tap < (2u * taps); tap++)
+        {
+            acc += (int32_t) x[tap] * src->coef[tap];
+        }
+
+        /* Scale to the output rate, rounded */
+        y = ((acc * src->gain) + ((int64_t) 1 << (AUDIO_SRC_COEF_Q + AUDIO_SRC_GAIN_Q - 1u))) >>
+            (AUDIO_SRC_COEF_Q + AUDIO_SRC_GAIN_Q);
+        out[channel] = (int16_t) ((y > INT16_MAX) ? INT16_MAX : ((y < INT16_MIN) ? INT16_MIN : y));
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_src_capture_rate
+********************************************************************************
+* Summary:
+*   Rate to capture at for a stored rate: the recommended rates are produced
+*   by the PDM/PCM block, the other ones are converted from the native rate.
+*
+* Parameters:
+*   sample_rate = stored rate in Hertz
+*
+* Return:
+*   Capture rate in Hertz.
+*
+*******************************************************************************/
+uint32_t audio_src_capture_rate(uint32_t sample_rate)
+{
+    switch (sample_rate)
+    {
+        case 8000u:
+        case 16000u:
+        case 32000u:
+        case 48000u:
+            return sample_rate;
+        default:
+            /* Higher rates are left to the PDM/PCM block */
+            return (sample_rate > AUDIO_SRC_NATIVE_RATE) ? sample_rate : AUDIO_SRC_NATIVE_RATE;
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_src_init
+********************************************************************************
+* Summary:
+*   Set up the converter for a record. It is off when the rates are the
+*   same, or out of its range.
+*
+* Parameters:
+*   src = converter state
+*   in_rate = capture rate in Hertz
+*   out_rate = stored rate in Hertz, down to in_rate / AUDIO_SRC_RATIO_MAX
+*   channels = 1 or 2, interleaved
+*
+*******************************************************************************/
+void audio_src_init(audio_src_t *src, uint32_t in_rate, uint32_t out_rate, uint32_t channels)
+{
+    uint32_t gcd;
+
+    memset(src, 0, sizeof(audio_src_t));
+    src->channels = channels;
+    if ((out_rate >= in_rate) || ((out_rate * AUDIO_SRC_RATIO_MAX) < in_rate))
+    {
+        return;
+    }
+    src->enabled = true;
+
+    gcd = audio_src_gcd(in_rate, out_rate);
+    src->l = out_rate / gcd;
+    src->m = in_rate / gcd;
+
+    /* The prototype spans AUDIO_SRC_ZEROS outputs on each side */
+    src->step = (uint32_t) (((uint64_t) out_rate * (AUDIO_SRC_PHASES << 16)) / in_rate);
+    src->taps = (uint32_t) (((uint64_t) AUDIO_SRC_ZEROS * in_rate + out_rate - 1u) / out_rate) + 1u;
+    src->gain = (int32_t) (((uint64_t) out_rate << AUDIO_SRC_GAIN_Q) / in_rate);
+
+    /* The first output is at the first input, after its right taps */
+    src->wait = src->taps + 1u;
+}
+
+/*******************************************************************************
+* Function Name: audio_src_process
+********************************************************************************
+* Summary:
+*   Convert PCM samples in place. At most one frame comes out of each frame
+*   going in, so the outputs never overtake the inputs.
+*
+* Parameters:
+*   src = converter state
+*   buf = interleaved 16-bit samples
+*   len = length of the samples in bytes, a multiple of the frame size
+*
+* Return:
+*   Length of the converted samples at the start of buf.
+*
+*******************************************************************************/
+uint32_t audio_src_process(audio_src_t *src, uint8_t *buf, uint32_t len)
+{
+    uint32_t frame_size = src->channels * sizeof(int16_t);
+    uint32_t frames = len / frame_size;
+    uint32_t frame;
+    uint32_t channel;
+    uint32_t out = 0;
+    int16_t sample[AUDIO_SRC_CHANNELS_MAX];
+
+    if (!src->enabled)
+    {
+        return len;
+    }
+
+    for (frame = 0; frame < frames; frame++)
+    {
+        /* Push the frame in the delay lines */
+        memcpy(sample, &buf[frame * frame_size], frame_size);
+        for (channel = 0; channel < src->channels; channel++)
+        {
+            src->delay[channel][src->pos] = sample[channel];
+            src->delay[channel][src->pos + AUDIO_SRC_DELAY] = sample[channel];
+        }
+        src->pos = (src->pos + 1u) % AUDIO_SRC_DELAY;
+
+        if (--src->wait == 0u)
+        {
+            audio_src_output(src, sample);
+            memcpy(&buf[out], sample, frame_size);
+            out += frame_size;
+
+            /* Move to the next output, m / l inputs later */
+            src->phase += src->m;
+            src->wait = src->phase / src->l;
+            src->phase %= src->l;
+        }
+    }
+    return out;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,103 @@
+/*****************************************************************************
+* File Name: audio_src.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the audio_src.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef AUDIO_SRC_H_
+#define AUDIO_SRC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define AUDIO_SRC_CHANNELS_MAX      2u
+
+/* Capture rate of the stored rates the PDM/PCM block does not produce */
+#define AUDIO_SRC_NATIVE_RATE       48000u
+
+/* Filter bank: one side of the low-pass prototype, in phases per zero
+ * crossing (tools/audio_src/src_table.py) */
+#define AUDIO_SRC_ZEROS             12u
+#define AUDIO_SRC_PHASES            128u
+
+/* Lowest output rate, the taps grow with the decimation ratio */
+#define AUDIO_SRC_RATIO_MAX         8u
+#define AUDIO_SRC_RATE_MIN          (AUDIO_SRC_NATIVE_RATE / AUDIO_SRC_RATIO_MAX)
+
+/* Taps on each side of an output, and the delay line holding them */
+#define AUDIO_SRC_TAPS_MAX          ((AUDIO_SRC_ZEROS * AUDIO_SRC_RATIO_MAX) + 1u)
+#define AUDIO_SRC_DELAY             256u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef struct
+{
+    bool enabled;
+    uint32_t channels;
+
+    /* Ratio of the rates reduced to l / m, an output every m / l input */
+    uint32_t l;
+    uint32_t m;
+    uint32_t phase;             /* Position of the next output, in 1 / l */
+    uint32_t wait;              /* Inputs until the next output */
+
+    /* Filter stretched to the output rate */
+    uint32_t taps;              /* On each side */
+    uint32_t step;              /* Q16 bank index per input */
+    int32_t gain;               /* Q20 */
+
+    /* Delay lines, stored twice so the taps are contiguous */
+    uint32_t pos;
+    int16_t delay[AUDIO_SRC_CHANNELS_MAX][2u * AUDIO_SRC_DELAY];
+    int16_t coef[2u * AUDIO_SRC_TAPS_MAX];
+} audio_src_t;
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+uint32_t audio_src_capture_rate(uint32_t sample_rate);
+void     audio_src_init(audio_src_t *src, uint32_t in_rate, uint32_t out_rate, uint32_t channels);
+uint32_t audio_src_process(audio_src_t *src, uint8_t *buf, uint32_t len);
+
+#endif /* AUDIO_SRC_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,207 @@
+/*****************************************************************************
+* File Name: audio_vad.c
+*
+* Description:
+*  This file contains the activity detector of the recorder. The energy of
+*  the conditioned samples is measured in short windows against a noise
+*  floor that follows the quietest ones. Activity starts when a window is
+*  loud enough, and ends after the windows stay below a lower threshold for
+*  the hangover time. The audio task writes only the blocks with activity,
+*  each segment starting with the silent block before it as pre-roll, and
+*  the segments are listed in an index file next to the record.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "audio_vad.h"
+
+#include <math.h>
+#include <string.h>
+
+/*******************************************************************************
+* Function Name: audio_vad_window
+********************************************************************************
+* Summary:
+*   Update the activity and the noise floor with a window of samples.
+*
+* Parameters:
+*   vad = detector state
+*   energy = mean square of the window samples
+*
+*******************************************************************************/
+static void audio_vad_window(audio_vad_t *vad, float energy)
+{
+    /* The first window is assumed to be noise */
+    if (vad->floor == 0.0f)
+    {
+        vad->floor = energy;
+    }
+
+    if (!vad->active && (energy > (vad->floor * vad->on_ratio)))
+    {
+        vad->active = true;
+        vad->hangover = vad->hangover_windows;
+    }
+    else if (vad->active && (energy > (vad->floor * vad->off_ratio)))
+    {
+        vad->hangover = vad->hangover_windows;
+    }
+    else if (vad->active)
+    {
+        vad->hangover--;
+        vad->active = (vad->hangover != 0u);
+    }
+
+    /* The floor also rises during activity, so a steady sound ends up as
+     * noise instead of keeping the record going */
+    if (energy < vad->floor)
+    {
+        vad->floor += (energy - vad->floor) * AUDIO_VAD_FLOOR_FALL;
+    }
+    else
+    {
+        vad->floor *= vad->rise;
+    }
+    vad->floor = (vad->floor < AUDIO_VAD_FLOOR_MIN) ? AUDIO_VAD_FLOOR_MIN : vad->floor;
+}
+
+/*******************************************************************************
+* Function Name: audio_vad_init
+********************************************************************************
+* Summary:
+*   Set up the detector for a record.
+*
+* Parameters:
+*   vad = detector state
+*   sample_rate = frame rate in Hertz
+*   channels = 1 or 2, interleaved
+*   threshold_db = start of the activity above the noise floor, 0 to keep
+*   all the blocks
+*
+*******************************************************************************/
+void audio_vad_init(audio_vad_t *vad, uint32_t sample_rate, uint32_t channels, uint32_t threshold_db)
+{
+    memset(vad, 0, sizeof(audio_vad_t));
+    vad->enabled = (threshold_db != 0u);
+    vad->channels = channels;
+    vad->sample_rate = sample_rate;
+
+    vad->on_ratio = powf(10.0f, (float) threshold_db / 10.0f);
+    vad->off_ratio = powf(10.0f, (float) ((int32_t) threshold_db - AUDIO_VAD_HYSTERESIS_DB) / 10.0f);
+    vad->rise = powf(10.0f, ((float) AUDIO_VAD_FLOOR_RISE_DB / 10.0f) /
+                            ((float) AUDIO_VAD_FLOOR_RISE_MS / (float) AUDIO_VAD_WINDOW_MS));
+
+    vad->window_frames = (sample_rate * AUDIO_VAD_WINDOW_MS) / 1000u;
+    vad->window_left = vad->window_frames * channels;
+    vad->hangover_windows = AUDIO_VAD_HANGOVER_MS / AUDIO_VAD_WINDOW_MS;
+}
+
+/*******************************************************************************
+* Function Name: audio_vad_process
+********************************************************************************
+* Summary:
+*   Decide if a block of samples is kept: it is if any of its windows is
+*   active. When a block is kept after a silent one, the silent block is
+*   kept first as the pre-roll of the segment. Once all the segments are
+*   used, every block is kept.
+*
+* Parameters:
+*   vad = detector state
+*   buf = interleaved 16-bit samples
+*   len = length of the samples in bytes, a multiple of the frame size
+*
+* Return:
+*   True if the block is kept.
+*
+*******************************************************************************/
+bool audio_vad_process(audio_vad_t *vad, const uint8_t *buf, uint32_t len)
+{
+    uint32_t frames = len / (vad->channels * sizeof(int16_t));
+    uint32_t samples = frames * vad->channels;
+    uint32_t index;
+    uint32_t count;
+    uint32_t end;
+    int16_t sample;
+    int64_t sum;
+    bool keep = vad->active;
+    audio_vad_segment_t *segment;
+
+    for (index = 0; index < samples; index = end)
+    {
+        /* Sum the samples up to the end of the window */
+        count = ((samples - index) < vad->window_left) ? (samples - index) : vad->window_left;
+        end = index + count;
+        sum = 0;
+        for (; index < end; index++)
+        {
+            memcpy(&sample, &buf[index * sizeof(int16_t)], sizeof(sample));
+            sum += (int32_t) sample * sample;
+        }
+        vad->window_sum += sum;
+        vad->window_left -= count;
+
+        if (vad->window_left == 0u)
+        {
+            audio_vad_window(vad, (float) vad->window_sum / (float) (vad->window_frames * vad->channels));
+            keep = keep || vad->active;
+            vad->window_left = vad->window_frames * vad->channels;
+            vad->window_sum = 0;
+        }
+    }
+    keep = keep || (vad->segment_num == AUDIO_VAD_SEGMENTS_MAX);
+
+    vad->blocks++;
+    if (keep)
+    {
+        if (!vad->last_kept)
+        {
+            /* New segment, from the pre-roll if any */
+            segment = &vad->segments[vad->segment_num++];
+            segment->start = vad->last_start;
+            segment->frames = vad->last_frames;
+            vad->blocks_kept += (vad->last_frames != 0u) ? 1u : 0u;
+        }
+        vad->segments[vad->segment_num - 1u].frames += frames;
+        vad->blocks_kept++;
+    }
+
+    vad->last_start = vad->frame;
+    vad->last_frames = frames;
+    vad->last_kept = keep;
+    vad->frame += frames;
+
+    return keep;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,123 @@
+/*****************************************************************************
+* File Name: audio_vad.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the audio_vad.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef AUDIO_VAD_H_
+#define AUDIO_VAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Analysis windows, and the time the activity lasts after the last loud one */
+#define AUDIO_VAD_WINDOW_MS         10u
+#define AUDIO_VAD_HANGOVER_MS       600u
+
+/* The activity ends this far below its threshold */
+#define AUDIO_VAD_HYSTERESIS_DB     3
+
+/* Noise floor: falls to quieter windows quickly, rises 3 dB in 5 seconds,
+ * and never goes below the energy of a 4 LSB RMS noise */
+#define AUDIO_VAD_FLOOR_FALL        0.25f
+#define AUDIO_VAD_FLOOR_RISE_DB     3
+#define AUDIO_VAD_FLOOR_RISE_MS     5000u
+#define AUDIO_VAD_FLOOR_MIN         16.0f
+
+/* Segments kept in a record, the gating stops when they are all used */
+#define AUDIO_VAD_SEGMENTS_MAX      128u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Segment of the session kept in the record, in frames */
+typedef struct
+{
+    uint32_t start;
+    uint32_t frames;
+} audio_vad_segment_t;
+
+typedef struct
+{
+    bool enabled;
+    uint32_t channels;
+    uint32_t sample_rate;
+
+    /* Thresholds as energy ratios to the noise floor */
+    float on_ratio;
+    float off_ratio;
+    float rise;
+    float floor;
+
+    /* Window being summed */
+    uint32_t window_frames;
+    uint32_t window_left;       /* Samples */
+    int64_t window_sum;
+
+    /* Activity, with the windows of hangover left */
+    bool active;
+    uint32_t hangover;
+    uint32_t hangover_windows;
+
+    /* Session position and the previous block, the pre-roll if silent */
+    uint32_t frame;
+    uint32_t last_start;
+    uint32_t last_frames;
+    bool last_kept;
+
+    /* Kept segments, the last one open while the blocks are kept */
+    audio_vad_segment_t segments[AUDIO_VAD_SEGMENTS_MAX];
+    uint32_t segment_num;
+
+    /* Metrics */
+    uint32_t blocks;
+    uint32_t blocks_kept;
+} audio_vad_t;
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void audio_vad_init(audio_vad_t *vad, uint32_t sample_rate, uint32_t channels, uint32_t threshold_db);
+bool audio_vad_process(audio_vad_t *vad, const uint8_t *buf, uint32_t len);
+
+#endif /* AUDIO_VAD_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,665 @@
+/*****************************************************************************
+* File Name: blk_dev.c
+*
+* Description:
+*  This file contains the stackable block device layer: the dispatch of the
+*  operations down the stack, and the reusable stages (partition, statistics,
+*  read cache, write coalescing, fault injection).
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "blk_dev.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define BLK_DEV_NO_TAG          0xFFFFFFFFu
+
+/*******************************************************************************
+* Function Name: blk_dev_init
+********************************************************************************
+* Summary:
+*   Initialize a device. The stages without an init operation pass it down
+*   to the backend.
+*
+*******************************************************************************/
+blk_dev_result_t blk_dev_init(blk_dev_t *dev)
+{
+    while ((dev != NULL) && (dev->ops->init == NULL))
+    {
+        dev = dev->lower;
+    }
+    return (dev != NULL) ? dev->ops->init(dev) : BLK_DEV_OK;
+}
+
+/*******************************************************************************
+* Function Name: blk_dev_is_connected
+********************************************************************************
+* Summary:
+*   Check if the device is connected.
+*
+*******************************************************************************/
+bool blk_dev_is_connected(blk_dev_t *dev)
+{
+    while ((dev != NULL) && (dev->ops->is_connected == NULL))
+    {
+        dev = dev->lower;
+    }
+    return (dev != NULL) ? dev->ops->is_connected(dev) : true;
+}
+
+/*******************************************************************************
+* Function Name: blk_dev_block_size
+********************************************************************************
+* Summary:
+*   Get the block size in bytes.
+*
+*******************************************************************************/
+uint32_t blk_dev_block_size(blk_dev_t *dev)
+{
+    while ((dev != NULL) && (dev->ops->block_size == NULL))
+    {
+        dev = dev->lower;
+    }
+    return (dev != NULL) ? dev->ops->block_size(dev) : 0u;
+}
+
+/*******************************************************************************
+* Function Name: blk_dev_block_num
+********************************************************************************
+* Summary:
+*   Get the number of blocks.
+*
+*******************************************************************************/
+uint32_t blk_dev_block_num(blk_dev_t *dev)
+{
+    while ((dev != NULL) && (dev->ops->block_num == NULL))
+    {
+        dev = dev->lower;
+    }
+    return (dev != NULL) ? dev->ops->block_num(dev) : 0u;
+}
+
+/*******************************************************************************
+* Function Name: blk_dev_read
+********************************************************************************
+* Summary:
+*   Read blocks.
+*
+* Parameters:
+*   dev: device
+*   block: first block
+*   buf: destination
+*   count: number of blocks, updated with the number of blocks read
+*
+*******************************************************************************/
+blk_dev_result_t blk_dev_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    while ((dev != NULL) && (dev->ops->read == NULL))
+    {
+        dev = dev->lower;
+    }
+    if (dev == NULL)
+    {
+        *count = 0;
+        return BLK_DEV_ERR_PARAM;
+    }
+    return dev->ops->read(dev, block, buf, count);
+}
+
+/*******************************************************************************
+* Function Name: blk_dev_write
+********************************************************************************
+* Summary:
+*   Write blocks.
+*
+* Parameters:
+*   dev: device
+*   block: first block
+*   buf: source
+*   count: number of blocks, updated with the number of blocks written
+*
+*******************************************************************************/
+blk_dev_result_t blk_dev_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    while ((dev != NULL) && (dev->ops->write == NULL))
+    {
+        dev = dev->lower;
+    }
+    if (dev == NULL)
+    {
+        *count = 0;
+        return BLK_DEV_ERR_PARAM;
+    }
+    return dev->ops->write(dev, block, buf, count);
+}
+
+/*******************************************************************************
+* Function Name: blk_dev_sync
+********************************************************************************
+* Summary:
+*   Make the blocks written durable.
+*
+*******************************************************************************/
+blk_dev_result_t blk_dev_sync(blk_dev_t *dev)
+{
+    while ((dev != NULL) && (dev->ops->sync == NULL))
+    {
+        dev = dev->lower;
+    }
+    return (dev != NULL) ? dev->ops->sync(dev) : BLK_DEV_OK;
+}
+
+/*******************************************************************************
+* Partition stage
+*******************************************************************************/
+static uint32_t blk_dev_part_block_num(blk_dev_t *dev)
+{
+    return ((blk_dev_part_t *) dev)->num;
+}
+
+static blk_dev_result_t blk_dev_part_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    blk_dev_part_t *part = (blk_dev_part_t *) dev;
+
+    if ((block >= part->num) || (*count > (part->num - block)))
+    {
+        *count = 0;
+        return BLK_DEV_ERR_PARAM;
+    }
+    return blk_dev_read(dev->lower, part->first + block, buf, count);
+}
+
+static blk_dev_result_t blk_dev_part_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    blk_dev_part_t *part = (blk_dev_part_t *) dev;
+
+    if ((block >= part->num) || (*count > (part->num - block)))
+    {
+        *count = 0;
+        return BLK_DEV_ERR_PARAM;
+    }
+    return blk_dev_write(dev->lower, part->first + block, buf, count);
+}
+
+static const blk_dev_ops_t blk_dev_part_ops =
+{
+    .block_num = blk_dev_part_block_num,
+    .read = blk_dev_part_read,
+    .write = blk_dev_part_write,
+};
+
+/*******************************************************************************
+* Function Name: blk_dev_part_init
+********************************************************************************
+* Summary:
+*   Stack a partition stage exposing num blocks from block first.
+*
+* Return:
+*   The stage.
+*
+*******************************************************************************/
+blk_dev_t *blk_dev_part_init(blk_dev_part_t *part, blk_dev_t *lower, uint32_t first, uint32_t num)
+{
+    part->dev.ops = &blk_dev_part_ops;
+    part->dev.lower = lower;
+    part->first = first;
+    part->num = num;
+    return &part->dev;
+}
+
+/*******************************************************************************
+* Statistics stage
+*******************************************************************************/
+static uint32_t blk_dev_stats_now(const blk_dev_stats_t *stats)
+{
+    return (stats->clock != NULL) ? stats->clock() : 0u;
+}
+
+static blk_dev_result_t blk_dev_stats_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    blk_dev_stats_t *stats = (blk_dev_stats_t *) dev;
+    uint32_t start = blk_dev_stats_now(stats);
+    blk_dev_result_t result = blk_dev_read(dev->lower, block, buf, count);
+    uint32_t time = blk_dev_stats_now(stats) - start;
+
+    stats->read_ops++;
+    stats->read_blocks += *count;
+    stats->read_time += time;
+    if (time > stats->read_time_max)
+    {
+        stats->read_time_max = time;
+    }
+    if (result != BLK_DEV_OK)
+    {
+        stats->errors++;
+    }
+    return result;
+}
+
+static blk_dev_result_t blk_dev_stats_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    blk_dev_stats_t *stats = (blk_dev_stats_t *) dev;
+    uint32_t start = blk_dev_stats_now(stats);
+    blk_dev_result_t result = blk_dev_write(dev->lower, block, buf, count);
+    uint32_t time = blk_dev_stats_now(stats) - start;
+
+    stats->write_ops++;
+    stats->write_blocks += *count;
+    stats->write_time += time;
+    if (time > stats->write_time_max)
+    {
+        stats->write_time_max = time;
+    }
+    if (result != BLK_DEV_OK)
+    {
+        stats->errors++;
+    }
+    return result;
+}
+
+static blk_dev_result_t blk_dev_stats_sync(blk_dev_t *dev)
+{
+    blk_dev_stats_t *stats = (blk_dev_stats_t *) dev;
+    blk_dev_result_t result = blk_dev_sync(dev->lower);
+
+    stats->sync_ops++;
+    if (result != BLK_DEV_OK)
+    {
+        stats->errors++;
+    }
+    return result;
+}
+
+static const blk_dev_ops_t blk_dev_stats_ops =
+{
+    .read = blk_dev_stats_read,
+    .write = blk_dev_stats_write,
+    .sync = blk_dev_stats_sync,
+};
+
+/*******************************************************************************
+* Function Name: blk_dev_stats_init
+********************************************************************************
+* Summary:
+*   Stack a statistics stage, with its counters cleared.
+*
+* Return:
+*   The stage.
+*
+*******************************************************************************/
+blk_dev_t *blk_dev_stats_init(blk_dev_stats_t *stats, blk_dev_t *lower, blk_dev_clock_t clock)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->dev.ops = &blk_dev_stats_ops;
+    stats->dev.lower = lower;
+    stats->clock = clock;
+    return &stats->dev;
+}
+
+/*******************************************************************************
+* Read cache stage
+*******************************************************************************/
+static uint8_t *blk_dev_cache_line(blk_dev_cache_t *cache, uint32_t block)
+{
+    return &cache->lines[(block % cache->line_num) * cache->block_size];
+}
+
+static blk_dev_result_t blk_dev_cache_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    blk_dev_cache_t *cache = (blk_dev_cache_t *) dev;
+    uint32_t line = block % cache->line_num;
+    blk_dev_result_t result;
+
+    if (*count != 1u)
+    {
+        return blk_dev_read(dev->lower, block, buf, count);
+    }
+
+    if (cache->tags[line] == block)
+    {
+        cache->hits++;
+        memcpy(buf, blk_dev_cache_line(cache, block), cache->block_size);
+        return BLK_DEV_OK;
+    }
+
+    cache->misses++;
+    result = blk_dev_read(dev->lower, block, buf, count);
+    if ((result == BLK_DEV_OK) && (*count == 1u))
+    {
+        memcpy(blk_dev_cache_line(cache, block), buf, cache->block_size);
+        cache->tags[line] = block;
+    }
+    return result;
+}
+
+static blk_dev_result_t blk_dev_cache_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    blk_dev_cache_t *cache = (blk_dev_cache_t *) dev;
+    uint32_t requested = *count;
+    blk_dev_result_t result = blk_dev_write(dev->lower, block, buf, count);
+    uint32_t index;
+    uint32_t line;
+
+    /* Keep the cached copies equal to the device: update the blocks written,
+    *  drop those the device may not have written */
+    for (index = 0; index < requested; index++)
+    {
+        line = (block + index) % cache->line_num;
+        if (cache->tags[line] == (block + index))
+        {
+            if ((result == BLK_DEV_OK) && (index < *count))
+            {
+                memcpy(blk_dev_cache_line(cache, block + index), &buf[index * cache->block_size], cache->block_size);
+            }
+            else
+            {
+                cache->tags[line] = BLK_DEV_NO_TAG;
+            }
+        }
+    }
+    return result;
+}
+
+static blk_dev_result_t blk_dev_cache_init_op(blk_dev_t *dev)
+{
+    blk_dev_cache_t *cache = (blk_dev_cache_t *) dev;
+
+    /* The device may have been changed while not initialized */
+    memset(cache->tags, 0xFF, cache->line_num * sizeof(cache->tags[0]));
+    return blk_dev_init(dev->lower);
+}
+
+static const blk_dev_ops_t blk_dev_cache_ops =
+{
+    .init = blk_dev_cache_init_op,
+    .read = blk_dev_cache_read,
+    .write = blk_dev_cache_write,
+};
+
+/*******************************************************************************
+* Function Name: blk_dev_cache_init
+********************************************************************************
+* Summary:
+*   Stack a read cache stage.
+*
+* Parameters:
+*   cache: stage
+*   lower: device below
+*   lines: buffer of line_num blocks
+*   tags: array of line_num entries
+*   line_num: number of cached blocks
+*   block_size: block size of the device below
+*
+* Return:
+*   The stage.
+*
+*******************************************************************************/
+blk_dev_t *blk_dev_cache_init(blk_dev_cache_t *cache, blk_dev_t *lower, uint8_t *lines, uint32_t *tags,
+                              uint32_t line_num, uint32_t block_size)
+{
+    cache->dev.ops = &blk_dev_cache_ops;
+    cache->dev.lower = lower;
+    cache->lines = lines;
+    cache->tags = tags;
+    cache->line_num = line_num;
+    cache->block_size = block_size;
+    cache->hits = 0;
+    cache->misses = 0;
+    memset(tags, 0xFF, line_num * sizeof(tags[0]));
+    return &cache->dev;
+}
+
+/*******************************************************************************
+* Write coalescing stage
+*******************************************************************************/
+static blk_dev_result_t blk_dev_coalesce_flush(blk_dev_coalesce_t *coalesce)
+{
+    blk_dev_result_t result;
+    uint32_t count = coalesce->count;
+
+    if (count == 0u)
+    {
+        return BLK_DEV_OK;
+    }
+
+    result = blk_dev_write(coalesce->dev.lower, coalesce->first, coalesce->buf, &count);
+    coalesce->flushes++;
+
+    /* Keep the blocks not written for the next flush */
+    if (count < coalesce->count)
+    {
+        memmove(coalesce->buf, &coalesce->buf[count * coalesce->block_size],
+                (coalesce->count - count) * coalesce->block_size);
+        coalesce->first += count;
+        coalesce->count -= count;
+        return (result != BLK_DEV_OK) ? result : BLK_DEV_ERR_IO;
+    }
+    coalesce->count = 0;
+    return result;
+}
+
+static blk_dev_result_t blk_dev_coalesce_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    blk_dev_coalesce_t *coalesce = (blk_dev_coalesce_t *) dev;
+    blk_dev_result_t result;
+
+    /* Write the buffer first if the read overlaps it */
+    if ((coalesce->count != 0u) && (block < (coalesce->first + coalesce->count)) &&
+        ((block + *count) > coalesce->first))
+    {
+        result = blk_dev_coalesce_flush(coalesce);
+        if (result != BLK_DEV_OK)
+        {
+            *count = 0;
+            return result;
+        }
+    }
+    return blk_dev_read(dev->lower, block, buf, count);
+}
+
+static blk_dev_result_t blk_dev_coalesce_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    blk_dev_coalesce_t *coalesce = (blk_dev_coalesce_t *) dev;
+    blk_dev_result_t result;
+    uint32_t requested = *count;
+    uint32_t done = 0;
+    uint32_t room;
+
+    while (done < requested)
+    {
+        /* Start a new run if this write does not extend the buffered one */
+        if ((coalesce->count != 0u) &&
+            (((block + done) != (coalesce->first + coalesce->count)) || (coalesce->count == coalesce->buf_blocks)))
+        {
+            result = blk_dev_coalesce_flush(coalesce);
+            if (result != BLK_DEV_OK)
+            {
+                *count = done;
+                return result;
+            }
+        }
+        if (coalesce->count == 0u)
+        {
+            coalesce->first = block + done;
+        }
+
+        room = coalesce->buf_blocks - coalesce->count;
+        if (room > (requested - done))
+        {
+            room = requested - done;
+        }
+        memcpy(&coalesce->buf[coalesce->count * coalesce->block_size], &buf[done * coalesce->block_size],
+               room * coalesce->block_size);
+        coalesce->count += room;
+        done += room;
+    }
+    return BLK_DEV_OK;
+}
+
+static blk_dev_result_t blk_dev_coalesce_sync(blk_dev_t *dev)
+{
+    blk_dev_result_t result = blk_dev_coalesce_flush((blk_dev_coalesce_t *) dev);
+
+    return (result == BLK_DEV_OK) ? blk_dev_sync(dev->lower) : result;
+}
+
+static const blk_dev_ops_t blk_dev_coalesce_ops =
+{
+    .read = blk_dev_coalesce_read,
+    .write = blk_dev_coalesce_write,
+    .sync = blk_dev_coalesce_sync,
+};
+
+/*******************************************************************************
+* Function Name: blk_dev_coalesce_init
+********************************************************************************
+* Summary:
+*   Stack a write coalescing stage.
+*
+* Parameters:
+*   coalesce: stage
+*   lower: device below
+*   buf: buffer of buf_blocks blocks
+*   buf_blocks: largest write to the device below
+*   block_size: block size of the device below
+*
+* Return:
+*   The stage.
+*
+*******************************************************************************/
+blk_dev_t *blk_dev_coalesce_init(blk_dev_coalesce_t *coalesce, blk_dev_t *lower, uint8_t *buf,
+                                 uint32_t buf_blocks, uint32_t block_size)
+{
+    coalesce->dev.ops = &blk_dev_coalesce_ops;
+    coalesce->dev.lower = lower;
+    coalesce->buf = buf;
+    coalesce->buf_blocks = buf_blocks;
+    coalesce->block_size = block_size;
+    coalesce->first = 0;
+    coalesce->count = 0;
+    coalesce->flushes = 0;
+    return &coalesce->dev;
+}
+
+/*******************************************************************************
+* Fault injection stage
+*******************************************************************************/
+static bool blk_dev_fault_due(blk_dev_fault_t *fault, uint8_t op)
+{
+    if (((fault->ops & op) == 0u) || (fault->period == 0u))
+    {
+        return false;
+    }
+    if (--fault->countdown != 0u)
+    {
+        return false;
+    }
+    fault->countdown = fault->period;
+    fault->injected++;
+    return true;
+}
+
+static blk_dev_result_t blk_dev_fault_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    if (blk_dev_fault_due((blk_dev_fault_t *) dev, BLK_DEV_FAULT_READ))
+    {
+        *count = 0;
+        return BLK_DEV_ERR_IO;
+    }
+    return blk_dev_read(dev->lower, block, buf, count);
+}
+
+static blk_dev_result_t blk_dev_fault_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    if (blk_dev_fault_due((blk_dev_fault_t *) dev, BLK_DEV_FAULT_WRITE))
+    {
+        *count /= 2u;
+        if (*count != 0u)
+        {
+            (void) blk_dev_write(dev->lower, block, buf, count);
+        }
+        return BLK_DEV_ERR_IO;
+    }
+    return blk_dev_write(dev->lower, block, buf, count);
+}
+
+static blk_dev_result_t blk_dev_fault_sync(blk_dev_t *dev)
+{
+    if (blk_dev_fault_due((blk_dev_fault_t *) dev, BLK_DEV_FAULT_SYNC))
+    {
+        return BLK_DEV_ERR_IO;
+    }
+    return blk_dev_sync(dev->lower);
+}
+
+static const blk_dev_ops_t blk_dev_fault_ops =
+{
+    .read = blk_dev_fault_read,
+    .write = blk_dev_fault_write,
+    .sync = blk_dev_fault_sync,
+};
+
+/*******************************************************************************
+* Function Name: blk_dev_fault_init
+********************************************************************************
+* Summary:
+*   Stack a fault injection stage.
+*
+* Parameters:
+*   fault: stage
+*   lower: device below
+*   ops: operations to fail, BLK_DEV_FAULT_xxx mask
+*   period: fail one of period operations of these kinds, 0 to disable
+*
+* Return:
+*   The stage.
+*
+*******************************************************************************/
+blk_dev_t *blk_dev_fault_init(blk_dev_fault_t *fault, blk_dev_t *lower, uint8_t ops, uint32_t period)
+{
+    fault->dev.ops = &blk_dev_fault_ops;
+    fault->dev.lower = lower;
+    fault->ops = ops;
+    fault->period = period;
+    fault->countdown = period;
+    fault->injected = 0;
+    return &fault->dev;
+}
+
+/* [] END OF FILE */
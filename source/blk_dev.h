@@ -0,0 +1,178 @@
+/*****************************************************************************
+* File Name: blk_dev.h
+*
+* Description:
+*  This file contains the stackable block device layer. A block device is
+*  a backend, or a stage wrapping the device below it. The stages keep the
+*  function table of the block device interface, so the USB mass storage
+*  class and FatFs use the same stack. The layer depends on no hardware
+*  API and builds on a host for benchmarks.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef BLK_DEV_H_
+#define BLK_DEV_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef enum
+{
+    BLK_DEV_OK = 0,
+    BLK_DEV_ERR_IO,
+    BLK_DEV_ERR_PARAM,
+    BLK_DEV_ERR_NOT_READY,
+} blk_dev_result_t;
+
+typedef struct blk_dev blk_dev_t;
+
+/* Operations of a block device. A NULL operation is passed to the device
+*  below, so a stage only implements what it changes. The read and write
+*  counts are in blocks, updated with the number of blocks done. */
+typedef struct
+{
+    blk_dev_result_t (*init)(blk_dev_t *dev);
+    bool             (*is_connected)(blk_dev_t *dev);
+    uint32_t         (*block_size)(blk_dev_t *dev);
+    uint32_t         (*block_num)(blk_dev_t *dev);
+    blk_dev_result_t (*read)(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count);
+    blk_dev_result_t (*write)(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count);
+    blk_dev_result_t (*sync)(blk_dev_t *dev);
+} blk_dev_ops_t;
+
+/* Common part of the backends and stages, their first member */
+struct blk_dev
+{
+    const blk_dev_ops_t *ops;
+    blk_dev_t *lower;       /* Device below, NULL for a backend */
+};
+
+/* Time source of the statistics stage, any unit, NULL for no timing */
+typedef uint32_t (*blk_dev_clock_t)(void);
+
+/* Partition stage: a window of the device below */
+typedef struct
+{
+    blk_dev_t dev;
+    uint32_t first;
+    uint32_t num;
+} blk_dev_part_t;
+
+/* Statistics stage: counts the operations and their time */
+typedef struct
+{
+    blk_dev_t dev;
+    blk_dev_clock_t clock;
+    uint32_t read_ops;
+    uint32_t write_ops;
+    uint32_t sync_ops;
+    uint32_t errors;
+    uint64_t read_blocks;
+    uint64_t write_blocks;
+    uint64_t read_time;
+    uint64_t write_time;
+    uint32_t read_time_max;
+    uint32_t write_time_max;
+} blk_dev_stats_t;
+
+/* Read cache stage: direct-mapped cache of the single-block reads, such as
+*  the file system metadata. Writes go through and update the cached copy;
+*  multi-block reads go to the device below. */
+typedef struct
+{
+    blk_dev_t dev;
+    uint8_t *lines;         /* line_num blocks */
+    uint32_t *tags;         /* line_num entries */
+    uint32_t line_num;
+    uint32_t block_size;
+    uint32_t hits;
+    uint32_t misses;
+} blk_dev_cache_t;
+
+/* Write coalescing stage: gathers the writes of consecutive blocks and writes
+*  them in one operation when the run breaks, the buffer is full, a read
+*  overlaps it, or on sync. The data is not durable until the sync. */
+typedef struct
+{
+    blk_dev_t dev;
+    uint8_t *buf;
+    uint32_t buf_blocks;
+    uint32_t block_size;
+    uint32_t first;         /* First block buffered */
+    uint32_t count;         /* Blocks buffered */
+    uint32_t flushes;
+} blk_dev_coalesce_t;
+
+/* Fault injection stage: fails one operation out of period. A failed write
+*  writes the first half of its blocks, as a write cut by a reset would. */
+#define BLK_DEV_FAULT_READ      0x01u
+#define BLK_DEV_FAULT_WRITE     0x02u
+#define BLK_DEV_FAULT_SYNC      0x04u
+
+typedef struct
+{
+    blk_dev_t dev;
+    uint8_t ops;            /* BLK_DEV_FAULT_xxx mask */
+    uint32_t period;        /* 0 to disable */
+    uint32_t countdown;
+    uint32_t injected;
+} blk_dev_fault_t;
+
+/*******************************************************************************
+* Function prototypes
+********************************************************************************/
+blk_dev_result_t blk_dev_init(blk_dev_t *dev);
+bool             blk_dev_is_connected(blk_dev_t *dev);
+uint32_t         blk_dev_block_size(blk_dev_t *dev);
+uint32_t         blk_dev_block_num(blk_dev_t *dev);
+blk_dev_result_t blk_dev_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count);
+blk_dev_result_t blk_dev_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count);
+blk_dev_result_t blk_dev_sync(blk_dev_t *dev);
+
+blk_dev_t *blk_dev_part_init(blk_dev_part_t *part, blk_dev_t *lower, uint32_t first, uint32_t num);
+blk_dev_t *blk_dev_stats_init(blk_dev_stats_t *stats, blk_dev_t *lower, blk_dev_clock_t clock);
+blk_dev_t *blk_dev_cache_init(blk_dev_cache_t *cache, blk_dev_t *lower, uint8_t *lines, uint32_t *tags,
+                              uint32_t line_num, uint32_t block_size);
+blk_dev_t *blk_dev_coalesce_init(blk_dev_coalesce_t *coalesce, blk_dev_t *lower, uint8_t *buf,
+                                 uint32_t buf_blocks, uint32_t block_size);
+blk_dev_t *blk_dev_fault_init(blk_dev_fault_t *fault, blk_dev_t *lower, uint8_t ops, uint32_t period);
+
+#endif /* BLK_DEV_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,232 @@
+/*****************************************************************************
+* File Name: buf_arena.c
+*
+* Description:
+*  This file provides the source code to lease large buffers from a
+*  shared SRAM arena to the MSC pipeline, the PCM ring and FatFs.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "buf_arena.h"
+#include "rtos.h"
+
+#include <stddef.h>
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+/* Shared SRAM, word aligned for the DMA based peripherals */
+static uint32_t arena[BUF_ARENA_SIZE / sizeof(uint32_t)];
+
+/* Leases are stacked from the top of the arena */
+static uint32_t lease_offset[BUF_ARENA_CLIENT_NUM];
+static uint32_t lease_size[BUF_ARENA_CLIENT_NUM];
+
+/* Lowest leased offset. Everything below belongs to the MSC media buffer */
+static volatile uint32_t arena_top = BUF_ARENA_SIZE;
+
+/* Size of the MSC buffer used by the in-flight command, zero if idle */
+static volatile uint32_t msc_busy_size = 0;
+
+/*******************************************************************************
+* Function Name: buf_arena_msc_limit
+********************************************************************************
+* Summary:
+*   Compute the size of the MSC media buffer for a given top of the arena.
+*
+*******************************************************************************/
+static uint32_t buf_arena_msc_limit(uint32_t top)
+{
+    if (top > BUF_ARENA_MSC_MAX_SIZE)
+    {
+        top = BUF_ARENA_MSC_MAX_SIZE;
+    }
+
+    return (top & ~(BUF_ARENA_MSC_ALIGN - 1u));
+}
+
+/*******************************************************************************
+* Function Name: buf_arena_lease
+********************************************************************************
+* Summary:
+*   Lease a buffer from the arena. The buffer is taken from the MSC media
+*   buffer, which shrinks down to its minimum size. If an MSC command is using
+*   the reclaimed area, wait for it to complete. Must be called from a task.
+*
+* Parameters:
+*   client = client requesting the buffer, higher priority than the MSC
+*   size = number of bytes
+*
+* Return:
+*   Pointer to the buffer, NULL if not available.
+*
+*******************************************************************************/
+uint8_t *buf_arena_lease(buf_arena_client_t client, uint32_t size)
+{
+    uint32_t offset;
+    uint32_t timeout = BUF_ARENA_RECLAIM_TIMEOUT_MS;
+
+    if ((client == BUF_ARENA_CLIENT_MSC) || (client >= BUF_ARENA_CLIENT_NUM) ||
+        (lease_size[client] != 0) || (size == 0))
+    {
+        return NULL;
+    }
+
+    /* Keep the leases word aligned */
+    size = (size + sizeof(uint32_t) - 1u) & ~(sizeof(uint32_t) - 1u);
+
+    taskENTER_CRITICAL();
+
+    if (arena_top < (BUF_ARENA_MSC_MIN_SIZE + size))
+    {
+        taskEXIT_CRITICAL();
+        return NULL;
+    }
+
+    offset = arena_top - size;
+    lease_offset[client] = offset;
+    lease_size[client]   = size;
+
+    /* New MSC commands only get the area below the lease from now on */
+    arena_top = offset;
+
+    taskEXIT_CRITICAL();
+
+    /* Wait for the in-flight MSC command to release the reclaimed area */
+    while ((msc_busy_size > offset) && (timeout > 0))
+    {
+        vTaskDelay(pdMS_TO_TICKS(1));
+        timeout--;
+    }
+
+    if (msc_busy_size > offset)
+    {
+        buf_arena_release(client);
+        return NULL;
+    }
+
+    return ((uint8_t *) arena) + offset;
+}
+
+/*******************************************************************************
+* Function Name: buf_arena_release
+********************************************************************************
+* Summary:
+*   Return a leased buffer to the arena. The MSC media buffer grows back on
+*   its next command.
+*
+* Parameters:
+*   client = client owning the buffer
+*
+*******************************************************************************/
+void buf_arena_release(buf_arena_client_t client)
+{
+    uint32_t top = BUF_ARENA_SIZE;
+    uint32_t index;
+
+    if ((client == BUF_ARENA_CLIENT_MSC) || (client >= BUF_ARENA_CLIENT_NUM))
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+
+    lease_size[client] = 0;
+
+    /* Find the lowest lease still active */
+    for (index = BUF_ARENA_CLIENT_FS; index < BUF_ARENA_CLIENT_NUM; index++)
+    {
+        if ((lease_size[index] != 0) && (lease_offset[index] < top))
+        {
+            top = lease_offset[index];
+        }
+    }
+
+    arena_top = top;
+
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+* Function Name: buf_arena_msc_begin
+********************************************************************************
+* Summary:
+*   Get the MSC media buffer for a new SCSI command. The buffer size is fixed
+*   until buf_arena_msc_end() is called. Called from the USB interrupts.
+*
+* Parameters:
+*   size = returns the size of the media buffer in bytes
+*
+* Return:
+*   Pointer to the media buffer.
+*
+*******************************************************************************/
+uint8_t *buf_arena_msc_begin(uint32_t *size)
+{
+    UBaseType_t state;
+
+    state = taskENTER_CRITICAL_FROM_ISR();
+
+    msc_busy_size = buf_arena_msc_limit(arena_top);
+    *size = msc_busy_size;
+
+    taskEXIT_CRITICAL_FROM_ISR(state);
+
+    return (uint8_t *) arena;
+}
+
+/*******************************************************************************
+* Function Name: buf_arena_msc_end
+********************************************************************************
+* Summary:
+*   Release the MSC media buffer at the end of a SCSI command.
+*
+*******************************************************************************/
+void buf_arena_msc_end(void)
+{
+    msc_busy_size = 0;
+}
+
+/*******************************************************************************
+* Function Name: buf_arena_msc_size
+********************************************************************************
+* Summary:
+*   Return the size of the media buffer the next MSC command will get.
+*
+*******************************************************************************/
+uint32_t buf_arena_msc_size(void)
+{
+    return buf_arena_msc_limit(arena_top);
+}
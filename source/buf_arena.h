@@ -0,0 +1,81 @@
+/*****************************************************************************
+* File Name: buf_arena.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the buf_arena.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef BUF_ARENA_H_
+#define BUF_ARENA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Total SRAM shared by the MSC media buffer, PCM ring and FatFs work area */
+#define BUF_ARENA_SIZE                  (72u * 1024u)
+
+/* The MSC media buffer is elastic, it always keeps at least the minimum size */
+#define BUF_ARENA_MSC_MIN_SIZE          (8u * 1024u)
+#define BUF_ARENA_MSC_MAX_SIZE          (64u * 1024u)
+#define BUF_ARENA_MSC_ALIGN             (4u * 1024u)
+
+/* Maximum time to wait for an in-flight MSC command to release its buffer */
+#define BUF_ARENA_RECLAIM_TIMEOUT_MS    100u
+
+/* Arena clients, ordered by priority (higher value reclaims lower ones) */
+typedef enum
+{
+    BUF_ARENA_CLIENT_MSC = 0,
+    BUF_ARENA_CLIENT_FS,
+    BUF_ARENA_CLIENT_AUDIO,
+    BUF_ARENA_CLIENT_NUM
+} buf_arena_client_t;
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+uint8_t *buf_arena_lease(buf_arena_client_t client, uint32_t size);
+void     buf_arena_release(buf_arena_client_t client);
+uint8_t *buf_arena_msc_begin(uint32_t *size);
+void     buf_arena_msc_end(void);
+uint32_t buf_arena_msc_size(void);
+
+#endif /* BUF_ARENA_H_ */
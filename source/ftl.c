@@ -0,0 +1,1014 @@
+/*****************************************************************************
+* File Name: ftl.c
+*
+* Description:
+*  This file contains a log-structured flash translation layer for NOR
+*  flash. The logical sectors are grouped in pages of FTL_PAGE_SIZE bytes,
+*  which are always programmed into the next free slot of an open erase
+*  block, so a page is never rewritten in place. The RAM map gives the
+*  slot of each page, and the slot tags written in the first page of each
+*  block let ftl_mount() rebuild it after a reset. The garbage collection
+*  moves the valid pages out of the block with the fewest of them, and
+*  also moves cold blocks to level the erase counts.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "ftl.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define FTL_MAGIC               0x314C5446u     /* "FTL1" */
+#define FTL_TAG_KEY             0x5A5AA5A5u
+#define FTL_TAG_FREE            0xFFFFFFFFu
+#define FTL_SEQ_FREE            0xFFFFFFFFu
+#define FTL_NO_PAGE             0xFFFFu
+#define FTL_NO_BLOCK            0xFFFFFFFFu
+#define FTL_SECTORS_MAX         32u
+#define FTL_ACTIVE_NUM          3u
+
+/* Block states */
+#define FTL_BLOCK_DIRTY         0u      /* To be erased before use */
+#define FTL_BLOCK_FREE          1u      /* Erased, header written */
+#define FTL_BLOCK_OPEN          2u      /* Being written */
+#define FTL_BLOCK_CLOSED        3u      /* Full, or left open at reset */
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Header at the start of each erase block, programmed after the erase. The
+*  magic comes after the erase count, so a header cut by a reset is not valid.
+*  The sequence is programmed when the block is opened. */
+typedef struct
+{
+    uint32_t erase_count;
+    uint32_t erase_check;
+    uint32_t magic;
+    uint32_t seq;
+} ftl_header_t;
+
+/* Tag of a slot, programmed after the page data. The check detects a tag
+*  cut by a reset. A slot that could not be programmed gets a zero tag, so
+*  the tags of a block stay contiguous. */
+typedef struct
+{
+    uint32_t page;
+    uint32_t seq;
+    uint32_t check;
+} ftl_tag_t;
+
+typedef struct
+{
+    uint32_t erase_count;
+    uint16_t valid;         /* Slots holding the current copy of a page */
+    uint16_t used;          /* Slots programmed */
+    uint8_t  state;
+    uint8_t  hot;           /* Opened for the often rewritten pages */
+} ftl_block_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static const ftl_nor_t *ftl_nor = NULL;
+
+/* Geometry */
+static uint32_t ftl_block_num;
+static uint32_t ftl_slot_num;           /* Slots per block, slot 0 is the header */
+static uint32_t ftl_page_num;           /* Pages exported */
+static uint32_t ftl_sector_size;
+static uint32_t ftl_sectors_per_page;
+
+/* Slot of each page (block * ftl_slot_num + slot) */
+static uint16_t ftl_map[FTL_MAX_PAGES];
+static ftl_block_t ftl_blocks[FTL_MAX_BLOCKS];
+
+/* Sequence of the next page programmed */
+static uint32_t ftl_seq;
+
+/* Blocks receiving the host pages, the often rewritten host pages, and the
+*  pages moved by the collection. Keeping the metadata rewritten sector by
+*  sector away from the streamed data lets their blocks empty quickly. */
+static uint32_t ftl_host_block = FTL_NO_BLOCK;
+static uint32_t ftl_hot_block = FTL_NO_BLOCK;
+static uint32_t ftl_gc_block = FTL_NO_BLOCK;
+static uint32_t * const ftl_active[FTL_ACTIVE_NUM] = { &ftl_host_block, &ftl_hot_block, &ftl_gc_block };
+
+/* Block being collected and its next slot to check */
+static uint32_t ftl_gc_victim = FTL_NO_BLOCK;
+static uint32_t ftl_gc_slot;
+
+/* Write buffer holding the sectors of one page until it is programmed */
+static uint8_t  ftl_wbuf[FTL_PAGE_SIZE];
+static uint32_t ftl_wbuf_page = FTL_TAG_FREE;
+static uint32_t ftl_wbuf_mask;
+
+/* Page copied by the collection, or completing the write buffer */
+static uint8_t  ftl_cbuf[FTL_PAGE_SIZE];
+
+static ftl_stats_t ftl_stats;
+
+/*******************************************************************************
+* Function Name: ftl_block_addr
+********************************************************************************
+* Summary:
+*   Get the flash address of a slot of a block.
+*
+*******************************************************************************/
+static uint32_t ftl_block_addr(uint32_t block, uint32_t slot)
+{
+    return (block * ftl_nor->erase_size) + (slot * FTL_PAGE_SIZE);
+}
+
+/*******************************************************************************
+* Function Name: ftl_tag_addr
+********************************************************************************
+* Summary:
+*   Get the flash address of the tag of a slot (1 and more).
+*
+*******************************************************************************/
+static uint32_t ftl_tag_addr(uint32_t block, uint32_t slot)
+{
+    return (block * ftl_nor->erase_size) + sizeof(ftl_header_t) + ((slot - 1u) * sizeof(ftl_tag_t));
+}
+
+/*******************************************************************************
+* Function Name: ftl_read_tag
+********************************************************************************
+* Summary:
+*   Read the tag of a slot.
+*
+* Return:
+*   True if the tag is complete.
+*
+*******************************************************************************/
+static bool ftl_read_tag(uint32_t block, uint32_t slot, ftl_tag_t *tag)
+{
+    if (ftl_nor->read(ftl_tag_addr(block, slot), (uint8_t *) tag, sizeof(*tag)) != 0)
+    {
+        return false;
+    }
+
+    return (tag->page < ftl_page_num) && (tag->check == (tag->page ^ tag->seq ^ FTL_TAG_KEY));
+}
+
+/*******************************************************************************
+* Function Name: ftl_free_blocks
+********************************************************************************
+* Summary:
+*   Count the blocks that can be opened without moving any page.
+*
+*******************************************************************************/
+static uint32_t ftl_free_blocks(void)
+{
+    uint32_t block;
+    uint32_t count = 0;
+
+    for (block = 0; block < ftl_block_num; block++)
+    {
+        if (ftl_blocks[block].state <= FTL_BLOCK_FREE)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: ftl_erase_block
+********************************************************************************
+* Summary:
+*   Erase a block and write its header.
+*
+*******************************************************************************/
+static ftl_result_t ftl_erase_block(uint32_t block)
+{
+    ftl_header_t header;
+    ftl_block_t *blk = &ftl_blocks[block];
+
+    if (ftl_nor->erase(ftl_block_addr(block, 0)) != 0)
+    {
+        return FTL_ERR_IO;
+    }
+
+    blk->erase_count++;
+    blk->state = FTL_BLOCK_FREE;
+    blk->valid = 0;
+    blk->used = 0;
+    blk->hot = 0;
+    ftl_stats.erases++;
+
+    header.erase_count = blk->erase_count;
+    header.erase_check = ~blk->erase_count;
+    header.magic = FTL_MAGIC;
+    header.seq = FTL_SEQ_FREE;
+    if (ftl_nor->program(ftl_block_addr(block, 0), (const uint8_t *) &header, sizeof(header)) != 0)
+    {
+        blk->state = FTL_BLOCK_DIRTY;
+        return FTL_ERR_IO;
+    }
+
+    return FTL_OK;
+}
+
+/*******************************************************************************
+* Function Name: ftl_open_block
+********************************************************************************
+* Summary:
+*   Open a free block, erasing one if none is ready. New host data goes to the
+*   least worn block, cold data moved by the wear leveling to the most worn.
+*
+* Parameters:
+*   worn: select the most worn block
+*
+* Return:
+*   Block opened, FTL_NO_BLOCK if none.
+*
+*******************************************************************************/
+static uint32_t ftl_open_block(bool worn)
+{
+    uint32_t block;
+    uint32_t best = FTL_NO_BLOCK;
+    ftl_block_t *blk;
+
+    for (block = 0; block < ftl_block_num; block++)
+    {
+        blk = &ftl_blocks[block];
+        if (blk->state > FTL_BLOCK_FREE)
+        {
+            continue;
+        }
+        /* Prefer the erased blocks, then by wear */
+        if ((best == FTL_NO_BLOCK) ||
+            (blk->state > ftl_blocks[best].state) ||
+            ((blk->state == ftl_blocks[best].state) &&
+             (worn ? (blk->erase_count > ftl_blocks[best].erase_count)
+                   : (blk->erase_count < ftl_blocks[best].erase_count))))
+        {
+            best = block;
+        }
+    }
+
+    if (best == FTL_NO_BLOCK)
+    {
+        return FTL_NO_BLOCK;
+    }
+
+    if ((ftl_blocks[best].state == FTL_BLOCK_DIRTY) && (ftl_erase_block(best) != FTL_OK))
+    {
+        return FTL_NO_BLOCK;
+    }
+
+    /* Mark the block as opened */
+    if (ftl_nor->program(ftl_block_addr(best, 0) + offsetof(ftl_header_t, seq),
+                         (const uint8_t *) &ftl_seq, sizeof(ftl_seq)) != 0)
+    {
+        ftl_blocks[best].state = FTL_BLOCK_DIRTY;
+        return FTL_NO_BLOCK;
+    }
+    ftl_blocks[best].state = FTL_BLOCK_OPEN;
+
+    return best;
+}
+
+/*******************************************************************************
+* Function Name: ftl_has_room
+********************************************************************************
+* Summary:
+*   Check if an open block has a slot left.
+*
+*******************************************************************************/
+static bool ftl_has_room(uint32_t block)
+{
+    return (block != FTL_NO_BLOCK) && (ftl_blocks[block].used < (ftl_slot_num - 1u));
+}
+
+/*******************************************************************************
+* Function Name: ftl_program_page
+********************************************************************************
+* Summary:
+*   Program a page into the next slot of an open block, and map it there.
+*
+* Parameters:
+*   active: open block, replaced when full
+*   page: page number
+*   data: page content
+*   worn: open a most worn block if a new one is needed
+*
+*******************************************************************************/
+static ftl_result_t ftl_program_page(uint32_t *active, uint32_t page, const uint8_t *data, bool worn)
+{
+    ftl_tag_t tag;
+    ftl_block_t *blk;
+    uint32_t slot;
+    uint16_t old;
+
+    if ((*active != FTL_NO_BLOCK) && !ftl_has_room(*active))
+    {
+        ftl_blocks[*active].state = FTL_BLOCK_CLOSED;
+        *active = FTL_NO_BLOCK;
+    }
+    if (*active == FTL_NO_BLOCK)
+    {
+        *active = ftl_open_block(worn);
+        if (*active == FTL_NO_BLOCK)
+        {
+            return FTL_ERR_FULL;
+        }
+        ftl_blocks[*active].hot = (active == &ftl_hot_block) ? 1u : 0u;
+    }
+
+    blk = &ftl_blocks[*active];
+    slot = ++blk->used;
+
+    /* Program the data first, the tag makes it valid */
+    tag.page = page;
+    tag.seq = ftl_seq++;
+    tag.check = tag.page ^ tag.seq ^ FTL_TAG_KEY;
+    if ((ftl_nor->program(ftl_block_addr(*active, slot), data, FTL_PAGE_SIZE) != 0) ||
+        (ftl_nor->program(ftl_tag_addr(*active, slot), (const uint8_t *) &tag, sizeof(tag)) != 0))
+    {
+        memset(&tag, 0, sizeof(tag));
+        (void) ftl_nor->program(ftl_tag_addr(*active, slot), (const uint8_t *) &tag, sizeof(tag));
+        return FTL_ERR_IO;
+    }
+
+    old = ftl_map[page];
+    if (old != FTL_NO_PAGE)
+    {
+        blk = &ftl_blocks[old / ftl_slot_num];
+        blk->valid--;
+        if ((blk->valid == 0) && (blk->state == FTL_BLOCK_CLOSED) && ((uint32_t) (blk - ftl_blocks) != ftl_gc_victim))
+        {
+            blk->state = FTL_BLOCK_DIRTY;
+        }
+    }
+    ftl_map[page] = (uint16_t) ((*active * ftl_slot_num) + slot);
+    ftl_blocks[*active].valid++;
+
+    return FTL_OK;
+}
+
+/*******************************************************************************
+* Function Name: ftl_pick_victim
+********************************************************************************
+* Summary:
+*   Select the block to collect: the closed block with the fewest valid pages,
+*   or for the wear leveling, the coldest block if the erase counts spread too
+*   much.
+*
+* Parameters:
+*   wear: select a block for the wear leveling
+*
+* Return:
+*   Block to collect, FTL_NO_BLOCK if none.
+*
+*******************************************************************************/
+static uint32_t ftl_pick_victim(bool wear)
+{
+    uint32_t block;
+    uint32_t best = FTL_NO_BLOCK;
+    uint32_t cold = FTL_NO_BLOCK;
+    uint32_t erase_max = 0;
+    ftl_block_t *blk;
+
+    for (block = 0; block < ftl_block_num; block++)
+    {
+        blk = &ftl_blocks[block];
+        if (blk->erase_count > erase_max)
+        {
+            erase_max = blk->erase_count;
+        }
+        if (blk->state != FTL_BLOCK_CLOSED)
+        {
+            continue;
+        }
+        if ((best == FTL_NO_BLOCK) || (blk->valid < ftl_blocks[best].valid))
+        {
+            best = block;
+        }
+        if ((cold == FTL_NO_BLOCK) || (blk->erase_count < ftl_blocks[cold].erase_count))
+        {
+            cold = block;
+        }
+    }
+
+    if (wear)
+    {
+        return ((cold != FTL_NO_BLOCK) && ((erase_max - ftl_blocks[cold].erase_count) > FTL_WL_THRESHOLD)) ?
+               cold : FTL_NO_BLOCK;
+    }
+
+    /* Nothing to gain from a full block */
+    if ((best != FTL_NO_BLOCK) && (ftl_blocks[best].valid >= (ftl_slot_num - 1u)))
+    {
+        best = FTL_NO_BLOCK;
+    }
+
+    return best;
+}
+
+/*******************************************************************************
+* Function Name: ftl_gc_run
+********************************************************************************
+* Summary:
+*   Do one step of garbage collection: move one valid page of the block being
+*   collected, or erase it once it is empty, or erase a dirty block ahead of
+*   its use.
+*
+* Parameters:
+*   force: collect even if enough blocks are free
+*
+* Return:
+*   True if some work was done.
+*
+*******************************************************************************/
+static bool ftl_gc_run(bool force)
+{
+    static bool gc_wear = false;
+    ftl_tag_t tag;
+    uint32_t *dest;
+    uint32_t block;
+    uint32_t slot;
+    uint32_t index;
+
+    if (ftl_gc_victim == FTL_NO_BLOCK)
+    {
+        gc_wear = false;
+        if (force || (ftl_free_blocks() < FTL_GC_FREE_TARGET))
+        {
+            ftl_gc_victim = ftl_pick_victim(false);
+        }
+        else
+        {
+            /* Erase the dirty blocks now, so opening a block does not wait */
+            for (block = 0; block < ftl_block_num; block++)
+            {
+                if (ftl_blocks[block].state == FTL_BLOCK_DIRTY)
+                {
+                    return (ftl_erase_block(block) == FTL_OK);
+                }
+            }
+            ftl_gc_victim = ftl_pick_victim(true);
+            gc_wear = true;
+        }
+        if (ftl_gc_victim == FTL_NO_BLOCK)
+        {
+            return false;
+        }
+        ftl_gc_slot = 1;
+    }
+
+    block = ftl_gc_victim;
+
+    /* Move the next valid page, the slot is retried if it fails */
+    while ((ftl_blocks[block].valid > 0) && (ftl_gc_slot <= ftl_blocks[block].used))
+    {
+        slot = ftl_gc_slot;
+        if (ftl_read_tag(block, slot, &tag) &&
+            (ftl_map[tag.page] == (uint16_t) ((block * ftl_slot_num) + slot)))
+        {
+            /* Without a free block, as when a power cut left the blocks open
+            *  in another order, use the room left in the other open blocks */
+            dest = &ftl_gc_block;
+            for (index = 0; (index < FTL_ACTIVE_NUM) && (ftl_free_blocks() == 0) && !ftl_has_room(*dest); index++)
+            {
+                dest = ftl_active[index];
+            }
+            if ((ftl_nor->read(ftl_block_addr(block, slot), ftl_cbuf, FTL_PAGE_SIZE) != 0) ||
+                (ftl_program_page(dest, tag.page, ftl_cbuf, gc_wear) != FTL_OK))
+            {
+                return false;
+            }
+            ftl_gc_slot++;
+            ftl_stats.gc_pages++;
+            return true;
+        }
+        ftl_gc_slot++;
+    }
+
+    /* All the pages moved */
+    ftl_gc_victim = FTL_NO_BLOCK;
+    if (ftl_blocks[block].valid > 0)
+    {
+        return false;
+    }
+    ftl_blocks[block].state = FTL_BLOCK_DIRTY;
+    return (ftl_erase_block(block) == FTL_OK);
+}
+
+/*******************************************************************************
+* Function Name: ftl_flush
+********************************************************************************
+* Summary:
+*   Program the page of the write buffer. The sectors not written by the host
+*   are read from the current copy of the page.
+*
+*******************************************************************************/
+static ftl_result_t ftl_flush(void)
+{
+    ftl_result_t result;
+    uint32_t full = (ftl_sectors_per_page == FTL_SECTORS_MAX) ? 0xFFFFFFFFu : ((1u << ftl_sectors_per_page) - 1u);
+    uint32_t index;
+    uint16_t phys;
+    bool hot;
+
+    if (ftl_wbuf_page == FTL_TAG_FREE)
+    {
+        return FTL_OK;
+    }
+    phys = ftl_map[ftl_wbuf_page];
+
+    /* A page written in part, or already hot, is likely metadata */
+    hot = (ftl_wbuf_mask != full) || ((phys != FTL_NO_PAGE) && (ftl_blocks[phys / ftl_slot_num].hot != 0));
+
+    if (ftl_wbuf_mask != full)
+    {
+        if (phys == FTL_NO_PAGE)
+        {
+            memset(ftl_cbuf, 0, FTL_PAGE_SIZE);
+        }
+        else if (ftl_nor->read(ftl_block_addr(phys / ftl_slot_num, phys % ftl_slot_num), ftl_cbuf, FTL_PAGE_SIZE) != 0)
+        {
+            return FTL_ERR_IO;
+        }
+        for (index = 0; index < ftl_sectors_per_page; index++)
+        {
+            if ((ftl_wbuf_mask & (1u << index)) == 0)
+            {
+                memcpy(&ftl_wbuf[index * ftl_sector_size], &ftl_cbuf[index * ftl_sector_size], ftl_sector_size);
+            }
+        }
+    }
+
+    /* Keep blocks for the collection to make progress */
+    while ((ftl_free_blocks() < FTL_RESERVE_BLOCKS) && ftl_gc_run(true))
+    {
+    }
+
+    result = ftl_program_page(hot ? &ftl_hot_block : &ftl_host_block, ftl_wbuf_page, ftl_wbuf, false);
+    if (result == FTL_OK)
+    {
+        ftl_stats.host_pages++;
+        ftl_wbuf_page = FTL_TAG_FREE;
+        ftl_wbuf_mask = 0;
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: ftl_mount
+********************************************************************************
+* Summary:
+*   Scan the flash and rebuild the page map. Blocks without a valid header are
+*   erased when first needed, so a blank flash needs no format. The flash must
+*   not hold any other data.
+*
+* Parameters:
+*   nor: flash access functions
+*   sector_size: logical sector size in bytes
+*
+*******************************************************************************/
+ftl_result_t ftl_mount(const ftl_nor_t *nor, uint32_t sector_size)
+{
+    ftl_header_t header;
+    ftl_tag_t tag;
+    ftl_tag_t best;
+    ftl_block_t *blk;
+    uint32_t block;
+    uint32_t slot;
+    uint32_t spare;
+    uint32_t erase_sum = 0;
+    uint32_t erase_known = 0;
+    uint32_t seq_max = 0;
+    uint32_t resume[FTL_ACTIVE_NUM];
+    uint32_t resume_seq[FTL_ACTIVE_NUM];
+    uint32_t index;
+    uint16_t phys;
+
+    if ((nor == NULL) || (sector_size == 0) || ((FTL_PAGE_SIZE % sector_size) != 0) ||
+        ((FTL_PAGE_SIZE / sector_size) > FTL_SECTORS_MAX) || (nor->erase_size == 0))
+    {
+        return FTL_ERR_PARAM;
+    }
+
+    ftl_nor = nor;
+    ftl_sector_size = sector_size;
+    ftl_sectors_per_page = FTL_PAGE_SIZE / sector_size;
+    ftl_slot_num = nor->erase_size / FTL_PAGE_SIZE;
+    ftl_block_num = nor->size / nor->erase_size;
+    if (ftl_block_num > FTL_MAX_BLOCKS)
+    {
+        ftl_block_num = FTL_MAX_BLOCKS;
+    }
+    while ((ftl_block_num * ftl_slot_num) >= FTL_NO_PAGE)
+    {
+        ftl_block_num--;
+    }
+    spare = ftl_block_num / FTL_SPARE_BLOCKS_DIV;
+    if (spare < FTL_SPARE_BLOCKS_MIN)
+    {
+        spare = FTL_SPARE_BLOCKS_MIN;
+    }
+    /* The blocks left open hold free slots the collection cannot use */
+    spare += FTL_ACTIVE_NUM;
+    if ((ftl_slot_num < 4u) || ((sizeof(ftl_header_t) + ((ftl_slot_num - 1u) * sizeof(ftl_tag_t))) > FTL_PAGE_SIZE) ||
+        (ftl_block_num <= (spare + FTL_RESERVE_BLOCKS)))
+    {
+        return FTL_ERR_PARAM;
+    }
+    ftl_page_num = (ftl_block_num - spare) * (ftl_slot_num - 1u);
+    if (ftl_page_num > FTL_MAX_PAGES)
+    {
+        ftl_page_num = FTL_MAX_PAGES;
+    }
+
+    memset(ftl_map, 0xFF, sizeof(ftl_map));
+    memset(ftl_blocks, 0, sizeof(ftl_blocks));
+    memset(&ftl_stats, 0, sizeof(ftl_stats));
+    for (index = 0; index < FTL_ACTIVE_NUM; index++)
+    {
+        *ftl_active[index] = FTL_NO_BLOCK;
+        resume[index] = FTL_NO_BLOCK;
+        resume_seq[index] = 0;
+    }
+    ftl_gc_victim = FTL_NO_BLOCK;
+    ftl_wbuf_page = FTL_TAG_FREE;
+    ftl_wbuf_mask = 0;
+
+    for (block = 0; block < ftl_block_num; block++)
+    {
+        blk = &ftl_blocks[block];
+        if (nor->read(ftl_block_addr(block, 0), (uint8_t *) &header, sizeof(header)) != 0)
+        {
+            return FTL_ERR_IO;
+        }
+        if ((header.magic != FTL_MAGIC) || (header.erase_check != ~header.erase_count))
+        {
+            blk->state = FTL_BLOCK_DIRTY;
+            blk->erase_count = FTL_TAG_FREE;
+            continue;
+        }
+        blk->erase_count = header.erase_count;
+        erase_sum += header.erase_count;
+        erase_known++;
+        if (header.seq == FTL_SEQ_FREE)
+        {
+            blk->state = FTL_BLOCK_FREE;
+            continue;
+        }
+
+        /* Blocks left open are not written anymore */
+        blk->state = FTL_BLOCK_CLOSED;
+        for (slot = 1; slot < ftl_slot_num; slot++)
+        {
+            if (nor->read(ftl_tag_addr(block, slot), (uint8_t *) &tag, sizeof(tag)) != 0)
+            {
+                return FTL_ERR_IO;
+            }
+            if ((tag.page == FTL_TAG_FREE) && (tag.seq == FTL_SEQ_FREE) && (tag.check == FTL_TAG_FREE))
+            {
+                break;
+            }
+            blk->used = (uint16_t) slot;
+            if ((tag.page >= ftl_page_num) || (tag.check != (tag.page ^ tag.seq ^ FTL_TAG_KEY)))
+            {
+                continue;
+            }
+            if (tag.seq >= seq_max)
+            {
+                seq_max = tag.seq + 1u;
+            }
+
+            /* Keep the most recent copy of the page */
+            phys = ftl_map[tag.page];
+            if ((phys != FTL_NO_PAGE) &&
+                ftl_read_tag(phys / ftl_slot_num, phys % ftl_slot_num, &best) &&
+                ((int32_t) (tag.seq - best.seq) < 0))
+            {
+                continue;
+            }
+            ftl_map[tag.page] = (uint16_t) ((block * ftl_slot_num) + slot);
+        }
+
+        /* Keep the most recently opened blocks not full to resume them */
+        if (blk->used < (ftl_slot_num - 1u))
+        {
+            for (index = 0; index < FTL_ACTIVE_NUM; index++)
+            {
+                if ((resume[index] == FTL_NO_BLOCK) || (header.seq > resume_seq[index]))
+                {
+                    memmove(&resume[index + 1u], &resume[index], (FTL_ACTIVE_NUM - index - 1u) * sizeof(resume[0]));
+                    memmove(&resume_seq[index + 1u], &resume_seq[index], (FTL_ACTIVE_NUM - index - 1u) * sizeof(resume_seq[0]));
+                    resume[index] = block;
+                    resume_seq[index] = header.seq;
+                    break;
+                }
+            }
+        }
+    }
+    ftl_seq = seq_max;
+
+    /* Resume the blocks left open. A slot programmed without its tag is
+    *  skipped with a zero tag. */
+    for (index = 0; index < FTL_ACTIVE_NUM; index++)
+    {
+        block = resume[index];
+        if (block == FTL_NO_BLOCK)
+        {
+            continue;
+        }
+        blk = &ftl_blocks[block];
+        while (blk->used < (ftl_slot_num - 1u))
+        {
+            if (nor->read(ftl_block_addr(block, blk->used + 1u), ftl_cbuf, FTL_PAGE_SIZE) != 0)
+            {
+                return FTL_ERR_IO;
+            }
+            for (slot = 0; (slot < FTL_PAGE_SIZE) && (ftl_cbuf[slot] == 0xFFu); slot++)
+            {
+            }
+            if (slot == FTL_PAGE_SIZE)
+            {
+                break;
+            }
+            blk->used++;
+            memset(&tag, 0, sizeof(tag));
+            if (nor->program(ftl_tag_addr(block, blk->used), (const uint8_t *) &tag, sizeof(tag)) != 0)
+            {
+                return FTL_ERR_IO;
+            }
+        }
+        if (blk->used < (ftl_slot_num - 1u))
+        {
+            /* Which stream opened the block is not recorded, any order works */
+            blk->state = FTL_BLOCK_OPEN;
+            *ftl_active[index] = block;
+        }
+    }
+
+    /* Count the valid pages */
+    for (block = 0; block < FTL_MAX_PAGES; block++)
+    {
+        if (ftl_map[block] != FTL_NO_PAGE)
+        {
+            ftl_blocks[ftl_map[block] / ftl_slot_num].valid++;
+        }
+    }
+
+    for (block = 0; block < ftl_block_num; block++)
+    {
+        blk = &ftl_blocks[block];
+        if ((blk->state == FTL_BLOCK_CLOSED) && (blk->valid == 0))
+        {
+            blk->state = FTL_BLOCK_DIRTY;
+        }
+        if (blk->erase_count == FTL_TAG_FREE)
+        {
+            /* Unknown count, assume an average wear */
+            blk->erase_count = (erase_known != 0) ? (erase_sum / erase_known) : 0;
+        }
+    }
+
+    return FTL_OK;
+}
+
+/*******************************************************************************
+* Function Name: ftl_sector_num
+********************************************************************************
+* Summary:
+*   Get the number of logical sectors.
+*
+*******************************************************************************/
+uint32_t ftl_sector_num(void)
+{
+    return ftl_page_num * ftl_sectors_per_page;
+}
+
+/*******************************************************************************
+* Function Name: ftl_read
+********************************************************************************
+* Summary:
+*   Read logical sectors. Sectors never written read as zeros.
+*
+* Parameters:
+*   sector: first sector
+*   buf: destination
+*   count: number of sectors
+*
+*******************************************************************************/
+ftl_result_t ftl_read(uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    uint32_t page;
+    uint32_t index;
+    uint32_t run;
+    uint16_t phys;
+
+    if ((ftl_nor == NULL) || (sector >= ftl_sector_num()) || (count > (ftl_sector_num() - sector)))
+    {
+        return FTL_ERR_PARAM;
+    }
+
+    while (count > 0)
+    {
+        page = sector / ftl_sectors_per_page;
+        index = sector % ftl_sectors_per_page;
+
+        if ((page == ftl_wbuf_page) && ((ftl_wbuf_mask & (1u << index)) != 0))
+        {
+            memcpy(buf, &ftl_wbuf[index * ftl_sector_size], ftl_sector_size);
+            run = 1;
+        }
+        else
+        {
+            /* Read the sectors up to the end of the page, or to a buffered one */
+            for (run = 1; (run < count) && ((index + run) < ftl_sectors_per_page); run++)
+            {
+                if ((page == ftl_wbuf_page) && ((ftl_wbuf_mask & (1u << (index + run))) != 0))
+                {
+                    break;
+                }
+            }
+            phys = ftl_map[page];
+            if (phys == FTL_NO_PAGE)
+            {
+                memset(buf, 0, run * ftl_sector_size);
+            }
+            else if (ftl_nor->read(ftl_block_addr(phys / ftl_slot_num, phys % ftl_slot_num) + (index * ftl_sector_size),
+                                   buf, run * ftl_sector_size) != 0)
+            {
+                return FTL_ERR_IO;
+            }
+        }
+
+        sector += run;
+        count -= run;
+        buf += run * ftl_sector_size;
+    }
+
+    return FTL_OK;
+}
+
+/*******************************************************************************
+* Function Name: ftl_write
+********************************************************************************
+* Summary:
+*   Write logical sectors. The sectors of a page are gathered in the write
+*   buffer, which is programmed when the page is complete or another page is
+*   written. Call ftl_sync() to program a partial page.
+*
+* Parameters:
+*   sector: first sector
+*   buf: source
+*   count: number of sectors
+*
+*******************************************************************************/
+ftl_result_t ftl_write(uint32_t sector, const uint8_t *buf, uint32_t count)
+{
+    ftl_result_t result;
+    uint32_t full = (ftl_sectors_per_page == FTL_SECTORS_MAX) ? 0xFFFFFFFFu : ((1u << ftl_sectors_per_page) - 1u);
+    uint32_t page;
+    uint32_t index;
+
+    if ((ftl_nor == NULL) || (sector >= ftl_sector_num()) || (count > (ftl_sector_num() - sector)))
+    {
+        return FTL_ERR_PARAM;
+    }
+
+    while (count > 0)
+    {
+        page = sector / ftl_sectors_per_page;
+        index = sector % ftl_sectors_per_page;
+
+        if (page != ftl_wbuf_page)
+        {
+            result = ftl_flush();
+            if (result != FTL_OK)
+            {
+                return result;
+            }
+            ftl_wbuf_page = page;
+        }
+
+        memcpy(&ftl_wbuf[index * ftl_sector_size], buf, ftl_sector_size);
+        ftl_wbuf_mask |= (1u << index);
+        if (ftl_wbuf_mask == full)
+        {
+            result = ftl_flush();
+            if (result != FTL_OK)
+            {
+                return result;
+            }
+        }
+
+        sector++;
+        count--;
+        buf += ftl_sector_size;
+    }
+
+    return FTL_OK;
+}
+
+/*******************************************************************************
+* Function Name: ftl_sync
+********************************************************************************
+* Summary:
+*   Program the partial page held in the write buffer.
+*
+*******************************************************************************/
+ftl_result_t ftl_sync(void)
+{
+    if (ftl_nor == NULL)
+    {
+        return FTL_ERR_PARAM;
+    }
+
+    return ftl_flush();
+}
+
+/*******************************************************************************
+* Function Name: ftl_gc_step
+********************************************************************************
+* Summary:
+*   Do one step of background garbage collection: it moves at most one page
+*   or erases at most one block. Call it while the storage is idle.
+*
+* Return:
+*   True if more work is pending.
+*
+*******************************************************************************/
+bool ftl_gc_step(void)
+{
+    if (ftl_nor == NULL)
+    {
+        return false;
+    }
+
+    return ftl_gc_run(false);
+}
+
+/*******************************************************************************
+* Function Name: ftl_get_stats
+********************************************************************************
+* Summary:
+*   Get the FTL counters.
+*
+*******************************************************************************/
+void ftl_get_stats(ftl_stats_t *stats)
+{
+    uint32_t block;
+
+    *stats = ftl_stats;
+    stats->erase_min = 0xFFFFFFFFu;
+    stats->erase_max = 0;
+    for (block = 0; block < ftl_block_num; block++)
+    {
+        if (ftl_blocks[block].erase_count < stats->erase_min)
+        {
+            stats->erase_min = ftl_blocks[block].erase_count;
+        }
+        if (ftl_blocks[block].erase_count > stats->erase_max)
+        {
+            stats->erase_max = ftl_blocks[block].erase_count;
+        }
+    }
+    stats->free_blocks = ftl_free_blocks();
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,122 @@
+/*****************************************************************************
+* File Name: ftl.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the ftl.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef FTL_H_
+#define FTL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Mapping unit of the FTL, a multiple of the logical sector size */
+#ifndef FTL_PAGE_SIZE
+#define FTL_PAGE_SIZE           4096u
+#endif
+
+/* Largest geometry supported by the RAM tables */
+#ifndef FTL_MAX_BLOCKS
+#define FTL_MAX_BLOCKS          256u
+#endif
+#ifndef FTL_MAX_PAGES
+#define FTL_MAX_PAGES           16384u
+#endif
+
+/* Erase blocks kept out of the exported capacity for garbage collection */
+#define FTL_SPARE_BLOCKS_MIN    4u
+#define FTL_SPARE_BLOCKS_DIV    16u
+
+/* The foreground collects garbage itself below this number of free blocks */
+#define FTL_RESERVE_BLOCKS      2u
+
+/* The background collects garbage below this number of free blocks */
+#define FTL_GC_FREE_TARGET      6u
+
+/* Static wear leveling: maximum spread of the erase counts */
+#define FTL_WL_THRESHOLD        64u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef enum
+{
+    FTL_OK = 0,
+    FTL_ERR_IO,
+    FTL_ERR_PARAM,
+    FTL_ERR_FULL,
+} ftl_result_t;
+
+/* NOR flash access, each function returns 0 if successful */
+typedef struct
+{
+    uint32_t size;          /* Bytes of flash given to the FTL */
+    uint32_t erase_size;    /* Erase block size in bytes */
+    int (*read)(uint32_t addr, uint8_t *buf, uint32_t len);
+    int (*program)(uint32_t addr, const uint8_t *buf, uint32_t len);
+    int (*erase)(uint32_t addr);
+} ftl_nor_t;
+
+typedef struct
+{
+    uint32_t host_pages;    /* Pages written by the host */
+    uint32_t gc_pages;      /* Pages moved by the garbage collection */
+    uint32_t erases;        /* Blocks erased */
+    uint32_t erase_min;     /* Lowest erase count */
+    uint32_t erase_max;     /* Highest erase count */
+    uint32_t free_blocks;   /* Blocks ready to be written */
+} ftl_stats_t;
+
+/*******************************************************************************
+* Function prototypes
+********************************************************************************/
+ftl_result_t ftl_mount(const ftl_nor_t *nor, uint32_t sector_size);
+uint32_t     ftl_sector_num(void);
+ftl_result_t ftl_read(uint32_t sector, uint8_t *buf, uint32_t count);
+ftl_result_t ftl_write(uint32_t sector, const uint8_t *buf, uint32_t count);
+ftl_result_t ftl_sync(void);
+bool         ftl_gc_step(void);
+void         ftl_get_stats(ftl_stats_t *stats);
+
+#endif /* FTL_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,280 @@
+/*****************************************************************************
+* File Name: log.c
+*
+* Description:
+*  This file contains the deferred logging. Messages are queued with their
+*  format and raw arguments, and formatted to the UART by a low priority
+*  task, so the callers never wait for the UART.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "log.h"
+#include "cy_pdl.h"
+
+#include "rtos.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef struct
+{
+    const char *format;
+    uintptr_t args[LOG_MAX_ARGS];
+    char str[LOG_STR_SIZE];
+    volatile uint8_t ready;
+} log_record_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static log_record_t log_queue[LOG_QUEUE_SIZE];
+static volatile uint32_t log_head = 0;
+static volatile uint32_t log_tail = 0;
+static volatile uint32_t log_drop_count = 0;
+
+/*******************************************************************************
+* Function Name: log_vwrite
+********************************************************************************
+* Summary:
+*   Queue a message. The slot is reserved with exclusive accesses so no lock
+*   is needed. If the queue is full, the message is dropped and counted, or
+*   with wait set, the task waits for the log task to drain it.
+*
+*   Only 32-bit arguments are supported (integers, characters and pointers).
+*   The %s arguments are copied, one after the other, in LOG_STR_SIZE bytes
+*   per message; the strings past that size are truncated.
+*
+* Parameters:
+*   wait = wait for a free slot instead of dropping the message
+*   format = printf-like format string, must be a constant
+*   ap = arguments, up to LOG_MAX_ARGS
+*
+*******************************************************************************/
+static void log_vwrite(bool wait, const char *format, va_list ap)
+{
+    log_record_t *record;
+    const char *fmt;
+    uint32_t index;
+    uint32_t arg_num = 0;
+    uint32_t str_len = 0;
+    const char *str;
+
+    /* Reserve a slot */
+    do
+    {
+        index = __LDREXW(&log_head);
+
+        if ((index - log_tail) >= LOG_QUEUE_SIZE)
+        {
+            __CLREX();
+
+            /* The store below fails after the clear, so the slot is tried
+             * again once the log task had time to drain the queue */
+            if (wait)
+            {
+                vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+                continue;
+            }
+
+            do
+            {
+                index = __LDREXW(&log_drop_count);
+            } while (__STREXW(index + 1u, &log_drop_count) != 0u);
+
+            return;
+        }
+    } while (__STREXW(index + 1u, &log_head) != 0u);
+
+    record = &log_queue[index & (LOG_QUEUE_SIZE - 1u)];
+    record->format = format;
+
+    /* Store the raw arguments, walking the conversions of the format */
+    for (fmt = format; (*fmt != '\0') && (arg_num < LOG_MAX_ARGS); fmt++)
+    {
+        if (*fmt != '%')
+        {
+            continue;
+        }
+
+        /* Skip the flags, width, precision and length */
+        fmt++;
+        while ((*fmt != '\0') && (strchr("-+ #0123456789.lhzjt", *fmt) != NULL))
+        {
+            fmt++;
+        }
+
+        if (*fmt == '\0')
+        {
+            break;
+        }
+        else if (*fmt == '%')
+        {
+            continue;
+        }
+
+        record->args[arg_num] = va_arg(ap, uintptr_t);
+
+        /* Copy the string after the ones before it */
+        if (*fmt == 's')
+        {
+            str = (const char *) record->args[arg_num];
+            record->args[arg_num] = (uintptr_t) &record->str[str_len];
+            while ((*str != '\0') && (str_len < (LOG_STR_SIZE - 1u)))
+            {
+                record->str[str_len++] = *str++;
+            }
+            record->str[str_len++] = '\0';
+            if (str_len > (LOG_STR_SIZE - 1u))
+            {
+                str_len = LOG_STR_SIZE - 1u;
+            }
+        }
+
+        arg_num++;
+    }
+
+    /* Publish the record to the log task */
+    __DMB();
+    record->ready = 1u;
+}
+
+/*******************************************************************************
+* Function Name: log_write
+********************************************************************************
+* Summary:
+*   Queue a message. Can be called from any context, and never waits: if the
+*   queue is full, the message is dropped and counted.
+*
+* Parameters:
+*   format = printf-like format string, must be a constant
+*   ... = arguments, up to LOG_MAX_ARGS
+*
+*******************************************************************************/
+void log_write(const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    log_vwrite(false, format, ap);
+    va_end(ap);
+}
+
+/*******************************************************************************
+* Function Name: log_write_wait
+********************************************************************************
+* Summary:
+*   Queue a message, waiting for the log task to drain the queue if it is
+*   full, so a long listing is printed whole. Only for a task outside of the
+*   storage and audio paths, such as the record listing at boot; before the
+*   scheduler starts, the message is dropped as by log_write().
+*
+* Parameters:
+*   format = printf-like format string, must be a constant
+*   ... = arguments, up to LOG_MAX_ARGS
+*
+*******************************************************************************/
+void log_write_wait(const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    log_vwrite((__get_IPSR() == 0u) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING), format, ap);
+    va_end(ap);
+}
+
+/*******************************************************************************
+* Function Name: log_dropped
+********************************************************************************
+* Summary:
+*   Return the number of messages dropped because the queue was full.
+*
+*******************************************************************************/
+uint32_t log_dropped(void)
+{
+    return log_drop_count;
+}
+
+/*******************************************************************************
+* Function Name: log_task
+********************************************************************************
+* Summary:
+*   Format the queued messages to the UART, and report the dropped ones.
+*
+* Parameters:
+*   arg: not used
+*
+*******************************************************************************/
+void log_task(void *arg)
+{
+    log_record_t *record;
+    uint32_t drop_reported = 0;
+    uint32_t drop_count;
+
+    (void) arg;
+
+    while (1)
+    {
+        record = &log_queue[log_tail & (LOG_QUEUE_SIZE - 1u)];
+
+        while (record->ready)
+        {
+            printf(record->format, record->args[0], record->args[1],
+                                   record->args[2], record->args[3]);
+
+            /* Return the slot to the producers */
+            record->ready = 0u;
+            __DMB();
+            log_tail++;
+
+            record = &log_queue[log_tail & (LOG_QUEUE_SIZE - 1u)];
+        }
+
+        drop_count = log_drop_count;
+        if (drop_count != drop_reported)
+        {
+            printf("log: %lu messages dropped\n\r", (unsigned long) (drop_count - drop_reported));
+            drop_reported = drop_count;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,119 @@
+/*****************************************************************************
+* File Name: log.h
+*
+* Description:
+*  This file contains the deferred logging macros, the function prototypes
+*  and constants used in the log.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define LOG_LEVEL_NONE          0u
+#define LOG_LEVEL_ERROR         1u
+#define LOG_LEVEL_WARN          2u
+#define LOG_LEVEL_INFO          3u
+#define LOG_LEVEL_DEBUG         4u
+
+/* Messages above this level are removed at compile time */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL               LOG_LEVEL_INFO
+#endif
+
+/* Number of messages waiting to be printed, must be a power of 2 */
+#define LOG_QUEUE_SIZE          64u
+
+/* Maximum number of arguments per message, 32-bit integers or pointers */
+#define LOG_MAX_ARGS            4u
+
+/* Size of the copies of the string arguments (%s) of a message */
+#define LOG_STR_SIZE            32u
+
+/* Period to drain the queue to the UART */
+#define LOG_DRAIN_MS            10u
+
+/*******************************************************************************
+* Logging Macros
+********************************************************************************/
+#if (LOG_LEVEL >= LOG_LEVEL_ERROR)
+#define LOG_ERROR(...)          log_write(__VA_ARGS__)
+#else
+#define LOG_ERROR(...)          do { } while (0)
+#endif
+
+#if (LOG_LEVEL >= LOG_LEVEL_WARN)
+#define LOG_WARN(...)           log_write(__VA_ARGS__)
+#else
+#define LOG_WARN(...)           do { } while (0)
+#endif
+
+#if (LOG_LEVEL >= LOG_LEVEL_INFO)
+#define LOG_INFO(...)           log_write(__VA_ARGS__)
+#else
+#define LOG_INFO(...)           do { } while (0)
+#endif
+
+#if (LOG_LEVEL >= LOG_LEVEL_DEBUG)
+#define LOG_DEBUG(...)          log_write(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...)          do { } while (0)
+#endif
+
+/* Message of a long listing, waiting for room in the queue instead of being
+*  dropped. Not for the storage and audio paths */
+#if (LOG_LEVEL >= LOG_LEVEL_INFO)
+#define LOG_INFO_WAIT(...)      log_write_wait(__VA_ARGS__)
+#else
+#define LOG_INFO_WAIT(...)      do { } while (0)
+#endif
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void     log_write(const char *format, ...);
+void     log_write_wait(const char *format, ...);
+uint32_t log_dropped(void);
+void     log_task(void *arg);
+
+#endif /* LOG_H_ */
+
+/* [] END OF FILE */
@@ -51,12 +51,18 @@
 #include "rtos.h"
 #include "usb_comm.h"
 #include "audio_in.h"
+#include "stats.h"
+#include "trace.h"
+#include "log.h"
+#include "storage.h"
 
 /*******************************************************************************
 * Global Variables
 ********************************************************************************/
 TaskHandle_t rtos_usb_task;
 TaskHandle_t rtos_audio_task;
+TaskHandle_t rtos_log_task;
+TaskHandle_t rtos_qspi_task;
 SemaphoreHandle_t rtos_fs_mutex;
 
 /*******************************************************************************
@@ -104,6 +110,15 @@ int main(void)
     printf("\x1b[2J\x1b[;H");
     printf("************* CE230360 - PSoC 6 MCU: USB Mass Storage File System *************\r\n\n");
 
+    /* Initialize the performance counters */
+    stats_init();
+
+    /* Initialize the event trace, when enabled */
+    TRACE_INIT();
+
+    /* Build the block device stacks of the storage */
+    storage_stacks_init();
+
     /* Create the RTOS tasks */
     task_return = xTaskCreate(audio_in_task, "Audio Task",
                               RTOS_STACK_DEPTH, NULL, RTOS_TASK_PRIORITY,
@@ -115,6 +130,20 @@ int main(void)
                               &rtos_usb_task);
     if( task_return != pdPASS ) CY_ASSERT(0);
 
+    /* The log task prints the deferred messages when the other tasks are idle */
+    task_return = xTaskCreate(log_task, "Log Task",
+                              RTOS_STACK_DEPTH, NULL, RTOS_LOG_TASK_PRIORITY,
+                              &rtos_log_task);
+    if( task_return != pdPASS ) CY_ASSERT(0);
+
+#if STORAGE_QSPI_USED
+    /* The QSPI task collects the FTL garbage when the flash is idle */
+    task_return = xTaskCreate(qspi_storage_task, "QSPI Task",
+                              RTOS_STACK_DEPTH, NULL, RTOS_QSPI_TASK_PRIORITY,
+                              &rtos_qspi_task);
+    if( task_return != pdPASS ) CY_ASSERT(0);
+#endif
+
     /* Create the file system semaphore */
     rtos_fs_mutex = xSemaphoreCreateMutex();
 
@@ -138,28 +167,43 @@ int main(void)
 *******************************************************************************/
 void usb_task(void *arg)
 {
+    TickType_t stats_time;
+
     /* Initialize and enumerate the USB */
     usb_comm_init();
 
     /* Check if other tasks are accessing the file system */
     xSemaphoreTake(rtos_fs_mutex, portMAX_DELAY);
+    stats_fs_mutex_taken();
 
     usb_comm_connect();
     
     /* Release the file system to other tasks */
+    stats_fs_mutex_given();
     xSemaphoreGive(rtos_fs_mutex);
 
+    stats_time = xTaskGetTickCount();
+
     while (1)
     {
         /* Check if other tasks are accessing the file system */
         xSemaphoreTake(rtos_fs_mutex, portMAX_DELAY);
+        stats_fs_mutex_taken();
         
         /* Process any USB request */
         usb_comm_process();
 
         /* Release the file system to other tasks */
+        stats_fs_mutex_given();
         xSemaphoreGive(rtos_fs_mutex);
 
+        /* Refresh the statistics virtual file */
+        if ((xTaskGetTickCount() - stats_time) >= pdMS_TO_TICKS(STATS_UPDATE_MS))
+        {
+            stats_time = xTaskGetTickCount();
+            stats_update();
+        }
+
         vTaskDelay(1);
     }
 }
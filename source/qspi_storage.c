@@ -0,0 +1,405 @@
+/*****************************************************************************
+* File Name: qspi_storage.c
+*
+* Description:
+*  This file presents the QSPI NOR flash of the kit as a block device. The
+*  flash translation layer (ftl.c) maps the logical blocks on the flash, and a
+*  low priority task collects its garbage when the storage is idle.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "qspi_storage.h"
+#include "storage.h"
+#include "ftl.h"
+#include "rtos.h"
+#include "stats.h"
+#include "trace.h"
+#include "cy_serial_flash_qspi.h"
+#include "cycfg_qspi_memslot.h"
+#include "cybsp.h"
+
+/*******************************************************************************
+* Constants
+*******************************************************************************/
+/* Blocks in units of 512 bytes for the statistics and the trace */
+#define QSPI_STORAGE_STATS_UNITS    (STORAGE_BLOCK_SIZE / 512u)
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+static int qspi_storage_nor_read(uint32_t addr, uint8_t *buf, uint32_t len);
+static int qspi_storage_nor_program(uint32_t addr, const uint8_t *buf, uint32_t len);
+static int qspi_storage_nor_erase(uint32_t addr);
+
+/*******************************************************************************
+* Global Variables
+*******************************************************************************/
+/* Flash given to the FTL, the geometry is read at initialization */
+static ftl_nor_t qspi_storage_nor =
+{
+    .size = 0,
+    .erase_size = 0,
+    .read = qspi_storage_nor_read,
+    .program = qspi_storage_nor_program,
+    .erase = qspi_storage_nor_erase,
+};
+
+static volatile bool qspi_storage_ready = false;
+
+/* Set while a context runs the FTL, which is not reentrant */
+static volatile bool qspi_storage_busy = false;
+
+/* Counts the host and file system accesses, for the idle detection */
+static volatile uint32_t qspi_storage_accesses = 0;
+
+/*******************************************************************************
+* Function Name: qspi_storage_nor_read
+********************************************************************************
+* Summary:
+*  Read from the flash region of the FTL.
+*
+*******************************************************************************/
+static int qspi_storage_nor_read(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    return (cy_serial_flash_qspi_read(QSPI_STORAGE_OFFSET + addr, len, buf) == CY_RSLT_SUCCESS) ? 0 : -1;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_nor_program
+********************************************************************************
+* Summary:
+*  Program the flash region of the FTL.
+*
+*******************************************************************************/
+static int qspi_storage_nor_program(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    return (cy_serial_flash_qspi_write(QSPI_STORAGE_OFFSET + addr, len, buf) == CY_RSLT_SUCCESS) ? 0 : -1;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_nor_erase
+********************************************************************************
+* Summary:
+*  Erase one block of the flash region of the FTL.
+*
+*******************************************************************************/
+static int qspi_storage_nor_erase(uint32_t addr)
+{
+    return (cy_serial_flash_qspi_erase(QSPI_STORAGE_OFFSET + addr, qspi_storage_nor.erase_size) == CY_RSLT_SUCCESS) ? 0 : -1;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_lock
+********************************************************************************
+* Summary:
+*  Take the FTL. A task waits for it; an interrupt cannot, the USB host then
+*  gets an error and retries the command.
+*
+* Return:
+*  True if taken.
+*
+*******************************************************************************/
+static bool qspi_storage_lock(void)
+{
+    UBaseType_t state;
+    bool taken;
+
+    for (;;)
+    {
+        state = taskENTER_CRITICAL_FROM_ISR();
+        taken = !qspi_storage_busy;
+        qspi_storage_busy = true;
+        taskEXIT_CRITICAL_FROM_ISR(state);
+
+        if (taken || (__get_IPSR() != 0u))
+        {
+            return taken;
+        }
+        vTaskDelay(1);
+    }
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_unlock
+********************************************************************************
+* Summary:
+*  Release the FTL.
+*
+*******************************************************************************/
+static void qspi_storage_unlock(void)
+{
+    qspi_storage_busy = false;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_is_connected
+********************************************************************************
+* Summary:
+*  The flash is soldered on the kit: report it once the FTL is mounted.
+*
+*******************************************************************************/
+bool qspi_storage_is_connected(void)
+{
+    return qspi_storage_ready;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_init
+********************************************************************************
+* Summary:
+*  Initialize the QSPI flash and mount the FTL. Calling it again once mounted
+*  does nothing.
+*
+* Return:
+*  CY_RSLT_SUCCESS if successful.
+*
+*******************************************************************************/
+cy_rslt_t qspi_storage_init(void)
+{
+    cy_rslt_t result;
+
+    if (qspi_storage_ready)
+    {
+        return CY_RSLT_SUCCESS;
+    }
+
+    result = cy_serial_flash_qspi_init(smifMemConfigs[0], CYBSP_QSPI_D0, CYBSP_QSPI_D1, CYBSP_QSPI_D2,
+                                       CYBSP_QSPI_D3, NC, NC, NC, NC, CYBSP_QSPI_SCK, CYBSP_QSPI_SS,
+                                       QSPI_STORAGE_BUS_FREQ);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return result;
+    }
+
+    qspi_storage_nor.size = (uint32_t) cy_serial_flash_qspi_get_size() - QSPI_STORAGE_OFFSET;
+    qspi_storage_nor.erase_size = (uint32_t) cy_serial_flash_qspi_get_erase_size(QSPI_STORAGE_OFFSET);
+
+    if (ftl_mount(&qspi_storage_nor, STORAGE_BLOCK_SIZE) != FTL_OK)
+    {
+        return CY_RSLT_TYPE_ERROR;
+    }
+
+    qspi_storage_ready = true;
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_sector_size
+********************************************************************************
+* Summary:
+*  Get the logical block size.
+*
+*******************************************************************************/
+uint32_t qspi_storage_sector_size(void)
+{
+    return STORAGE_BLOCK_SIZE;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_max_sector_num
+********************************************************************************
+* Summary:
+*  Get the number of logical blocks exported by the FTL.
+*
+*******************************************************************************/
+uint32_t qspi_storage_max_sector_num(void)
+{
+    return ftl_sector_num();
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_total_mem_bytes
+********************************************************************************
+* Summary:
+*  Get the storage total memory bytes.
+*
+*******************************************************************************/
+uint64_t qspi_storage_total_mem_bytes(void)
+{
+    uint64_t sector_num = qspi_storage_max_sector_num();
+    return (sector_num * qspi_storage_sector_size());
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_read
+********************************************************************************
+* Summary:
+*  Read data from the flash.
+*
+* Parameters:
+*  address The logical block to read data from
+*  data    Pointer to the byte-array where data read from the device should be stored
+*  length  Number of logical blocks to read, set to 0 if the read failed
+*
+* Return:
+*  CY_RSLT_SUCCESS if successful.
+*******************************************************************************/
+cy_rslt_t qspi_storage_read(uint32_t address, uint8_t *data, uint32_t *length)
+{
+    ftl_result_t result;
+    uint32_t start;
+
+    if (!qspi_storage_ready || !qspi_storage_lock())
+    {
+        *length = 0;
+        return CY_RSLT_TYPE_ERROR;
+    }
+    qspi_storage_accesses++;
+
+    TRACE_BEGIN(TRACE_ID_SD_READ, *length * QSPI_STORAGE_STATS_UNITS);
+    start = stats_timestamp();
+    result = ftl_read(address, data, *length);
+    stats_sd_record(STATS_SD_READ, start, *length * QSPI_STORAGE_STATS_UNITS);
+    TRACE_END(TRACE_ID_SD_READ, *length * QSPI_STORAGE_STATS_UNITS);
+    qspi_storage_unlock();
+
+    if (result != FTL_OK)
+    {
+        *length = 0;
+        return CY_RSLT_TYPE_ERROR;
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_write
+********************************************************************************
+* Summary:
+*  Write data to the flash. The last page written may stay in the FTL write
+*  buffer until qspi_storage_sync() or the background task flushes it.
+*
+* Parameters:
+*  address The logical block to write data to
+*  data    Pointer to the byte-array of data to write to the device
+*  length  Number of logical blocks to write, set to 0 if the write failed
+*
+* Return:
+*  CY_RSLT_SUCCESS if successful.
+*******************************************************************************/
+cy_rslt_t qspi_storage_write(uint32_t address, const uint8_t *data, uint32_t *length)
+{
+    ftl_result_t result;
+    uint32_t start;
+
+    if (!qspi_storage_ready || !qspi_storage_lock())
+    {
+        *length = 0;
+        return CY_RSLT_TYPE_ERROR;
+    }
+    qspi_storage_accesses++;
+
+    TRACE_BEGIN(TRACE_ID_SD_WRITE, *length * QSPI_STORAGE_STATS_UNITS);
+    start = stats_timestamp();
+    result = ftl_write(address, data, *length);
+    stats_sd_record(STATS_SD_WRITE, start, *length * QSPI_STORAGE_STATS_UNITS);
+    TRACE_END(TRACE_ID_SD_WRITE, *length * QSPI_STORAGE_STATS_UNITS);
+    qspi_storage_unlock();
+
+    if (result != FTL_OK)
+    {
+        *length = 0;
+        return CY_RSLT_TYPE_ERROR;
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_sync
+********************************************************************************
+* Summary:
+*  Program the write buffer of the FTL to the flash.
+*
+* Return:
+*  CY_RSLT_SUCCESS if successful.
+*******************************************************************************/
+cy_rslt_t qspi_storage_sync(void)
+{
+    ftl_result_t result;
+
+    if (!qspi_storage_ready || !qspi_storage_lock())
+    {
+        return CY_RSLT_TYPE_ERROR;
+    }
+    result = ftl_sync();
+    qspi_storage_unlock();
+
+    return (result == FTL_OK) ? CY_RSLT_SUCCESS : CY_RSLT_TYPE_ERROR;
+}
+
+/*******************************************************************************
+* Function Name: qspi_storage_task
+********************************************************************************
+* Summary:
+*  Once neither the host nor the file system accessed the flash for
+*  QSPI_STORAGE_IDLE_MS, sync the write buffer, then collect the garbage one
+*  step at a time, so the writes seldom wait for an erase.
+*
+* Parameters:
+*  arg: not used
+*
+*******************************************************************************/
+void qspi_storage_task(void *arg)
+{
+    uint32_t seen = 0;
+    bool work;
+
+    (void) arg;
+
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(QSPI_STORAGE_IDLE_MS));
+
+        if (!qspi_storage_ready || (seen != qspi_storage_accesses))
+        {
+            seen = qspi_storage_accesses;
+            continue;
+        }
+
+        /* Stop at the first access, the next step waits for idle again */
+        work = true;
+        while (work && (seen == qspi_storage_accesses))
+        {
+            if (!qspi_storage_lock())
+            {
+                break;
+            }
+            work = (ftl_sync() == FTL_OK) && ftl_gc_step();
+            qspi_storage_unlock();
+            vTaskDelay(1);
+        }
+    }
+}
+
+/* [] END OF FILE */
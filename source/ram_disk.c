@@ -0,0 +1,271 @@
+/*****************************************************************************
+* File Name: ram_disk.c
+*
+* Description:
+*  This file implements a RAM disk. It is formatted as a FAT12 volume at
+*  initialization, so the host can use it without formatting it. The content
+*  is lost at reset.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include <string.h>
+#include "ram_disk.h"
+
+#if (RAM_DISK_SIZE > 0)
+
+#if ((RAM_DISK_SIZE % RAM_DISK_SECTOR_SIZE) != 0) || (RAM_DISK_SECTOR_NUM < 32) || (RAM_DISK_SECTOR_NUM > 4000)
+#error "RAM_DISK_SIZE must be a multiple of 512 bytes from 16 KB to 2000 KB"
+#endif
+
+/*******************************************************************************
+* Constants
+*******************************************************************************/
+#define RAM_DISK_ROOT_ENTRIES       64u
+#define RAM_DISK_DIR_ENTRY_SIZE     32u
+#define RAM_DISK_MEDIA_TYPE         0xF8u
+#define RAM_DISK_VOLUME_ID          0x52414D44u
+
+/*******************************************************************************
+* Global Variables
+*******************************************************************************/
+static uint8_t ram_disk_data[RAM_DISK_SIZE];
+
+static bool ram_disk_formatted = false;
+
+/*******************************************************************************
+* Function Name: ram_disk_put16
+********************************************************************************
+* Summary:
+*  Store a little-endian 16-bit value.
+*
+*******************************************************************************/
+static void ram_disk_put16(uint8_t *dst, uint32_t value)
+{
+    dst[0] = (uint8_t) value;
+    dst[1] = (uint8_t) (value >> 8);
+}
+
+/*******************************************************************************
+* Function Name: ram_disk_format
+********************************************************************************
+* Summary:
+*  Write an empty FAT12 volume without partition table, with one sector per
+*  cluster and two FATs.
+*
+*******************************************************************************/
+static void ram_disk_format(void)
+{
+    uint8_t *boot = ram_disk_data;
+    uint8_t *fat;
+    uint32_t root_sectors = (RAM_DISK_ROOT_ENTRIES * RAM_DISK_DIR_ENTRY_SIZE) / RAM_DISK_SECTOR_SIZE;
+    uint32_t fat_sectors = 1;
+    uint32_t clusters;
+    uint32_t index;
+
+    /* Grow the FAT until its 12-bit entries map all the data clusters */
+    for (;;)
+    {
+        clusters = RAM_DISK_SECTOR_NUM - 1u - root_sectors - (2u * fat_sectors);
+        if (((((clusters + 2u) * 3u) + 1u) / 2u) <= (fat_sectors * RAM_DISK_SECTOR_SIZE))
+        {
+            break;
+        }
+        fat_sectors++;
+    }
+
+    memset(ram_disk_data, 0, sizeof(ram_disk_data));
+
+    /* Boot sector */
+    boot[0] = 0xEB;
+    boot[1] = 0x3C;
+    boot[2] = 0x90;
+    memcpy(&boot[3], "MSDOS5.0", 8);
+    ram_disk_put16(&boot[11], RAM_DISK_SECTOR_SIZE);
+    boot[13] = 1;
+    ram_disk_put16(&boot[14], 1);
+    boot[16] = 2;
+    ram_disk_put16(&boot[17], RAM_DISK_ROOT_ENTRIES);
+    ram_disk_put16(&boot[19], RAM_DISK_SECTOR_NUM);
+    boot[21] = RAM_DISK_MEDIA_TYPE;
+    ram_disk_put16(&boot[22], fat_sectors);
+    ram_disk_put16(&boot[24], 32);
+    ram_disk_put16(&boot[26], 2);
+    boot[36] = 0x80;
+    boot[38] = 0x29;
+    ram_disk_put16(&boot[39], RAM_DISK_VOLUME_ID);
+    ram_disk_put16(&boot[41], RAM_DISK_VOLUME_ID >> 16);
+    memcpy(&boot[43], "RAMDISK    ", 11);
+    memcpy(&boot[54], "FAT12   ", 8);
+    boot[510] = 0x55;
+    boot[511] = 0xAA;
+
+    /* Reserved entries of both FATs */
+    for (index = 0; index < 2u; index++)
+    {
+        fat = &ram_disk_data[(1u + (index * fat_sectors)) * RAM_DISK_SECTOR_SIZE];
+        fat[0] = RAM_DISK_MEDIA_TYPE;
+        fat[1] = 0xFF;
+        fat[2] = 0xFF;
+    }
+
+    /* Volume label in the root directory */
+    memcpy(&ram_disk_data[(1u + (2u * fat_sectors)) * RAM_DISK_SECTOR_SIZE], "RAMDISK    ", 11);
+    ram_disk_data[((1u + (2u * fat_sectors)) * RAM_DISK_SECTOR_SIZE) + 11u] = 0x08;
+}
+
+/*******************************************************************************
+* Function Name: ram_disk_is_connected
+********************************************************************************
+* Summary:
+*  The RAM disk is always present.
+*
+*******************************************************************************/
+bool ram_disk_is_connected(void)
+{
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: ram_disk_init
+********************************************************************************
+* Summary:
+*  Format the RAM disk the first time it is called.
+*
+* Return:
+*  CY_RSLT_SUCCESS
+*
+*******************************************************************************/
+cy_rslt_t ram_disk_init(void)
+{
+    if (!ram_disk_formatted)
+    {
+        ram_disk_format();
+        ram_disk_formatted = true;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: ram_disk_sector_size
+********************************************************************************
+* Summary:
+*  Get the block size of the RAM disk.
+*
+*******************************************************************************/
+uint32_t ram_disk_sector_size(void)
+{
+    return RAM_DISK_SECTOR_SIZE;
+}
+
+/*******************************************************************************
+* Function Name: ram_disk_max_sector_num
+********************************************************************************
+* Summary:
+*  Get the number of blocks of the RAM disk.
+*
+*******************************************************************************/
+uint32_t ram_disk_max_sector_num(void)
+{
+    return RAM_DISK_SECTOR_NUM;
+}
+
+/*******************************************************************************
+* Function Name: ram_disk_total_mem_bytes
+********************************************************************************
+* Summary:
+*  Get the RAM disk total memory bytes.
+*
+*******************************************************************************/
+uint64_t ram_disk_total_mem_bytes(void)
+{
+    return RAM_DISK_SIZE;
+}
+
+/*******************************************************************************
+* Function Name: ram_disk_read
+********************************************************************************
+* Summary:
+*  Read data from the RAM disk.
+*
+* Parameters:
+*  address The block to read data from
+*  data    Pointer to the byte-array where data read from the device should be stored
+*  length  Number of blocks to read
+*
+* Return:
+*  CY_RSLT_SUCCESS if successful.
+*******************************************************************************/
+cy_rslt_t ram_disk_read(uint32_t address, uint8_t *data, uint32_t *length)
+{
+    if ((address > RAM_DISK_SECTOR_NUM) || (*length > (RAM_DISK_SECTOR_NUM - address)))
+    {
+        *length = 0;
+        return CY_RSLT_TYPE_ERROR;
+    }
+
+    memcpy(data, &ram_disk_data[address * RAM_DISK_SECTOR_SIZE], *length * RAM_DISK_SECTOR_SIZE);
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: ram_disk_write
+********************************************************************************
+* Summary:
+*  Write data to the RAM disk.
+*
+* Parameters:
+*  address The block to write data to
+*  data    Pointer to the byte-array of data to write to the device
+*  length  Number of blocks to write
+*
+* Return:
+*  CY_RSLT_SUCCESS if successful.
+*******************************************************************************/
+cy_rslt_t ram_disk_write(uint32_t address, const uint8_t *data, uint32_t *length)
+{
+    if ((address > RAM_DISK_SECTOR_NUM) || (*length > (RAM_DISK_SECTOR_NUM - address)))
+    {
+        *length = 0;
+        return CY_RSLT_TYPE_ERROR;
+    }
+
+    memcpy(&ram_disk_data[address * RAM_DISK_SECTOR_SIZE], data, *length * RAM_DISK_SECTOR_SIZE);
+    return CY_RSLT_SUCCESS;
+}
+
+#endif /* RAM_DISK_SIZE > 0 */
+
+/* [] END OF FILE */
@@ -0,0 +1,74 @@
+/*****************************************************************************
+* File Name: ram_disk.h
+*
+* Description:
+*  This file contains the function prototypes of the RAM disk, exposed to the
+*  USB host as a scratch or status volume next to the recording storage.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#if !defined(RAM_DISK_H)
+#define RAM_DISK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cyhal.h"
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Size of the RAM disk in bytes, 0 to remove it. Selected with RAM_DISK_SIZE
+*  in the Makefile. */
+#ifndef RAM_DISK_SIZE
+#define RAM_DISK_SIZE               (128u * 1024u)
+#endif
+
+#define RAM_DISK_SECTOR_SIZE        512u
+#define RAM_DISK_SECTOR_NUM         (RAM_DISK_SIZE / RAM_DISK_SECTOR_SIZE)
+
+/*******************************************************************************
+* Function prototypes
+********************************************************************************/
+bool ram_disk_is_connected(void);
+cy_rslt_t ram_disk_init(void);
+uint32_t ram_disk_sector_size(void);
+uint32_t ram_disk_max_sector_num(void);
+uint64_t ram_disk_total_mem_bytes(void);
+cy_rslt_t ram_disk_read(uint32_t address, uint8_t *data, uint32_t *length);
+cy_rslt_t ram_disk_write(uint32_t address, const uint8_t *data, uint32_t *length);
+
+#endif /* RAM_DISK_H */
+
+/* [] END OF FILE */
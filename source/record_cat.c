@@ -0,0 +1,659 @@
+/*****************************************************************************
+* File Name: record_cat.c
+*
+* Description:
+*  This file contains the catalog of the audio records. The records are
+*  grouped by thousands in subfolders, and the catalog keeps the number of
+*  records per subfolder and the last record number. It is built once at
+*  mount time and persisted in a hidden index file, so allocating a record
+*  does not scan any folder, and listing scans only the non-empty subfolders.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "record_cat.h"
+#include "audio_fs.h"
+#include "log.h"
+#include "ff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t max_num;
+    uint32_t count;
+    uint32_t last;
+} record_cat_header_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+/* Number of records in each subfolder */
+static uint16_t record_cat_shards[RECORD_SHARD_NUM];
+static uint32_t record_cat_num = 0;
+static uint32_t record_cat_last_num = 0;
+static bool record_cat_dirty = false;
+
+/*******************************************************************************
+* Function Name: record_cat_index_path
+********************************************************************************
+* Summary:
+*   Build the path of the index file.
+*
+*******************************************************************************/
+static void record_cat_index_path(char *path)
+{
+    sprintf(path, "%s/%s", RECORD_FOLDER_NAME, RECORD_CAT_FILE_NAME);
+}
+
+/*******************************************************************************
+* Function Name: record_cat_load
+********************************************************************************
+* Summary:
+*   Load the catalog from the index file.
+*
+* Return:
+*   True if the index file is valid.
+*
+*******************************************************************************/
+static bool record_cat_load(void)
+{
+    record_cat_header_t header;
+    char path[RECORD_CAT_NAME_SIZE];
+    FRESULT result;
+    FIL fp;
+    UINT count;
+
+    record_cat_index_path(path);
+
+    if (f_open(&fp, path, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    {
+        return false;
+    }
+
+    result = f_read(&fp, &header, sizeof(header), &count);
+    if ((result != FR_OK) || (count != sizeof(header)) ||
+        (header.magic != RECORD_CAT_MAGIC) || (header.version != RECORD_CAT_VERSION) ||
+        (header.max_num != RECORD_MAX_NUM) || (header.last >= RECORD_MAX_NUM))
+    {
+        f_close(&fp);
+        return false;
+    }
+
+    result = f_read(&fp, record_cat_shards, sizeof(record_cat_shards), &count);
+    f_close(&fp);
+
+    if ((result != FR_OK) || (count != sizeof(record_cat_shards)))
+    {
+        return false;
+    }
+
+    record_cat_num = header.count;
+    record_cat_last_num = header.last;
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_exists
+********************************************************************************
+* Summary:
+*   Check if a record exists, whatever its encoding.
+*
+*******************************************************************************/
+static bool record_cat_exists(uint32_t num)
+{
+    char name[RECORD_CAT_NAME_SIZE];
+    FRESULT result = FR_NO_FILE;
+    uint32_t format;
+
+    for (format = 0; (format < AUDIO_ENC_NUM) && (result == FR_NO_FILE); format++)
+    {
+        record_cat_name(num, audio_enc_ext((audio_enc_format_t) format), name);
+        result = f_stat(name, NULL);
+    }
+
+    return (result == FR_OK);
+}
+
+/*******************************************************************************
+* Function Name: record_cat_check
+********************************************************************************
+* Summary:
+*   Spot check the loaded catalog against the folders, in case the records
+*   were changed by another computer: the last record must exist and the next
+*   one must not.
+*
+* Return:
+*   True if the catalog is consistent.
+*
+*******************************************************************************/
+static bool record_cat_check(void)
+{
+    if ((record_cat_last_num != 0u) && !record_cat_exists(record_cat_last_num))
+    {
+        return false;
+    }
+
+    if (((record_cat_last_num + 1u) < RECORD_MAX_NUM) && record_cat_exists(record_cat_last_num + 1u))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_scan_shard
+********************************************************************************
+* Summary:
+*   Scan a subfolder, count its records and optionally mark the used numbers.
+*
+* Parameters:
+*   shard = subfolder index
+*   used = bitmap of RECORD_SHARD_SIZE bits to fill, can be NULL
+*   last = updated with the highest record number found, can be NULL
+*
+* Return:
+*   Number of records in the subfolder.
+*
+*******************************************************************************/
+static uint32_t record_cat_scan_shard(uint32_t shard, uint8_t *used, uint32_t *last)
+{
+    char path[RECORD_CAT_NAME_SIZE];
+    FRESULT result;
+    FILINFO fno;
+    DIR dir;
+    uint32_t num;
+    uint32_t index;
+    uint32_t count = 0;
+
+    record_cat_shard_path(shard, path);
+
+    result = f_findfirst(&dir, &fno, path, RECORD_FILE_PATTERN);
+
+    while ((result == FR_OK) && (fno.fname[0]))
+    {
+        num = record_cat_parse(fno.fname);
+
+        if ((num != 0u) && ((num / RECORD_SHARD_SIZE) == shard))
+        {
+            count++;
+
+            if (used != NULL)
+            {
+                index = num % RECORD_SHARD_SIZE;
+                used[index / 8u] |= (uint8_t) (1u << (index % 8u));
+            }
+            if ((last != NULL) && (num > *last))
+            {
+                *last = num;
+            }
+        }
+
+        result = f_findnext(&dir, &fno);
+    }
+
+    f_closedir(&dir);
+
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_migrate
+********************************************************************************
+* Summary:
+*   Move the records stored directly in the records folder, by older firmware,
+*   to their subfolder.
+*
+*******************************************************************************/
+static void record_cat_migrate(void)
+{
+    char path[RECORD_CAT_NAME_SIZE];
+    char name[RECORD_CAT_NAME_SIZE];
+    FRESULT result;
+    FILINFO fno;
+    DIR dir;
+    uint32_t num;
+
+    result = f_findfirst(&dir, &fno, RECORD_FOLDER_NAME, RECORD_FILE_PATTERN);
+
+    while ((result == FR_OK) && (fno.fname[0]))
+    {
+        num = record_cat_parse(fno.fname);
+
+        if ((num != 0u) && !(fno.fattrib & AM_DIR))
+        {
+            record_cat_shard_path(num / RECORD_SHARD_SIZE, path);
+            f_mkdir(path);
+
+            sprintf(path, "%s/%s", RECORD_FOLDER_NAME, fno.fname);
+            record_cat_name(num, strrchr(fno.fname, '.') + 1, name);
+
+            if (f_rename(path, name) != FR_OK)
+            {
+                LOG_ERROR("Not able to move %s\n\r", fno.fname);
+            }
+        }
+
+        result = f_findnext(&dir, &fno);
+    }
+
+    f_closedir(&dir);
+}
+
+/*******************************************************************************
+* Function Name: record_cat_mount
+********************************************************************************
+* Summary:
+*   Load the catalog from the index file, or rebuild it if the file is missing
+*   or out of date. Must be called after the file system is mounted.
+*
+*******************************************************************************/
+void record_cat_mount(void)
+{
+    if (!record_cat_load() || !record_cat_check())
+    {
+        record_cat_rebuild();
+    }
+}
+
+/*******************************************************************************
+* Function Name: record_cat_rebuild
+********************************************************************************
+* Summary:
+*   Scan the subfolders to rebuild the catalog, and persist it. Records left
+*   in the records folder by older firmware are moved to their subfolder.
+*
+*******************************************************************************/
+void record_cat_rebuild(void)
+{
+    FRESULT result;
+    FILINFO fno;
+    DIR dir;
+    char *str;
+    uint32_t shard;
+
+    record_cat_migrate();
+
+    memset(record_cat_shards, 0, sizeof(record_cat_shards));
+    record_cat_num = 0;
+    record_cat_last_num = 0;
+
+    /* Only the existing subfolders are scanned */
+    result = f_findfirst(&dir, &fno, RECORD_FOLDER_NAME, "???");
+
+    while ((result == FR_OK) && (fno.fname[0]))
+    {
+        shard = strtoul(fno.fname, &str, 10);
+
+        if ((fno.fattrib & AM_DIR) && (*str == '\0') && (shard < RECORD_SHARD_NUM))
+        {
+            record_cat_shards[shard] = (uint16_t) record_cat_scan_shard(shard, NULL, &record_cat_last_num);
+            record_cat_num += record_cat_shards[shard];
+        }
+
+        result = f_findnext(&dir, &fno);
+    }
+
+    f_closedir(&dir);
+
+    record_cat_dirty = true;
+    record_cat_sync();
+}
+
+/*******************************************************************************
+* Function Name: record_cat_alloc
+********************************************************************************
+* Summary:
+*   Return the number for a new record, following the last one, and create its
+*   subfolder if needed. Once the last number is used, the first free number
+*   of the first subfolder not full is returned. The catalog is not rebuilt
+*   when the host wrote to the memory: the number is checked with a lookup of
+*   its names, and a record found there is added to the catalog before the
+*   next number is tried, up to RECORD_CAT_PROBES numbers.
+*
+* Return:
+*   Record number, 0 if the catalog is full.
+*
+*******************************************************************************/
+uint32_t record_cat_alloc(void)
+{
+    char path[RECORD_CAT_NAME_SIZE];
+    uint8_t used[RECORD_SHARD_SIZE / 8u];
+    uint32_t shard;
+    uint32_t num = 0;
+    uint32_t index;
+    uint32_t probes = 0;
+
+    if ((record_cat_last_num + 1u) < RECORD_MAX_NUM)
+    {
+        num = record_cat_last_num + 1u;
+    }
+    else
+    {
+        for (shard = 0; (shard < RECORD_SHARD_NUM) && (num == 0u); shard++)
+        {
+            if (record_cat_shards[shard] >= RECORD_SHARD_SIZE)
+            {
+                continue;
+            }
+
+            /* Scan this subfolder only, to find a free number */
+            memset(used, 0, sizeof(used));
+            record_cat_shards[shard] = (uint16_t) record_cat_scan_shard(shard, used, NULL);
+
+            for (index = (shard == 0u) ? 1u : 0u; index < RECORD_SHARD_SIZE; index++)
+            {
+                if ((used[index / 8u] & (1u << (index % 8u))) == 0u)
+                {
+                    num = (shard * RECORD_SHARD_SIZE) + index;
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Records copied by the host since the catalog was built */
+    while ((num != 0u) && record_cat_exists(num))
+    {
+        record_cat_add(num);
+        probes++;
+        num = ((probes < RECORD_CAT_PROBES) && ((num + 1u) < RECORD_MAX_NUM)) ? (num + 1u) : 0u;
+    }
+
+    if (num != 0u)
+    {
+        record_cat_shard_path(num / RECORD_SHARD_SIZE, path);
+        f_mkdir(path);
+    }
+
+    return num;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_add
+********************************************************************************
+* Summary:
+*   Add a new record to the catalog.
+*
+*******************************************************************************/
+void record_cat_add(uint32_t num)
+{
+    if ((num == 0u) || (num >= RECORD_MAX_NUM))
+    {
+        return;
+    }
+
+    record_cat_shards[num / RECORD_SHARD_SIZE]++;
+    record_cat_num++;
+
+    if (num > record_cat_last_num)
+    {
+        record_cat_last_num = num;
+    }
+
+    record_cat_dirty = true;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_remove
+********************************************************************************
+* Summary:
+*   Remove a deleted record from the catalog.
+*
+*******************************************************************************/
+void record_cat_remove(uint32_t num)
+{
+    uint32_t shard;
+
+    if ((num == 0u) || (num >= RECORD_MAX_NUM) || (record_cat_shards[num / RECORD_SHARD_SIZE] == 0u))
+    {
+        return;
+    }
+
+    record_cat_shards[num / RECORD_SHARD_SIZE]--;
+    record_cat_num--;
+
+    /* Find the new last record in the last non-empty subfolder */
+    if (num == record_cat_last_num)
+    {
+        record_cat_last_num = 0;
+
+        for (shard = (num / RECORD_SHARD_SIZE) + 1u; shard > 0u; shard--)
+        {
+            if (record_cat_shards[shard - 1u] != 0u)
+            {
+                record_cat_scan_shard(shard - 1u, NULL, &record_cat_last_num);
+                break;
+            }
+        }
+    }
+
+    record_cat_dirty = true;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_count
+********************************************************************************
+* Summary:
+*   Return the number of records.
+*
+*******************************************************************************/
+uint32_t record_cat_count(void)
+{
+    return record_cat_num;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_shard_count
+********************************************************************************
+* Summary:
+*   Return the number of records in a subfolder.
+*
+*******************************************************************************/
+uint32_t record_cat_shard_count(uint32_t shard)
+{
+    return (shard < RECORD_SHARD_NUM) ? record_cat_shards[shard] : 0u;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_shard_update
+********************************************************************************
+* Summary:
+*   Correct the number of records of a subfolder, after it was listed.
+*
+*******************************************************************************/
+void record_cat_shard_update(uint32_t shard, uint32_t count)
+{
+    if ((shard < RECORD_SHARD_NUM) && (record_cat_shards[shard] != count))
+    {
+        record_cat_num = (record_cat_num - record_cat_shards[shard]) + count;
+        record_cat_shards[shard] = (uint16_t) count;
+        record_cat_dirty = true;
+    }
+}
+
+/*******************************************************************************
+* Function Name: record_cat_shard_path
+********************************************************************************
+* Summary:
+*   Build the path of a subfolder.
+*
+*******************************************************************************/
+void record_cat_shard_path(uint32_t shard, char *path)
+{
+    sprintf(path, "%s/%.3lu", RECORD_FOLDER_NAME, (unsigned long) shard);
+}
+
+/*******************************************************************************
+* Function Name: record_cat_last
+********************************************************************************
+* Summary:
+*   Return the highest record number, 0 if no records.
+*
+*******************************************************************************/
+uint32_t record_cat_last(void)
+{
+    return record_cat_last_num;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_name
+********************************************************************************
+* Summary:
+*   Build the path of a record.
+*
+* Parameters:
+*   num = record number
+*   ext = file extension of the record encoding
+*   name = destination, RECORD_CAT_NAME_SIZE bytes
+*
+*******************************************************************************/
+void record_cat_name(uint32_t num, const char *ext, char *name)
+{
+    sprintf(name, "%s/%.3lu/%s%.4lu.%s", RECORD_FOLDER_NAME,
+            (unsigned long) (num / RECORD_SHARD_SIZE), RECORD_FILE_NAME,
+            (unsigned long) num, ext);
+}
+
+/*******************************************************************************
+* Function Name: record_cat_parse
+********************************************************************************
+* Summary:
+*   Return the number of a record from its file name, with the extension
+*   of a record encoding.
+*
+* Return:
+*   Record number, 0 if the name is not a record.
+*
+*******************************************************************************/
+uint32_t record_cat_parse(const char *fname)
+{
+    char *str;
+    uint32_t num;
+    uint32_t format;
+
+    if (strncmp(fname, RECORD_FILE_NAME, sizeof(RECORD_FILE_NAME) - 1) != 0)
+    {
+        return 0;
+    }
+
+    num = strtoul(fname + sizeof(RECORD_FILE_NAME) - 1, &str, 10);
+
+    if ((*str != '.') || (num >= RECORD_MAX_NUM))
+    {
+        return 0;
+    }
+
+    /* The extension of an encoding */
+    for (format = 0; format < AUDIO_ENC_NUM; format++)
+    {
+        if (strcmp(str + 1, audio_enc_ext((audio_enc_format_t) format)) == 0)
+        {
+            return num;
+        }
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: record_cat_sync
+********************************************************************************
+* Summary:
+*   Write the catalog to the index file, if it changed.
+*
+*******************************************************************************/
+void record_cat_sync(void)
+{
+    record_cat_header_t header;
+    char path[RECORD_CAT_NAME_SIZE];
+    FRESULT result;
+    FRESULT closed;
+    FIL fp;
+    UINT count;
+    UINT total = 0;
+
+    if (!record_cat_dirty)
+    {
+        return;
+    }
+
+    header.magic   = RECORD_CAT_MAGIC;
+    header.version = RECORD_CAT_VERSION;
+    header.max_num = RECORD_MAX_NUM;
+    header.count   = record_cat_num;
+    header.last    = record_cat_last_num;
+
+    record_cat_index_path(path);
+
+    result = f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (result == FR_OK)
+    {
+        result = f_write(&fp, &header, sizeof(header), &count);
+        total += count;
+        if (result == FR_OK)
+        {
+            result = f_write(&fp, record_cat_shards, sizeof(record_cat_shards), &count);
+            total += count;
+        }
+
+        /* The file is closed anyway, the first error is reported */
+        closed = f_close(&fp);
+        if (result == FR_OK)
+        {
+            result = closed;
+        }
+    }
+
+    if ((result != FR_OK) || (total != (sizeof(header) + sizeof(record_cat_shards))))
+    {
+        LOG_ERROR("Error writing the record index!\n\r");
+        return;
+    }
+
+    f_chmod(path, AM_HID, AM_HID);
+
+    record_cat_dirty = false;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,83 @@
+/*****************************************************************************
+* File Name: record_cat.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the record_cat.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef RECORD_CAT_H_
+#define RECORD_CAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Index file persisting the catalog, hidden in the records folder */
+#define RECORD_CAT_FILE_NAME        "index.bin"
+#define RECORD_CAT_MAGIC            0x58444E49u     /* "INDX" */
+#define RECORD_CAT_VERSION          2u
+
+/* Size of a record path, "PSOC_RECORDS/xxx/rec_xxxxxx.raw" */
+#define RECORD_CAT_NAME_SIZE        40u
+
+/* Numbers tried for a new record when the host copied records the catalog
+ * does not know */
+#define RECORD_CAT_PROBES           16u
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void     record_cat_mount(void);
+void     record_cat_rebuild(void);
+uint32_t record_cat_alloc(void);
+void     record_cat_add(uint32_t num);
+void     record_cat_remove(uint32_t num);
+uint32_t record_cat_count(void);
+uint32_t record_cat_shard_count(uint32_t shard);
+void     record_cat_shard_update(uint32_t shard, uint32_t count);
+void     record_cat_shard_path(uint32_t shard, char *path);
+uint32_t record_cat_last(void);
+void     record_cat_name(uint32_t num, const char *ext, char *name);
+uint32_t record_cat_parse(const char *fname);
+void     record_cat_sync(void);
+
+#endif /* RECORD_CAT_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,490 @@
+/*****************************************************************************
+* File Name: record_journal.c
+*
+* Description:
+*  This file contains the journal of the record being written. Before its
+*  first audio, the record is named in a hidden journal file of one sector,
+*  which each write rewrites in place. The audio is committed to the memory
+*  at intervals; after a reset, the recovery finds the record left open,
+*  takes back the audio written since the last commit by checking its
+*  frames, and completes the file size and header.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "record_journal.h"
+#include "record_cat.h"
+#include "audio_fs.h"
+#include "audio_enc.h"
+#include "log.h"
+#include "ff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define RECORD_JOURNAL_PATH         RECORD_FOLDER_NAME "/" RECORD_JOURNAL_FILE_NAME
+
+/* Entry states */
+#define RECORD_JOURNAL_CLOSED       0u
+#define RECORD_JOURNAL_OPEN         1u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t state;
+    uint32_t is_prealloc;       /* The file size is the reserved area */
+    uint64_t size;              /* Committed size of a preallocated record */
+    char name[RECORD_CAT_NAME_SIZE];
+} record_journal_entry_t;
+
+/* Entry padded to a sector, so each write goes to the memory as it is */
+typedef union
+{
+    record_journal_entry_t entry;
+    uint8_t sector[FF_MAX_SS];
+} record_journal_t;
+
+/* Window of the record file being checked */
+typedef struct
+{
+    FIL *fp;
+    uint8_t *buf;
+    uint32_t size;
+    FSIZE_t start;
+    uint32_t len;
+} record_journal_window_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static record_journal_t journal;
+static FIL journal_fp;
+static bool journal_is_open = false;
+
+/*******************************************************************************
+* Function Name: record_journal_write
+********************************************************************************
+* Summary:
+*   Rewrite the journal sector in place. The file size does not change, so
+*   its directory entry is not written again.
+*
+*******************************************************************************/
+static void record_journal_write(void)
+{
+    UINT count;
+
+    if (!journal_is_open)
+    {
+        return;
+    }
+
+    journal.entry.magic = RECORD_JOURNAL_MAGIC;
+    journal.entry.version = RECORD_JOURNAL_VERSION;
+
+    if ((f_lseek(&journal_fp, 0) != FR_OK) ||
+        (f_write(&journal_fp, journal.sector, sizeof(journal.sector), &count) != FR_OK) ||
+        (count != sizeof(journal.sector)))
+    {
+        LOG_ERROR("Error writing the record journal!\n\r");
+    }
+}
+
+/*******************************************************************************
+* Function Name: record_journal_mount
+********************************************************************************
+* Summary:
+*   Open the journal file, creating it in the records folder if needed. Must
+*   be called again each time the volume is mounted.
+*
+*******************************************************************************/
+void record_journal_mount(void)
+{
+    UINT count;
+
+    journal_is_open = false;
+
+    if (f_open(&journal_fp, RECORD_JOURNAL_PATH, FA_OPEN_ALWAYS | FA_READ | FA_WRITE) != FR_OK)
+    {
+        return;
+    }
+
+    if (f_size(&journal_fp) < sizeof(journal.sector))
+    {
+        memset(&journal, 0, sizeof(journal));
+        journal.entry.magic = RECORD_JOURNAL_MAGIC;
+        journal.entry.version = RECORD_JOURNAL_VERSION;
+
+        if ((f_write(&journal_fp, journal.sector, sizeof(journal.sector), &count) != FR_OK) ||
+            (count != sizeof(journal.sector)) || (f_sync(&journal_fp) != FR_OK))
+        {
+            LOG_ERROR("Error creating the record journal!\n\r");
+            f_close(&journal_fp);
+            return;
+        }
+        f_chmod(RECORD_JOURNAL_PATH, AM_HID, AM_HID);
+    }
+
+    journal_is_open = true;
+}
+
+/*******************************************************************************
+* Function Name: record_journal_begin
+********************************************************************************
+* Summary:
+*   Name the record in the journal before its first audio is written.
+*
+* Parameters:
+*   name = path of the record
+*   is_prealloc = the record has a reserved area, so its file size tells
+*                 nothing about the audio written
+*   size = size of the record, its header
+*
+*******************************************************************************/
+void record_journal_begin(const char *name, bool is_prealloc, FSIZE_t size)
+{
+    memset(&journal, 0, sizeof(journal));
+    journal.entry.state = RECORD_JOURNAL_OPEN;
+    journal.entry.is_prealloc = is_prealloc;
+    journal.entry.size = size;
+    strncpy(journal.entry.name, name, sizeof(journal.entry.name) - 1u);
+
+    record_journal_write();
+}
+
+/*******************************************************************************
+* Function Name: record_journal_commit
+********************************************************************************
+* Summary:
+*   Record the size of the audio synced to the memory, for a preallocated
+*   record. The others have it in their directory entry.
+*
+* Parameters:
+*   size = size of the record
+*
+*******************************************************************************/
+void record_journal_commit(FSIZE_t size)
+{
+    if (journal.entry.state == RECORD_JOURNAL_OPEN)
+    {
+        journal.entry.size = size;
+        record_journal_write();
+    }
+}
+
+/*******************************************************************************
+* Function Name: record_journal_end
+********************************************************************************
+* Summary:
+*   Close the entry of the record, once it is saved or closed on an error.
+*
+*******************************************************************************/
+void record_journal_end(void)
+{
+    if (journal.entry.state == RECORD_JOURNAL_OPEN)
+    {
+        journal.entry.state = RECORD_JOURNAL_CLOSED;
+        record_journal_write();
+    }
+}
+
+/*******************************************************************************
+* Function Name: record_journal_window
+********************************************************************************
+* Summary:
+*   Give the data of the file from a position, reading it again if the window
+*   does not hold AUDIO_ENC_CHECK_SIZE bytes from there.
+*
+* Parameters:
+*   win = file window
+*   pos = position in the file
+*   len = bytes available from pos, set on return
+*
+* Return:
+*   Pointer to the data at pos.
+*
+*******************************************************************************/
+static const uint8_t *record_journal_window(record_journal_window_t *win, FSIZE_t pos, uint32_t *len)
+{
+    UINT count = 0;
+
+    if ((pos < win->start) || ((pos + AUDIO_ENC_CHECK_SIZE) > (win->start + win->len)))
+    {
+        win->start = pos;
+        win->len = 0;
+        if ((f_lseek(win->fp, pos) == FR_OK) && (f_read(win->fp, win->buf, win->size, &count) == FR_OK))
+        {
+            win->len = count;
+        }
+    }
+
+    *len = (uint32_t) ((win->start + win->len) - pos);
+    return &win->buf[pos - win->start];
+}
+
+/*******************************************************************************
+* Function Name: record_journal_scan
+********************************************************************************
+* Summary:
+*   Find the end of the valid audio of an encoded record: from two units
+*   before the committed size, find a valid unit (FLAC frame or IMA-ADPCM
+*   block), then follow the units as long as they are valid. The commit may
+*   cut a unit and the header of the next one, which leaves only the unit
+*   before them to be confirmed.
+*
+* Parameters:
+*   enc = encoder state, from the record header
+*   win = file window
+*   data_start = size of the header
+*   committed = committed size of the record
+*   limit = end of the data to check
+*
+* Return:
+*   End of the valid audio.
+*
+*******************************************************************************/
+static FSIZE_t record_journal_scan(audio_enc_t *enc, record_journal_window_t *win, FSIZE_t data_start,
+                                   FSIZE_t committed, FSIZE_t limit)
+{
+    FSIZE_t pos;
+    FSIZE_t search_end;
+    FSIZE_t end;
+    const uint8_t *data;
+    uint32_t step = (enc->format == AUDIO_ENC_IMA_ADPCM) ? enc->block_align : 1u;
+    uint32_t len;
+    uint32_t size = 0;
+
+    /* The blocks before the committed size are kept */
+    pos = (committed > (data_start + (2u * AUDIO_ENC_CHECK_SIZE))) ? (committed - (2u * AUDIO_ENC_CHECK_SIZE)) :
+                                                                     data_start;
+    pos = data_start + (((pos - data_start) / step) * step);
+    end = (enc->format == AUDIO_ENC_IMA_ADPCM) ? (data_start + (((committed - data_start) / step) * step)) :
+                                                 data_start;
+
+    /* First valid unit */
+    for (search_end = pos + (2u * AUDIO_ENC_CHECK_SIZE); (pos < search_end) && (pos < limit); pos += step)
+    {
+        data = record_journal_window(win, pos, &len);
+        len = ((pos + len) > limit) ? (uint32_t) (limit - pos) : len;
+        size = audio_enc_check(enc, (uint32_t) (pos - data_start), data, len);
+        if (size > 0u)
+        {
+            break;
+        }
+    }
+
+    /* Following units */
+    while (size > 0u)
+    {
+        pos += size;
+        end = (pos > end) ? pos : end;
+
+        data = record_journal_window(win, pos, &len);
+        len = ((pos + len) > limit) ? (uint32_t) (limit - pos) : len;
+        size = (pos < limit) ? audio_enc_check(enc, (uint32_t) (pos - data_start), data, len) : 0u;
+    }
+
+    return end;
+}
+
+/*******************************************************************************
+* Function Name: record_journal_fix
+********************************************************************************
+* Summary:
+*   Complete the record left open by a reset. Its clusters written after the
+*   last commit are taken back by extending the file over them, which works
+*   when the record was written contiguously, as usual. The audio found valid
+*   is kept, the rest is released, and the header is written with the final
+*   sizes.
+*
+* Parameters:
+*   entry = journal entry of the record
+*   work = work area, RECORD_JOURNAL_WORK_SIZE bytes
+*
+*******************************************************************************/
+static void record_journal_fix(const record_journal_entry_t *entry, uint8_t *work)
+{
+    audio_enc_t *enc = (audio_enc_t *) work;
+    record_journal_window_t win;
+    audio_enc_format_t format = AUDIO_ENC_RAW;
+    const char *ext = strrchr(entry->name, '.');
+    FSIZE_t committed;
+    FSIZE_t limit;
+    FSIZE_t end;
+    uint32_t data_start = 0;
+    uint8_t header[AUDIO_ENC_HEADER_SIZE_MAX];
+    uint32_t len;
+    UINT count = 0;
+    FIL fp;
+
+    if (f_open(&fp, entry->name, FA_OPEN_EXISTING | FA_READ | FA_WRITE) != FR_OK)
+    {
+        return;
+    }
+
+    win.fp = &fp;
+    win.buf = &work[(sizeof(audio_enc_t) + 3u) & ~3u];
+    win.size = RECORD_JOURNAL_WORK_SIZE - ((sizeof(audio_enc_t) + 3u) & ~3u);
+    win.start = 0;
+    win.len = 0;
+
+    while ((ext != NULL) && (format < AUDIO_ENC_NUM) && (strcmp(ext + 1, audio_enc_ext(format)) != 0))
+    {
+        format++;
+    }
+
+    if ((format != AUDIO_ENC_RAW) && (format < AUDIO_ENC_NUM))
+    {
+        (void) f_read(&fp, header, sizeof(header), &count);
+        data_start = audio_enc_parse_header(enc, format, header, count);
+        if (data_start == 0u)
+        {
+            LOG_WARN("Unknown header in %s\n\r", entry->name);
+            f_close(&fp);
+            return;
+        }
+    }
+
+    /* The size synced to the memory, then the data written after it */
+    committed = (entry->is_prealloc) ? entry->size : f_size(&fp);
+    committed = (committed < data_start) ? data_start : committed;
+    limit = committed + RECORD_JOURNAL_SCAN_SIZE;
+    if ((format != AUDIO_ENC_RAW) && (limit > f_size(&fp)))
+    {
+        /* The FAT links written after the commit may lead to clusters the
+         * reset left free: the chain is cut at the committed size first */
+        if ((f_lseek(&fp, committed - 1u) == FR_OK) && (f_truncate(&fp) == FR_OK))
+        {
+            (void) f_lseek(&fp, limit);
+        }
+    }
+    limit = (limit < f_size(&fp)) ? limit : f_size(&fp);
+
+    if ((format == AUDIO_ENC_RAW) || (format >= AUDIO_ENC_NUM))
+    {
+        /* Raw samples cannot be checked, the committed ones are kept */
+        end = committed & ~(FSIZE_t) 3u;
+    }
+    else
+    {
+        end = record_journal_scan(enc, &win, data_start, committed, limit);
+        if (format == AUDIO_ENC_IMA_ADPCM)
+        {
+            enc->data_size = (uint32_t) (end - data_start);
+            enc->frames = (enc->data_size / enc->block_align) * enc->block_frames;
+        }
+    }
+
+    if ((f_lseek(&fp, end) != FR_OK) || (f_truncate(&fp) != FR_OK))
+    {
+        LOG_ERROR("Error truncating %s\n\r", entry->name);
+    }
+
+    len = (data_start > 0u) ? audio_enc_header(enc, header) : 0u;
+    if ((len > 0u) &&
+        ((f_lseek(&fp, 0) != FR_OK) || (f_write(&fp, header, len, &count) != FR_OK) || (count != len)))
+    {
+        LOG_ERROR("Error writing the header of %s\n\r", entry->name);
+    }
+
+    if (f_close(&fp) != FR_OK)
+    {
+        LOG_ERROR("Error closing %s\n\r", entry->name);
+        return;
+    }
+
+    /* A record with audio is shown, an empty one is left to be deleted */
+    if (end > data_start)
+    {
+        f_chmod(entry->name, 0, AM_HID);
+    }
+
+    LOG_INFO("Recovered %s: %lu KB\n\r", entry->name, (unsigned long) ((end - data_start) >> 10));
+}
+
+/*******************************************************************************
+* Function Name: record_journal_recover
+********************************************************************************
+* Summary:
+*   Complete the record left open by a reset, if the journal names one. Must
+*   run after the mount and before any cluster is allocated, so the clusters
+*   written after the last commit are still free.
+*
+* Parameters:
+*   work = work area
+*   size = size of the work area, at least RECORD_JOURNAL_WORK_SIZE
+*
+*******************************************************************************/
+void record_journal_recover(uint8_t *work, uint32_t size)
+{
+    UINT count = 0;
+
+    journal_is_open = false;
+    memset(&journal, 0, sizeof(journal));
+
+    if (f_open(&journal_fp, RECORD_JOURNAL_PATH, FA_OPEN_EXISTING | FA_READ | FA_WRITE) != FR_OK)
+    {
+        return;
+    }
+    journal_is_open = true;
+
+    if ((f_read(&journal_fp, journal.sector, sizeof(journal.sector), &count) != FR_OK) ||
+        (count < sizeof(journal.entry)) || (journal.entry.magic != RECORD_JOURNAL_MAGIC) ||
+        (journal.entry.version != RECORD_JOURNAL_VERSION) || (journal.entry.state != RECORD_JOURNAL_OPEN))
+    {
+        memset(&journal, 0, sizeof(journal));
+        return;
+    }
+
+    /* Without its work area, the record is left open for the next boot */
+    if ((work == NULL) || (size < RECORD_JOURNAL_WORK_SIZE))
+    {
+        LOG_WARN("Can't recover %s\n\r", journal.entry.name);
+        memset(&journal, 0, sizeof(journal));
+        return;
+    }
+
+    journal.entry.name[sizeof(journal.entry.name) - 1u] = '\0';
+    record_journal_fix(&journal.entry, work);
+    record_journal_end();
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,81 @@
+/*****************************************************************************
+* File Name: record_journal.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the record_journal.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef RECORD_JOURNAL_H_
+#define RECORD_JOURNAL_H_
+
+#include "ff.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Journal of the record being written, hidden in the records folder */
+#define RECORD_JOURNAL_FILE_NAME    "journal.bin"
+#define RECORD_JOURNAL_MAGIC        0x4C4E524Au     /* "JRNL" */
+#define RECORD_JOURNAL_VERSION      1u
+
+/* Audio written to an encoded record between two commits. Its frames are
+ * checked by the recovery, so a reset loses little of it */
+#define RECORD_JOURNAL_COMMIT_SIZE  (256u * 1024u)
+
+/* Data checked past the last commit: the commit interval, and a write in
+ * progress */
+#define RECORD_JOURNAL_SCAN_SIZE    (RECORD_JOURNAL_COMMIT_SIZE + (64u * 1024u))
+
+/* Work area of the recovery: an encoder state and a window of the file */
+#define RECORD_JOURNAL_WORK_SIZE    (32u * 1024u)
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void record_journal_mount(void);
+void record_journal_recover(uint8_t *work, uint32_t size);
+void record_journal_begin(const char *name, bool is_prealloc, FSIZE_t size);
+void record_journal_commit(FSIZE_t size);
+void record_journal_end(void);
+
+#endif /* RECORD_JOURNAL_H_ */
+
+/* [] END OF FILE */
@@ -49,12 +49,16 @@
 ***************************************/
 #define RTOS_STACK_DEPTH    1024u
 #define RTOS_TASK_PRIORITY  1u
+#define RTOS_LOG_TASK_PRIORITY  (tskIDLE_PRIORITY)
+#define RTOS_QSPI_TASK_PRIORITY (tskIDLE_PRIORITY)
 
 /***************************************
 *    Task Handlers
 ***************************************/
 extern TaskHandle_t rtos_usb_task;
 extern TaskHandle_t rtos_audio_task;
+extern TaskHandle_t rtos_log_task;
+extern TaskHandle_t rtos_qspi_task;
 
 /***************************************
 *    Semaphore Handlers
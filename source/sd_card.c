@@ -39,6 +39,8 @@
 * so agrees to indemnify Cypress against all liability.
 *****************************************************************************/
 #include "sd_card.h"
+#include "stats.h"
+#include "trace.h"
 #include "cy_utils.h"
 #include "cyhal.h"
 #include "cycfg.h"
@@ -128,24 +130,24 @@ cy_rslt_t sd_card_init(void)
 * Function Name: sd_card_sector_size
 ********************************************************************************
 * Summary:
-*  Get the sector size of SD card.
+*  Get the logical block size of the SD card.
 *
 *******************************************************************************/
 uint32_t sd_card_sector_size(void)
 {
-    return CY_SD_HOST_BLOCK_SIZE;
+    return STORAGE_BLOCK_SIZE;
 }
 
 /*******************************************************************************
 * Function Name: sd_card_max_sector_num
 ********************************************************************************
 * Summary:
-*  Get the SD card maximum number of the sectors.
+*  Get the SD card maximum number of the logical blocks.
 *
 *******************************************************************************/
 uint32_t sd_card_max_sector_num(void)
 {
-    return sdhc_obj.context.maxSectorNum;
+    return sdhc_obj.context.maxSectorNum / SD_CARD_SECTORS_PER_BLOCK;
 }
 
 /*******************************************************************************
@@ -168,9 +170,9 @@ uint64_t sd_card_total_mem_bytes(void)
 *  Read data from SD card.
 *
 * Parameters:
-*  address The address to read data from
+*  address The logical block to read data from
 *  data    Pointer to the byte-array where data read from the device should be stored
-*  length  Number of 512 byte blocks to read, updated with the number actually read
+*  length  Number of logical blocks to read, updated with the number actually read
 *
 * Return:
 *  CY_RSLT_SUCCESS if successful.
@@ -178,12 +180,19 @@ uint64_t sd_card_total_mem_bytes(void)
 cy_rslt_t sd_card_read(uint32_t address, uint8_t *data, uint32_t *length)
 {
     cy_rslt_t result;
+    uint32_t start;
+    size_t sectors = (size_t) *length * SD_CARD_SECTORS_PER_BLOCK;
 
     if(!sd_card_is_connected()) {
         return CY_RSLT_TYPE_ERROR;
     }
     
-    result = cyhal_sdhc_read(&sdhc_obj, address, data, (size_t *)length);
+    TRACE_BEGIN(TRACE_ID_SD_READ, sectors);
+    start = stats_timestamp();
+    result = cyhal_sdhc_read(&sdhc_obj, address * SD_CARD_SECTORS_PER_BLOCK, data, &sectors);
+    stats_sd_record(STATS_SD_READ, start, sectors);
+    TRACE_END(TRACE_ID_SD_READ, sectors);
+    *length = sectors / SD_CARD_SECTORS_PER_BLOCK;
     if (result != CY_RSLT_SUCCESS) {
         return result;
     }
@@ -197,9 +206,9 @@ cy_rslt_t sd_card_read(uint32_t address, uint8_t *data, uint32_t *length)
 *  Write data to SD card.
 *
 * Parameters:
-*  address The address to write data to
+*  address The logical block to write data to
 *  data    Pointer to the byte-array of data to write to the device
-*  length  Number of 512 byte blocks to write, updated with the number actually written
+*  length  Number of logical blocks to write, updated with the number actually written
 *
 * Return:
 *  CY_RSLT_SUCCESS if successful.
@@ -207,12 +216,19 @@ cy_rslt_t sd_card_read(uint32_t address, uint8_t *data, uint32_t *length)
 cy_rslt_t sd_card_write(uint32_t address, const uint8_t *data, uint32_t *length)
 {
     cy_rslt_t result;
+    uint32_t start;
+    size_t sectors = (size_t) *length * SD_CARD_SECTORS_PER_BLOCK;
 
     if(!sd_card_is_connected()) {
         return CY_RSLT_TYPE_ERROR;
     }
 
-    result = cyhal_sdhc_write(&sdhc_obj, address, data, (size_t *)length);
+    TRACE_BEGIN(TRACE_ID_SD_WRITE, sectors);
+    start = stats_timestamp();
+    result = cyhal_sdhc_write(&sdhc_obj, address * SD_CARD_SECTORS_PER_BLOCK, data, &sectors);
+    stats_sd_record(STATS_SD_WRITE, start, sectors);
+    TRACE_END(TRACE_ID_SD_WRITE, sectors);
+    *length = sectors / SD_CARD_SECTORS_PER_BLOCK;
     if (result != CY_RSLT_SUCCESS) {
         return result;
     }
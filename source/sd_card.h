@@ -45,6 +45,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "cyhal.h"
+#include "storage.h"
+
+#define SD_CARD_SECTOR_SIZE         512u
+#define SD_CARD_SECTORS_PER_BLOCK   (STORAGE_BLOCK_SIZE / SD_CARD_SECTOR_SIZE)
 
 bool sd_card_is_connected(void);
 cy_rslt_t sd_card_init(void);
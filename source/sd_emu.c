@@ -0,0 +1,271 @@
+/*****************************************************************************
+* File Name: sd_emu.c
+*
+* Description:
+*  This file contains the SD card latency emulator. It delays the commands
+*  passed to the device below as a card of the selected profile would, to
+*  reproduce the write stalls of the cards with a fast or simulated device.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "sd_emu.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define SD_EMU_NO_AU            0xFFFFFFFFu
+#define SD_EMU_SECTOR_SIZE      512u
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+/* Effective figures on the 4-bit 50-MHz bus of the kit */
+const sd_emu_profile_t sd_emu_profiles[SD_EMU_PROFILE_NUM] =
+{
+    [SD_EMU_FAST] =
+    {
+        .name = "fast", .cmd_us = 100, .read_kbps = 20000, .write_kbps = 16000,
+        .au_size = 4u * 1024u * 1024u, .au_penalty_us = 1000,
+        .gc_chance = 32, .gc_min_us = 10000, .gc_max_us = 60000,
+    },
+    [SD_EMU_TYPICAL] =
+    {
+        .name = "typical", .cmd_us = 250, .read_kbps = 18000, .write_kbps = 10000,
+        .au_size = 4u * 1024u * 1024u, .au_penalty_us = 4000,
+        .gc_chance = 128, .gc_min_us = 40000, .gc_max_us = 250000,
+    },
+    [SD_EMU_SLOW] =
+    {
+        .name = "slow", .cmd_us = 600, .read_kbps = 10000, .write_kbps = 4000,
+        .au_size = 4u * 1024u * 1024u, .au_penalty_us = 15000,
+        .gc_chance = 384, .gc_min_us = 100000, .gc_max_us = 700000,
+    },
+};
+
+/*******************************************************************************
+* Function Name: sd_emu_random
+********************************************************************************
+* Summary:
+*   Next value of the xorshift generator of the emulator.
+*
+*******************************************************************************/
+static uint32_t sd_emu_random(sd_emu_t *emu)
+{
+    uint32_t x = emu->random;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    emu->random = x;
+    return x;
+}
+
+/*******************************************************************************
+* Function Name: sd_emu_transfer_us
+********************************************************************************
+* Summary:
+*   Time of a command transferring some bytes at a bandwidth in KB/s.
+*
+*******************************************************************************/
+static uint32_t sd_emu_transfer_us(const sd_emu_profile_t *profile, uint64_t bytes, uint32_t kbps)
+{
+    return profile->cmd_us + (uint32_t) ((bytes * 1000000u) / ((uint64_t) kbps * 1024u));
+}
+
+/*******************************************************************************
+* Function Name: sd_emu_wait
+********************************************************************************
+* Summary:
+*   Account and wait for the time of a command.
+*
+*******************************************************************************/
+static void sd_emu_wait(sd_emu_t *emu, uint32_t us)
+{
+    emu->time_us += us;
+    if (us > emu->time_max_us)
+    {
+        emu->time_max_us = us;
+    }
+    if (emu->delay != NULL)
+    {
+        emu->delay(us);
+    }
+}
+
+/*******************************************************************************
+* Function Name: sd_emu_stall_us
+********************************************************************************
+* Summary:
+*   Stall added to a write: the next stall of the trace, or the AU change
+*   and garbage collection of the model.
+*
+*******************************************************************************/
+static uint32_t sd_emu_stall_us(sd_emu_t *emu, uint32_t block, uint32_t block_size)
+{
+    const sd_emu_profile_t *profile = emu->profile;
+    const sd_emu_sample_t *sample;
+    uint32_t model;
+    uint32_t au;
+    uint32_t stall = 0;
+
+    if (profile->trace_num != 0)
+    {
+        sample = &profile->trace[emu->trace_index];
+        emu->trace_index = (emu->trace_index + 1u) % profile->trace_num;
+        model = sd_emu_transfer_us(profile, (uint64_t) sample->sectors * SD_EMU_SECTOR_SIZE, profile->write_kbps);
+        return (sample->time_us > model) ? (sample->time_us - model) : 0u;
+    }
+
+    au = (uint32_t) (((uint64_t) block * block_size) / profile->au_size);
+    if ((emu->au != SD_EMU_NO_AU) && (au != emu->au))
+    {
+        stall += profile->au_penalty_us;
+    }
+    emu->au = au;
+
+    if ((sd_emu_random(emu) & 0xFFFFu) < profile->gc_chance)
+    {
+        stall += profile->gc_min_us + (sd_emu_random(emu) % (profile->gc_max_us - profile->gc_min_us + 1u));
+    }
+
+    return stall;
+}
+
+/*******************************************************************************
+* Function Name: sd_emu_read
+********************************************************************************
+* Summary:
+*   Read from the device below, then wait for the read time of the card.
+*
+*******************************************************************************/
+static blk_dev_result_t sd_emu_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    sd_emu_t *emu = (sd_emu_t *) dev;
+    blk_dev_result_t result = blk_dev_read(dev->lower, block, buf, count);
+
+    sd_emu_wait(emu, sd_emu_transfer_us(emu->profile, (uint64_t) *count * blk_dev_block_size(dev->lower),
+                                        emu->profile->read_kbps));
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: sd_emu_write
+********************************************************************************
+* Summary:
+*   Write to the device below, then wait for the write time of the card with
+*   its stalls.
+*
+*******************************************************************************/
+static blk_dev_result_t sd_emu_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    sd_emu_t *emu = (sd_emu_t *) dev;
+    uint32_t block_size = blk_dev_block_size(dev->lower);
+    blk_dev_result_t result = blk_dev_write(dev->lower, block, buf, count);
+    uint32_t stall = sd_emu_stall_us(emu, block, block_size);
+
+    emu->writes++;
+    if (stall != 0)
+    {
+        emu->stalls++;
+    }
+    sd_emu_wait(emu, stall + sd_emu_transfer_us(emu->profile, (uint64_t) *count * block_size,
+                                                emu->profile->write_kbps));
+    return result;
+}
+
+static const blk_dev_ops_t sd_emu_ops =
+{
+    .read = sd_emu_read,
+    .write = sd_emu_write,
+};
+
+/*******************************************************************************
+* Function Name: sd_emu_init
+********************************************************************************
+* Summary:
+*   Stack a latency emulator stage.
+*
+* Parameters:
+*  emu: stage
+*  lower: device below, holding the data
+*  profile: card model, a preset or a measured trace
+*  delay: waits for the time of each command, NULL to only account it
+*  seed: seed of the garbage collections, not 0
+*
+* Return:
+*   The stage.
+*
+*******************************************************************************/
+blk_dev_t *sd_emu_init(sd_emu_t *emu, blk_dev_t *lower, const sd_emu_profile_t *profile,
+                       sd_emu_delay_t delay, uint32_t seed)
+{
+    memset(emu, 0, sizeof(*emu));
+    emu->dev.ops = &sd_emu_ops;
+    emu->dev.lower = lower;
+    emu->profile = profile;
+    emu->delay = delay;
+    emu->random = (seed != 0) ? seed : 1u;
+    emu->au = SD_EMU_NO_AU;
+    return &emu->dev;
+}
+
+/*******************************************************************************
+* Function Name: sd_emu_find_profile
+********************************************************************************
+* Summary:
+*   Find a preset by name.
+*
+* Return:
+*   The preset, NULL if not found.
+*
+*******************************************************************************/
+const sd_emu_profile_t *sd_emu_find_profile(const char *name)
+{
+    uint32_t index;
+
+    for (index = 0; index < SD_EMU_PROFILE_NUM; index++)
+    {
+        if (strcmp(sd_emu_profiles[index].name, name) == 0)
+        {
+            return &sd_emu_profiles[index];
+        }
+    }
+    return NULL;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,121 @@
+/*****************************************************************************
+* File Name: sd_emu.h
+*
+* Description:
+*  This file contains the SD card latency emulator, a block device stage
+*  adding the delays of a card model to the device below.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef SD_EMU_H_
+#define SD_EMU_H_
+
+#include "blk_dev.h"
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Card profile presets, selected with SD_EMU in the Makefile */
+typedef enum
+{
+    SD_EMU_FAST = 0,            /* Recent A1/A2 card, rare short stalls */
+    SD_EMU_TYPICAL,             /* Class 10 card */
+    SD_EMU_SLOW,                /* Low-end card, long garbage collections */
+    SD_EMU_PROFILE_NUM
+} sd_emu_preset_t;
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Write measured on a card, see "trace_to_chrome.py --sd-writes" */
+typedef struct
+{
+    uint32_t sectors;           /* 512-byte sectors written */
+    uint32_t time_us;
+} sd_emu_sample_t;
+
+/* Card latency model. A command costs cmd_us plus its transfer at the read
+*  or write bandwidth. A write starting in another allocation unit than the
+*  previous one costs au_penalty_us more, and a write can trigger a garbage
+*  collection pause. With a trace, the stalls of the measured writes (their
+*  time above the model) are replayed in turn instead of the AU and GC ones. */
+typedef struct
+{
+    const char *name;
+    uint32_t cmd_us;
+    uint32_t read_kbps;         /* KB/s */
+    uint32_t write_kbps;        /* KB/s */
+    uint32_t au_size;           /* Bytes */
+    uint32_t au_penalty_us;
+    uint32_t gc_chance;         /* Per write, in 1/65536 */
+    uint32_t gc_min_us;
+    uint32_t gc_max_us;
+    const sd_emu_sample_t *trace;
+    uint32_t trace_num;
+} sd_emu_profile_t;
+
+/* Wait for a number of microseconds, or advance a simulated clock */
+typedef void (*sd_emu_delay_t)(uint32_t us);
+
+/* Latency emulator stage */
+typedef struct
+{
+    blk_dev_t dev;
+    const sd_emu_profile_t *profile;
+    sd_emu_delay_t delay;
+    uint32_t random;
+    uint32_t au;                /* AU of the last write */
+    uint32_t trace_index;
+    uint32_t writes;
+    uint32_t stalls;            /* AU, GC and trace stalls */
+    uint32_t time_max_us;       /* Longest command */
+    uint64_t time_us;           /* Total emulated time */
+} sd_emu_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+extern const sd_emu_profile_t sd_emu_profiles[SD_EMU_PROFILE_NUM];
+
+/*******************************************************************************
+* Function prototypes
+********************************************************************************/
+blk_dev_t *sd_emu_init(sd_emu_t *emu, blk_dev_t *lower, const sd_emu_profile_t *profile,
+                       sd_emu_delay_t delay, uint32_t seed);
+const sd_emu_profile_t *sd_emu_find_profile(const char *name);
+
+#endif /* SD_EMU_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,557 @@
+/*****************************************************************************
+* File Name: stats.c
+*
+* Description:
+*  This file provides the source code to collect the runtime performance
+*  counters and render them as text for the STATS virtual file.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "stats.h"
+#include "virt_file.h"
+#include "buf_arena.h"
+#include "storage.h"
+#include "cy_pdl.h"
+
+#include "rtos.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define STATS_SCSI_OTHER            (sizeof(scsi_opcodes))
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef struct
+{
+    uint32_t count;
+    uint32_t total_us;
+    uint32_t max_us;
+} stats_latency_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t blocks;
+    uint32_t max_us;
+    uint32_t hist[STATS_SD_BUCKETS];
+} stats_sd_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+/* SCSI commands tracked individually, any other is accounted as "other" */
+static const uint8_t scsi_opcodes[] =
+{
+    0x00, 0x03, 0x04, 0x12, 0x15, 0x1A, 0x1B, 0x1E,
+    0x23, 0x25, 0x28, 0x2A, 0x2F, 0x55, 0x5A
+};
+
+static stats_latency_t scsi_stats[sizeof(scsi_opcodes) + 1];
+static uint32_t scsi_start;
+static uint64_t msc_read_bytes;
+static uint64_t msc_write_bytes;
+
+static stats_sd_t sd_stats[STATS_SD_NUM];
+
+static uint32_t pcm_blocks;
+static uint32_t pcm_overruns;
+static uint32_t pcm_occupancy_max;
+
+static stats_latency_t fs_mutex_stats;
+static uint32_t fs_mutex_start;
+
+/* Extension of the 32-bit cycle counter for the run time counter */
+static uint32_t run_time_last;
+static uint32_t run_time_high;
+
+/* Double buffered text, the USB reads the one not being rendered */
+static char stats_text[2][STATS_FILE_SIZE];
+static volatile uint8_t stats_text_index = 0;
+
+/*******************************************************************************
+* Function Name: stats_init
+********************************************************************************
+* Summary:
+*   Enable the cycle counter and register the statistics virtual file.
+*
+*******************************************************************************/
+void stats_init(void)
+{
+    stats_run_time_init();
+
+    memset(stats_text, ' ', sizeof(stats_text));
+
+    virt_file_register(STATS_FILE_NAME, STATS_FILE_SIZE, stats_read);
+}
+
+/*******************************************************************************
+* Function Name: stats_run_time_init
+********************************************************************************
+* Summary:
+*   Enable the DWT cycle counter. Also used by FreeRTOS for the run time
+*   statistics.
+*
+*******************************************************************************/
+void stats_run_time_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/*******************************************************************************
+* Function Name: stats_run_time
+********************************************************************************
+* Summary:
+*   Return the run time counter used by FreeRTOS. The cycle counter is
+*   extended to 64-bit, which only requires a context switch every ~40 s.
+*
+*******************************************************************************/
+uint32_t stats_run_time(void)
+{
+    uint32_t now = DWT->CYCCNT;
+
+    if (now < run_time_last)
+    {
+        run_time_high++;
+    }
+    run_time_last = now;
+
+    return (uint32_t) (((((uint64_t) run_time_high) << 32) | now) >> STATS_RUN_TIME_SHIFT);
+}
+
+/*******************************************************************************
+* Function Name: stats_timestamp
+********************************************************************************
+* Summary:
+*   Return the current cycle count.
+*
+*******************************************************************************/
+uint32_t stats_timestamp(void)
+{
+    return DWT->CYCCNT;
+}
+
+/*******************************************************************************
+* Function Name: stats_cycles_to_us
+********************************************************************************
+* Summary:
+*   Convert a number of CPU cycles to microseconds.
+*
+*******************************************************************************/
+uint32_t stats_cycles_to_us(uint32_t cycles)
+{
+    return cycles / (SystemCoreClock / 1000000u);
+}
+
+/*******************************************************************************
+* Function Name: stats_latency_add
+********************************************************************************
+* Summary:
+*   Account a latency sample.
+*
+*******************************************************************************/
+static void stats_latency_add(stats_latency_t *stats, uint32_t us)
+{
+    stats->count++;
+    stats->total_us += us;
+    if (us > stats->max_us)
+    {
+        stats->max_us = us;
+    }
+}
+
+/*******************************************************************************
+* Function Name: stats_scsi_begin
+********************************************************************************
+* Summary:
+*   Start timing a SCSI command. Called when the CBW is received.
+*
+*******************************************************************************/
+void stats_scsi_begin(uint8_t opcode)
+{
+    (void) opcode;
+
+    scsi_start = stats_timestamp();
+}
+
+/*******************************************************************************
+* Function Name: stats_scsi_end
+********************************************************************************
+* Summary:
+*   Account a completed SCSI command. Called when the CSW is sent.
+*
+* Parameters:
+*   opcode = SCSI operation code
+*   bytes = number of data bytes transferred
+*
+*******************************************************************************/
+void stats_scsi_end(uint8_t opcode, uint32_t bytes)
+{
+    uint32_t us = stats_cycles_to_us(stats_timestamp() - scsi_start);
+    uint32_t index;
+
+    for (index = 0; index < sizeof(scsi_opcodes); index++)
+    {
+        if (scsi_opcodes[index] == opcode)
+        {
+            break;
+        }
+    }
+
+    stats_latency_add(&scsi_stats[index], us);
+
+    if (opcode == 0x28)
+    {
+        msc_read_bytes += bytes;
+    }
+    else if (opcode == 0x2A)
+    {
+        msc_write_bytes += bytes;
+    }
+}
+
+/*******************************************************************************
+* Function Name: stats_sd_record
+********************************************************************************
+* Summary:
+*   Account a SD card transfer. Can be called from tasks and interrupts.
+*
+* Parameters:
+*   op = read or write
+*   start = timestamp when the transfer started
+*   blocks = number of blocks transferred
+*
+*******************************************************************************/
+void stats_sd_record(stats_sd_op_t op, uint32_t start, uint32_t blocks)
+{
+    uint32_t us = stats_cycles_to_us(stats_timestamp() - start);
+    uint32_t bucket = 0;
+    UBaseType_t state;
+
+    while (((us >> bucket) > 1u) && (bucket < (STATS_SD_BUCKETS - 1u)))
+    {
+        bucket++;
+    }
+
+    state = taskENTER_CRITICAL_FROM_ISR();
+
+    sd_stats[op].count++;
+    sd_stats[op].blocks += blocks;
+    sd_stats[op].hist[bucket]++;
+    if (us > sd_stats[op].max_us)
+    {
+        sd_stats[op].max_us = us;
+    }
+
+    taskEXIT_CRITICAL_FROM_ISR(state);
+}
+
+/*******************************************************************************
+* Function Name: stats_pcm_block
+********************************************************************************
+* Summary:
+*   Account a PCM block captured by the recorder. Called from the PDM/PCM
+*   interrupt.
+*
+* Parameters:
+*   filled = number of blocks waiting to be written
+*   overrun = true if the block was dropped
+*
+*******************************************************************************/
+void stats_pcm_block(uint32_t filled, bool overrun)
+{
+    pcm_blocks++;
+
+    if (overrun)
+    {
+        pcm_overruns++;
+    }
+
+    if (filled > pcm_occupancy_max)
+    {
+        pcm_occupancy_max = filled;
+    }
+}
+
+/*******************************************************************************
+* Function Name: stats_fs_mutex_taken
+********************************************************************************
+* Summary:
+*   Start timing the file system mutex hold time.
+*
+*******************************************************************************/
+void stats_fs_mutex_taken(void)
+{
+    fs_mutex_start = stats_timestamp();
+}
+
+/*******************************************************************************
+* Function Name: stats_fs_mutex_given
+********************************************************************************
+* Summary:
+*   Account the file system mutex hold time.
+*
+*******************************************************************************/
+void stats_fs_mutex_given(void)
+{
+    stats_latency_add(&fs_mutex_stats, stats_cycles_to_us(stats_timestamp() - fs_mutex_start));
+}
+
+/*******************************************************************************
+* Function Name: stats_sd_percentile
+********************************************************************************
+* Summary:
+*   Return the upper bound in microseconds of the histogram bucket holding
+*   the given percentile.
+*
+*******************************************************************************/
+static uint32_t stats_sd_percentile(const stats_sd_t *stats, uint32_t percent)
+{
+    uint32_t target = ((stats->count * percent) + 99u) / 100u;
+    uint32_t sum = 0;
+    uint32_t bucket;
+
+    for (bucket = 0; bucket < STATS_SD_BUCKETS; bucket++)
+    {
+        sum += stats->hist[bucket];
+        if ((sum >= target) && (sum > 0))
+        {
+            break;
+        }
+    }
+
+    if (bucket >= STATS_SD_BUCKETS)
+    {
+        return 0;
+    }
+
+    return (2u << bucket);
+}
+
+/*******************************************************************************
+* Function Name: stats_print
+********************************************************************************
+* Summary:
+*   Append formatted text to the statistics buffer being rendered.
+*
+*******************************************************************************/
+static void stats_print(char *text, uint32_t *pos, const char *format, ...)
+{
+    va_list args;
+    int len;
+
+    if (*pos >= (STATS_FILE_SIZE - 1u))
+    {
+        return;
+    }
+
+    va_start(args, format);
+    len = vsnprintf(&text[*pos], STATS_FILE_SIZE - *pos, format, args);
+    va_end(args);
+
+    if (len > 0)
+    {
+        *pos += (uint32_t) len;
+        if (*pos > (STATS_FILE_SIZE - 1u))
+        {
+            *pos = STATS_FILE_SIZE - 1u;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: stats_update
+********************************************************************************
+* Summary:
+*   Render the statistics text. Must be called from a task, it switches the
+*   buffer served to the USB once completed.
+*
+*******************************************************************************/
+void stats_update(void)
+{
+    static TaskStatus_t tasks[STATS_MAX_TASKS];
+    static uint64_t last_read_bytes;
+    static uint64_t last_write_bytes;
+    static uint32_t last_time;
+    char *text = stats_text[stats_text_index ^ 1u];
+    const blk_dev_stats_t *fs_stats;
+    uint32_t pos = 0;
+    uint32_t total_time;
+    uint32_t num_tasks;
+    uint32_t now = xTaskGetTickCount();
+    uint32_t elapsed_ms = now - last_time;
+    uint32_t index;
+
+    if (elapsed_ms == 0)
+    {
+        elapsed_ms = 1;
+    }
+
+    stats_print(text, &pos, "uptime_s=%lu\r\n", (unsigned long) (now / configTICK_RATE_HZ));
+
+    /* Per task CPU share and stack high water marks */
+    num_tasks = uxTaskGetSystemState(tasks, STATS_MAX_TASKS, &total_time);
+    total_time /= 100u;
+    stats_print(text, &pos, "\r\n[tasks]\r\nname cpu_pct stack_free_words\r\n");
+    for (index = 0; index < num_tasks; index++)
+    {
+        stats_print(text, &pos, "%-16s %3lu %5u\r\n", tasks[index].pcTaskName,
+                    (unsigned long) ((total_time > 0) ? (tasks[index].ulRunTimeCounter / total_time) : 0),
+                    (unsigned) tasks[index].usStackHighWaterMark);
+    }
+
+    /* USB throughput */
+    stats_print(text, &pos, "\r\n[msc]\r\nread_bytes=%llu\r\nwrite_bytes=%llu\r\n"
+                            "read_bytes_per_s=%lu\r\nwrite_bytes_per_s=%lu\r\nmedia_buffer=%lu\r\n",
+                (unsigned long long) msc_read_bytes, (unsigned long long) msc_write_bytes,
+                (unsigned long) (((msc_read_bytes - last_read_bytes) * 1000u) / elapsed_ms),
+                (unsigned long) (((msc_write_bytes - last_write_bytes) * 1000u) / elapsed_ms),
+                (unsigned long) buf_arena_msc_size());
+    last_read_bytes = msc_read_bytes;
+    last_write_bytes = msc_write_bytes;
+    last_time = now;
+
+    /* SCSI commands */
+    stats_print(text, &pos, "\r\n[scsi]\r\nopcode count avg_us max_us\r\n");
+    for (index = 0; index <= sizeof(scsi_opcodes); index++)
+    {
+        const stats_latency_t *scsi = &scsi_stats[index];
+
+        if (scsi->count == 0)
+        {
+            continue;
+        }
+        if (index == STATS_SCSI_OTHER)
+        {
+            stats_print(text, &pos, "other");
+        }
+        else
+        {
+            stats_print(text, &pos, "0x%02X", scsi_opcodes[index]);
+        }
+        stats_print(text, &pos, " %lu %lu %lu\r\n", (unsigned long) scsi->count,
+                    (unsigned long) (scsi->total_us / scsi->count), (unsigned long) scsi->max_us);
+    }
+
+    /* SD card latency percentiles */
+    stats_print(text, &pos, "\r\n[sd]\r\nop count blocks p50_us p90_us p99_us max_us\r\n");
+    for (index = 0; index < STATS_SD_NUM; index++)
+    {
+        const stats_sd_t *sd = &sd_stats[index];
+
+        stats_print(text, &pos, "%s %lu %lu %lu %lu %lu %lu\r\n",
+                    (index == STATS_SD_READ) ? "read " : "write",
+                    (unsigned long) sd->count, (unsigned long) sd->blocks,
+                    (unsigned long) stats_sd_percentile(sd, 50),
+                    (unsigned long) stats_sd_percentile(sd, 90),
+                    (unsigned long) stats_sd_percentile(sd, 99),
+                    (unsigned long) sd->max_us);
+    }
+
+    /* Operations of FatFs reaching the storage */
+    fs_stats = storage_get_fs_stats();
+    if (fs_stats != NULL)
+    {
+        stats_print(text, &pos, "\r\n[fs_dev]\r\nop count blocks avg_us max_us\r\n");
+        stats_print(text, &pos, "read  %lu %llu %lu %lu\r\n", (unsigned long) fs_stats->read_ops,
+                    (unsigned long long) fs_stats->read_blocks,
+                    (unsigned long) ((fs_stats->read_ops > 0) ?
+                                     stats_cycles_to_us((uint32_t) (fs_stats->read_time / fs_stats->read_ops)) : 0),
+                    (unsigned long) stats_cycles_to_us(fs_stats->read_time_max));
+        stats_print(text, &pos, "write %lu %llu %lu %lu\r\n", (unsigned long) fs_stats->write_ops,
+                    (unsigned long long) fs_stats->write_blocks,
+                    (unsigned long) ((fs_stats->write_ops > 0) ?
+                                     stats_cycles_to_us((uint32_t) (fs_stats->write_time / fs_stats->write_ops)) : 0),
+                    (unsigned long) stats_cycles_to_us(fs_stats->write_time_max));
+        stats_print(text, &pos, "sync=%lu\r\nerrors=%lu\r\n", (unsigned long) fs_stats->sync_ops,
+                    (unsigned long) fs_stats->errors);
+    }
+
+    /* Recorder */
+    stats_print(text, &pos, "\r\n[recorder]\r\nblocks=%lu\r\noverruns=%lu\r\nring_occupancy_max=%lu\r\n",
+                (unsigned long) pcm_blocks, (unsigned long) pcm_overruns,
+                (unsigned long) pcm_occupancy_max);
+
+    /* File system mutex */
+    stats_print(text, &pos, "\r\n[fs_mutex]\r\ncount=%lu\r\navg_us=%lu\r\nmax_us=%lu\r\n",
+                (unsigned long) fs_mutex_stats.count,
+                (unsigned long) ((fs_mutex_stats.count > 0) ? (fs_mutex_stats.total_us / fs_mutex_stats.count) : 0),
+                (unsigned long) fs_mutex_stats.max_us);
+
+    /* Pad the file with spaces, terminated by a new line */
+    memset(&text[pos], ' ', STATS_FILE_SIZE - pos);
+    text[STATS_FILE_SIZE - 2u] = '\r';
+    text[STATS_FILE_SIZE - 1u] = '\n';
+
+    stats_text_index ^= 1u;
+}
+
+/*******************************************************************************
+* Function Name: stats_read
+********************************************************************************
+* Summary:
+*   Copy the statistics text. Called by the USB to serve the virtual file.
+*
+* Parameters:
+*   offset = offset in the file
+*   buf = destination buffer
+*   len = number of bytes
+*
+* Return:
+*   Number of bytes copied.
+*
+*******************************************************************************/
+uint32_t stats_read(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    if (offset >= STATS_FILE_SIZE)
+    {
+        return 0;
+    }
+
+    if (len > (STATS_FILE_SIZE - offset))
+    {
+        len = STATS_FILE_SIZE - offset;
+    }
+
+    memcpy(buf, &stats_text[stats_text_index][offset], len);
+
+    return len;
+}
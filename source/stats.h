@@ -0,0 +1,92 @@
+/*****************************************************************************
+* File Name: stats.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the stats.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Virtual file exposing the statistics on the drive */
+#define STATS_FILE_NAME             "STATS.TXT"
+#define STATS_FILE_SIZE             4096u
+
+/* Period to refresh the statistics text */
+#define STATS_UPDATE_MS             1000u
+
+/* Maximum number of tasks reported */
+#define STATS_MAX_TASKS             8u
+
+/* Run time counter is the cycle counter divided by 2^STATS_RUN_TIME_SHIFT */
+#define STATS_RUN_TIME_SHIFT        12u
+
+/* Number of log2 buckets of the SD latency histogram (1 us to 32 s) */
+#define STATS_SD_BUCKETS            26u
+
+typedef enum
+{
+    STATS_SD_READ = 0,
+    STATS_SD_WRITE,
+    STATS_SD_NUM
+} stats_sd_op_t;
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void     stats_init(void);
+void     stats_run_time_init(void);
+uint32_t stats_run_time(void);
+uint32_t stats_timestamp(void);
+uint32_t stats_cycles_to_us(uint32_t cycles);
+void     stats_scsi_begin(uint8_t opcode);
+void     stats_scsi_end(uint8_t opcode, uint32_t bytes);
+void     stats_sd_record(stats_sd_op_t op, uint32_t start, uint32_t blocks);
+void     stats_pcm_block(uint32_t filled, bool overrun);
+void     stats_fs_mutex_taken(void);
+void     stats_fs_mutex_given(void);
+void     stats_update(void);
+uint32_t stats_read(uint32_t offset, uint8_t *buf, uint32_t len);
+
+#endif /* STATS_H_ */
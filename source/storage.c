@@ -0,0 +1,377 @@
+/*****************************************************************************
+* File Name: storage.c
+*
+* Description:
+*  This file builds the block device stacks of the storage. The SD card, the
+*  QSPI flash and the RAM disk drivers are adapted as backends, and the stages
+*  of blk_dev.h are stacked on them here, for both the USB mass storage class
+*  and FatFs.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "storage.h"
+#if defined(SD_EMU)
+#include "sd_emu.h"
+#include "rtos.h"
+#include "cyhal.h"
+#endif
+#if (STORAGE_FS_STATS != 0)
+#include "stats.h"
+#endif
+
+/*******************************************************************************
+* Data types
+*******************************************************************************/
+/* Backend adapting the functions of a storage driver */
+typedef struct
+{
+    blk_dev_t dev;
+    bool      (*is_connected)(void);
+    cy_rslt_t (*init)(void);
+    uint32_t  (*sector_size)(void);
+    uint32_t  (*max_sector_num)(void);
+    cy_rslt_t (*read)(uint32_t address, uint8_t *data, uint32_t *length);
+    cy_rslt_t (*write)(uint32_t address, const uint8_t *data, uint32_t *length);
+    cy_rslt_t (*sync)(void);    /* NULL if the writes are durable */
+} storage_backend_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+static blk_dev_result_t storage_backend_init(blk_dev_t *dev);
+static bool storage_backend_is_connected(blk_dev_t *dev);
+static uint32_t storage_backend_block_size(blk_dev_t *dev);
+static uint32_t storage_backend_block_num(blk_dev_t *dev);
+static blk_dev_result_t storage_backend_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count);
+static blk_dev_result_t storage_backend_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count);
+static blk_dev_result_t storage_backend_sync(blk_dev_t *dev);
+
+/*******************************************************************************
+* Global Variables
+*******************************************************************************/
+static const blk_dev_ops_t storage_backend_ops =
+{
+    .init = storage_backend_init,
+    .is_connected = storage_backend_is_connected,
+    .block_size = storage_backend_block_size,
+    .block_num = storage_backend_block_num,
+    .read = storage_backend_read,
+    .write = storage_backend_write,
+    .sync = storage_backend_sync,
+};
+
+#if !defined(STORAGE_QSPI) || (MSC_OTHER_STORAGE != 0)
+static storage_backend_t storage_sd_card =
+{
+    .dev = { &storage_backend_ops, NULL },
+    .is_connected = sd_card_is_connected,
+    .init = sd_card_init,
+    .sector_size = sd_card_sector_size,
+    .max_sector_num = sd_card_max_sector_num,
+    .read = sd_card_read,
+    .write = sd_card_write,
+    .sync = NULL,
+};
+#endif
+
+#if STORAGE_QSPI_USED
+static storage_backend_t storage_qspi =
+{
+    .dev = { &storage_backend_ops, NULL },
+    .is_connected = qspi_storage_is_connected,
+    .init = qspi_storage_init,
+    .sector_size = qspi_storage_sector_size,
+    .max_sector_num = qspi_storage_max_sector_num,
+    .read = qspi_storage_read,
+    .write = qspi_storage_write,
+    .sync = qspi_storage_sync,
+};
+#endif
+
+#if (RAM_DISK_SIZE > 0)
+static storage_backend_t storage_ram_disk =
+{
+    .dev = { &storage_backend_ops, NULL },
+    .is_connected = ram_disk_is_connected,
+    .init = ram_disk_init,
+    .sector_size = ram_disk_sector_size,
+    .max_sector_num = ram_disk_max_sector_num,
+    .read = ram_disk_read,
+    .write = ram_disk_write,
+    .sync = NULL,
+};
+#endif
+
+#if defined(SD_EMU) && !defined(STORAGE_QSPI)
+/* Latency emulator of the card profile selected by SD_EMU in the Makefile, on
+*  the FatFs stack only */
+static sd_emu_t storage_sd_emu;
+#endif
+
+/* Stages of the FatFs stack. The cache is emptied when FatFs mounts the
+*  volume, which it does again after the host writes to it. */
+#if (STORAGE_FS_CACHE > 0)
+static blk_dev_cache_t storage_fs_cache;
+static uint8_t storage_fs_cache_lines[STORAGE_FS_CACHE * STORAGE_BLOCK_SIZE];
+static uint32_t storage_fs_cache_tags[STORAGE_FS_CACHE];
+#endif
+
+#if (STORAGE_FS_COALESCE > 0)
+static blk_dev_coalesce_t storage_fs_coalesce;
+static uint8_t storage_fs_coalesce_buf[STORAGE_FS_COALESCE * STORAGE_BLOCK_SIZE];
+#endif
+
+#if (STORAGE_FS_STATS != 0)
+static blk_dev_stats_t storage_fs_stats;
+#endif
+
+/* Top of each stack, NULL if the unit is not built */
+static blk_dev_t *storage_stacks[STORAGE_UNIT_NUM];
+
+/*******************************************************************************
+* Function Name: storage_backend_init
+********************************************************************************
+* Summary:
+*  Initialize the storage driver.
+*
+*******************************************************************************/
+static blk_dev_result_t storage_backend_init(blk_dev_t *dev)
+{
+    return (((storage_backend_t *) dev)->init() == CY_RSLT_SUCCESS) ? BLK_DEV_OK : BLK_DEV_ERR_NOT_READY;
+}
+
+/*******************************************************************************
+* Function Name: storage_backend_is_connected
+********************************************************************************
+* Summary:
+*  Check if the storage is connected.
+*
+*******************************************************************************/
+static bool storage_backend_is_connected(blk_dev_t *dev)
+{
+    return ((storage_backend_t *) dev)->is_connected();
+}
+
+/*******************************************************************************
+* Function Name: storage_backend_block_size
+********************************************************************************
+* Summary:
+*  Get the logical block size of the storage.
+*
+*******************************************************************************/
+static uint32_t storage_backend_block_size(blk_dev_t *dev)
+{
+    return ((storage_backend_t *) dev)->sector_size();
+}
+
+/*******************************************************************************
+* Function Name: storage_backend_block_num
+********************************************************************************
+* Summary:
+*  Get the number of logical blocks of the storage.
+*
+*******************************************************************************/
+static uint32_t storage_backend_block_num(blk_dev_t *dev)
+{
+    return ((storage_backend_t *) dev)->max_sector_num();
+}
+
+/*******************************************************************************
+* Function Name: storage_backend_read
+********************************************************************************
+* Summary:
+*  Read blocks from the storage.
+*
+*******************************************************************************/
+static blk_dev_result_t storage_backend_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    return (((storage_backend_t *) dev)->read(block, buf, count) == CY_RSLT_SUCCESS) ? BLK_DEV_OK : BLK_DEV_ERR_IO;
+}
+
+/*******************************************************************************
+* Function Name: storage_backend_write
+********************************************************************************
+* Summary:
+*  Write blocks to the storage.
+*
+*******************************************************************************/
+static blk_dev_result_t storage_backend_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    return (((storage_backend_t *) dev)->write(block, buf, count) == CY_RSLT_SUCCESS) ? BLK_DEV_OK : BLK_DEV_ERR_IO;
+}
+
+/*******************************************************************************
+* Function Name: storage_backend_sync
+********************************************************************************
+* Summary:
+*  Make the blocks written durable, for the drivers buffering them.
+*
+*******************************************************************************/
+static blk_dev_result_t storage_backend_sync(blk_dev_t *dev)
+{
+    storage_backend_t *backend = (storage_backend_t *) dev;
+
+    if (backend->sync == NULL)
+    {
+        return BLK_DEV_OK;
+    }
+    return (backend->sync() == CY_RSLT_SUCCESS) ? BLK_DEV_OK : BLK_DEV_ERR_IO;
+}
+
+#if defined(SD_EMU) && !defined(STORAGE_QSPI)
+/*******************************************************************************
+* Function Name: storage_sd_emu_delay
+********************************************************************************
+* Summary:
+*  Wait for the time of an emulated SD card command. The emulator is only on
+*  the FatFs stack, used by the tasks: they sleep for the whole milliseconds
+*  and busy-wait the rest. The USB interrupt never waits for it.
+*
+*******************************************************************************/
+static void storage_sd_emu_delay(uint32_t us)
+{
+    uint32_t chunk;
+
+    if ((xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) && (us >= 1000u))
+    {
+        vTaskDelay(pdMS_TO_TICKS(us / 1000u));
+        us %= 1000u;
+    }
+
+    while (us > 0u)
+    {
+        chunk = (us > 50000u) ? 50000u : us;
+        cyhal_system_delay_us((uint16_t) chunk);
+        us -= chunk;
+    }
+}
+#endif
+
+/*******************************************************************************
+* Function Name: storage_stacks_init
+********************************************************************************
+* Summary:
+*  Build the block device stacks. Called once before the scheduler starts.
+*  The stages of blk_dev.h are added here, on top of the backends. A stage
+*  keeping state must only be used by one context at a time: the USB mass
+*  storage class accesses its stacks from its interrupt, and FatFs has its
+*  own stack over the main storage. The SD card emulator is only on the
+*  FatFs stack, so the host accesses are not slowed and the interrupt never
+*  waits for an emulated stall.
+*
+*******************************************************************************/
+void storage_stacks_init(void)
+{
+#if !defined(STORAGE_QSPI) || (MSC_OTHER_STORAGE != 0)
+    blk_dev_t *sd_dev = &storage_sd_card.dev;
+#endif
+
+#if defined(STORAGE_QSPI)
+    storage_stacks[STORAGE_UNIT_MAIN] = &storage_qspi.dev;
+#if (MSC_OTHER_STORAGE != 0)
+    storage_stacks[STORAGE_UNIT_OTHER] = sd_dev;
+#endif
+#else
+    storage_stacks[STORAGE_UNIT_MAIN] = sd_dev;
+#if (MSC_OTHER_STORAGE != 0)
+    storage_stacks[STORAGE_UNIT_OTHER] = &storage_qspi.dev;
+#endif
+#endif
+
+    /* FatFs stack over the main storage. The statistics are taken below the
+    *  cache and the coalescing, on the operations reaching the storage. */
+    storage_stacks[STORAGE_UNIT_FS] = storage_stacks[STORAGE_UNIT_MAIN];
+#if defined(SD_EMU) && !defined(STORAGE_QSPI)
+    storage_stacks[STORAGE_UNIT_FS] = sd_emu_init(&storage_sd_emu, storage_stacks[STORAGE_UNIT_FS],
+                                                  &sd_emu_profiles[SD_EMU], storage_sd_emu_delay, 1u);
+#endif
+#if (STORAGE_FS_STATS != 0)
+    storage_stacks[STORAGE_UNIT_FS] = blk_dev_stats_init(&storage_fs_stats, storage_stacks[STORAGE_UNIT_FS],
+                                                         stats_timestamp);
+#endif
+#if (STORAGE_FS_COALESCE > 0)
+    storage_stacks[STORAGE_UNIT_FS] = blk_dev_coalesce_init(&storage_fs_coalesce, storage_stacks[STORAGE_UNIT_FS],
+                                                            storage_fs_coalesce_buf, STORAGE_FS_COALESCE,
+                                                            STORAGE_BLOCK_SIZE);
+#endif
+#if (STORAGE_FS_CACHE > 0)
+    storage_stacks[STORAGE_UNIT_FS] = blk_dev_cache_init(&storage_fs_cache, storage_stacks[STORAGE_UNIT_FS],
+                                                         storage_fs_cache_lines, storage_fs_cache_tags,
+                                                         STORAGE_FS_CACHE, STORAGE_BLOCK_SIZE);
+#endif
+
+#if (RAM_DISK_SIZE > 0)
+    storage_stacks[STORAGE_UNIT_RAM_DISK] = &storage_ram_disk.dev;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: storage_get_dev
+********************************************************************************
+* Summary:
+*  Get the top of the block device stack of a storage unit.
+*
+* Parameters:
+*  unit: storage unit
+*
+* Return:
+*  The block device, NULL if the unit is not built.
+*
+*******************************************************************************/
+blk_dev_t *storage_get_dev(storage_unit_t unit)
+{
+    return (unit < STORAGE_UNIT_NUM) ? storage_stacks[unit] : NULL;
+}
+
+/*******************************************************************************
+* Function Name: storage_get_fs_stats
+********************************************************************************
+* Summary:
+*  Get the statistics stage of the FatFs stack, timed in CPU cycles.
+*
+* Return:
+*  The stage, NULL if STORAGE_FS_STATS is 0.
+*
+*******************************************************************************/
+const blk_dev_stats_t *storage_get_fs_stats(void)
+{
+#if (STORAGE_FS_STATS != 0)
+    return &storage_fs_stats;
+#else
+    return NULL;
+#endif
+}
+
+/* [] END OF FILE */
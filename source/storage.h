@@ -0,0 +1,101 @@
+/*****************************************************************************
+* File Name: storage.h
+*
+* Description:
+*  This file selects the storage backend behind the USB mass storage class
+*  and FatFs: the SD card, or the QSPI NOR flash through the FTL.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#if !defined(STORAGE_H)
+#define STORAGE_H
+
+/* Logical block size presented to FatFs and the USB host, a multiple of the
+*  512-byte SD card sector. Selected with STORAGE_BLOCK_SIZE in the Makefile. */
+#ifndef STORAGE_BLOCK_SIZE
+#define STORAGE_BLOCK_SIZE          512
+#endif
+
+#include "sd_card.h"
+#include "qspi_storage.h"
+#include "ram_disk.h"
+#include "blk_dev.h"
+
+/* Additional logical unit with the storage not selected by STORAGE in the
+*  Makefile, exposed to the USB host */
+#ifndef MSC_OTHER_STORAGE
+#define MSC_OTHER_STORAGE           0
+#endif
+
+/* The QSPI flash is used, and needs its background task */
+#if defined(STORAGE_QSPI) || (MSC_OTHER_STORAGE != 0)
+#define STORAGE_QSPI_USED           1
+#else
+#define STORAGE_QSPI_USED           0
+#endif
+
+/* Stages of the FatFs stack, selected in the Makefile: blocks of read cache,
+*  blocks of write coalescing, and statistics, 0 to remove each */
+#ifndef STORAGE_FS_CACHE
+#define STORAGE_FS_CACHE            0
+#endif
+
+#ifndef STORAGE_FS_COALESCE
+#define STORAGE_FS_COALESCE         0
+#endif
+
+#ifndef STORAGE_FS_STATS
+#define STORAGE_FS_STATS            0
+#endif
+
+/* Block device stacks. The USB mass storage class reaches the units from its
+*  interrupt; FatFs reaches the main storage from the tasks, through a stack
+*  of its own, so a stage keeping state is never shared by the two */
+typedef enum
+{
+    STORAGE_UNIT_MAIN = 0,      /* Selected by STORAGE, holds the recordings */
+    STORAGE_UNIT_OTHER,         /* The storage not selected */
+    STORAGE_UNIT_RAM_DISK,
+    STORAGE_UNIT_FS,            /* The main storage, as FatFs reaches it */
+    STORAGE_UNIT_NUM
+} storage_unit_t;
+
+void       storage_stacks_init(void);
+blk_dev_t *storage_get_dev(storage_unit_t unit);
+const blk_dev_stats_t *storage_get_fs_stats(void);
+
+#endif /* STORAGE_H */
+
+/* [] END OF FILE */
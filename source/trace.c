@@ -0,0 +1,282 @@
+/*****************************************************************************
+* File Name: trace.c
+*
+* Description:
+*  This file contains the event trace ring. Events are stamped with the
+*  cycle counter and stored in a lock-free ring that can be dumped over the
+*  UART or read from the TRACE.BIN virtual file.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "trace.h"
+#include "virt_file.h"
+#include "cy_pdl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(TRACE_ENABLE)
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Number of bytes printed per line in the UART dump */
+#define TRACE_DUMP_LINE             32u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t clock_hz;
+    uint32_t ring_size;
+    uint32_t head;
+    uint32_t time;
+    uint32_t running;
+    uint32_t reserved;
+} trace_header_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static trace_record_t trace_ring[TRACE_RING_SIZE];
+static volatile uint32_t trace_head = 0;
+static volatile bool trace_running = false;
+
+/* Header latched when the dump starts */
+static trace_header_t trace_header;
+
+/*******************************************************************************
+* Function Name: trace_init
+********************************************************************************
+* Summary:
+*   Start recording events and register the trace virtual file.
+*
+*******************************************************************************/
+void trace_init(void)
+{
+    /* Enable the cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    virt_file_register(TRACE_FILE_NAME, TRACE_FILE_SIZE, trace_read);
+
+    trace_start();
+}
+
+/*******************************************************************************
+* Function Name: trace_start
+********************************************************************************
+* Summary:
+*   Clear the ring and resume recording events.
+*
+*******************************************************************************/
+void trace_start(void)
+{
+    trace_running = false;
+    trace_head = 0;
+    memset(trace_ring, 0, sizeof(trace_ring));
+    trace_running = true;
+}
+
+/*******************************************************************************
+* Function Name: trace_stop
+********************************************************************************
+* Summary:
+*   Freeze the ring, so the events leading to a failure are kept. Can be
+*   called from interrupts.
+*
+*******************************************************************************/
+void trace_stop(void)
+{
+    trace_running = false;
+}
+
+/*******************************************************************************
+* Function Name: trace_record
+********************************************************************************
+* Summary:
+*   Store an event in the ring. Can be called from any context, the slot is
+*   reserved with exclusive accesses so no lock is needed. The oldest events
+*   are overwritten.
+*
+* Parameters:
+*   id = event identifier
+*   type = TRACE_TYPE_BEGIN, TRACE_TYPE_END or TRACE_TYPE_INSTANT
+*   arg = event argument
+*
+*******************************************************************************/
+void trace_record(trace_id_t id, uint8_t type, uint16_t arg)
+{
+    trace_record_t *record;
+    uint32_t index;
+    uint32_t time;
+
+    if (!trace_running)
+    {
+        return;
+    }
+
+    /* Sample the clock inside the exclusive access, so a preempted reservation
+     * is retried and the records are stored in time order */
+    do
+    {
+        index = __LDREXW(&trace_head);
+        time = TRACE_CLOCK();
+    } while (__STREXW(index + 1u, &trace_head) != 0u);
+
+    record = &trace_ring[index & (TRACE_RING_SIZE - 1u)];
+    record->time = time;
+    record->id   = (uint8_t) id;
+    record->type = type;
+    record->arg  = arg;
+}
+
+/*******************************************************************************
+* Function Name: trace_latch_header
+********************************************************************************
+* Summary:
+*   Capture the ring position and time at the beginning of a dump. Records
+*   written after this time are discarded by the host tool.
+*
+*******************************************************************************/
+static void trace_latch_header(void)
+{
+    trace_header.magic     = TRACE_MAGIC;
+    trace_header.version   = TRACE_VERSION;
+    trace_header.clock_hz  = TRACE_CLOCK_HZ;
+    trace_header.ring_size = TRACE_RING_SIZE;
+    trace_header.head      = trace_head;
+    trace_header.time      = TRACE_CLOCK();
+    trace_header.running   = trace_running;
+    trace_header.reserved  = 0;
+}
+
+/*******************************************************************************
+* Function Name: trace_dump
+********************************************************************************
+* Summary:
+*   Print the trace over the UART as hexadecimal lines prefixed by "TRC ".
+*   The lines are converted by tools/trace_to_chrome.py.
+*
+*******************************************************************************/
+void trace_dump(void)
+{
+    uint8_t line[TRACE_DUMP_LINE];
+    uint32_t offset;
+    uint32_t index;
+    uint32_t count;
+
+    trace_latch_header();
+
+    printf("\n\rTRC BEGIN %u\n\r", (unsigned int) TRACE_FILE_SIZE);
+
+    for (offset = 0; offset < TRACE_FILE_SIZE; offset += count)
+    {
+        count = trace_read(offset, line, sizeof(line));
+
+        printf("TRC ");
+        for (index = 0; index < count; index++)
+        {
+            printf("%02x", line[index]);
+        }
+        printf("\n\r");
+    }
+
+    printf("TRC END\n\r");
+}
+
+/*******************************************************************************
+* Function Name: trace_read
+********************************************************************************
+* Summary:
+*   Copy the header and the raw ring. Called by the USB to serve the virtual
+*   file, the header is latched when the beginning of the file is read.
+*
+* Parameters:
+*   offset = offset in the file
+*   buf = destination buffer
+*   len = number of bytes
+*
+* Return:
+*   Number of bytes copied.
+*
+*******************************************************************************/
+uint32_t trace_read(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    uint32_t count = 0;
+    uint32_t chunk;
+
+    if (offset >= TRACE_FILE_SIZE)
+    {
+        return 0;
+    }
+
+    if (len > (TRACE_FILE_SIZE - offset))
+    {
+        len = TRACE_FILE_SIZE - offset;
+    }
+
+    if (offset < TRACE_HEADER_SIZE)
+    {
+        if (offset == 0)
+        {
+            trace_latch_header();
+        }
+
+        chunk = TRACE_HEADER_SIZE - offset;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+
+        memcpy(buf, &((const uint8_t *) &trace_header)[offset], chunk);
+        count = chunk;
+    }
+
+    if (count < len)
+    {
+        memcpy(&buf[count], &((const uint8_t *) trace_ring)[(offset + count) - TRACE_HEADER_SIZE], len - count);
+        count = len;
+    }
+
+    return count;
+}
+
+#endif /* TRACE_ENABLE */
+
+/* [] END OF FILE */
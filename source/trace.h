@@ -0,0 +1,139 @@
+/*****************************************************************************
+* File Name: trace.h
+*
+* Description:
+*  This file contains the event trace macros, the function prototypes
+*  and constants used in the trace.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Virtual file exposing the trace ring on the drive */
+#define TRACE_FILE_NAME             "TRACE.BIN"
+
+/* Number of records in the ring, must be a power of 2 */
+#define TRACE_RING_SIZE             1024u
+
+/* Header placed before the records in the dump */
+#define TRACE_MAGIC                 0x45435254u     /* "TRCE" */
+#define TRACE_VERSION               1u
+#define TRACE_HEADER_SIZE           32u
+#define TRACE_FILE_SIZE             (TRACE_HEADER_SIZE + (TRACE_RING_SIZE * sizeof(trace_record_t)))
+
+/* Record types */
+#define TRACE_TYPE_BEGIN            0u
+#define TRACE_TYPE_END              1u
+#define TRACE_TYPE_INSTANT          2u
+
+/* Traced events, keep in sync with tools/trace_to_chrome.py */
+typedef enum
+{
+    TRACE_ID_USB_ISR = 0,           /* USB interrupt, arg = 0 high, 1 medium, 2 low */
+    TRACE_ID_SCSI_CMD,              /* CBW to CSW, arg = opcode */
+    TRACE_ID_SD_READ,               /* SD card read, arg = blocks */
+    TRACE_ID_SD_WRITE,              /* SD card write, arg = blocks */
+    TRACE_ID_PDM_BLOCK,             /* PCM block captured, arg = ring occupancy */
+    TRACE_ID_PDM_OVERRUN,           /* PCM block dropped, arg = ring occupancy */
+    TRACE_ID_AUDIO_WRITE,           /* audio_fs_write, arg = KB */
+    TRACE_ID_AUDIO_DSP,             /* audio_dsp_process, arg = KB */
+    TRACE_ID_AUDIO_SRC,             /* audio_src_process, arg = KB */
+    TRACE_ID_AUDIO_VAD,             /* audio_vad_process, arg = KB */
+    TRACE_ID_AUDIO_START,           /* Press to capture start, arg = 1 if created at the press */
+    TRACE_ID_AUDIO_PEAK,            /* audio_peak_process, arg = KB */
+    TRACE_ID_NUM
+} trace_id_t;
+
+/* Record stored in the ring, 8 bytes */
+typedef struct
+{
+    uint32_t time;
+    uint8_t  id;
+    uint8_t  type;
+    uint16_t arg;
+} trace_record_t;
+
+/* Time stamp source, can be overridden at compile time */
+#ifndef TRACE_CLOCK
+#define TRACE_CLOCK()               (DWT->CYCCNT)
+#endif
+
+/* Frequency of the time stamp source in Hz */
+#ifndef TRACE_CLOCK_HZ
+#define TRACE_CLOCK_HZ              SystemCoreClock
+#endif
+
+/*******************************************************************************
+* Trace Macros, removed when TRACE_ENABLE is not defined
+********************************************************************************/
+#if defined(TRACE_ENABLE)
+#define TRACE_BEGIN(id, arg)        trace_record((id), TRACE_TYPE_BEGIN, (uint16_t)(arg))
+#define TRACE_END(id, arg)          trace_record((id), TRACE_TYPE_END, (uint16_t)(arg))
+#define TRACE_INSTANT(id, arg)      trace_record((id), TRACE_TYPE_INSTANT, (uint16_t)(arg))
+#define TRACE_INIT()                trace_init()
+#define TRACE_START()               trace_start()
+#define TRACE_STOP()                trace_stop()
+#define TRACE_DUMP()                trace_dump()
+#else
+#define TRACE_BEGIN(id, arg)        do { } while (0)
+#define TRACE_END(id, arg)          do { } while (0)
+#define TRACE_INSTANT(id, arg)      do { } while (0)
+#define TRACE_INIT()                do { } while (0)
+#define TRACE_START()               do { } while (0)
+#define TRACE_STOP()                do { } while (0)
+#define TRACE_DUMP()                do { } while (0)
+#endif
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+void     trace_init(void);
+void     trace_start(void);
+void     trace_stop(void);
+void     trace_record(trace_id_t id, uint8_t type, uint16_t arg);
+void     trace_dump(void);
+uint32_t trace_read(uint32_t offset, uint8_t *buf, uint32_t len);
+
+#endif /* TRACE_H_ */
+
+/* [] END OF FILE */
@@ -48,7 +48,10 @@
 #include "cycfg.h"
 #include "cycfg_usbdev.h"
 
-#include "sd_card.h"
+#include "storage.h"
+#include "buf_arena.h"
+#include "stats.h"
+#include "trace.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -62,6 +65,9 @@
 #define USB_COMM_CBS_PHASE_ERROR    0x02
 #define USB_COMM_TIMEOUT            2000
 
+/* Logical unit holding the recordings and the file system of the firmware */
+#define USB_COMM_LUN_STORAGE        0u
+
 /***************************************************************************
 * USB Interrupt Handlers
 ***************************************************************************/
@@ -107,24 +113,30 @@ cyhal_timer_cfg_t usb_timer_cfg =
     .period        = 10000
 };
 
-/* Mass storage device interfaces */
-cy_stc_mass_storage_dev_t disk_fops = {
-  sd_card_is_connected,
-  sd_card_init,
-  sd_card_sector_size,
-  sd_card_max_sector_num,
-  sd_card_total_mem_bytes,
-  sd_card_read,
-  sd_card_write,
+/* Storage units exposed to the host as logical units, the file system of
+*  the firmware first */
+static const storage_unit_t usb_lun_units[] = {
+  STORAGE_UNIT_MAIN,
+#if (MSC_OTHER_STORAGE != 0)
+  STORAGE_UNIT_OTHER,
+#endif
+#if (RAM_DISK_SIZE > 0)
+  STORAGE_UNIT_RAM_DISK,
+#endif
 };
 
+#define USB_COMM_LUN_NUM            (sizeof(usb_lun_units) / sizeof(usb_lun_units[0]))
+
+/* Logical units, they stay removed until their device is connected */
+cy_stc_usb_dev_msc_lun_t usb_luns[USB_COMM_LUN_NUM];
+
 volatile bool usb_suspended = false;
 volatile uint32_t usb_idle_counter = 0;
 
 uint8_t *usb_fs = NULL;
 
-extern uint8_t forceOS;
-extern uint8_t statusFileTimer;
+/* Incremented on each write from the host to the recording volume */
+static volatile uint32_t usb_write_gen = 0;
 
 /*******************************************************************************
 * Function Prototypes
@@ -134,6 +146,7 @@ static void usb_comm_msc_in_ep_cb(USBFS_Type *base, uint32_t endpointAddr, uint3
 static cy_en_usb_dev_status_t usb_msc_request_received (cy_stc_usb_dev_control_transfer_t *transfer, void *classContext, cy_stc_usb_dev_context_t *devContext);
 static cy_en_usb_dev_status_t usb_msc_request_completed(cy_stc_usb_dev_control_transfer_t *transfer, void *classContext, cy_stc_usb_dev_context_t *devContext);
 static uint8 is_command_block_wrapper_valid(cy_stc_usb_dev_msc_context_t *context);
+static void usb_comm_update_luns(void);
 static void usb_high_isr(void);
 static void usb_medium_isr(void);
 static void usb_low_isr(void);
@@ -161,6 +174,8 @@ static int32_t usb_comm_timeout_handler(int32_t ms)
 *******************************************************************************/
 void usb_comm_init(void)
 {
+    uint8_t index;
+
     /* Init the USB Block */
     Cy_USB_Dev_Init(CYBSP_USBDEV_HW,
                     &CYBSP_USBDEV_config,
@@ -174,11 +189,24 @@ void usb_comm_init(void)
                         &usb_mscContext,
                         &usb_devContext);
                         
-    /* Add Storage callbacks for Mass Storage Device Class */
-    usb_mscContext.p_user_data = &disk_fops;
-    usb_mscContext.block_size = ((cy_stc_mass_storage_dev_t *)usb_mscContext.p_user_data)->get_block_size();
-    usb_mscContext.block_num = ((cy_stc_mass_storage_dev_t *)usb_mscContext.p_user_data)->get_block_num();
-    usb_mscContext.mem_size = ((cy_stc_mass_storage_dev_t *)usb_mscContext.p_user_data)->get_mem_size();
+    /* Add the logical units for Mass Storage Device Class. The file system
+     * of the firmware initializes its storage, the others are initialized
+     * here. */
+    usb_mscContext.luns = usb_luns;
+    usb_mscContext.lun_num = USB_COMM_LUN_NUM;
+    msc_lun = USB_COMM_LUN_NUM - 1u;
+    for (index = 0; index < USB_COMM_LUN_NUM; index++)
+    {
+        usb_luns[index].dev = storage_get_dev(usb_lun_units[index]);
+        usb_luns[index].virt_files = (usb_lun_units[index] == STORAGE_UNIT_MAIN);
+        usb_luns[index].removed = true;
+        if (usb_lun_units[index] != STORAGE_UNIT_MAIN)
+        {
+            (void) blk_dev_init(usb_luns[index].dev);
+        }
+    }
+    usb_comm_update_luns();
+    usb_scsi_select_lun(&usb_mscContext, USB_COMM_LUN_STORAGE);
 
     /* Register MSC data endpoint callbacks */
     Cy_USBFS_Dev_Drv_RegisterEndpointCallback(CYBSP_USBDEV_HW, MSC_IN_ENDPOINT, usb_comm_msc_in_ep_cb, &usb_drvContext);
@@ -248,8 +276,52 @@ bool usb_comm_is_ready(void)
 *******************************************************************************/
 void usb_comm_refresh(void)
 {
-    forceOS = true;
-    statusFileTimer = 0;
+    usb_luns[USB_COMM_LUN_STORAGE].force_os = true;
+    usb_luns[USB_COMM_LUN_STORAGE].status_timer = 0;
+}
+
+/*******************************************************************************
+* Function Name: usb_comm_write_generation
+********************************************************************************
+* Summary:
+*   Return a counter incremented on each write from the host to the logical
+*   unit of the recording volume. Used to detect that the file system content
+*   changed behind the firmware; the writes to the other units do not count.
+*
+*******************************************************************************/
+uint32_t usb_comm_write_generation(void)
+{
+    return usb_write_gen;
+}
+
+/*******************************************************************************
+* Function Name: usb_comm_update_luns
+********************************************************************************
+* Summary:
+*   Update the removed state of the logical units, and read the geometry of a
+*   device when it gets connected, before the host can access it.
+*
+*******************************************************************************/
+static void usb_comm_update_luns(void)
+{
+    cy_stc_usb_dev_msc_lun_t *unit;
+    uint8_t index;
+
+    for (index = 0; index < usb_mscContext.lun_num; index++)
+    {
+        unit = &usb_luns[index];
+        if (!blk_dev_is_connected(unit->dev))
+        {
+            unit->removed = true;
+        }
+        else if (unit->removed || (unit->block_num == 0))
+        {
+            unit->block_size = blk_dev_block_size(unit->dev);
+            unit->block_num = blk_dev_block_num(unit->dev);
+            unit->mem_size = (uint64_t) unit->block_num * unit->block_size;
+            unit->removed = false;
+        }
+    }
 }
 
 /*******************************************************************************
@@ -261,19 +333,14 @@ void usb_comm_refresh(void)
 *******************************************************************************/
 void usb_comm_process(void)
 {
-    /* Storage device Status */
-    if(!((cy_stc_mass_storage_dev_t *)usb_mscContext.p_user_data)->is_connected()) 
-    {
-        storageRemovedFlag = true;
-    } else 
-    {
-        storageRemovedFlag = false;
-    }
+    /* Storage devices status */
+    usb_comm_update_luns();
 
     /* Check the USB configuration */
     if(Cy_USB_Dev_IsConfigurationChanged(&usb_devContext)) 
     {
         usb_mscContext.state = CY_USB_DEV_MSC_READY_STATE;
+        buf_arena_msc_end();
         /* Enable the OUT Endpoint */
         Cy_USB_Dev_StartReadEp(MSC_OUT_ENDPOINT, &usb_devContext);
     }
@@ -314,6 +381,8 @@ static void usb_comm_msc_out_ep_cb(USBFS_Type *base, uint32_t endpointAddr, uint
             Cy_USBFS_Dev_Drv_StallEndpoint(base, MSC_IN_ENDPOINT, context);
             return;
         }
+        stats_scsi_begin(usb_mscContext.cmd_block.cmd[0]);
+        TRACE_BEGIN(TRACE_ID_SCSI_CMD, usb_mscContext.cmd_block.cmd[0]);
         usb_mscContext.cmd_status.tag = usb_mscContext.cmd_block.tag;
         usb_mscContext.cmd_status.data_residue = usb_mscContext.cmd_block.data_transfer_length;
 
@@ -321,13 +390,13 @@ static void usb_comm_msc_out_ep_cb(USBFS_Type *base, uint32_t endpointAddr, uint
         if(usb_mscContext.cmd_block.data_transfer_length == 0) {
             switch (usb_mscContext.cmd_block.cmd[0]) {
                 case CY_USB_DEV_MSC_SCSI_TEST_UNIT_READY:
-                    status = usb_scsi_test_unit_ready();
+                    status = usb_scsi_test_unit_ready(&usb_mscContext);
                     break;
                 case CY_USB_DEV_MSC_SCSI_MEDIA_REMOVAL:
-                    status = usb_scsi_prevent_media_removal(usb_mscContext.cmd_block.cmd[4]);
+                    status = usb_scsi_prevent_media_removal(&usb_mscContext, usb_mscContext.cmd_block.cmd[4]);
                     break;
                 case CY_USB_DEV_MSC_SCSI_START_STOP_UNIT:
-                    status = usb_scsi_start_stop_unit(usb_mscContext.cmd_block.cmd[4]);
+                    status = usb_scsi_start_stop_unit(&usb_mscContext, usb_mscContext.cmd_block.cmd[4]);
                     break;
                 default:
                     break;
@@ -350,17 +419,21 @@ static void usb_comm_msc_out_ep_cb(USBFS_Type *base, uint32_t endpointAddr, uint
                 /* SCSI Read command (10) */
                 case CY_USB_DEV_MSC_SCSI_READ10:
                     tempVar = ((usb_mscContext.cmd_block.cmd[2] << 24) | (usb_mscContext.cmd_block.cmd[3] << 16) | (usb_mscContext.cmd_block.cmd[4] << 8) | (usb_mscContext.cmd_block.cmd[5]));
-                    usb_mscContext.start_location = tempVar * MSC_BLOCKSIZE;
+                    usb_mscContext.start_location = (uint64_t) tempVar * usb_mscContext.block_size;
                     tempVar = ((usb_mscContext.cmd_block.cmd[7] << 8) | (usb_mscContext.cmd_block.cmd[8]));
-                    usb_mscContext.bytes_to_transfer = tempVar * MSC_BLOCKSIZE;
+                    usb_mscContext.bytes_to_transfer = tempVar * usb_mscContext.block_size;
                     usb_mscContext.dev_data_len = 0;
                     if (usb_mscContext.cmd_block.data_transfer_length != usb_mscContext.bytes_to_transfer) {
                         usb_mscContext.cmd_status.status = USB_COMM_CBS_PHASE_ERROR;
                         /* Stall OUT endpoint */
                         Cy_USBFS_Dev_Drv_StallEndpoint(base, MSC_OUT_ENDPOINT, context);
                         usb_mscContext.state = CY_USB_DEV_MSC_READY_STATE;
+                        /* No CSW follows, return the media buffer now */
+                        buf_arena_msc_end();
                         return;
                     }
+                    /* Lease the media buffer for this command */
+                    usb_mscContext.dev_data_buf = buf_arena_msc_begin(&usb_mscContext.dev_data_size);
                     status = usb_scsi_read_10(&usb_mscContext);
                     break;
                 case CY_USB_DEV_MSC_SCSI_REQUEST_SENSE:
@@ -409,6 +482,10 @@ static void usb_comm_msc_out_ep_cb(USBFS_Type *base, uint32_t endpointAddr, uint
                     usb_mscContext.state = CY_USB_DEV_MSC_DATA_IN;
                 }
                 usb_mscContext.cmd_status.status = status;
+            } else {
+                /* The command failed, such as a media read, and no CSW
+                 * follows: return the media buffer now */
+                buf_arena_msc_end();
             }
         /* Data-Out from host to the device */
         } else {
@@ -416,19 +493,28 @@ static void usb_comm_msc_out_ep_cb(USBFS_Type *base, uint32_t endpointAddr, uint
             if((usb_mscContext.cmd_block.cmd[0] == CY_USB_DEV_MSC_SCSI_WRITE10) || (usb_mscContext.cmd_block.cmd[0] == CY_USB_DEV_MSC_SCSI_VERIFY10)) {
                 /* Get the block address */
                 tempVar = ((usb_mscContext.cmd_block.cmd[2] << 24) | (usb_mscContext.cmd_block.cmd[3] << 16) | (usb_mscContext.cmd_block.cmd[4] << 8) | (usb_mscContext.cmd_block.cmd[5]));
-                usb_mscContext.start_location = tempVar * MSC_BLOCKSIZE;
+                usb_mscContext.start_location = (uint64_t) tempVar * usb_mscContext.block_size;
                 /* Get the block num */
                 tempVar = ((usb_mscContext.cmd_block.cmd[7] << 8) | (usb_mscContext.cmd_block.cmd[8]));
-                usb_mscContext.bytes_to_transfer = tempVar * MSC_BLOCKSIZE;
+                usb_mscContext.bytes_to_transfer = tempVar * usb_mscContext.block_size;
                 usb_mscContext.dev_data_len = 0;
                 /* Check the transfer length */
                 if(usb_mscContext.cmd_block.data_transfer_length != usb_mscContext.bytes_to_transfer) {
                     usb_mscContext.cmd_status.status = USB_COMM_CBS_PHASE_ERROR;
                     /* Stall OUT endpoint */
                     Cy_USBFS_Dev_Drv_StallEndpoint(base, MSC_OUT_ENDPOINT, context);
+                    /* No CSW follows, return the media buffer now */
+                    buf_arena_msc_end();
                     return;
                 }
+                /* Lease the media buffer for this command */
+                usb_mscContext.dev_data_buf = buf_arena_msc_begin(&usb_mscContext.dev_data_size);
                 usb_mscContext.state = CY_USB_DEV_MSC_DATA_OUT;
+                /* Only the writes to the recording volume change it */
+                if ((usb_mscContext.cmd_block.cmd[0] == CY_USB_DEV_MSC_SCSI_WRITE10) &&
+                    (usb_mscContext.lun == &usb_luns[USB_COMM_LUN_STORAGE])) {
+                    usb_write_gen++;
+                }
             }
         }
     /* Data OUT transfer */
@@ -468,6 +554,11 @@ static void usb_comm_msc_in_ep_cb(USBFS_Type *base, uint32_t endpointAddr, uint3
     if(CY_USB_DEV_MSC_STATUS_TRANSPORT == usb_mscContext.state) 
     {
         usb_mscContext.state = CY_USB_DEV_MSC_READY_STATE;
+        /* Command completed, return the media buffer to the arena */
+        buf_arena_msc_end();
+        stats_scsi_end(usb_mscContext.cmd_block.cmd[0],
+                       usb_mscContext.cmd_block.data_transfer_length - usb_mscContext.cmd_status.data_residue);
+        TRACE_END(TRACE_ID_SCSI_CMD, usb_mscContext.cmd_block.cmd[0]);
     /* Send the data completed */
     } else if(CY_USB_DEV_MSC_DATA_IN == usb_mscContext.state) {
         if(CY_USB_DEV_MSC_SCSI_READ10 != usb_mscContext.cmd_block.cmd[0]) {
@@ -489,6 +580,10 @@ static void usb_comm_msc_in_ep_cb(USBFS_Type *base, uint32_t endpointAddr, uint3
                                                                 usb_mscContext.packet_in_size, context->devConext)) {
                         //TODO...
                     }
+                } else {
+                    /* The media read failed and no CSW follows, return the
+                     * media buffer now */
+                    buf_arena_msc_end();
                 }
                 usb_mscContext.cmd_status.status = status;
             } else {
@@ -529,7 +624,8 @@ static uint8 is_command_block_wrapper_valid(cy_stc_usb_dev_msc_context_t *contex
 
     if(context->cmd_block.signature == MSC_CBW_SIGNATURE)
     {
-        if(context->cmd_block.lun <= 0)
+        /* Select the logical unit, the lookup is a direct index */
+        if(usb_scsi_select_lun(context, context->cmd_block.lun))
         {
             if((context->cmd_block.length > 0) && (context->cmd_block.length <= CY_USB_DEV_MSC_CMD_SIZE))
             {
@@ -570,6 +666,10 @@ static cy_en_usb_dev_status_t usb_msc_request_received(cy_stc_usb_dev_control_tr
                 retStatus = CY_USB_DEV_SUCCESS;
                 break;
             case CY_USB_DEV_MSC_RESET:
+                /* Bulk-only reset: the command in progress is abandoned,
+                 * return its media buffer */
+                usb_mscContext.state = CY_USB_DEV_MSC_READY_STATE;
+                buf_arena_msc_end();
                 transfer->notify = true;
                 transfer->ptr = &msc_reset;
                 transfer->remaining = 0x01;
@@ -622,7 +722,7 @@ static cy_en_usb_dev_status_t usb_msc_request_completed(cy_stc_usb_dev_control_t
 ***************************************************************************/
 void usb_timer_handler(void *arg, cyhal_timer_event_t event)
 {
-    usb_scsi_serve_timeout();
+    usb_scsi_serve_timeout(&usb_mscContext);
 
     if (0u != Cy_USBFS_Dev_Drv_CheckActivity(CYBSP_USBDEV_HW))
     {
@@ -652,10 +752,14 @@ void usb_timer_handler(void *arg, cyhal_timer_event_t event)
 ***************************************************************************/
 static void usb_high_isr(void)
 {
+    TRACE_BEGIN(TRACE_ID_USB_ISR, 0);
+
     /* Call interrupt processing */
     Cy_USBFS_Dev_Drv_Interrupt(CYBSP_USBDEV_HW,
                                Cy_USBFS_Dev_Drv_GetInterruptCauseHi(CYBSP_USBDEV_HW),
                                &usb_drvContext);
+
+    TRACE_END(TRACE_ID_USB_ISR, 0);
 }
 
 
@@ -668,10 +772,14 @@ static void usb_high_isr(void)
 ***************************************************************************/
 static void usb_medium_isr(void)
 {
+    TRACE_BEGIN(TRACE_ID_USB_ISR, 1);
+
     /* Call interrupt processing */
     Cy_USBFS_Dev_Drv_Interrupt(CYBSP_USBDEV_HW,
                                Cy_USBFS_Dev_Drv_GetInterruptCauseMed(CYBSP_USBDEV_HW),
                                &usb_drvContext);
+
+    TRACE_END(TRACE_ID_USB_ISR, 1);
 }
 
 
@@ -684,8 +792,12 @@ static void usb_medium_isr(void)
 **************************************************************************/
 static void usb_low_isr(void)
 {
+    TRACE_BEGIN(TRACE_ID_USB_ISR, 2);
+
     /* Call interrupt processing */
     Cy_USBFS_Dev_Drv_Interrupt(CYBSP_USBDEV_HW,
                                Cy_USBFS_Dev_Drv_GetInterruptCauseLo(CYBSP_USBDEV_HW),
                                &usb_drvContext);
+
+    TRACE_END(TRACE_ID_USB_ISR, 2);
 }
@@ -63,6 +63,7 @@ void     usb_comm_connect(void);
 void     usb_comm_link_fs(uint8_t *fs);
 bool     usb_comm_is_ready(void);
 void     usb_comm_refresh(void);
+uint32_t usb_comm_write_generation(void);
 void     usb_comm_process(void);
 
 
@@ -40,21 +40,11 @@
 *****************************************************************************/
 #include <stdio.h>
 #include "usb_scsi.h"
+#include "virt_file.h"
 
 /*******************************************************************************
 * Global Variables
 *******************************************************************************/
-/* Variable to keep track of when to send a Test Unit Ready
- * fail status to force a read from the host. */
-uint8_t forceOS = false;
-
-uint8_t statusFileTimer = 0;
-
-bool mediaEjectedState = false;
-
-/* Variable to keep track of failed commands. */
-bool commandFailed = false;
-
 /* Should not exceet 8 characters. */
 const unsigned char vendorIDT10[] = "CYPRESS ";
 
@@ -64,8 +54,70 @@ const unsigned char productID[] = "PSoC USB MSC";
 /* Product Revision */
 const unsigned char productRev[] = "9999";
 
-/* The storage removed flag */
-volatile bool storageRemovedFlag = false;
+/*******************************************************************************
+* Function Name: usb_scsi_media_read()
+********************************************************************************
+* Summary:
+*  Read blocks from the mass storage device into the media buffer. Blocks
+*  mapped to virtual files are generated instead of read from the memory.
+*
+* Parameters:
+*  context: pointer to the USB MSC context
+*  blk_addr: first block to read
+*  blk_len: number of blocks, updated with the number of blocks read
+*
+* Return:
+*  BLK_DEV_OK if successful.
+*
+*******************************************************************************/
+static blk_dev_result_t usb_scsi_media_read(cy_stc_usb_dev_msc_context_t *context, uint32_t blk_addr, uint32_t *blk_len)
+{
+    blk_dev_result_t result = BLK_DEV_OK;
+
+    if (!context->lun->virt_files || !virt_file_covers(blk_addr, *blk_len))
+    {
+        result = blk_dev_read(context->lun->dev, blk_addr, context->dev_data_buf, blk_len);
+    }
+
+    if ((result == BLK_DEV_OK) && context->lun->virt_files)
+    {
+        virt_file_overlay(blk_addr, *blk_len, context->block_size, context->dev_data_buf);
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: usb_scsi_select_lun()
+********************************************************************************
+* Summary:
+*  Select the logical unit addressed by the command block.
+*
+* Parameters:
+*  context: pointer to the USB MSC context
+*  lun: logical unit number
+*
+* Return:
+*  False if there is no such logical unit.
+*
+*******************************************************************************/
+bool usb_scsi_select_lun(cy_stc_usb_dev_msc_context_t *context, uint8_t lun)
+{
+    cy_stc_usb_dev_msc_lun_t *unit;
+
+    if (lun >= context->lun_num)
+    {
+        return false;
+    }
+
+    unit = &context->luns[lun];
+    context->lun = unit;
+    context->block_num = unit->block_num;
+    context->block_size = unit->block_size;
+    context->mem_size = unit->mem_size;
+
+    return true;
+}
 
 /*******************************************************************************
 * Function Name: usb_scsi_serve_timeout()
@@ -73,15 +125,21 @@ volatile bool storageRemovedFlag = false;
 * Summary:
 *  Serve the timeout handler for USB SCSI.
 *
+* Parameters:
+*  context: pointer to the USB MSC context
+*
 *******************************************************************************/
-void usb_scsi_serve_timeout(void)
+void usb_scsi_serve_timeout(cy_stc_usb_dev_msc_context_t *context)
 {
-    if (forceOS == true)
+    cy_stc_usb_dev_msc_lun_t *unit;
+    uint8_t index;
+
+    for (index = 0; index < context->lun_num; index++)
     {
-        statusFileTimer++;
-        if (statusFileTimer > STATUS_FILE_TIMEOUT)
+        unit = &context->luns[index];
+        if ((unit->force_os == true) && (unit->status_timer < STATUS_FILE_TIMEOUT))
         {
-            statusFileTimer = STATUS_FILE_TIMEOUT;
+            unit->status_timer++;
         }
     }
 }
@@ -93,13 +151,14 @@ void usb_scsi_serve_timeout(void)
 *  Handle the Prevent Media Removal scenario.
 *
 * Parameters:
+*  context: pointer to the USB MSC context
 *  prevent: is prevent enabled or not
 *
 * Return:
 *  Success if prevent is disabled, error if prevent is enabled.
 *
 *******************************************************************************/
-cy_en_usb_dev_status_t usb_scsi_prevent_media_removal(uint8_t prevent)
+cy_en_usb_dev_status_t usb_scsi_prevent_media_removal(cy_stc_usb_dev_msc_context_t *context, uint8_t prevent)
 {
     cy_en_usb_dev_status_t status = CY_USB_DEV_DRV_HW_ERROR;
 
@@ -113,7 +172,7 @@ cy_en_usb_dev_status_t usb_scsi_prevent_media_removal(uint8_t prevent)
         /* Send a fail response for command to force
          * the OS to initiate a Request Sense. */
         status = CY_USB_DEV_BAD_PARAM;
-        commandFailed = true;
+        context->lun->command_failed = true;
     }
 
     return(status);
@@ -125,31 +184,35 @@ cy_en_usb_dev_status_t usb_scsi_prevent_media_removal(uint8_t prevent)
 * Summary:
 *  Responds to the periodic Test Unit Ready Command from host. 
 *
+* Parameters:
+*  context: pointer to the USB MSC context
+*
 * Return:
 *  Success if no timeout or in ejected state. 
 *
 *******************************************************************************/
-cy_en_usb_dev_status_t usb_scsi_test_unit_ready(void)
+cy_en_usb_dev_status_t usb_scsi_test_unit_ready(cy_stc_usb_dev_msc_context_t *context)
 {
+    cy_stc_usb_dev_msc_lun_t *unit = context->lun;
     cy_en_usb_dev_status_t status = CY_USB_DEV_DRV_HW_ERROR;
 
-    if((mediaEjectedState) || (storageRemovedFlag)) {
+    if((unit->ejected) || (unit->removed)) {
         /* Send a fail response for Test Unit Ready command
          * since the media is in ejected state. */
         status = CY_USB_DEV_DRV_HW_ERROR;
     }
     else
     {
-        if(forceOS == false)
+        if(unit->force_os == false)
         {
             /* Send pass by default. */
             status = CY_USB_DEV_SUCCESS;
         }
         else
         {
-            if(statusFileTimer >= STATUS_FILE_TIMEOUT)
+            if(unit->status_timer >= STATUS_FILE_TIMEOUT)
             {
-                statusFileTimer = 0;
+                unit->status_timer = 0;
 
                 /* Send a fail response for Test Unit Ready command to force
                  * the OS to initiate a Request Sense. */
@@ -181,11 +244,13 @@ cy_en_usb_dev_status_t usb_scsi_test_unit_ready(void)
 *******************************************************************************/
 cy_en_usb_dev_status_t usb_scsi_request_sense(cy_stc_usb_dev_msc_context_t *context)
 {
+    cy_stc_usb_dev_msc_lun_t *unit = context->lun;
+
     memset(context->in_buffer, 0, context->packet_in_size);
     context->in_buffer[0] = SENSE_RESPONSE_CODE;
     context->in_buffer[7] = SENSE_ADDITIONAL_LENGTH;
 
-    if ((forceOS == false) && (commandFailed == false) && (mediaEjectedState == false))
+    if ((unit->force_os == false) && (unit->command_failed == false) && (unit->ejected == false))
     {
         context->in_buffer[2] = SENSE_KEY_NO_SENSE;
         context->in_buffer[12] = SENSE_ASC_NO_SENSE;
@@ -193,26 +258,26 @@ cy_en_usb_dev_status_t usb_scsi_request_sense(cy_stc_usb_dev_msc_context_t *cont
     }
     else
     {
-        if (commandFailed == true)
+        if (unit->command_failed == true)
         {
             context->in_buffer[2] = SENSE_KEY_ILLEGAL_REQUEST;
             context->in_buffer[12] = SENSE_ASC_INVALID_FIELD_IN_CDB;
             context->in_buffer[13] = SENSE_ASCQ_NO_SENSE;
-            commandFailed = false;
+            unit->command_failed = false;
         }
 
-        if (forceOS == true)
+        if (unit->force_os == true)
         {
             context->in_buffer[2] = SENSE_KEY_NOT_READY;
             context->in_buffer[12] = SENSE_ASC_MEDIA_REMOVAL;
             context->in_buffer[13] = SENSE_ASCQ_NO_SENSE;
-            forceOS = false;
-            statusFileTimer = 0;
+            unit->force_os = false;
+            unit->status_timer = 0;
         }
 
         /* If the host has sent a command to eject the drive,
          * send not ready until re-mounted. */
-        if(mediaEjectedState == true)
+        if(unit->ejected == true)
         {
             context->in_buffer[2] = SENSE_KEY_NOT_READY;
             context->in_buffer[12] = SENSE_ASC_MEDIA_REMOVAL;
@@ -240,7 +305,7 @@ cy_en_usb_dev_status_t usb_scsi_request_sense(cy_stc_usb_dev_msc_context_t *cont
 *******************************************************************************/
 cy_en_usb_dev_status_t usb_scsi_format_unit(cy_stc_usb_dev_msc_context_t *context)
 {
-    commandFailed = true;
+    context->lun->command_failed = true;
     context->packet_in_size = 0;
     context->state = CY_USB_DEV_MSC_STATUS_TRANSPORT;
 
@@ -390,23 +455,24 @@ cy_en_usb_dev_status_t usb_scsi_mode_sense_10(cy_stc_usb_dev_msc_context_t *cont
 *  This command responds to the eject/mount requests from the host.
 *
 * Parameters:
+*  context: pointer to the USB MSC context
 *  eject_indicator: bit mask to indicate ejection
 *
 * Return:
 *  Always success
 *
 *******************************************************************************/
-cy_en_usb_dev_status_t usb_scsi_start_stop_unit(uint8_t eject_indicator)
+cy_en_usb_dev_status_t usb_scsi_start_stop_unit(cy_stc_usb_dev_msc_context_t *context, uint8_t eject_indicator)
 {
     if((eject_indicator & LOEJ_BIT_FIELD) != 0)
     {
         if((eject_indicator & START_BIT_FIELD) == true)
         {
-            mediaEjectedState = false;
+            context->lun->ejected = false;
         }
         else
         {
-            mediaEjectedState = true;
+            context->lun->ejected = true;
         }
     }
 
@@ -495,9 +561,9 @@ cy_en_usb_dev_status_t usb_scsi_read_10(cy_stc_usb_dev_msc_context_t *context)
 
     /* Read data from memory */
     if(context->dev_data_len == 0) {
-        len = (((context->bytes_to_transfer) < (CY_USB_DEV_MSC_MEDIA_PACKET)) ? (context->bytes_to_transfer) : (CY_USB_DEV_MSC_MEDIA_PACKET));
+        len = (((context->bytes_to_transfer) < (context->dev_data_size)) ? (context->bytes_to_transfer) : (context->dev_data_size));
         len = len / context->block_size;
-        if(CY_RSLT_SUCCESS != ((cy_stc_mass_storage_dev_t *)context->p_user_data)->read((context->start_location/context->block_size), context->dev_data_buf, &len)) {
+        if(BLK_DEV_OK != usb_scsi_media_read(context, (uint32_t) (context->start_location/context->block_size), &len)) {
             return CY_USB_DEV_REQUEST_NOT_HANDLED;
         }
         context->dev_data_addr = context->start_location;
@@ -521,15 +587,15 @@ cy_en_usb_dev_status_t usb_scsi_read_10(cy_stc_usb_dev_msc_context_t *context)
         } else {
             /* Allow reads from memory if the requested location is within the memory. */
             if(context->dev_data_len > 0) {
-                index = context->start_location - context->dev_data_addr;
+                index = (uint32_t) (context->start_location - context->dev_data_addr);
                 memcpy(context->in_buffer, &(context->dev_data_buf[index]), context->packet_in_size);
                 /* Check the data buffer */
-                uint32_t next_start = context->start_location + context->packet_in_size;
+                uint64_t next_start = context->start_location + context->packet_in_size;
                 if((next_start >= (context->dev_data_addr + context->dev_data_len)) && (0 < (context->bytes_to_transfer - context->packet_in_size))) {
                     uint32_t next_len = context->bytes_to_transfer - context->packet_in_size;
-                    len = (((next_len) < (CY_USB_DEV_MSC_MEDIA_PACKET)) ? (next_len) : (CY_USB_DEV_MSC_MEDIA_PACKET));
+                    len = (((next_len) < (context->dev_data_size)) ? (next_len) : (context->dev_data_size));
                     len = len / context->block_size;
-                    if(CY_RSLT_SUCCESS != ((cy_stc_mass_storage_dev_t *)context->p_user_data)->read((next_start/context->block_size), context->dev_data_buf, &len)) {
+                    if(BLK_DEV_OK != usb_scsi_media_read(context, (uint32_t) (next_start/context->block_size), &len)) {
                         return CY_USB_DEV_REQUEST_NOT_HANDLED;
                     }
                     context->dev_data_addr = next_start;
@@ -561,7 +627,7 @@ void usb_scsi_write_10(cy_stc_usb_dev_msc_context_t *context)
 {
     /* Get the data length of written */
     if(context->dev_data_len == 0) {
-        context->dev_data_wr_len = (((context->bytes_to_transfer) < (CY_USB_DEV_MSC_MEDIA_PACKET)) ? (context->bytes_to_transfer) : (CY_USB_DEV_MSC_MEDIA_PACKET));
+        context->dev_data_wr_len = (((context->bytes_to_transfer) < (context->dev_data_size)) ? (context->bytes_to_transfer) : (context->dev_data_size));
         context->dev_data_addr = context->start_location;
     }
     /* Copy the USB data to buffer */
@@ -571,7 +637,10 @@ void usb_scsi_write_10(cy_stc_usb_dev_msc_context_t *context)
         /* Write data to memory */
         if(context->dev_data_len >= context->dev_data_wr_len) {
             uint32_t len = context->dev_data_wr_len / context->block_size;
-            if(CY_RSLT_SUCCESS != ((cy_stc_mass_storage_dev_t *)context->p_user_data)->write((context->dev_data_addr/context->block_size), context->dev_data_buf, &len)) {
+            if (context->lun->virt_files) {
+                virt_file_invalidate((uint32_t) (context->dev_data_addr/context->block_size), len);
+            }
+            if(BLK_DEV_OK != blk_dev_write(context->lun->dev, (uint32_t) (context->dev_data_addr/context->block_size), context->dev_data_buf, &len)) {
                 return ;
             }
             context->dev_data_len = 0;
@@ -48,8 +48,6 @@
 /*******************************************************************************
 * Constants
 ********************************************************************************/
-#define MSC_BLOCKSIZE                               512
-
 #define STATUS_FILE_TIMEOUT                         200
 
 /* Start Stop Unit */
@@ -90,18 +88,13 @@
 #define FORMAT_CAP_LIST_LENGTH                      0x08
 #define FORMAT_CAP_FORMATTED_MEDIA                  0x02
 
-/*******************************************************************************
-* Extern Global Variables
-*******************************************************************************/
-extern uint8_t forceOS;
-extern volatile bool storageRemovedFlag;
-
 /*******************************************************************************
 * Function Prototypes
 ********************************************************************************/
-void usb_scsi_serve_timeout(void);
-cy_en_usb_dev_status_t usb_scsi_prevent_media_removal(uint8_t prevent);
-cy_en_usb_dev_status_t usb_scsi_test_unit_ready(void);
+bool usb_scsi_select_lun(cy_stc_usb_dev_msc_context_t *context, uint8_t lun);
+void usb_scsi_serve_timeout(cy_stc_usb_dev_msc_context_t *context);
+cy_en_usb_dev_status_t usb_scsi_prevent_media_removal(cy_stc_usb_dev_msc_context_t *context, uint8_t prevent);
+cy_en_usb_dev_status_t usb_scsi_test_unit_ready(cy_stc_usb_dev_msc_context_t *context);
 cy_en_usb_dev_status_t usb_scsi_request_sense(cy_stc_usb_dev_msc_context_t *context);
 cy_en_usb_dev_status_t usb_scsi_format_unit(cy_stc_usb_dev_msc_context_t *context);
 cy_en_usb_dev_status_t usb_scsi_inquiry(cy_stc_usb_dev_msc_context_t *context);
@@ -109,7 +102,7 @@ cy_en_usb_dev_status_t usb_scsi_mode_select_6(cy_stc_usb_dev_msc_context_t *cont
 cy_en_usb_dev_status_t usb_scsi_mode_sense_6(cy_stc_usb_dev_msc_context_t *context);
 cy_en_usb_dev_status_t usb_scsi_mode_select_10(cy_stc_usb_dev_msc_context_t *context);
 cy_en_usb_dev_status_t usb_scsi_mode_sense_10(cy_stc_usb_dev_msc_context_t *context);
-cy_en_usb_dev_status_t usb_scsi_start_stop_unit(uint8_t eject_indicator);
+cy_en_usb_dev_status_t usb_scsi_start_stop_unit(cy_stc_usb_dev_msc_context_t *context, uint8_t eject_indicator);
 cy_en_usb_dev_status_t usb_scsi_read_format_capacities(cy_stc_usb_dev_msc_context_t *context);
 cy_en_usb_dev_status_t usb_scsi_read_capacity(cy_stc_usb_dev_msc_context_t *context);
 cy_en_usb_dev_status_t usb_scsi_read_capacity(cy_stc_usb_dev_msc_context_t *context);
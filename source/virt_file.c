@@ -0,0 +1,262 @@
+/*****************************************************************************
+* File Name: virt_file.c
+*
+* Description:
+*  This file provides the source code to expose virtual files on the drive.
+*  A placeholder file is allocated on the file system, and the USB reads of
+*  its sectors are served from a callback instead of the memory.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "virt_file.h"
+#include "ff.h"
+
+#include <string.h>
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef struct
+{
+    const char *name;
+    uint32_t size;
+    virt_file_read_t read;
+    volatile uint32_t sector;       /* First sector of the placeholder */
+    volatile uint32_t sector_num;   /* Number of sectors, zero if not mapped */
+} virt_file_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static virt_file_t virt_files[VIRT_FILE_MAX_NUM];
+static uint32_t virt_file_num = 0;
+
+/*******************************************************************************
+* Function Name: virt_file_register
+********************************************************************************
+* Summary:
+*   Register a virtual file. It appears on the drive at the next mount.
+*
+* Parameters:
+*   name = file name in the root folder
+*   size = file size in bytes
+*   read = callback generating the file content
+*
+* Return:
+*   Return true if success, false if no more virtual files are available.
+*
+*******************************************************************************/
+bool virt_file_register(const char *name, uint32_t size, virt_file_read_t read)
+{
+    if (virt_file_num >= VIRT_FILE_MAX_NUM)
+    {
+        return false;
+    }
+
+    virt_files[virt_file_num].name = name;
+    virt_files[virt_file_num].size = size;
+    virt_files[virt_file_num].read = read;
+    virt_files[virt_file_num].sector_num = 0;
+    virt_file_num++;
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: virt_file_mount
+********************************************************************************
+* Summary:
+*   Create the read-only placeholder files on a contiguous set of clusters
+*   and map their sectors. Must be called with the file system mounted.
+*
+*******************************************************************************/
+void virt_file_mount(void)
+{
+    FRESULT result;
+    FIL fp;
+    FATFS *fs;
+    uint32_t sector_size;
+    uint32_t index;
+
+    for (index = 0; index < virt_file_num; index++)
+    {
+        virt_file_t *file = &virt_files[index];
+
+        file->sector_num = 0;
+
+        /* Allow the placeholder of the previous mount to be recreated */
+        f_chmod(file->name, 0, AM_RDO);
+
+        result = f_open(&fp, file->name, FA_CREATE_ALWAYS | FA_WRITE);
+        if (result != FR_OK)
+        {
+            continue;
+        }
+
+        /* Allocate contiguous clusters, the content is never written */
+        result = f_expand(&fp, file->size, 1);
+        if (result == FR_OK)
+        {
+            fs = fp.obj.fs;
+#if FF_MAX_SS == FF_MIN_SS
+            sector_size = FF_MAX_SS;
+#else
+            sector_size = fs->ssize;
+#endif
+            file->sector = (uint32_t) (fs->database + ((LBA_t) (fp.obj.sclust - 2u) * fs->csize));
+        }
+        f_close(&fp);
+
+        if (result == FR_OK)
+        {
+            f_chmod(file->name, AM_RDO, AM_RDO);
+            file->sector_num = (file->size + sector_size - 1u) / sector_size;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: virt_file_covers
+********************************************************************************
+* Summary:
+*   Check if a range of sectors is entirely served by a virtual file, in which
+*   case the memory does not need to be read.
+*
+* Parameters:
+*   blk_addr = first sector
+*   blk_len = number of sectors
+*
+*******************************************************************************/
+bool virt_file_covers(uint32_t blk_addr, uint32_t blk_len)
+{
+    uint32_t index;
+
+    for (index = 0; index < virt_file_num; index++)
+    {
+        const virt_file_t *file = &virt_files[index];
+
+        if ((file->sector_num != 0) && (blk_addr >= file->sector) &&
+            ((blk_addr + blk_len) <= (file->sector + file->sector_num)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: virt_file_overlay
+********************************************************************************
+* Summary:
+*   Replace the content of the sectors mapped to virtual files with the
+*   generated content. Called from the USB interrupts.
+*
+* Parameters:
+*   blk_addr = first sector of the buffer
+*   blk_len = number of sectors in the buffer
+*   block_size = size of a sector in bytes
+*   buf = buffer holding the sectors read from the memory
+*
+*******************************************************************************/
+void virt_file_overlay(uint32_t blk_addr, uint32_t blk_len, uint32_t block_size, uint8_t *buf)
+{
+    uint32_t index;
+
+    for (index = 0; index < virt_file_num; index++)
+    {
+        const virt_file_t *file = &virt_files[index];
+        uint32_t first = file->sector;
+        uint32_t last = file->sector + file->sector_num;
+        uint32_t len;
+        uint32_t count;
+
+        if (file->sector_num == 0)
+        {
+            continue;
+        }
+
+        if (first < blk_addr)
+        {
+            first = blk_addr;
+        }
+        if (last > (blk_addr + blk_len))
+        {
+            last = blk_addr + blk_len;
+        }
+        if (first >= last)
+        {
+            continue;
+        }
+
+        len = (last - first) * block_size;
+        count = file->read((first - file->sector) * block_size,
+                           &buf[(first - blk_addr) * block_size], len);
+
+        /* Clear the slack past the end of the file */
+        if (count < len)
+        {
+            memset(&buf[((first - blk_addr) * block_size) + count], 0, len - count);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: virt_file_invalidate
+********************************************************************************
+* Summary:
+*   Unmap the virtual files overlapping sectors written by the host. The host
+*   only writes there if it deleted the placeholder and reused its clusters.
+*
+* Parameters:
+*   blk_addr = first sector
+*   blk_len = number of sectors
+*
+*******************************************************************************/
+void virt_file_invalidate(uint32_t blk_addr, uint32_t blk_len)
+{
+    uint32_t index;
+
+    for (index = 0; index < virt_file_num; index++)
+    {
+        virt_file_t *file = &virt_files[index];
+
+        if ((file->sector_num != 0) && (blk_addr < (file->sector + file->sector_num)) &&
+            (file->sector < (blk_addr + blk_len)))
+        {
+            file->sector_num = 0;
+        }
+    }
+}
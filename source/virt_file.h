@@ -0,0 +1,66 @@
+/*****************************************************************************
+* File Name: virt_file.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the virt_file.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef VIRT_FILE_H_
+#define VIRT_FILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define VIRT_FILE_MAX_NUM       4u
+
+/* Callback to generate the content of a virtual file. Must fill len bytes */
+typedef uint32_t (*virt_file_read_t)(uint32_t offset, uint8_t *buf, uint32_t len);
+
+/*******************************************************************************
+* Functions
+********************************************************************************/
+bool virt_file_register(const char *name, uint32_t size, virt_file_read_t read);
+void virt_file_mount(void);
+bool virt_file_covers(uint32_t blk_addr, uint32_t blk_len);
+void virt_file_overlay(uint32_t blk_addr, uint32_t blk_len, uint32_t block_size, uint8_t *buf);
+void virt_file_invalidate(uint32_t blk_addr, uint32_t blk_len);
+
+#endif /* VIRT_FILE_H_ */
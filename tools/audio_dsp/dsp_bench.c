@@ -0,0 +1,317 @@
+/*****************************************************************************
+* File Name: dsp_bench.c
+*
+* Description:
+*  This file contains a host benchmark and check of the recorder
+*  conditioning stage (source/audio_dsp.c). A test signal with a DC offset,
+*  rumble, tones and near full-scale segments is processed in blocks of the
+*  PCM ring size by the SIMD path and by the scalar reference, which must
+*  give the same samples for every configuration. The benchmark reports the
+*  time of both paths in CPU cycles per sample on the host, and the response
+*  of the filter: DC residual, 20 Hz attenuation and 1 kHz gain.
+*
+*  On a host without the DSP extension the SIMD path runs on the C emulation
+*  of the instructions, so only its results are meaningful, not its speed.
+*  The cycles on the target are measured with TRACE_ID_AUDIO_DSP.
+*
+*  Build on Linux from this folder:
+*    gcc -O2 -DAUDIO_DSP_SIMD_EMULATE -I.. -I../../source -o dsp_bench dsp_bench.c
+*        ../../source/audio_dsp.c -lm
+*
+*  Usage: dsp_bench [-s seconds]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "audio_dsp.h"
+#include "audio_in.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define DEFAULT_SECONDS         20u
+#define BENCH_RATE              48000u      /* CONFIG_DEFAULT_SAMPLE_RATE */
+#define BENCH_HIGH_PASS         80u         /* CONFIG_DEFAULT_HIGH_PASS */
+#define BENCH_RUNS              5u
+#define TONE_SECONDS            2u
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static const uint32_t check_rates[] = {8000u, 16000u, 22050u, 44100u, 48000u};
+static const uint32_t check_high_pass[] = {0u, 80u, 200u};
+static const int32_t check_gains[] = {-12, 0, 6, 18};
+
+/*******************************************************************************
+* Function Name: make_signal
+********************************************************************************
+* Summary:
+*   Test signal: a DC offset, 30 Hz rumble, tones and noise, with a segment
+*   close to full scale and one clipped, different on each channel.
+*
+*******************************************************************************/
+static void make_signal(int16_t *pcm, uint32_t frames, uint32_t rate, uint32_t channels)
+{
+    uint32_t frame;
+    uint32_t channel;
+    uint32_t seed = 1;
+    double t;
+    double scale;
+    double value;
+
+    for (frame = 0; frame < frames; frame++)
+    {
+        t = (double) frame / rate;
+        scale = ((frame / rate) % 5u == 3u) ? 4.0 : (((frame / rate) % 5u == 4u) ? 8.0 : 1.0);
+        for (channel = 0; channel < channels; channel++)
+        {
+            value = 900.0 - 1800.0 * channel +
+                    2000.0 * sin(2.0 * PI * 30.0 * t) +
+                    scale * (3000.0 * sin(2.0 * PI * (220.0 + 110.0 * channel) * t) +
+                             1500.0 * sin(2.0 * PI * 1870.0 * t + channel)) +
+                    (double) (bench_rand(&seed) % 400 - 200);
+            value = (value > 32767.0) ? 32767.0 : ((value < -32768.0) ? -32768.0 : value);
+            pcm[frame * channels + channel] = (int16_t) value;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: process
+********************************************************************************
+* Summary:
+*   Process a signal in place in ring blocks, by the SIMD path or by the
+*   scalar reference.
+*
+* Return:
+*   Time of the processing.
+*
+*******************************************************************************/
+static uint64_t process(audio_dsp_t *dsp, uint8_t *buf, uint32_t len, bool ref)
+{
+    uint32_t pos;
+    uint32_t size;
+    uint64_t start = cycles();
+
+    for (pos = 0; pos < len; pos += size)
+    {
+        size = ((len - pos) < PCM_BLOCK_SIZE) ? (len - pos) : PCM_BLOCK_SIZE;
+        if (ref)
+        {
+            audio_dsp_process_ref(dsp, &buf[pos], size);
+        }
+        else
+        {
+            audio_dsp_process(dsp, &buf[pos], size);
+        }
+    }
+    return cycles() - start;
+}
+
+/*******************************************************************************
+* Function Name: tone_db
+********************************************************************************
+* Summary:
+*   Gain of the stage for a tone, or the DC residual in LSB if freq is 0.
+*   The first half of the signal lets the filter settle.
+*
+*******************************************************************************/
+static double tone_db(uint32_t rate, double freq, uint32_t high_pass, int32_t gain_db)
+{
+    uint32_t frames = rate * TONE_SECONDS;
+    uint32_t frame;
+    int16_t *pcm = malloc((size_t) frames * sizeof(int16_t));
+    double in = 0;
+    double out = 0;
+    double value;
+    audio_dsp_t dsp;
+
+    for (frame = 0; frame < frames; frame++)
+    {
+        value = (freq > 0) ? (8000.0 * sin(2.0 * PI * freq * frame / rate)) : 1000.0;
+        pcm[frame] = (int16_t) lrint(value);
+        if (frame >= (frames / 2u))
+        {
+            in += value * value;
+        }
+    }
+
+    audio_dsp_init(&dsp, rate, 1u, high_pass, gain_db);
+    process(&dsp, (uint8_t *) pcm, frames * sizeof(int16_t), false);
+    for (frame = frames / 2u; frame < frames; frame++)
+    {
+        out += (freq > 0) ? ((double) pcm[frame] * pcm[frame]) : pcm[frame];
+    }
+    free(pcm);
+
+    return (freq > 0) ? (10.0 * log10(out / in)) : (out / (frames - frames / 2u));
+}
+
+/*******************************************************************************
+* Function Name: check
+********************************************************************************
+* Summary:
+*   Compare the SIMD path against the scalar reference on the test signal.
+*
+* Return:
+*   True if the samples are the same.
+*
+*******************************************************************************/
+static bool check(uint32_t rate, uint32_t channels, uint32_t high_pass, int32_t gain_db, uint32_t seconds)
+{
+    uint32_t frames = rate * seconds + 1u;  /* Odd, for the last frame */
+    uint32_t len = frames * channels * sizeof(int16_t);
+    int16_t *pcm = malloc(len);
+    int16_t *ref = malloc(len);
+    audio_dsp_t dsp;
+    audio_dsp_t dsp_ref;
+    bool same;
+
+    make_signal(pcm, frames, rate, channels);
+    memcpy(ref, pcm, len);
+    audio_dsp_init(&dsp, rate, channels, high_pass, gain_db);
+    audio_dsp_init(&dsp_ref, rate, channels, high_pass, gain_db);
+    process(&dsp, (uint8_t *) pcm, len, false);
+    process(&dsp_ref, (uint8_t *) ref, len, true);
+    same = (memcmp(pcm, ref, len) == 0);
+    free(pcm);
+    free(ref);
+
+    return same;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = DEFAULT_SECONDS;
+    uint32_t channels;
+    uint32_t frames;
+    uint32_t len;
+    uint32_t run;
+    uint32_t index;
+    uint32_t hp;
+    uint32_t gain;
+    uint32_t checks = 0;
+    uint32_t failures = 0;
+    uint64_t time;
+    uint64_t best[2];
+    int16_t *pcm;
+    uint8_t *buf;
+    audio_dsp_t dsp;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': seconds = (uint32_t) atoi(optarg); break;
+            default:
+                printf("usage: %s [-s seconds]\n", argv[0]);
+                return 1;
+        }
+    }
+#if !defined(__ARM_FEATURE_DSP) && !defined(AUDIO_DSP_SIMD_EMULATE)
+    printf("SIMD path not built, add -DAUDIO_DSP_SIMD_EMULATE\n");
+#endif
+
+    /* Time of both paths at the default configuration, fastest run */
+    for (channels = 1u; channels <= AUDIO_DSP_CHANNELS_MAX; channels++)
+    {
+        frames = BENCH_RATE * seconds;
+        len = frames * channels * sizeof(int16_t);
+        pcm = malloc(len);
+        buf = malloc(len);
+        make_signal(pcm, frames, BENCH_RATE, channels);
+        for (index = 0; index < 2u; index++)
+        {
+            best[index] = UINT64_MAX;
+            for (run = 0; run < BENCH_RUNS; run++)
+            {
+                memcpy(buf, pcm, len);
+                audio_dsp_init(&dsp, BENCH_RATE, channels, BENCH_HIGH_PASS, 6);
+                time = process(&dsp, buf, len, (index != 0u));
+                best[index] = (time < best[index]) ? time : best[index];
+            }
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        printf("%u Hz x %u: simd %.1f, ref %.1f cycles per sample (host)\n", BENCH_RATE, channels,
+#else
+        printf("%u Hz x %u: simd %.1f, ref %.1f ns per sample (host)\n", BENCH_RATE, channels,
+#endif
+               (double) best[0] / ((double) frames * channels), (double) best[1] / ((double) frames * channels));
+        free(pcm);
+        free(buf);
+    }
+
+    /* Response at the default configuration */
+    printf("DC residual: %.2f LSB, 1000 LSB in\n", tone_db(BENCH_RATE, 0, BENCH_HIGH_PASS, 0));
+    printf("20 Hz:       %.1f dB\n", tone_db(BENCH_RATE, 20.0, BENCH_HIGH_PASS, 0));
+    printf("80 Hz:       %.1f dB\n", tone_db(BENCH_RATE, 80.0, BENCH_HIGH_PASS, 0));
+    printf("1 kHz:       %.2f dB, %.2f dB with 6 dB gain\n", tone_db(BENCH_RATE, 1000.0, BENCH_HIGH_PASS, 0),
+           tone_db(BENCH_RATE, 1000.0, BENCH_HIGH_PASS, 6));
+
+    /* Same samples on both paths for every configuration */
+    for (index = 0; index < (sizeof(check_rates) / sizeof(check_rates[0])); index++)
+    {
+        for (channels = 1u; channels <= AUDIO_DSP_CHANNELS_MAX; channels++)
+        {
+            for (hp = 0; hp < (sizeof(check_high_pass) / sizeof(check_high_pass[0])); hp++)
+            {
+                for (gain = 0; gain < (sizeof(check_gains) / sizeof(check_gains[0])); gain++)
+                {
+                    checks++;
+                    if (!check(check_rates[index], channels, check_high_pass[hp], check_gains[gain], 5u))
+                    {
+                        failures++;
+                        printf("DIFFERENT: %u Hz x %u, high-pass %u Hz, gain %d dB\n", check_rates[index],
+                               channels, check_high_pass[hp], (int) check_gains[gain]);
+                    }
+                }
+            }
+        }
+    }
+    printf("simd vs ref: %u of %u configurations the same\n", checks - failures, checks);
+
+    return (failures == 0u) ? 0 : 1;
+}
+
+/* [] END OF FILE */
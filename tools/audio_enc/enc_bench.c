@@ -0,0 +1,327 @@
+/*****************************************************************************
+* File Name: enc_bench.c
+*
+* Description:
+*  This file contains a host benchmark of the recorder encoding stage
+*  (source/audio_enc.c). A test signal, or a raw 16-bit PCM file, is
+*  encoded in place in blocks of the PCM ring size, as audio_in_task() does.
+*  The benchmark reports the encode time in CPU cycles per sample on the
+*  host, the record bitrate against raw PCM, and the signal-to-noise ratio
+*  of the decoded samples. It also checks that encoding in blocks of
+*  random sizes gives the same data, and can write the WAV file.
+*
+*  Build on Linux from this folder:
+*    gcc -O2 -I.. -I../../source -o enc_bench enc_bench.c ../../source/audio_enc.c
+*        ../../source/audio_flac.c -lm
+*
+*  Usage: enc_bench [-f raw file] [-r rate] [-c channels] [-s seconds]
+*                   [-o wav file]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "audio_enc.h"
+#include "audio_in.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define DEFAULT_SAMPLE_RATE     48000u      /* CONFIG_DEFAULT_SAMPLE_RATE */
+#define DEFAULT_CHANNELS        2u
+#define DEFAULT_SECONDS         60u
+#define BENCH_RUNS              5u
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static const int16_t ima_steps[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t ima_index_adjust[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/*******************************************************************************
+* Function Name: decode
+********************************************************************************
+* Summary:
+*   Decode the IMA-ADPCM blocks of a record.
+*
+* Return:
+*   Number of frames decoded.
+*
+*******************************************************************************/
+static uint32_t decode(const audio_enc_t *enc, const uint8_t *data, uint32_t len, int16_t *pcm)
+{
+    int32_t predictor[AUDIO_ENC_CHANNELS_MAX];
+    int32_t index[AUDIO_ENC_CHANNELS_MAX];
+    uint32_t frames = 0;
+    uint32_t block;
+    uint32_t channel;
+    uint32_t group;
+    uint32_t pos;
+    uint32_t sample;
+    int32_t step;
+    int32_t delta;
+    uint8_t code;
+
+    for (block = 0; (block + enc->block_align) <= len; block += enc->block_align)
+    {
+        pos = block;
+        for (channel = 0; channel < enc->channels; channel++)
+        {
+            predictor[channel] = (int16_t) (data[pos] | (data[pos + 1u] << 8));
+            index[channel] = data[pos + 2u];
+            pcm[frames * enc->channels + channel] = (int16_t) predictor[channel];
+            pos += 4u;
+        }
+        frames++;
+        for (group = 1; group < enc->block_frames; group += AUDIO_ENC_IMA_GROUP)
+        {
+            for (channel = 0; channel < enc->channels; channel++)
+            {
+                for (sample = 0; sample < AUDIO_ENC_IMA_GROUP; sample++)
+                {
+                    code = (data[pos + (sample / 2u)] >> ((sample % 2u) * 4u)) & 0x0Fu;
+                    step = ima_steps[index[channel]];
+                    delta = step >> 3;
+                    delta += (code & 4) ? step : 0;
+                    delta += (code & 2) ? (step >> 1) : 0;
+                    delta += (code & 1) ? (step >> 2) : 0;
+                    predictor[channel] += (code & 8) ? -delta : delta;
+                    predictor[channel] = (predictor[channel] > 32767) ? 32767 :
+                                         ((predictor[channel] < -32768) ? -32768 : predictor[channel]);
+                    index[channel] += ima_index_adjust[code];
+                    index[channel] = (index[channel] < 0) ? 0 : ((index[channel] > 88) ? 88 : index[channel]);
+                    pcm[(frames + sample) * enc->channels + channel] = (int16_t) predictor[channel];
+                }
+                pos += 4u;
+            }
+            frames += AUDIO_ENC_IMA_GROUP;
+        }
+    }
+    return frames;
+}
+
+/*******************************************************************************
+* Function Name: encode
+********************************************************************************
+* Summary:
+*   Encode a signal in place, in chunks of a fixed size or of random sizes,
+*   and complete the last block.
+*
+* Return:
+*   Length of the encoded data, compacted at the start of buf.
+*
+*******************************************************************************/
+static uint32_t encode(audio_enc_t *enc, uint8_t *buf, uint32_t len, uint32_t chunk, uint64_t *time)
+{
+    uint32_t frame_size = enc->channels * sizeof(int16_t);
+    uint32_t pos = 0;
+    uint32_t out = 0;
+    uint32_t size;
+    uint32_t coded;
+    uint64_t start;
+
+    srand(1);
+    while (pos < len)
+    {
+        size = (chunk != 0) ? chunk : ((((uint32_t) rand() % 4096u) + 1u) * frame_size);
+        size = ((len - pos) < size) ? (len - pos) : size;
+
+        start = cycles();
+        coded = audio_enc_process(enc, &buf[pos], size);
+        *time += cycles() - start;
+
+        /* Append the encoded data, as the record file does */
+        memmove(&buf[out], &buf[pos], coded);
+        out += coded;
+        pos += size;
+    }
+    return out + audio_enc_finish(enc, &buf[out]);
+}
+
+/*******************************************************************************
+* Function Name: snr_db
+********************************************************************************
+* Summary:
+*   Signal-to-noise ratio of the decoded samples.
+*
+*******************************************************************************/
+static double snr_db(const int16_t *ref, const int16_t *dec, uint32_t samples)
+{
+    double signal = 0;
+    double noise = 0;
+    uint32_t index;
+
+    for (index = 0; index < samples; index++)
+    {
+        signal += (double) ref[index] * ref[index];
+        noise += (double) (ref[index] - dec[index]) * (ref[index] - dec[index]);
+    }
+    return (noise > 0) ? (10.0 * log10(signal / noise)) : INFINITY;
+}
+
+int main(int argc, char **argv)
+{
+    const char *raw_path = NULL;
+    const char *wav_path = NULL;
+    uint32_t rate = DEFAULT_SAMPLE_RATE;
+    uint32_t channels = DEFAULT_CHANNELS;
+    uint32_t seconds = DEFAULT_SECONDS;
+    uint8_t header[AUDIO_ENC_WAV_HEADER_SIZE];
+    audio_enc_t enc;
+    int16_t *pcm;
+    int16_t *decoded;
+    uint8_t *buf;
+    uint8_t *check;
+    uint32_t frames;
+    uint32_t len;
+    uint32_t coded = 0;
+    uint32_t check_len;
+    uint32_t run;
+    uint64_t time;
+    uint64_t best = UINT64_MAX;
+    FILE *fp;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:r:c:s:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': raw_path = optarg; break;
+            case 'r': rate = (uint32_t) atoi(optarg); break;
+            case 'c': channels = (uint32_t) atoi(optarg); break;
+            case 's': seconds = (uint32_t) atoi(optarg); break;
+            case 'o': wav_path = optarg; break;
+            default:
+                printf("usage: %s [-f raw file] [-r rate] [-c channels] [-s seconds] [-o wav file]\n", argv[0]);
+                return 1;
+        }
+    }
+    if ((channels < 1u) || (channels > AUDIO_ENC_CHANNELS_MAX))
+    {
+        printf("channels: 1 or 2\n");
+        return 1;
+    }
+
+    /* Test signal, or the samples of a record */
+    if (raw_path != NULL)
+    {
+        fp = fopen(raw_path, "rb");
+        if ((fp == NULL) || (fseek(fp, 0, SEEK_END) != 0))
+        {
+            perror(raw_path);
+            return 1;
+        }
+        frames = (uint32_t) (ftell(fp) / (long) (channels * sizeof(int16_t)));
+        rewind(fp);
+        pcm = malloc((size_t) frames * channels * sizeof(int16_t));
+        frames = (uint32_t) fread(pcm, channels * sizeof(int16_t), frames, fp);
+        fclose(fp);
+    }
+    else
+    {
+        frames = rate * seconds;
+        pcm = malloc((size_t) frames * channels * sizeof(int16_t));
+        bench_signal(pcm, frames, rate, channels);
+    }
+    len = frames * channels * sizeof(int16_t);
+    buf = malloc(len + AUDIO_ENC_IMA_BLOCK_SIZE * AUDIO_ENC_CHANNELS_MAX);
+    check = malloc(len + AUDIO_ENC_IMA_BLOCK_SIZE * AUDIO_ENC_CHANNELS_MAX);
+    decoded = calloc((size_t) frames + 2048u, channels * sizeof(int16_t));
+
+    /* Encode in ring blocks, keep the fastest run */
+    for (run = 0; run < BENCH_RUNS; run++)
+    {
+        memcpy(buf, pcm, len);
+        audio_enc_init(&enc, AUDIO_ENC_IMA_ADPCM, rate, channels);
+        time = 0;
+        coded = encode(&enc, buf, len, PCM_BLOCK_SIZE, &time);
+        best = (time < best) ? time : best;
+    }
+
+    /* Same data when encoded in chunks of random sizes */
+    memcpy(check, pcm, len);
+    audio_enc_init(&enc, AUDIO_ENC_IMA_ADPCM, rate, channels);
+    time = 0;
+    check_len = encode(&enc, check, len, 0, &time);
+
+    printf("%u Hz x %u, %.1f s, %u frames per %u-byte block\n", rate, channels, (double) frames / rate,
+           enc.block_frames, enc.block_align);
+#if defined(__x86_64__) || defined(__i386__)
+    printf("encode:    %.1f cycles per sample (host)\n", (double) best / ((double) frames * channels));
+#else
+    printf("encode:    %.1f ns per sample (host)\n", (double) best / ((double) frames * channels));
+#endif
+    printf("raw:       %.1f KB/s\n", (double) rate * channels * sizeof(int16_t) / 1024.0);
+    printf("adpcm:     %.1f KB/s, %.2fx smaller\n", (double) coded * rate / frames / 1024.0, (double) len / coded);
+    printf("SNR:       %.1f dB\n",
+           snr_db(pcm, decoded, decode(&enc, buf, coded, decoded) >= frames ? frames * channels : 0));
+    printf("chunking:  %s\n", ((check_len == coded) && (memcmp(check, buf, coded) == 0)) ? "same data" : "DIFFERENT");
+
+    if (wav_path != NULL)
+    {
+        fp = fopen(wav_path, "wb");
+        if ((fp == NULL) || (fwrite(header, 1, audio_enc_header(&enc, header), fp) != AUDIO_ENC_WAV_HEADER_SIZE) ||
+            (fwrite(buf, 1, coded, fp) != coded))
+        {
+            perror(wav_path);
+            return 1;
+        }
+        fclose(fp);
+    }
+
+    return ((check_len == coded) && (memcmp(check, buf, coded) == 0)) ? 0 : 1;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,965 @@
+/*****************************************************************************
+* File Name: flac_check.c
+*
+* Description:
+*  This file contains a host round-trip test of the lossless encoding of the
+*  recorder (source/audio_flac.c). Raw 16-bit PCM files, recorded by the kit
+*  or any other corpus, or a test signal, are encoded in place in blocks of
+*  the PCM ring size, as audio_in_task() does, then decoded by an independent
+*  FLAC decoder and compared sample by sample. The test reports the encode
+*  time in CPU cycles per sample on the host and the compression ratio of
+*  each file, decodes frames found from random file offsets as a seeking
+*  player does, and checks that encoding in blocks of random numbers of FLAC
+*  frames gives the same data. With -d, it verifies a FLAC record copied from the card:
+*  frame CRCs, frame numbers and STREAMINFO totals, and can write the samples.
+*
+*  Build on Linux from this folder:
+*    gcc -O2 -I.. -I../../source -o flac_check flac_check.c ../../source/audio_enc.c
+*        ../../source/audio_flac.c -lm
+*
+*  Usage: flac_check [-r rate] [-c channels] [-s seconds] [-n] [-o flac file]
+*                    [raw file...]
+*         flac_check -d flac file [-o raw file]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "audio_enc.h"
+#include "audio_in.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define DEFAULT_SAMPLE_RATE     48000u      /* CONFIG_DEFAULT_SAMPLE_RATE */
+#define DEFAULT_CHANNELS        2u
+#define DEFAULT_SECONDS         60u
+#define BENCH_RUNS              5u
+#define SEEK_TESTS              200u
+#define BLOCK_FRAMES_MAX        65536u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* MSB-first bit reader */
+typedef struct
+{
+    const uint8_t *data;
+    size_t len;
+    size_t pos;             /* In bits */
+    bool error;
+} reader_t;
+
+/* STREAMINFO fields */
+typedef struct
+{
+    uint32_t block_min;
+    uint32_t block_max;
+    uint32_t frame_size_min;
+    uint32_t frame_size_max;
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t bps;
+    uint64_t frames;
+    size_t   audio_start;   /* Offset of the first frame */
+} stream_t;
+
+/* Header of a frame */
+typedef struct
+{
+    uint32_t num;
+    uint32_t frames;
+    uint32_t sample_rate;
+    uint32_t assignment;
+} frame_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static const uint32_t frame_rates[12] =
+{
+    0u, 88200u, 176400u, 192000u, 8000u, 16000u, 22050u, 24000u, 32000u, 44100u, 48000u, 96000u
+};
+
+static int32_t subframe[AUDIO_FLAC_CHANNELS_MAX][BLOCK_FRAMES_MAX];
+
+/*******************************************************************************
+* Function Name: make_signal
+********************************************************************************
+* Summary:
+*   Test signal of bench.h, or full-scale white noise, which does not
+*   compress.
+*
+*******************************************************************************/
+static void make_signal(int16_t *pcm, uint32_t frames, uint32_t rate, uint32_t channels, bool noise)
+{
+    uint32_t sample;
+    uint32_t seed = 1;
+
+    if (!noise)
+    {
+        bench_signal(pcm, frames, rate, channels);
+        return;
+    }
+    for (sample = 0; sample < (frames * channels); sample++)
+    {
+        pcm[sample] = (int16_t) bench_rand(&seed);
+    }
+}
+
+/*******************************************************************************
+* Function Name: get
+********************************************************************************
+* Summary:
+*   Read up to 32 bits.
+*
+*******************************************************************************/
+static uint32_t get(reader_t *br, uint32_t bits)
+{
+    uint32_t value = 0;
+
+    if ((br->pos + bits) > (br->len * 8u))
+    {
+        br->error = true;
+        return 0;
+    }
+    while (bits-- > 0u)
+    {
+        value = (value << 1) | ((br->data[br->pos >> 3] >> (7u - (br->pos & 7u))) & 1u);
+        br->pos++;
+    }
+    return value;
+}
+
+/*******************************************************************************
+* Function Name: get_signed
+********************************************************************************
+* Summary:
+*   Read a two's complement value of up to 32 bits.
+*
+*******************************************************************************/
+static int32_t get_signed(reader_t *br, uint32_t bits)
+{
+    uint32_t value = get(br, bits);
+
+    if ((bits > 0u) && (bits < 32u) && (value & (1u << (bits - 1u))))
+    {
+        value |= ~((1u << bits) - 1u);
+    }
+    return (int32_t) value;
+}
+
+/*******************************************************************************
+* Function Name: get_unary
+********************************************************************************
+* Summary:
+*   Read the zeros before a one.
+*
+*******************************************************************************/
+static uint32_t get_unary(reader_t *br)
+{
+    uint32_t count = 0;
+
+    while (!br->error && (get(br, 1) == 0u))
+    {
+        count++;
+    }
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: crc8
+********************************************************************************
+* Summary:
+*   CRC-8 of a frame header, polynomial 0x07.
+*
+*******************************************************************************/
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0;
+    uint32_t bit;
+
+    while (len-- > 0u)
+    {
+        crc ^= *data++;
+        for (bit = 0; bit < 8u; bit++)
+        {
+            crc = (crc & 0x80u) ? ((crc << 1) ^ 0x07u) : (crc << 1);
+        }
+    }
+    return (uint8_t) crc;
+}
+
+/*******************************************************************************
+* Function Name: crc16
+********************************************************************************
+* Summary:
+*   CRC-16 of a frame, polynomial 0x8005.
+*
+*******************************************************************************/
+static uint16_t crc16(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0;
+    uint32_t bit;
+
+    while (len-- > 0u)
+    {
+        crc ^= (uint32_t) *data++ << 8;
+        for (bit = 0; bit < 8u; bit++)
+        {
+            crc = (crc & 0x8000u) ? ((crc << 1) ^ 0x8005u) : (crc << 1);
+        }
+    }
+    return (uint16_t) crc;
+}
+
+/*******************************************************************************
+* Function Name: parse_stream
+********************************************************************************
+* Summary:
+*   Read the "fLaC" marker and the metadata blocks.
+*
+* Return:
+*   False if the file is not a FLAC stream.
+*
+*******************************************************************************/
+static bool parse_stream(const uint8_t *data, size_t len, stream_t *stream)
+{
+    reader_t br = { data, len, 32u, false };
+    uint32_t last = 0;
+    uint32_t type;
+    uint32_t size;
+
+    memset(stream, 0, sizeof(stream_t));
+    if ((len < 4u) || (memcmp(data, "fLaC", 4u) != 0))
+    {
+        return false;
+    }
+
+    while (!last && !br.error)
+    {
+        last = get(&br, 1);
+        type = get(&br, 7);
+        size = get(&br, 24);
+        if (type == 0u)
+        {
+            stream->block_min = get(&br, 16);
+            stream->block_max = get(&br, 16);
+            stream->frame_size_min = get(&br, 24);
+            stream->frame_size_max = get(&br, 24);
+            stream->sample_rate = get(&br, 20);
+            stream->channels = get(&br, 3) + 1u;
+            stream->bps = get(&br, 5) + 1u;
+            stream->frames = (uint64_t) get(&br, 4) << 32;
+            stream->frames |= get(&br, 32);
+            br.pos += (size - 18u) * 8u;
+        }
+        else
+        {
+            br.pos += size * 8u;
+        }
+    }
+    stream->audio_start = br.pos / 8u;
+
+    return !br.error && (stream->channels > 0u) && (stream->channels <= AUDIO_FLAC_CHANNELS_MAX) &&
+           (stream->bps == 16u) && (stream->block_max <= BLOCK_FRAMES_MAX) && (stream->audio_start <= len);
+}
+
+/*******************************************************************************
+* Function Name: decode_residual
+********************************************************************************
+* Summary:
+*   Read the Rice-coded residuals of a subframe after its warm-up samples.
+*
+*******************************************************************************/
+static void decode_residual(reader_t *br, int32_t *out, uint32_t frames, uint32_t order)
+{
+    uint32_t method = get(br, 2);
+    uint32_t partition = get(br, 4);
+    uint32_t param_bits = (method == 0u) ? 4u : 5u;
+    uint32_t escape = (1u << param_bits) - 1u;
+    uint32_t count;
+    uint32_t index = order;
+    uint32_t part;
+    uint32_t param;
+    uint32_t raw;
+    uint32_t value;
+
+    if ((method > 1u) || ((frames >> partition) <= order) || ((frames & ((1u << partition) - 1u)) != 0u))
+    {
+        br->error = true;
+        return;
+    }
+
+    for (part = 0; (part < (1u << partition)) && !br->error; part++)
+    {
+        count = (frames >> partition) - ((part == 0u) ? order : 0u);
+        param = get(br, param_bits);
+        if (param == escape)
+        {
+            raw = get(br, 5);
+            while (count-- > 0u)
+            {
+                out[index++] = get_signed(br, raw);
+            }
+        }
+        else
+        {
+            while ((count-- > 0u) && !br->error)
+            {
+                value = (get_unary(br) << param) | get(br, param);
+                out[index++] = (int32_t) (value >> 1) ^ -(int32_t) (value & 1u);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: decode_subframe
+********************************************************************************
+* Summary:
+*   Decode a constant, verbatim, fixed or LPC subframe.
+*
+*******************************************************************************/
+static void decode_subframe(reader_t *br, int32_t *out, uint32_t frames, uint32_t bps)
+{
+    static const int32_t fixed[5][4] =
+    {
+        { 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 2, -1, 0, 0 }, { 3, -3, 1, 0 }, { 4, -6, 4, -1 }
+    };
+    int32_t coefs[32];
+    uint32_t type;
+    uint32_t wasted = 0;
+    uint32_t order;
+    uint32_t precision = 0;
+    int32_t shift = 0;
+    uint32_t index;
+    uint32_t tap;
+    int64_t sum;
+
+    if (get(br, 1) != 0u)
+    {
+        br->error = true;
+        return;
+    }
+    type = get(br, 6);
+    if (get(br, 1) != 0u)
+    {
+        wasted = get_unary(br) + 1u;
+        bps -= wasted;
+    }
+
+    if (type == 0u)
+    {
+        out[0] = get_signed(br, bps);
+        for (index = 1; index < frames; index++)
+        {
+            out[index] = out[0];
+        }
+    }
+    else if (type == 1u)
+    {
+        for (index = 0; index < frames; index++)
+        {
+            out[index] = get_signed(br, bps);
+        }
+    }
+    else if (((type >= 8u) && (type <= 12u)) || (type >= 32u))
+    {
+        order = (type >= 32u) ? ((type & 31u) + 1u) : (type & 7u);
+        if (order > frames)
+        {
+            br->error = true;
+            return;
+        }
+        for (index = 0; index < order; index++)
+        {
+            out[index] = get_signed(br, bps);
+        }
+        if (type >= 32u)
+        {
+            precision = get(br, 4) + 1u;
+            shift = get_signed(br, 5);
+            for (tap = 0; tap < order; tap++)
+            {
+                coefs[tap] = get_signed(br, precision);
+            }
+        }
+        else
+        {
+            for (tap = 0; tap < order; tap++)
+            {
+                coefs[tap] = fixed[order][tap];
+            }
+        }
+        decode_residual(br, out, frames, order);
+
+        for (index = order; (index < frames) && !br->error; index++)
+        {
+            sum = 0;
+            for (tap = 0; tap < order; tap++)
+            {
+                sum += (int64_t) coefs[tap] * out[index - tap - 1u];
+            }
+            out[index] += (int32_t) (sum >> shift);
+        }
+    }
+    else
+    {
+        br->error = true;
+    }
+
+    for (index = 0; (wasted > 0u) && (index < frames); index++)
+    {
+        out[index] = (int32_t) ((uint32_t) out[index] << wasted);
+    }
+}
+
+/*******************************************************************************
+* Function Name: decode_frame
+********************************************************************************
+* Summary:
+*   Decode the frame at an offset, and check its CRCs.
+*
+* Return:
+*   Length of the frame, 0 if it is not a valid frame.
+*
+*******************************************************************************/
+static size_t decode_frame(const uint8_t *data, size_t len, size_t offset, const stream_t *stream,
+                           frame_t *frame, int16_t *pcm)
+{
+    reader_t br = { data, len, offset * 8u, false };
+    uint32_t code;
+    uint32_t rate_code;
+    uint32_t size_code;
+    uint32_t bytes;
+    uint32_t channel;
+    uint32_t channels;
+    uint32_t index;
+    int32_t mid;
+    int32_t side;
+
+    if ((get(&br, 15) != 0x7FFCu) || (get(&br, 1) != 0u))
+    {
+        return 0;
+    }
+    code = get(&br, 4);
+    rate_code = get(&br, 4);
+    frame->assignment = get(&br, 4);
+    size_code = get(&br, 3);
+    if ((code == 0u) || (rate_code == 0xFu) || (frame->assignment > 10u) || (get(&br, 1) != 0u) ||
+        ((size_code != 0u) && (size_code != 4u)))
+    {
+        return 0;
+    }
+
+    /* Frame number, coded as UTF-8 */
+    frame->num = get(&br, 8);
+    for (bytes = 0; (bytes < 7u) && (frame->num & (0x80u >> bytes)); bytes++)
+    {
+    }
+    if ((bytes == 1u) || (bytes > 6u))
+    {
+        return 0;
+    }
+    frame->num &= (0x7Fu >> bytes);
+    for (index = 1; index < bytes; index++)
+    {
+        channel = get(&br, 8);
+        if ((channel & 0xC0u) != 0x80u)
+        {
+            return 0;
+        }
+        frame->num = (frame->num << 6) | (channel & 0x3Fu);
+    }
+
+    frame->frames = (code == 1u) ? 192u :
+                    (code <= 5u) ? (576u << (code - 2u)) :
+                    (code == 6u) ? (get(&br, 8) + 1u) :
+                    (code == 7u) ? (get(&br, 16) + 1u) : (256u << (code - 8u));
+    frame->sample_rate = (rate_code == 0u) ? stream->sample_rate :
+                         (rate_code < 12u) ? frame_rates[rate_code] :
+                         (rate_code == 12u) ? (get(&br, 8) * 1000u) :
+                         (rate_code == 13u) ? get(&br, 16) : (get(&br, 16) * 10u);
+    if (br.error || (get(&br, 8) != crc8(&data[offset], (br.pos / 8u) - offset - 1u)) ||
+        (frame->frames > BLOCK_FRAMES_MAX))
+    {
+        return 0;
+    }
+
+    channels = (frame->assignment < 8u) ? (frame->assignment + 1u) : 2u;
+    if (channels != stream->channels)
+    {
+        return 0;
+    }
+    for (channel = 0; channel < channels; channel++)
+    {
+        /* The side channel has one more bit */
+        decode_subframe(&br, subframe[channel], frame->frames,
+                        stream->bps + ((((frame->assignment == 8u) || (frame->assignment == 10u)) && (channel == 1u)) ||
+                                       ((frame->assignment == 9u) && (channel == 0u)) ? 1u : 0u));
+    }
+    br.pos = (br.pos + 7u) & ~(size_t) 7u;
+    if (br.error || (get(&br, 16) != crc16(&data[offset], (br.pos / 8u) - offset - 2u)))
+    {
+        return 0;
+    }
+
+    for (index = 0; index < frame->frames; index++)
+    {
+        switch (frame->assignment)
+        {
+            case 8u:
+                subframe[1][index] = subframe[0][index] - subframe[1][index];
+                break;
+            case 9u:
+                subframe[0][index] += subframe[1][index];
+                break;
+            case 10u:
+                side = subframe[1][index];
+                mid = (int32_t) ((uint32_t) subframe[0][index] << 1) | (side & 1);
+                subframe[0][index] = (mid + side) >> 1;
+                subframe[1][index] = (mid - side) >> 1;
+                break;
+            default:
+                break;
+        }
+        for (channel = 0; channel < channels; channel++)
+        {
+            pcm[(index * channels) + channel] = (int16_t) subframe[channel][index];
+        }
+    }
+
+    return (br.pos / 8u) - offset;
+}
+
+/*******************************************************************************
+* Function Name: decode_stream
+********************************************************************************
+* Summary:
+*   Decode all the frames of a stream, and check their numbers and sizes
+*   against STREAMINFO.
+*
+* Return:
+*   Number of frames (samples per channel) decoded, or -1 on an error.
+*
+*******************************************************************************/
+static int64_t decode_stream(const uint8_t *data, size_t len, const stream_t *stream, int16_t *pcm, bool verbose)
+{
+    frame_t frame;
+    size_t offset = stream->audio_start;
+    size_t size;
+    uint64_t frames = 0;
+    uint32_t num = 0;
+
+    while (offset < len)
+    {
+        size = decode_frame(data, len, offset, stream, &frame, &pcm[frames * stream->channels]);
+        if (size == 0u)
+        {
+            if (verbose)
+            {
+                printf("frame %u at offset %zu: bad header, data or CRC\n", num, offset);
+            }
+            return -1;
+        }
+        if ((frame.num != num) || (frame.sample_rate != stream->sample_rate) ||
+            (frame.frames > stream->block_max) || ((frame.frames < stream->block_min) && ((offset + size) < len)) ||
+            (size < stream->frame_size_min) || ((stream->frame_size_max != 0u) && (size > stream->frame_size_max)))
+        {
+            if (verbose)
+            {
+                printf("frame %u at offset %zu: number %u, %u frames at %u Hz, %zu bytes do not match STREAMINFO\n",
+                       num, offset, frame.num, frame.frames, frame.sample_rate, size);
+            }
+            return -1;
+        }
+        frames += frame.frames;
+        offset += size;
+        num++;
+    }
+
+    if ((stream->frames != 0u) && (frames != stream->frames))
+    {
+        if (verbose)
+        {
+            printf("%llu frames decoded, %llu in STREAMINFO\n", (unsigned long long) frames,
+                   (unsigned long long) stream->frames);
+        }
+        return -1;
+    }
+    return (int64_t) frames;
+}
+
+/*******************************************************************************
+* Function Name: seek_check
+********************************************************************************
+* Summary:
+*   Decode the first frame after random offsets, found by its sync code and
+*   CRCs as a seeking player does, and compare it with the samples.
+*
+* Return:
+*   Number of frames found and identical.
+*
+*******************************************************************************/
+static uint32_t seek_check(const uint8_t *data, size_t len, const stream_t *stream, const int16_t *ref,
+                           uint64_t ref_frames)
+{
+    static int16_t pcm[BLOCK_FRAMES_MAX * AUDIO_FLAC_CHANNELS_MAX];
+    frame_t frame;
+    size_t offset;
+    uint32_t test;
+    uint32_t good = 0;
+    uint64_t start;
+
+    srand(2);
+    for (test = 0; test < SEEK_TESTS; test++)
+    {
+        offset = stream->audio_start + ((size_t) rand() % (len - stream->audio_start));
+        for (; (offset + 2u) < len; offset++)
+        {
+            if ((data[offset] == 0xFFu) && (data[offset + 1u] == 0xF8u) &&
+                (decode_frame(data, len, offset, stream, &frame, pcm) != 0u))
+            {
+                break;
+            }
+        }
+        if ((offset + 2u) >= len)
+        {
+            /* Offset in the last frame */
+            good++;
+            continue;
+        }
+        start = (uint64_t) frame.num * stream->block_max;
+        if (((start + frame.frames) <= ref_frames) &&
+            (memcmp(pcm, &ref[start * stream->channels], frame.frames * stream->channels * sizeof(int16_t)) == 0))
+        {
+            good++;
+        }
+    }
+    return good;
+}
+
+/*******************************************************************************
+* Function Name: encode
+********************************************************************************
+* Summary:
+*   Encode a signal in place, in chunks of a fixed size or of random numbers
+*   of FLAC frames, and complete the stream.
+*
+* Return:
+*   Length of the encoded data, compacted at the start of buf.
+*
+*******************************************************************************/
+static uint32_t encode(audio_enc_t *enc, uint8_t *buf, uint32_t len, uint32_t chunk, uint64_t *time)
+{
+    uint32_t frame_size = enc->channels * sizeof(int16_t);
+    uint32_t pos = 0;
+    uint32_t out = 0;
+    uint32_t size;
+    uint32_t coded;
+    uint64_t start;
+
+    srand(1);
+    while (pos < len)
+    {
+        size = (chunk != 0) ? chunk : ((((uint32_t) rand() % 16u) + 1u) * AUDIO_FLAC_BLOCK_FRAMES * frame_size);
+        size = ((len - pos) < size) ? (len - pos) : size;
+
+        start = cycles();
+        coded = audio_enc_process(enc, &buf[pos], size);
+        *time += cycles() - start;
+
+        /* Append the encoded data, as the record file does */
+        memmove(&buf[out], &buf[pos], coded);
+        out += coded;
+        pos += size;
+    }
+    return out + audio_enc_finish(enc, &buf[out]);
+}
+
+/*******************************************************************************
+* Function Name: read_file
+********************************************************************************
+* Summary:
+*   Read a whole file, with room after it.
+*
+*******************************************************************************/
+static uint8_t *read_file(const char *path, size_t extra, size_t *len)
+{
+    uint8_t *data;
+    FILE *fp = fopen(path, "rb");
+    long size;
+
+    if ((fp == NULL) || (fseek(fp, 0, SEEK_END) != 0) || ((size = ftell(fp)) < 0))
+    {
+        perror(path);
+        return NULL;
+    }
+    rewind(fp);
+    data = malloc((size_t) size + extra);
+    *len = fread(data, 1, (size_t) size, fp);
+    fclose(fp);
+    return data;
+}
+
+/*******************************************************************************
+* Function Name: write_file
+********************************************************************************
+* Summary:
+*   Write a file from a header and data.
+*
+*******************************************************************************/
+static bool write_file(const char *path, const uint8_t *header, size_t header_len, const void *data, size_t len)
+{
+    FILE *fp = fopen(path, "wb");
+
+    if ((fp == NULL) || (fwrite(header, 1, header_len, fp) != header_len) || (fwrite(data, 1, len, fp) != len))
+    {
+        perror(path);
+        return false;
+    }
+    fclose(fp);
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: verify
+********************************************************************************
+* Summary:
+*   Verify a FLAC record copied from the card, and write its samples.
+*
+*******************************************************************************/
+static int verify(const char *path, const char *raw_path)
+{
+    stream_t stream;
+    uint8_t *data;
+    int16_t *pcm;
+    size_t len;
+    int64_t frames;
+
+    data = read_file(path, 0, &len);
+    if (data == NULL)
+    {
+        return 1;
+    }
+    if (!parse_stream(data, len, &stream))
+    {
+        printf("%s: not a 16-bit FLAC stream\n", path);
+        return 1;
+    }
+
+    pcm = malloc((len * 8u) + ((size_t) BLOCK_FRAMES_MAX * AUDIO_FLAC_CHANNELS_MAX * sizeof(int16_t)));
+    frames = decode_stream(data, len, &stream, pcm, true);
+    if (frames < 0)
+    {
+        printf("%s: FAILED\n", path);
+        return 1;
+    }
+
+    printf("%s: %u Hz x %u, %.1f s, %u-frame blocks, frames of %u to %u bytes, %.1f KB/s, ratio %.3f\n", path,
+           stream.sample_rate, stream.channels, (double) frames / stream.sample_rate, stream.block_max,
+           stream.frame_size_min, stream.frame_size_max, (double) len * stream.sample_rate / (double) frames / 1024.0,
+           (double) len / ((double) frames * stream.channels * sizeof(int16_t)));
+    printf("seek:      %u/%u frames found\n", seek_check(data, len, &stream, pcm, (uint64_t) frames), SEEK_TESTS);
+
+    if ((raw_path != NULL) &&
+        !write_file(raw_path, NULL, 0, pcm, (size_t) frames * stream.channels * sizeof(int16_t)))
+    {
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    const char *flac_path = NULL;
+    uint32_t rate = DEFAULT_SAMPLE_RATE;
+    uint32_t channels = DEFAULT_CHANNELS;
+    uint32_t seconds = DEFAULT_SECONDS;
+    bool noise = false;
+    uint8_t header[AUDIO_ENC_HEADER_SIZE_MAX];
+    static audio_enc_t enc;
+    stream_t stream;
+    int16_t *pcm;
+    int16_t *decoded;
+    uint8_t *buf;
+    uint8_t *check;
+    uint8_t *file;
+    uint32_t frames;
+    uint32_t len;
+    uint32_t coded = 0;
+    uint32_t check_len;
+    uint32_t header_len;
+    uint32_t run;
+    uint32_t seek;
+    uint64_t time;
+    uint64_t best;
+    uint64_t total_in = 0;
+    uint64_t total_out = 0;
+    int64_t decoded_frames;
+    size_t size;
+    bool same;
+    bool failed = false;
+    int input;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:c:s:no:d:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r': rate = (uint32_t) atoi(optarg); break;
+            case 'c': channels = (uint32_t) atoi(optarg); break;
+            case 's': seconds = (uint32_t) atoi(optarg); break;
+            case 'n': noise = true; break;
+            case 'o': out_path = optarg; break;
+            case 'd': flac_path = optarg; break;
+            default:
+                printf("usage: %s [-r rate] [-c channels] [-s seconds] [-n] [-o flac file] [raw file...]\n"
+                       "       %s -d flac file [-o raw file]\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+    if (flac_path != NULL)
+    {
+        return verify(flac_path, out_path);
+    }
+    if ((channels < 1u) || (channels > AUDIO_ENC_CHANNELS_MAX))
+    {
+        printf("channels: 1 or 2\n");
+        return 1;
+    }
+    if ((out_path != NULL) && ((argc - optind) > 1))
+    {
+        printf("-o: one raw file only\n");
+        return 1;
+    }
+
+    /* Each raw file, or the test signal */
+    for (input = optind; (input < argc) || (input == optind); input++)
+    {
+        if (input < argc)
+        {
+            file = read_file(argv[input], 0, &size);
+            if (file == NULL)
+            {
+                return 1;
+            }
+            pcm = (int16_t *) file;
+            frames = (uint32_t) (size / (channels * sizeof(int16_t)));
+        }
+        else
+        {
+            frames = rate * seconds;
+            pcm = malloc((size_t) frames * channels * sizeof(int16_t));
+            make_signal(pcm, frames, rate, channels, noise);
+        }
+        len = frames * channels * sizeof(int16_t);
+        buf = malloc(len + AUDIO_ENC_FLAC_PENDING_SIZE);
+        check = malloc(len + AUDIO_ENC_FLAC_PENDING_SIZE);
+        decoded = malloc(len + ((size_t) BLOCK_FRAMES_MAX * AUDIO_FLAC_CHANNELS_MAX * sizeof(int16_t)));
+
+        /* Encode in ring blocks, keep the fastest run */
+        best = UINT64_MAX;
+        for (run = 0; run < BENCH_RUNS; run++)
+        {
+            memcpy(buf, pcm, len);
+            audio_enc_init(&enc, AUDIO_ENC_FLAC, rate, channels);
+            time = 0;
+            coded = encode(&enc, buf, len, PCM_BLOCK_SIZE, &time);
+            best = (time < best) ? time : best;
+        }
+        header_len = audio_enc_header(&enc, header);
+
+        /* Same data when encoded in chunks of random sizes */
+        memcpy(check, pcm, len);
+        audio_enc_init(&enc, AUDIO_ENC_FLAC, rate, channels);
+        time = 0;
+        check_len = encode(&enc, check, len, 0, &time);
+
+        /* Decode the record file, as a player would */
+        file = malloc(header_len + coded);
+        memcpy(file, header, header_len);
+        memcpy(&file[header_len], buf, coded);
+        decoded_frames = parse_stream(file, header_len + coded, &stream) ?
+                         decode_stream(file, header_len + coded, &stream, decoded, true) : -1;
+        same = (decoded_frames == (int64_t) frames) && (memcmp(decoded, pcm, len) == 0);
+        seek = (decoded_frames > 0) ? seek_check(file, header_len + coded, &stream, pcm, frames) : 0u;
+
+        printf("%s: %u Hz x %u, %.1f s\n", (input < argc) ? argv[input] : (noise ? "white noise" : "test signal"),
+               rate, channels, (double) frames / rate);
+#if defined(__x86_64__) || defined(__i386__)
+        printf("encode:    %.1f cycles per sample (host)\n", (double) best / ((double) frames * channels));
+#else
+        printf("encode:    %.1f ns per sample (host)\n", (double) best / ((double) frames * channels));
+#endif
+        printf("flac:      %.1f KB/s, raw %.1f KB/s, ratio %.3f%s\n", (double) (header_len + coded) * rate / frames / 1024.0,
+               (double) rate * channels * sizeof(int16_t) / 1024.0, (double) (header_len + coded) / len,
+               enc.overflow ? ", ENCODER OVERFLOW" : "");
+        printf("decode:    %s\n", same ? "same samples" : "DIFFERENT");
+        printf("seek:      %u/%u frames found\n", seek, SEEK_TESTS);
+        printf("chunking:  %s\n", ((check_len == coded) && (memcmp(check, buf, coded) == 0)) ? "same data" : "DIFFERENT");
+
+        failed = failed || !same || (seek != SEEK_TESTS) || (check_len != coded) || (memcmp(check, buf, coded) != 0);
+        total_in += len;
+        total_out += header_len + coded;
+
+        if ((out_path != NULL) && !write_file(out_path, header, header_len, buf, coded))
+        {
+            return 1;
+        }
+        free(pcm);
+        free(buf);
+        free(check);
+        free(decoded);
+        free(file);
+    }
+
+    if ((argc - optind) > 1)
+    {
+        printf("total:     ratio %.3f\n", (double) total_out / total_in);
+    }
+    return failed ? 1 : 0;
+}
+
+/* [] END OF FILE */
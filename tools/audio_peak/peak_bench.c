@@ -0,0 +1,438 @@
+/*****************************************************************************
+* File Name: peak_bench.c
+*
+* Description:
+*  This file contains a host check and benchmark of the record overview
+*  (source/audio_peak.c). A test signal, or a raw 16-bit PCM record, is split
+*  in blocks of the PCM ring size and summed as audio_in_task() does, the
+*  pages going to a sidecar file as they fill up. The sidecar is then read
+*  back page by page from the place of each bin, and every bin of every
+*  level is compared with one computed directly from the samples. The
+*  benchmark reports the overview time in CPU cycles per block on the host.
+*  With -x the end of the record is skipped, as a reset would leave it.
+*
+*  Build on Linux from this folder:
+*    gcc -O2 -I.. -I../../source -o peak_bench peak_bench.c ../../source/audio_peak.c -lm
+*
+*  Usage: peak_bench [-f raw file] [-r rate] [-c channels] [-s seconds]
+*                    [-o sidecar file] [-x]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "audio_peak.h"
+#include "audio_in.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define DEFAULT_SAMPLE_RATE     48000u
+#define DEFAULT_CHANNELS        2u
+#define DEFAULT_SECONDS         1200u
+#define DEFAULT_SIDECAR         "peak_bench.pk"
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Bin computed directly from the samples */
+typedef struct
+{
+    int16_t min[AUDIO_PEAK_CHANNELS_MAX];
+    int16_t max[AUDIO_PEAK_CHANNELS_MAX];
+    uint64_t sum[AUDIO_PEAK_CHANNELS_MAX];
+    uint32_t frames;
+} bin_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static bin_t *bins[AUDIO_PEAK_LEVELS];
+static uint32_t bin_frames[AUDIO_PEAK_LEVELS];
+
+/*******************************************************************************
+* Function Name: make_block
+********************************************************************************
+* Summary:
+*   Test signal from a frame on: tones whose level swells and fades over
+*   noise, with a full scale clip every 37 seconds.
+*
+*******************************************************************************/
+static void make_block(int16_t *pcm, uint32_t first, uint32_t frames, uint32_t rate, uint32_t channels)
+{
+    static uint32_t seed = 1;
+    uint32_t frame;
+    uint32_t channel;
+    double t;
+    double value;
+
+    for (frame = first; frame < (first + frames); frame++)
+    {
+        t = (double) frame / rate;
+        for (channel = 0; channel < channels; channel++)
+        {
+            value = 200.0 * ((double) (bench_rand(&seed) % 2000 - 1000) / 577.0) +
+                    12000.0 * pow(sin(2.0 * PI * t / (23.0 + 6.0 * channel)), 4.0) * sin(2.0 * PI * 440.0 * t);
+            if ((frame % (37u * rate)) < 64u)
+            {
+                value = (channel == 0u) ? -32768.0 : 32767.0;
+            }
+            pcm[(frame - first) * channels + channel] = (int16_t) value;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: sum_block
+********************************************************************************
+* Summary:
+*   Sum the samples of a block in the bins of every level, directly.
+*
+*******************************************************************************/
+static void sum_block(const int16_t *pcm, uint32_t first, uint32_t frames, uint32_t channels)
+{
+    uint32_t frame;
+    uint32_t channel;
+    uint32_t level;
+    int16_t sample;
+    bin_t *bin;
+
+    for (frame = 0; frame < frames; frame++)
+    {
+        for (level = 0; level < AUDIO_PEAK_LEVELS; level++)
+        {
+            bin = &bins[level][(first + frame) / bin_frames[level]];
+            if (bin->frames == 0u)
+            {
+                for (channel = 0; channel < AUDIO_PEAK_CHANNELS_MAX; channel++)
+                {
+                    bin->min[channel] = INT16_MAX;
+                    bin->max[channel] = INT16_MIN;
+                }
+            }
+            for (channel = 0; channel < channels; channel++)
+            {
+                sample = pcm[frame * channels + channel];
+                bin->min[channel] = (sample < bin->min[channel]) ? sample : bin->min[channel];
+                bin->max[channel] = (sample > bin->max[channel]) ? sample : bin->max[channel];
+                bin->sum[channel] += (uint64_t) ((int32_t) sample * sample);
+            }
+            bin->frames++;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: page_place
+********************************************************************************
+* Summary:
+*   Place in the sidecar of a full page, before the end of the record: after
+*   the header and the pages that filled up before it, the finer first.
+*
+*******************************************************************************/
+static uint32_t page_place(uint32_t level, uint32_t page)
+{
+    uint32_t last = page + 1u;
+    uint32_t place = 1u + level;
+    uint32_t index;
+
+    /* Last page of level 0 with it */
+    for (index = 0; index < level; index++)
+    {
+        last *= AUDIO_PEAK_RATIO;
+    }
+    last--;
+
+    for (index = 0; index < AUDIO_PEAK_LEVELS; index++)
+    {
+        place += last;
+        last /= AUDIO_PEAK_RATIO;
+    }
+    return place;
+}
+
+/*******************************************************************************
+* Function Name: get32
+********************************************************************************
+* Summary:
+*   Little-endian field of the header.
+*
+*******************************************************************************/
+static uint32_t get32(const uint8_t *field)
+{
+    return (uint32_t) field[0] | ((uint32_t) field[1] << 8) | ((uint32_t) field[2] << 16) |
+           ((uint32_t) field[3] << 24);
+}
+
+int main(int argc, char **argv)
+{
+    const char *raw_path = NULL;
+    const char *sidecar_path = DEFAULT_SIDECAR;
+    bool reset = false;
+    uint32_t rate = DEFAULT_SAMPLE_RATE;
+    uint32_t channels = DEFAULT_CHANNELS;
+    uint32_t seconds = DEFAULT_SECONDS;
+    uint32_t frames;
+    uint32_t frame_size;
+    uint32_t block_frames;
+    uint32_t pos;
+    uint32_t size;
+    uint32_t used;
+    uint32_t blocks = 0;
+    uint32_t page_bins;
+    uint32_t sidecar_pages;
+    uint32_t full_pages;
+    uint32_t normal[AUDIO_PEAK_LEVELS];
+    uint32_t level_bins[AUDIO_PEAK_LEVELS];
+    uint32_t checked = 0;
+    uint32_t wrong = 0;
+    uint32_t level;
+    uint32_t bin;
+    uint32_t place;
+    uint32_t tail;
+    uint32_t channel;
+    uint64_t start;
+    uint64_t time = 0;
+    int16_t *raw = NULL;
+    int16_t *pcm;
+    const uint8_t *page;
+    uint8_t header[AUDIO_PEAK_PAGE_SIZE];
+    uint8_t read_page[AUDIO_PEAK_PAGE_SIZE];
+    const uint8_t *entry;
+    bin_t *ref;
+    uint16_t rms;
+    static audio_peak_t peak;
+    FILE *fp;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:r:c:s:o:x")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': raw_path = optarg; break;
+            case 'r': rate = (uint32_t) atoi(optarg); break;
+            case 'c': channels = (uint32_t) atoi(optarg); break;
+            case 's': seconds = (uint32_t) atoi(optarg); break;
+            case 'o': sidecar_path = optarg; break;
+            case 'x': reset = true; break;
+            default:
+                printf("usage: %s [-f raw file] [-r rate] [-c channels] [-s seconds] [-o sidecar file] [-x]\n",
+                       argv[0]);
+                return 1;
+        }
+    }
+    if ((channels < 1u) || (channels > AUDIO_PEAK_CHANNELS_MAX) || (rate == 0u))
+    {
+        printf("channels: 1 or 2\n");
+        return 1;
+    }
+    frame_size = channels * (uint32_t) sizeof(int16_t);
+    block_frames = PCM_BLOCK_SIZE / frame_size;
+
+    /* Samples of a record, or the test signal made block by block */
+    if (raw_path != NULL)
+    {
+        fp = fopen(raw_path, "rb");
+        if ((fp == NULL) || (fseek(fp, 0, SEEK_END) != 0))
+        {
+            perror(raw_path);
+            return 1;
+        }
+        frames = (uint32_t) (ftell(fp) / (long) frame_size);
+        rewind(fp);
+        raw = malloc((size_t) frames * frame_size + 1u);
+        frames = (uint32_t) fread(raw, frame_size, frames, fp);
+        fclose(fp);
+    }
+    else
+    {
+        frames = rate * seconds;
+    }
+    pcm = malloc(PCM_BLOCK_SIZE);
+    for (level = 0; level < AUDIO_PEAK_LEVELS; level++)
+    {
+        bin_frames[level] = (level == 0u) ? AUDIO_PEAK_BIN_FRAMES : bin_frames[level - 1u] * AUDIO_PEAK_RATIO;
+        bins[level] = calloc((frames / bin_frames[level]) + 1u, sizeof(bin_t));
+    }
+
+    fp = fopen(sidecar_path, "w+b");
+    if (fp == NULL)
+    {
+        perror(sidecar_path);
+        return 1;
+    }
+
+    /* Sum the blocks, the sidecar is created with a header of no samples and
+     * its pages are written as they fill up */
+    audio_peak_init(&peak, rate, channels);
+    fwrite(audio_peak_header(&peak), AUDIO_PEAK_PAGE_SIZE, 1, fp);
+    for (pos = 0; pos < frames; pos += size)
+    {
+        size = ((frames - pos) < block_frames) ? (frames - pos) : block_frames;
+        if (raw != NULL)
+        {
+            memcpy(pcm, &raw[pos * channels], size * frame_size);
+        }
+        else
+        {
+            make_block(pcm, pos, size, rate, channels);
+        }
+        sum_block(pcm, pos, size, channels);
+
+        for (used = 0; used < (size * frame_size); )
+        {
+            start = cycles();
+            used += audio_peak_process(&peak, (uint8_t *) pcm + used, (size * frame_size) - used);
+            page = audio_peak_page(&peak);
+            time += cycles() - start;
+            for (; page != NULL; page = audio_peak_page(&peak))
+            {
+                fwrite(page, AUDIO_PEAK_PAGE_SIZE, 1, fp);
+            }
+        }
+        blocks++;
+    }
+    if (!reset)
+    {
+        audio_peak_finish(&peak);
+        while ((page = audio_peak_page(&peak)) != NULL)
+        {
+            fwrite(page, AUDIO_PEAK_PAGE_SIZE, 1, fp);
+        }
+        rewind(fp);
+        fwrite(audio_peak_header(&peak), AUDIO_PEAK_PAGE_SIZE, 1, fp);
+    }
+    fflush(fp);
+
+    /* Read back the header, a sidecar left by a reset has only full pages:
+     * the full pages of level 0 are found from its size */
+    fseek(fp, 0, SEEK_END);
+    sidecar_pages = (uint32_t) (ftell(fp) / AUDIO_PEAK_PAGE_SIZE);
+    rewind(fp);
+    if ((fread(header, sizeof(header), 1, fp) != 1) || (get32(&header[0]) != AUDIO_PEAK_MAGIC))
+    {
+        printf("sidecar: bad header\n");
+        return 1;
+    }
+    page_bins = get32(&header[20]) >> 16;
+    full_pages = get32(&header[24]);
+    if (get32(&header[12]) == 0u)
+    {
+        for (full_pages = 0; page_place(0, full_pages) < sidecar_pages; full_pages++)
+        {
+        }
+    }
+    for (level = 0; level < AUDIO_PEAK_LEVELS; level++)
+    {
+        normal[level] = (level == 0u) ? full_pages : normal[level - 1u] / AUDIO_PEAK_RATIO;
+        level_bins[level] = (get32(&header[12]) == 0u) ? (normal[level] * page_bins) : get32(&header[28 + level * 4u]);
+    }
+
+    /* Every bin from the place of its page, the pages not full at the end
+     * follow the full ones in the order of the levels */
+    tail = 1u;
+    for (level = 0; level < AUDIO_PEAK_LEVELS; level++)
+    {
+        tail += normal[level];
+    }
+    for (level = 0; level < AUDIO_PEAK_LEVELS; level++)
+    {
+        for (bin = 0; bin < level_bins[level]; bin++)
+        {
+            place = ((bin / page_bins) < normal[level]) ? page_place(level, bin / page_bins) : tail;
+            if ((bin % page_bins) == 0u)
+            {
+                fseek(fp, (long) place * AUDIO_PEAK_PAGE_SIZE, SEEK_SET);
+                if (fread(read_page, sizeof(read_page), 1, fp) != 1)
+                {
+                    memset(read_page, 0, sizeof(read_page));
+                }
+            }
+
+            ref = &bins[level][bin];
+            entry = &read_page[(bin % page_bins) * channels * AUDIO_PEAK_ENTRY_SIZE];
+            for (channel = 0; channel < channels; channel++)
+            {
+                rms = (uint16_t) (sqrtf((float) ref->sum[channel] / (float) ref->frames) + 0.5f);
+                if ((ref->frames == 0u) ||
+                    ((int16_t) (entry[0] | (entry[1] << 8)) != ref->min[channel]) ||
+                    ((int16_t) (entry[2] | (entry[3] << 8)) != ref->max[channel]) ||
+                    ((uint16_t) (entry[4] | (entry[5] << 8)) != rms))
+                {
+                    if (wrong < 8u)
+                    {
+                        printf("level %u bin %u channel %u: %d %d %u, expected %d %d %u\n", level, bin, channel,
+                               (int16_t) (entry[0] | (entry[1] << 8)), (int16_t) (entry[2] | (entry[3] << 8)),
+                               entry[4] | (entry[5] << 8), ref->min[channel], ref->max[channel], rms);
+                    }
+                    wrong++;
+                }
+                entry += AUDIO_PEAK_ENTRY_SIZE;
+                checked++;
+            }
+        }
+        tail += ((level_bins[level] > (normal[level] * page_bins)) ? 1u : 0u);
+    }
+    fclose(fp);
+
+    printf("%u Hz x %u, %.1f s, %u frames per block%s\n", rate, channels, (double) frames / rate, block_frames,
+           reset ? ", end lost to a reset" : "");
+    printf("sidecar:   %u pages, %u bytes, %.3f%% of the PCM\n", sidecar_pages, sidecar_pages * AUDIO_PEAK_PAGE_SIZE,
+           100.0 * sidecar_pages * AUDIO_PEAK_PAGE_SIZE / ((double) frames * frame_size));
+    for (level = 0; level < AUDIO_PEAK_LEVELS; level++)
+    {
+        printf("level %u:   %u bins of %.1f ms, %u full pages\n", level, level_bins[level],
+               1000.0 * bin_frames[level] / rate, normal[level]);
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    printf("overview:  %.0f cycles per block (host)\n", (double) time / blocks);
+#else
+    printf("overview:  %.0f ns per block (host)\n", (double) time / blocks);
+#endif
+    printf("bins:      %u checked, %u wrong\n", checked, wrong);
+
+    free(pcm);
+    free(raw);
+    return (wrong == 0u) ? 0 : 1;
+}
+
+/* [] END OF FILE */
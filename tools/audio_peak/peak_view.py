@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""
+Show the waveform overview of a record from its sidecar (rec_NNNN.pk, see
+source/audio_peak.c), reading only the pages of the level and the time
+range shown: one line per slice of the range, with the span between the
+minimum and maximum of each channel and its RMS level, or the bins as CSV.
+A sidecar left by a reset holds its full pages only. With --check, the
+bins shown are compared with the samples of the raw 16-bit PCM record.
+
+Usage:
+    peak_view.py rec_0001.pk [--start s] [--end s] [--rows n] [--level n]
+                 [--csv] [--check rec_0001.raw]
+
+Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+This software is provided under the license agreement accompanying the
+software package from which you obtained this software.
+"""
+
+import argparse
+import math
+import os
+import struct
+import sys
+
+PAGE_SIZE = 512         # AUDIO_PEAK_PAGE_SIZE
+ENTRY_SIZE = 6          # AUDIO_PEAK_ENTRY_SIZE
+MAGIC = 0x4B414550      # AUDIO_PEAK_MAGIC
+BAR = 33
+
+
+class Sidecar:
+    """Header of a sidecar, and the place of its pages."""
+
+    def __init__(self, path):
+        self.fp = open(path, "rb")
+        size = os.path.getsize(path)
+        fields = struct.unpack("<10I", self.fp.read(40).ljust(40, b"\0"))
+        if fields[0] != MAGIC:
+            sys.exit("%s: not an overview sidecar" % path)
+        self.channels = fields[1] >> 16
+        self.rate = fields[2]
+        self.frames = fields[3]
+        self.bin_frames = fields[4] & 0xFFFF
+        self.ratio = fields[4] >> 16
+        self.levels = fields[5] & 0xFFFF
+        self.page_bins = fields[5] >> 16
+        self.reset = self.frames == 0
+        full_pages = fields[6]
+        if self.reset:
+            # Left by a reset: the full pages of level 0 from the size
+            full_pages = 0
+            while self.place(0, full_pages) < size // PAGE_SIZE:
+                full_pages += 1
+        self.normal = [full_pages // self.ratio ** level for level in range(self.levels)]
+        if self.reset:
+            self.bins = [pages * self.page_bins for pages in self.normal]
+            self.frames = self.bins[0] * self.bin_frames
+        else:
+            self.bins = list(fields[7:7 + self.levels])
+        self.tail = {}
+        place = 1 + sum(self.normal)
+        for level in range(self.levels):
+            if self.bins[level] > self.normal[level] * self.page_bins:
+                self.tail[level] = place
+                place += 1
+        self.pages = {}
+
+    def place(self, level, page):
+        """Place of a full page: after the pages that filled up before it."""
+        last = (page + 1) * self.ratio ** level - 1
+        return 1 + level + sum(last // self.ratio ** index for index in range(self.levels))
+
+    def bin_len(self, level):
+        return self.bin_frames * self.ratio ** level
+
+    def read(self, level, index):
+        """Bin of a level: (minimum, maximum, RMS) of each channel."""
+        page = index // self.page_bins
+        place = self.place(level, page) if page < self.normal[level] else self.tail[level]
+        if place not in self.pages:
+            self.fp.seek(place * PAGE_SIZE)
+            self.pages[place] = self.fp.read(PAGE_SIZE).ljust(PAGE_SIZE, b"\0")
+        offset = (index % self.page_bins) * self.channels * ENTRY_SIZE
+        return [struct.unpack_from("<hhH", self.pages[place], offset + channel * ENTRY_SIZE)
+                for channel in range(self.channels)]
+
+
+def raw_bin(raw, channels, start, frames):
+    """Bin computed from the samples of the record."""
+    data = raw[start * channels:(start + frames) * channels]
+    result = []
+    for channel in range(channels):
+        samples = data[channel::channels]
+        rms = int(math.sqrt(sum(sample * sample for sample in samples) / len(samples)) + 0.5)
+        result.append((min(samples), max(samples), rms))
+    return result
+
+
+def bar(entry):
+    """Span between the minimum and the maximum, and the RMS level."""
+    line = [" "] * BAR
+    half = BAR // 2
+
+    def column(value):
+        return max(0, min(BAR - 1, half + int(round(value * half / 32768.0))))
+
+    for index in range(column(entry[0]), column(entry[1]) + 1):
+        line[index] = "-"
+    for index in range(column(-entry[2]), column(entry[2]) + 1):
+        line[index] = "="
+    line[half] = "|"
+    return "".join(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("sidecar", help="rec_NNNN.pk file")
+    parser.add_argument("--start", type=float, default=0.0, help="start of the range in seconds")
+    parser.add_argument("--end", type=float, help="end of the range in seconds")
+    parser.add_argument("--rows", type=int, default=40, help="lines of the overview")
+    parser.add_argument("--level", type=int, help="level shown, the coarsest with a bin per line if not given")
+    parser.add_argument("--csv", action="store_true", help="print the bins of the range as CSV")
+    parser.add_argument("--check", metavar="RAW", help="compare the bins with a raw 16-bit PCM record")
+    args = parser.parse_args()
+
+    sidecar = Sidecar(args.sidecar)
+    first = int(args.start * sidecar.rate)
+    last = sidecar.frames if args.end is None else min(sidecar.frames, int(args.end * sidecar.rate))
+    if last <= first:
+        sys.exit("empty range, the record is %.1f s" % (sidecar.frames / sidecar.rate))
+
+    level = args.level
+    if level is None:
+        level = 0
+        while (level + 1 < sidecar.levels) and ((last - first) // sidecar.bin_len(level + 1) >= args.rows):
+            level += 1
+    bin_len = sidecar.bin_len(level)
+    indexes = range(first // bin_len, min(sidecar.bins[level], (last + bin_len - 1) // bin_len))
+
+    print("# %u Hz x %u, %.1f s%s, level %u: bins of %.1f ms" %
+          (sidecar.rate, sidecar.channels, sidecar.frames / sidecar.rate,
+           ", end lost to a reset" if sidecar.reset else "", level, 1000.0 * bin_len / sidecar.rate))
+
+    if args.check:
+        with open(args.check, "rb") as fp:
+            data = fp.read()
+        raw = struct.unpack("<%dh" % (len(data) // 2), data[:len(data) // 2 * 2])
+        wrong = 0
+        for index in indexes:
+            frames = min(bin_len, len(raw) // sidecar.channels - index * bin_len)
+            if frames <= 0:
+                wrong += 1
+                continue
+            # The firmware takes the root in single precision
+            expected = raw_bin(raw, sidecar.channels, index * bin_len, frames)
+            for got, want in zip(sidecar.read(level, index), expected):
+                if got[:2] != want[:2] or abs(got[2] - want[2]) > 1:
+                    wrong += 1
+                    break
+        print("# %u bins checked, %u wrong" % (len(indexes), wrong))
+        sys.exit(0 if wrong == 0 else 1)
+
+    if args.csv:
+        print("time," + ",".join("min%u,max%u,rms%u" % ((channel,) * 3) for channel in range(sidecar.channels)))
+        for index in indexes:
+            print("%.4f," % (index * bin_len / sidecar.rate) +
+                  ",".join("%d,%d,%d" % entry for entry in sidecar.read(level, index)))
+        return
+
+    # Slices of the range, each the union of its bins
+    rows = min(args.rows, len(indexes))
+    for row in range(rows):
+        group = indexes[row * len(indexes) // rows:(row + 1) * len(indexes) // rows]
+        bins = [sidecar.read(level, index) for index in group]
+        line = "%9.2f s " % (group[0] * bin_len / sidecar.rate)
+        for channel in range(sidecar.channels):
+            entry = (min(item[channel][0] for item in bins), max(item[channel][1] for item in bins),
+                     int(math.sqrt(sum(item[channel][2] ** 2 for item in bins) / len(bins))))
+            line += " " + bar(entry)
+        print(line.rstrip())
+
+
+if __name__ == "__main__":
+    main()
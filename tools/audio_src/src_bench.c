@@ -0,0 +1,349 @@
+/*****************************************************************************
+* File Name: src_bench.c
+*
+* Description:
+*  This file contains a host check and benchmark of the recorder sample
+*  rate converter (source/audio_src.c). Tones captured at the native rate
+*  are converted to each stored rate the PDM/PCM block does not produce, in
+*  blocks of the PCM ring size, as audio_in_task() does. The benchmark
+*  reports the passband ripple up to 0.4 of the output rate, the rejection
+*  of the tones that would alias, the signal-to-noise ratio of a 1 kHz tone,
+*  and the conversion time in CPU cycles per output sample on the host. It
+*  also checks the number of frames out, and that blocks of random sizes
+*  give the same samples.
+*
+*  Build on Linux from this folder:
+*    gcc -O2 -I.. -I../../source -o src_bench src_bench.c ../../source/audio_src.c -lm
+*
+*  Usage: src_bench [-r output rate] [-c channels]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "audio_src.h"
+#include "audio_in.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define TONE_SECONDS            1u
+#define TONE_AMPLITUDE          16000.0
+#define BENCH_SECONDS           20u
+#define BENCH_RUNS              3u
+#define SWEEP_STEPS             40u
+
+/* Limits of the check */
+#define RIPPLE_DB_MAX           0.1
+#define REJECTION_DB_MIN        60.0
+#define SNR_DB_MIN              70.0
+
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static const uint32_t check_rates[] = {6000u, 11025u, 12000u, 22050u, 24000u, 44100u};
+
+/*******************************************************************************
+* Function Name: convert
+********************************************************************************
+* Summary:
+*   Convert a signal in place, in chunks of a fixed size or of random sizes,
+*   appending the outputs as the record file does.
+*
+* Return:
+*   Number of frames out, compacted at the start of buf.
+*
+*******************************************************************************/
+static uint32_t convert(audio_src_t *src, uint8_t *buf, uint32_t len, uint32_t chunk, uint64_t *time)
+{
+    uint32_t frame_size = src->channels * sizeof(int16_t);
+    uint32_t pos = 0;
+    uint32_t out = 0;
+    uint32_t size;
+    uint32_t coded;
+    uint64_t start;
+
+    srand(1);
+    while (pos < len)
+    {
+        size = (chunk != 0) ? chunk : ((((uint32_t) rand() % 4096u) + 1u) * frame_size);
+        size = ((len - pos) < size) ? (len - pos) : size;
+
+        start = cycles();
+        coded = audio_src_process(src, &buf[pos], size);
+        *time += cycles() - start;
+
+        memmove(&buf[out], &buf[pos], coded);
+        out += coded;
+        pos += size;
+    }
+    return out / frame_size;
+}
+
+/*******************************************************************************
+* Function Name: tone
+********************************************************************************
+* Summary:
+*   Convert a tone, and fit a tone of the same frequency to the outputs
+*   after the filter settled.
+*
+* Parameters:
+*   gain = gain of the fitted tone in dB
+*   snr = ratio of the fitted tone to the rest in dB
+*
+*******************************************************************************/
+static void tone(uint32_t in_rate, uint32_t out_rate, uint32_t channels, double freq, double *gain, double *snr)
+{
+    uint32_t frames = in_rate * TONE_SECONDS;
+    uint32_t frame;
+    uint32_t channel;
+    uint32_t out_frames;
+    uint32_t skip;
+    int16_t *pcm = malloc((size_t) frames * channels * sizeof(int16_t));
+    double sum_c = 0;
+    double sum_s = 0;
+    double power = 0;
+    double residual = 0;
+    double amplitude;
+    double phase;
+    double t;
+    double value;
+    uint64_t time = 0;
+    audio_src_t src;
+
+    for (frame = 0; frame < frames; frame++)
+    {
+        for (channel = 0; channel < channels; channel++)
+        {
+            pcm[frame * channels + channel] = (int16_t) lrint(TONE_AMPLITUDE * sin(2.0 * PI * freq * frame / in_rate));
+        }
+    }
+    audio_src_init(&src, in_rate, out_rate, channels);
+    out_frames = convert(&src, (uint8_t *) pcm, frames * channels * sizeof(int16_t), PCM_BLOCK_SIZE, &time);
+
+    /* The output n is at the input n * in_rate / out_rate */
+    skip = src.taps;
+    for (frame = skip; frame < out_frames; frame++)
+    {
+        t = (double) frame / out_rate;
+        value = pcm[frame * channels];
+        sum_c += value * cos(2.0 * PI * freq * t);
+        sum_s += value * sin(2.0 * PI * freq * t);
+        power += value * value;
+    }
+    sum_c *= 2.0 / (out_frames - skip);
+    sum_s *= 2.0 / (out_frames - skip);
+    amplitude = sqrt(sum_c * sum_c + sum_s * sum_s);
+    phase = atan2(sum_c, sum_s);
+    for (frame = skip; frame < out_frames; frame++)
+    {
+        value = pcm[frame * channels] - amplitude * sin(2.0 * PI * freq * frame / out_rate + phase);
+        residual += value * value;
+    }
+    free(pcm);
+
+    *gain = 20.0 * log10(((freq * 2.0) < out_rate) ? (amplitude / TONE_AMPLITUDE) :
+                         (sqrt(2.0 * power / (out_frames - skip)) / TONE_AMPLITUDE + 1e-9));
+    *snr = 10.0 * log10((amplitude * amplitude / 2.0) / (residual / (out_frames - skip) + 1e-9));
+}
+
+/*******************************************************************************
+* Function Name: check
+********************************************************************************
+* Summary:
+*   Check and time the conversion to a rate.
+*
+* Return:
+*   True if the conversion is within the limits.
+*
+*******************************************************************************/
+static bool check(uint32_t out_rate, uint32_t channels)
+{
+    uint32_t in_rate = audio_src_capture_rate(out_rate);
+    uint32_t frames = in_rate * BENCH_SECONDS;
+    uint32_t len = frames * channels * sizeof(int16_t);
+    uint32_t step;
+    uint32_t run;
+    uint32_t out_frames;
+    uint32_t check_frames;
+    uint32_t expected;
+    uint64_t time;
+    uint64_t best = UINT64_MAX;
+    int16_t *pcm;
+    uint8_t *buf;
+    uint8_t *chunked;
+    double freq;
+    double gain;
+    double snr;
+    double gain_min = INFINITY;
+    double gain_max = -INFINITY;
+    double rejection = INFINITY;
+    double snr_1k;
+    bool same;
+    bool pass;
+    audio_src_t src;
+
+    if (in_rate == out_rate)
+    {
+        printf("%u Hz: captured directly\n", out_rate);
+        return true;
+    }
+
+    /* Passband ripple up to 0.4 of the output rate */
+    for (step = 0; step <= SWEEP_STEPS; step++)
+    {
+        freq = 50.0 + (0.4 * out_rate - 50.0) * step / SWEEP_STEPS;
+        tone(in_rate, out_rate, channels, freq, &gain, &snr);
+        gain_min = (gain < gain_min) ? gain : gain_min;
+        gain_max = (gain > gain_max) ? gain : gain_max;
+    }
+
+    /* Rejection of the tones aliasing below 0.4 of the output rate, if the
+     * capture has any */
+    for (step = 0; ((0.6 * out_rate) < (0.5 * in_rate)) && (step <= SWEEP_STEPS); step++)
+    {
+        freq = 0.6 * out_rate + (0.5 * in_rate - 0.6 * out_rate - 50.0) * step / SWEEP_STEPS;
+        tone(in_rate, out_rate, channels, freq, &gain, &snr);
+        rejection = (-gain < rejection) ? -gain : rejection;
+    }
+    tone(in_rate, out_rate, channels, 1000.0, &gain, &snr_1k);
+
+    /* Time in ring blocks, and the same samples in blocks of random sizes */
+    pcm = malloc(len);
+    buf = malloc(len);
+    chunked = malloc(len);
+    srand(2);
+    for (step = 0; step < (frames * channels); step++)
+    {
+        pcm[step] = (int16_t) ((rand() % 20000) - 10000);
+    }
+    for (run = 0; run < BENCH_RUNS; run++)
+    {
+        memcpy(buf, pcm, len);
+        audio_src_init(&src, in_rate, out_rate, channels);
+        time = 0;
+        out_frames = convert(&src, buf, len, PCM_BLOCK_SIZE, &time);
+        best = (time < best) ? time : best;
+    }
+    memcpy(chunked, pcm, len);
+    audio_src_init(&src, in_rate, out_rate, channels);
+    time = 0;
+    check_frames = convert(&src, chunked, len, 0, &time);
+    same = (check_frames == out_frames) && (memcmp(buf, chunked, out_frames * channels * sizeof(int16_t)) == 0);
+
+    /* Outputs at n * m / l, due once their right taps are in */
+    expected = (uint32_t) ((((uint64_t) (frames - src.taps) * src.l) + src.m - 1u) / src.m);
+
+    printf("%5u Hz x %u from %u Hz: %u/%u, %u taps\n", out_rate, channels, in_rate, src.l, src.m, 2u * src.taps);
+    printf("  passband ripple %.3f dB, ", gain_max - gain_min);
+    if (isinf(rejection))
+    {
+        printf("no tone aliasing in the passband");
+    }
+    else
+    {
+        printf("alias rejection %.1f dB", rejection);
+    }
+    printf(", 1 kHz SNR %.1f dB\n", snr_1k);
+#if defined(__x86_64__) || defined(__i386__)
+    printf("  %.1f cycles per output sample (host)", (double) best / ((double) out_frames * channels));
+#else
+    printf("  %.1f ns per output sample (host)", (double) best / ((double) out_frames * channels));
+#endif
+    printf(", %u frames out of %u expected, chunking %s\n", out_frames, expected, same ? "same data" : "DIFFERENT");
+    free(pcm);
+    free(buf);
+    free(chunked);
+
+    pass = same && (out_frames == expected) && ((gain_max - gain_min) <= RIPPLE_DB_MAX) &&
+           (rejection >= REJECTION_DB_MIN) && (snr_1k >= SNR_DB_MIN);
+    if (!pass)
+    {
+        printf("  FAILED\n");
+    }
+    return pass;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rate = 0;
+    uint32_t channels = 0;
+    uint32_t index;
+    uint32_t count;
+    bool pass = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r': rate = (uint32_t) atoi(optarg); break;
+            case 'c': channels = (uint32_t) atoi(optarg); break;
+            default:
+                printf("usage: %s [-r output rate] [-c channels]\n", argv[0]);
+                return 1;
+        }
+    }
+    if ((channels > AUDIO_SRC_CHANNELS_MAX) || ((rate != 0u) && (rate < AUDIO_SRC_RATE_MIN)))
+    {
+        printf("channels: 1 or 2, rate: %u Hz or more\n", AUDIO_SRC_RATE_MIN);
+        return 1;
+    }
+
+    count = sizeof(check_rates) / sizeof(check_rates[0]);
+    for (index = 0; index < ((rate != 0u) ? 1u : count); index++)
+    {
+        if ((channels == 0u) || (channels == 1u))
+        {
+            pass = check((rate != 0u) ? rate : check_rates[index], 1u) && pass;
+        }
+        if ((channels == 0u) || (channels == 2u))
+        {
+            pass = check((rate != 0u) ? rate : check_rates[index], 2u) && pass;
+        }
+    }
+
+    return pass ? 0 : 1;
+}
+
+/* [] END OF FILE */
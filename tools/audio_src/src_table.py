@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""
+Generate the filter bank of the sample rate converter (source/audio_src.c):
+one side of a Kaiser-windowed sinc, AUDIO_SRC_PHASES samples per zero
+crossing over AUDIO_SRC_ZEROS zero crossings, in Q15. The converter
+stretches it to the output rate and interpolates between the phases.
+
+Usage:
+    src_table.py > table.txt
+
+Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+This software is provided under the license agreement accompanying the
+software package from which you obtained this software.
+"""
+
+import argparse
+import math
+
+ZEROS = 12          # AUDIO_SRC_ZEROS
+PHASES = 128        # AUDIO_SRC_PHASES
+BETA = 7.0          # Kaiser window, about 70 dB of stopband attenuation
+PER_LINE = 12
+
+
+def bessel_i0(x):
+    """Modified Bessel function of the first kind, order 0."""
+    total = 1.0
+    term = 1.0
+    k = 1
+    while term > 1e-12 * total:
+        term *= (x / (2.0 * k)) ** 2
+        total += term
+        k += 1
+    return total
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--beta", type=float, default=BETA, help="Kaiser window beta")
+    args = parser.parse_args()
+
+    values = []
+    for index in range(ZEROS * PHASES + 1):
+        t = index / PHASES
+        sinc = 1.0 if index == 0 else math.sin(math.pi * t) / (math.pi * t)
+        ratio = t / ZEROS
+        window = bessel_i0(args.beta * math.sqrt(max(0.0, 1.0 - ratio * ratio))) / bessel_i0(args.beta)
+        values.append(min(32767, int(round(sinc * window * 32768.0))))
+
+    for start in range(0, len(values), PER_LINE):
+        line = ", ".join("%d" % value for value in values[start:start + PER_LINE])
+        print("    " + line + ("," if (start + PER_LINE) < len(values) else ""))
+
+
+if __name__ == "__main__":
+    main()
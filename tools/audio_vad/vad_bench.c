@@ -0,0 +1,283 @@
+/*****************************************************************************
+* File Name: vad_bench.c
+*
+* Description:
+*  This file contains a host check and benchmark of the recorder activity
+*  detector (source/audio_vad.c). A session of speech-like bursts over
+*  background noise, or a raw 16-bit PCM record, is split in blocks of the
+*  PCM ring size and gated as audio_in_task() does, holding the last silent
+*  block as pre-roll. The benchmark reports the fraction of the SD card
+*  writes avoided, the bursts whose onset or end was not kept, the segments
+*  of the index, and the detector time in CPU cycles per block on the host.
+*
+*  Build on Linux from this folder:
+*    gcc -O2 -I.. -I../../source -o vad_bench vad_bench.c ../../source/audio_vad.c -lm
+*
+*  Usage: vad_bench [-f raw file] [-r rate] [-c channels] [-t threshold dB]
+*                   [-s seconds]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "audio_vad.h"
+#include "audio_in.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define DEFAULT_SAMPLE_RATE     16000u
+#define DEFAULT_CHANNELS        1u
+#define DEFAULT_THRESHOLD_DB    12u
+#define DEFAULT_SECONDS         600u
+#define BURSTS_MAX              1024u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+typedef struct
+{
+    uint32_t start;
+    uint32_t frames;
+} burst_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static burst_t bursts[BURSTS_MAX];
+static uint32_t burst_num;
+
+/*******************************************************************************
+* Function Name: make_session
+********************************************************************************
+* Summary:
+*   Test session: bursts of 0.3 to 3 seconds of syllable-like tones, one
+*   every 2 to 40 seconds, over noise whose level drifts by 10 dB.
+*
+*******************************************************************************/
+static void make_session(int16_t *pcm, uint32_t frames, uint32_t rate, uint32_t channels)
+{
+    uint32_t frame;
+    uint32_t channel;
+    uint32_t seed = 1;
+    uint32_t next;
+    burst_t *burst = NULL;
+    double t;
+    double noise;
+    double value;
+
+    srand(3);
+    burst_num = 0;
+    next = rate * (2u + ((uint32_t) rand() % 10u));
+    for (frame = 0; frame < frames; frame++)
+    {
+        if ((frame == next) && (burst_num < BURSTS_MAX))
+        {
+            burst = &bursts[burst_num++];
+            burst->start = frame;
+            burst->frames = (rate * (300u + ((uint32_t) rand() % 2700u))) / 1000u;
+            next = frame + burst->frames + rate * (2u + ((uint32_t) rand() % 38u));
+        }
+        if ((burst != NULL) && (frame >= (burst->start + burst->frames)))
+        {
+            burst = NULL;
+        }
+
+        t = (double) frame / rate;
+        noise = 60.0 * pow(10.0, 0.25 * sin(2.0 * PI * t / 97.0));
+        for (channel = 0; channel < channels; channel++)
+        {
+            value = noise * ((double) (bench_rand(&seed) % 2000 - 1000) / 577.0);
+            if (burst != NULL)
+            {
+                value += (0.55 + 0.45 * sin(2.0 * PI * 4.0 * (frame - burst->start) / rate - PI / 2.0)) *
+                         (4000.0 * sin(2.0 * PI * 180.0 * t) + 1500.0 * sin(2.0 * PI * 900.0 * t + channel));
+            }
+            pcm[frame * channels + channel] = (int16_t) value;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: kept
+********************************************************************************
+* Summary:
+*   Check that a span of the session is in the kept segments.
+*
+*******************************************************************************/
+static bool kept(const audio_vad_t *vad, uint32_t start, uint32_t frames)
+{
+    uint32_t index;
+
+    for (index = 0; index < vad->segment_num; index++)
+    {
+        if ((vad->segments[index].start <= start) &&
+            ((start + frames) <= (vad->segments[index].start + vad->segments[index].frames)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    const char *raw_path = NULL;
+    uint32_t rate = DEFAULT_SAMPLE_RATE;
+    uint32_t channels = DEFAULT_CHANNELS;
+    uint32_t threshold = DEFAULT_THRESHOLD_DB;
+    uint32_t seconds = DEFAULT_SECONDS;
+    uint32_t frames;
+    uint32_t len;
+    uint32_t pos;
+    uint32_t size;
+    uint32_t index;
+    uint32_t written = 0;
+    uint32_t preroll = 0;
+    uint32_t kept_frames = 0;
+    uint32_t clipped_onsets = 0;
+    uint32_t clipped_ends = 0;
+    uint32_t window;
+    uint64_t start;
+    uint64_t time = 0;
+    int16_t *pcm;
+    audio_vad_t vad;
+    FILE *fp;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:r:c:t:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': raw_path = optarg; break;
+            case 'r': rate = (uint32_t) atoi(optarg); break;
+            case 'c': channels = (uint32_t) atoi(optarg); break;
+            case 't': threshold = (uint32_t) atoi(optarg); break;
+            case 's': seconds = (uint32_t) atoi(optarg); break;
+            default:
+                printf("usage: %s [-f raw file] [-r rate] [-c channels] [-t threshold dB] [-s seconds]\n", argv[0]);
+                return 1;
+        }
+    }
+    if ((channels < 1u) || (channels > 2u) || (threshold == 0u))
+    {
+        printf("channels: 1 or 2, threshold: 1 dB or more\n");
+        return 1;
+    }
+
+    /* Test session, or the samples of a record */
+    if (raw_path != NULL)
+    {
+        fp = fopen(raw_path, "rb");
+        if ((fp == NULL) || (fseek(fp, 0, SEEK_END) != 0))
+        {
+            perror(raw_path);
+            return 1;
+        }
+        frames = (uint32_t) (ftell(fp) / (long) (channels * sizeof(int16_t)));
+        rewind(fp);
+        pcm = malloc((size_t) frames * channels * sizeof(int16_t));
+        frames = (uint32_t) fread(pcm, channels * sizeof(int16_t), frames, fp);
+        fclose(fp);
+        burst_num = 0;
+    }
+    else
+    {
+        frames = rate * seconds;
+        pcm = malloc((size_t) frames * channels * sizeof(int16_t));
+        make_session(pcm, frames, rate, channels);
+    }
+    len = frames * channels * sizeof(int16_t);
+
+    /* Gate the blocks, the pre-roll is written with the first kept block */
+    audio_vad_init(&vad, rate, channels, threshold);
+    for (pos = 0; pos < len; pos += size)
+    {
+        size = ((len - pos) < PCM_BLOCK_SIZE) ? (len - pos) : PCM_BLOCK_SIZE;
+        start = cycles();
+        if (audio_vad_process(&vad, (uint8_t *) pcm + pos, size))
+        {
+            time += cycles() - start;
+            written += 1u + preroll;
+            preroll = 0;
+        }
+        else
+        {
+            time += cycles() - start;
+            preroll = 1;
+        }
+    }
+
+    /* The segments hold the kept blocks, and the bursts from their onset */
+    for (index = 0; index < vad.segment_num; index++)
+    {
+        kept_frames += vad.segments[index].frames;
+    }
+    window = (rate * AUDIO_VAD_WINDOW_MS) / 1000u;
+    for (index = 0; index < burst_num; index++)
+    {
+        clipped_onsets += kept(&vad, bursts[index].start, window) ? 0u : 1u;
+        clipped_ends += kept(&vad, bursts[index].start + bursts[index].frames - window, window) ? 0u : 1u;
+    }
+
+    printf("%u Hz x %u, %.1f s, threshold %u dB, %u frames per block\n", rate, channels, (double) frames / rate,
+           threshold, PCM_BLOCK_SIZE / (channels * (uint32_t) sizeof(int16_t)));
+    printf("blocks:    %u written of %u, %.1f%% of the SD writes avoided\n", written, vad.blocks,
+           100.0 * (vad.blocks - written) / vad.blocks);
+    printf("segments:  %u, %.1f s kept\n", vad.segment_num, (double) kept_frames / rate);
+    if (burst_num != 0u)
+    {
+        printf("bursts:    %u, %u onsets and %u ends clipped\n", burst_num, clipped_onsets, clipped_ends);
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    printf("detector:  %.0f cycles per block (host)\n", (double) time / vad.blocks);
+#else
+    printf("detector:  %.0f ns per block (host)\n", (double) time / vad.blocks);
+#endif
+    printf("index:     %s\n", ((written == vad.blocks_kept) &&
+                                (kept_frames <= (written * PCM_BLOCK_SIZE / (channels * sizeof(int16_t))))) ?
+                               "consistent" : "INCONSISTENT");
+
+    return ((written == vad.blocks_kept) && (clipped_onsets == 0u) && (clipped_ends == 0u)) ? 0 : 1;
+}
+
+/* [] END OF FILE */
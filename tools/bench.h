@@ -0,0 +1,130 @@
+/*****************************************************************************
+* File Name: bench.h
+*
+* Description:
+*  This file contains the helpers shared by the host benchmarks and checks
+*  of tools/: the CPU cycle counter and the test signal. Include it with
+*  -I.. from the tool folder.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define PI                      3.14159265358979323846
+
+/*******************************************************************************
+* Function Name: cycles
+********************************************************************************
+* Summary:
+*   CPU cycle counter, or nanoseconds if the host has none.
+*
+*******************************************************************************/
+static inline uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000u) + (uint64_t) now.tv_nsec;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: bench_rand
+********************************************************************************
+* Summary:
+*   Next value of a linear congruential generator, the same on every host.
+*
+* Parameters:
+*   seed: state of the generator, 1 to start
+*
+* Return:
+*   Value from 0 to 65535.
+*
+*******************************************************************************/
+static inline int32_t bench_rand(uint32_t *seed)
+{
+    *seed = (*seed * 1103515245u) + 12345u;
+    return (int32_t) (*seed >> 16);
+}
+
+/*******************************************************************************
+* Function Name: bench_signal
+********************************************************************************
+* Summary:
+*   Test signal: tones with a syllable-like envelope over background noise,
+*   different on each channel.
+*
+*******************************************************************************/
+static inline void bench_signal(int16_t *pcm, uint32_t frames, uint32_t rate, uint32_t channels)
+{
+    uint32_t frame;
+    uint32_t channel;
+    uint32_t seed = 1;
+    double t;
+    double env;
+    double value;
+
+    for (frame = 0; frame < frames; frame++)
+    {
+        t = (double) frame / rate;
+        env = 0.5 + 0.5 * sin(2.0 * PI * 3.0 * t);
+        for (channel = 0; channel < channels; channel++)
+        {
+            value = env * (6000.0 * sin(2.0 * PI * (220.0 + 110.0 * channel) * t) +
+                           3000.0 * sin(2.0 * PI * 1870.0 * t + channel)) +
+                    (double) (bench_rand(&seed) % 400 - 200);
+            pcm[frame * channels + channel] = (int16_t) value;
+        }
+    }
+}
+
+#endif /* BENCH_H_ */
+
+/* [] END OF FILE */
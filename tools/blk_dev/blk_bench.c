@@ -0,0 +1,467 @@
+/*****************************************************************************
+* File Name: blk_bench.c
+*
+* Description:
+*  This file contains a host program running the block device stages
+*  (source/blk_dev.c) over a file backend. The "check" mode runs random
+*  reads, writes and syncs through a partition, a read cache and a write
+*  coalescing stage, and compares every read with a model of the device.
+*  The "bench" mode runs a recording workload, long data writes mixed with
+*  single-block FAT and directory updates, through several stacks and
+*  reports the operations reaching the backend and their time.
+*
+*  Build:
+*    gcc -O2 -I../../source -o blk_bench blk_bench.c ../../source/blk_dev.c
+*  Run:
+*    ./blk_bench check [image file] [seed] [operations]
+*    ./blk_bench bench [image file]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "blk_dev.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define BLOCK_SIZE              512u
+#define IMAGE_BLOCKS            16384u      /* 8 MB */
+#define PART_FIRST              64u
+#define RUN_MAX                 32u
+
+#define CACHE_LINES             16u
+#define COALESCE_BLOCKS         64u
+
+#define BENCH_CLUSTER_BLOCKS    64u         /* 32 KB clusters */
+#define BENCH_WRITE_BLOCKS      8u          /* 4 KB record writes */
+#define BENCH_SYNC_BLOCKS       128u        /* Sync every 64 KB */
+#define BENCH_FAT_FIRST         32u
+#define BENCH_DIR_BLOCK         96u
+#define BENCH_DATA_FIRST        128u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* File backend */
+typedef struct
+{
+    blk_dev_t dev;
+    int fd;
+    uint32_t block_num;
+} file_dev_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static uint8_t cache_lines[CACHE_LINES * BLOCK_SIZE];
+static uint32_t cache_tags[CACHE_LINES];
+static uint8_t coalesce_buf[COALESCE_BLOCKS * BLOCK_SIZE];
+static uint8_t buf[RUN_MAX * BLOCK_SIZE];
+static uint8_t check_buf[RUN_MAX * BLOCK_SIZE];
+
+/*******************************************************************************
+* Function Name: clock_us
+********************************************************************************
+* Summary:
+*   Monotonic time in microseconds, the clock of the statistics stages.
+*
+*******************************************************************************/
+static uint32_t clock_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((now.tv_sec * 1000000u) + (now.tv_nsec / 1000u));
+}
+
+/*******************************************************************************
+* Function Name: file_block_size
+********************************************************************************
+* Summary:
+*   Block size of the file backend.
+*
+*******************************************************************************/
+static uint32_t file_block_size(blk_dev_t *dev)
+{
+    (void) dev;
+    return BLOCK_SIZE;
+}
+
+/*******************************************************************************
+* Function Name: file_block_num
+********************************************************************************
+* Summary:
+*   Number of blocks of the file backend.
+*
+*******************************************************************************/
+static uint32_t file_block_num(blk_dev_t *dev)
+{
+    return ((file_dev_t *) dev)->block_num;
+}
+
+/*******************************************************************************
+* Function Name: file_read
+********************************************************************************
+* Summary:
+*   Read blocks from the image file.
+*
+*******************************************************************************/
+static blk_dev_result_t file_read(blk_dev_t *dev, uint32_t block, uint8_t *data, uint32_t *count)
+{
+    file_dev_t *file = (file_dev_t *) dev;
+    size_t size = (size_t) *count * BLOCK_SIZE;
+
+    if (pread(file->fd, data, size, (off_t) block * BLOCK_SIZE) != (ssize_t) size)
+    {
+        *count = 0;
+        return BLK_DEV_ERR_IO;
+    }
+    return BLK_DEV_OK;
+}
+
+/*******************************************************************************
+* Function Name: file_write
+********************************************************************************
+* Summary:
+*   Write blocks to the image file.
+*
+*******************************************************************************/
+static blk_dev_result_t file_write(blk_dev_t *dev, uint32_t block, const uint8_t *data, uint32_t *count)
+{
+    file_dev_t *file = (file_dev_t *) dev;
+    size_t size = (size_t) *count * BLOCK_SIZE;
+
+    if (pwrite(file->fd, data, size, (off_t) block * BLOCK_SIZE) != (ssize_t) size)
+    {
+        *count = 0;
+        return BLK_DEV_ERR_IO;
+    }
+    return BLK_DEV_OK;
+}
+
+/*******************************************************************************
+* Function Name: file_sync
+********************************************************************************
+* Summary:
+*   Flush the image file.
+*
+*******************************************************************************/
+static blk_dev_result_t file_sync(blk_dev_t *dev)
+{
+    return (fdatasync(((file_dev_t *) dev)->fd) == 0) ? BLK_DEV_OK : BLK_DEV_ERR_IO;
+}
+
+static const blk_dev_ops_t file_ops =
+{
+    .block_size = file_block_size,
+    .block_num = file_block_num,
+    .read = file_read,
+    .write = file_write,
+    .sync = file_sync,
+};
+
+/*******************************************************************************
+* Function Name: file_open
+********************************************************************************
+* Summary:
+*   Open and size the image file of the file backend.
+*
+*******************************************************************************/
+static blk_dev_t *file_open(file_dev_t *file, const char *path)
+{
+    file->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if ((file->fd < 0) || (ftruncate(file->fd, (off_t) IMAGE_BLOCKS * BLOCK_SIZE) != 0))
+    {
+        perror(path);
+        exit(1);
+    }
+    file->dev.ops = &file_ops;
+    file->dev.lower = NULL;
+    file->block_num = IMAGE_BLOCKS;
+    return &file->dev;
+}
+
+/*******************************************************************************
+* Function Name: fill_run
+********************************************************************************
+* Summary:
+*   Fill blocks with their number and a version.
+*
+*******************************************************************************/
+static void fill_run(uint8_t *data, uint32_t block, uint32_t count, uint32_t version)
+{
+    uint32_t index;
+    uint32_t word[2];
+
+    for (index = 0; index < (count * BLOCK_SIZE); index += 8u)
+    {
+        word[0] = block + (index / BLOCK_SIZE);
+        word[1] = version;
+        memcpy(&data[index], word, 8);
+    }
+}
+
+/*******************************************************************************
+* Function Name: check
+********************************************************************************
+* Summary:
+*   Run random operations through a partition, a read cache and a write
+*   coalescing stage, and compare the reads with a model.
+*
+* Return:
+*   0 if all the reads match.
+*
+*******************************************************************************/
+static int check(const char *path, uint32_t seed, uint32_t operations)
+{
+    static uint8_t model[(IMAGE_BLOCKS - PART_FIRST) * BLOCK_SIZE];
+    file_dev_t file;
+    blk_dev_part_t part;
+    blk_dev_cache_t cache;
+    blk_dev_coalesce_t coalesce;
+    blk_dev_t *dev;
+    uint32_t num;
+    uint32_t op;
+    uint32_t block;
+    uint32_t count;
+
+    srand(seed);
+    dev = file_open(&file, path);
+    dev = blk_dev_part_init(&part, dev, PART_FIRST, IMAGE_BLOCKS - PART_FIRST);
+    dev = blk_dev_cache_init(&cache, dev, cache_lines, cache_tags, CACHE_LINES, BLOCK_SIZE);
+    dev = blk_dev_coalesce_init(&coalesce, dev, coalesce_buf, COALESCE_BLOCKS, BLOCK_SIZE);
+    num = blk_dev_block_num(dev);
+    memset(model, 0, sizeof(model));
+
+    for (op = 0; op < operations; op++)
+    {
+        /* Favour short runs in a small window so the stages get hits */
+        count = ((rand() % 4) == 0) ? (1u + (rand() % RUN_MAX)) : 1u;
+        block = ((rand() % 2) == 0) ? (rand() % 256u) : (rand() % (num - RUN_MAX));
+
+        switch (rand() % 8)
+        {
+            case 0:
+            case 1:
+            case 2:
+                fill_run(buf, block, count, op + 1u);
+                if ((blk_dev_write(dev, block, buf, &count) != BLK_DEV_OK))
+                {
+                    printf("op %u: write %u+%u failed\n", op, block, count);
+                    return 1;
+                }
+                memcpy(&model[block * BLOCK_SIZE], buf, count * BLOCK_SIZE);
+                break;
+
+            case 3:
+                /* Consecutive write, the coalescing case */
+                block = coalesce.first + coalesce.count;
+                if ((block + count) > num)
+                {
+                    break;
+                }
+                fill_run(buf, block, count, op + 1u);
+                if ((blk_dev_write(dev, block, buf, &count) != BLK_DEV_OK))
+                {
+                    printf("op %u: write %u+%u failed\n", op, block, count);
+                    return 1;
+                }
+                memcpy(&model[block * BLOCK_SIZE], buf, count * BLOCK_SIZE);
+                break;
+
+            case 4:
+                if (blk_dev_sync(dev) != BLK_DEV_OK)
+                {
+                    printf("op %u: sync failed\n", op);
+                    return 1;
+                }
+                break;
+
+            default:
+                if ((blk_dev_read(dev, block, check_buf, &count) != BLK_DEV_OK))
+                {
+                    printf("op %u: read %u+%u failed\n", op, block, count);
+                    return 1;
+                }
+                if (memcmp(check_buf, &model[block * BLOCK_SIZE], count * BLOCK_SIZE) != 0)
+                {
+                    printf("op %u: read %u+%u mismatch\n", op, block, count);
+                    return 1;
+                }
+                break;
+        }
+    }
+
+    /* What was synced must be in the image, past the partition offset */
+    (void) blk_dev_sync(dev);
+    for (block = 0; block < num; block += RUN_MAX)
+    {
+        count = ((num - block) < RUN_MAX) ? (num - block) : RUN_MAX;
+        if ((file_read(&file.dev, PART_FIRST + block, check_buf, &count) != BLK_DEV_OK) ||
+            (memcmp(check_buf, &model[block * BLOCK_SIZE], count * BLOCK_SIZE) != 0))
+        {
+            printf("image mismatch at block %u\n", block);
+            return 1;
+        }
+    }
+
+    printf("check: %u operations, cache %u hits %u misses, %u coalesced writes\n",
+           operations, cache.hits, cache.misses, coalesce.flushes);
+    close(file.fd);
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: bench_run
+********************************************************************************
+* Summary:
+*   Write a recording through a stack: record writes of a few blocks, a FAT
+*   update at each new cluster, and a directory entry update with a sync
+*   every BENCH_SYNC_BLOCKS. The FAT block is read before its update.
+*
+*******************************************************************************/
+static void bench_run(const char *name, blk_dev_t *dev, blk_dev_stats_t *top, blk_dev_stats_t *bottom)
+{
+    uint32_t block;
+    uint32_t count;
+    uint32_t fat;
+    uint32_t start;
+    uint32_t data_num = blk_dev_block_num(dev) - BENCH_DATA_FIRST;
+
+    data_num -= data_num % BENCH_SYNC_BLOCKS;
+    start = clock_us();
+    for (block = 0; block < data_num; block += BENCH_WRITE_BLOCKS)
+    {
+        count = BENCH_WRITE_BLOCKS;
+        fill_run(buf, BENCH_DATA_FIRST + block, count, 1);
+        (void) blk_dev_write(dev, BENCH_DATA_FIRST + block, buf, &count);
+
+        if (((block + BENCH_WRITE_BLOCKS) % BENCH_CLUSTER_BLOCKS) == 0)
+        {
+            fat = BENCH_FAT_FIRST + ((block / BENCH_CLUSTER_BLOCKS) / 128u);
+            count = 1;
+            (void) blk_dev_read(dev, fat, buf, &count);
+            buf[0]++;
+            (void) blk_dev_write(dev, fat, buf, &count);
+        }
+        if (((block + BENCH_WRITE_BLOCKS) % BENCH_SYNC_BLOCKS) == 0)
+        {
+            count = 1;
+            (void) blk_dev_read(dev, BENCH_DIR_BLOCK, buf, &count);
+            buf[0]++;
+            (void) blk_dev_write(dev, BENCH_DIR_BLOCK, buf, &count);
+            (void) blk_dev_sync(dev);
+        }
+    }
+
+    printf("%-20s %8u %8u %8u %8u %10.1f\n", name,
+           top->read_ops + top->write_ops, bottom->read_ops, bottom->write_ops,
+           bottom->sync_ops, (double) (clock_us() - start) / 1000.0);
+}
+
+/*******************************************************************************
+* Function Name: bench
+********************************************************************************
+* Summary:
+*   Run the recording workload through stacks with and without the read
+*   cache and the write coalescing.
+*
+*******************************************************************************/
+static int bench(const char *path)
+{
+    static const char *names[] = { "backend", "cache", "coalesce", "cache+coalesce" };
+    file_dev_t file;
+    blk_dev_stats_t bottom;
+    blk_dev_stats_t top;
+    blk_dev_cache_t cache;
+    blk_dev_coalesce_t coalesce;
+    blk_dev_t *dev;
+    uint32_t stack;
+
+    printf("%-20s %8s %8s %8s %8s %10s\n", "stack", "ops", "reads", "writes", "syncs", "time (ms)");
+    for (stack = 0; stack < 4u; stack++)
+    {
+        dev = file_open(&file, path);
+        dev = blk_dev_stats_init(&bottom, dev, clock_us);
+        if ((stack & 1u) != 0)
+        {
+            dev = blk_dev_cache_init(&cache, dev, cache_lines, cache_tags, CACHE_LINES, BLOCK_SIZE);
+        }
+        if ((stack & 2u) != 0)
+        {
+            dev = blk_dev_coalesce_init(&coalesce, dev, coalesce_buf, COALESCE_BLOCKS, BLOCK_SIZE);
+        }
+        dev = blk_dev_stats_init(&top, dev, NULL);
+        bench_run(names[stack], dev, &top, &bottom);
+        close(file.fd);
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*   Run the check or the bench.
+*
+*******************************************************************************/
+int main(int argc, char **argv)
+{
+    const char *path = (argc > 2) ? argv[2] : "blk_bench.img";
+
+    if ((argc > 1) && (strcmp(argv[1], "check") == 0))
+    {
+        return check(path, (argc > 3) ? (uint32_t) atoi(argv[3]) : 1u,
+                     (argc > 4) ? (uint32_t) atoi(argv[4]) : 100000u);
+    }
+    if ((argc > 1) && (strcmp(argv[1], "bench") == 0))
+    {
+        return bench(path);
+    }
+
+    printf("usage: %s check|bench [image file] [seed] [operations]\n", argv[0]);
+    return 1;
+}
+
+/* [] END OF FILE */
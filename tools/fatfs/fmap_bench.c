@@ -0,0 +1,481 @@
+/*****************************************************************************
+* File Name: fmap_bench.c
+*
+* Description:
+*  This file contains a host benchmark of the free cluster map of FatFs
+*  (FF_USE_FREEMAP in fatfs/ffconf.h). A 32000 MB image file is formatted in
+*  FAT32 with 32-KB clusters, as the firmware does for a 32-GB card, and
+*  filled with 64-MB records; a few records in the middle of the volume are
+*  then deleted, so the free clusters are far from the last allocation, as
+*  on a full card the host cleaned. FatFs runs behind the SD card emulator
+*  (source/sd_emu.c) on a simulated clock. After each mount, the benchmark
+*  reports the FAT sectors read and the emulated time of f_getfree(), of a
+*  record written after it as audio_fs_init() does, and of a record written
+*  right after the mount, with the time of its first write, which builds the
+*  map.
+*
+*  The map mode follows from the build, so the benchmark is built three times:
+*    gcc -O2 -I../../source -I../../fatfs -o fmap_count fmap_bench.c \
+*        ../../source/sd_emu.c ../../source/blk_dev.c ../../fatfs/ff.c \
+*        ../../fatfs/ffunicode.c ../../fatfs/ffsystem.c
+*    the same with -DFF_FREEMAP_SIZE=131072 -o fmap_bits, for one bit per
+*    cluster, and with -DFF_USE_FREEMAP=0 -o fmap_off, for no map.
+*  Run:
+*    ./fmap_count [-p fast|typical|slow] [-m record MB] [-i image file]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "sd_emu.h"
+#include "ff.h"
+#include "diskio.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define SECTOR_SIZE             512u
+#define IMAGE_SIZE              (32000ull * 1024ull * 1024ull)
+#define CLUSTER_SIZE            32768u
+#define FILL_SIZE               (64u * 1024u * 1024u)
+#define HOLES                   4u          /* Records deleted in the middle */
+#define WRITE_SIZE              CLUSTER_SIZE
+
+#define DEFAULT_RECORD_MB       128u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Image file backend */
+typedef struct
+{
+    blk_dev_t dev;
+    int fd;
+} file_dev_t;
+
+/* FAT reads and emulated time of a step */
+typedef struct
+{
+    uint32_t fat_reads;
+    uint64_t time_us;
+    uint64_t first_us;          /* First write of a record */
+} step_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static const char *image = "fmap_bench.img";
+static file_dev_t file;
+static sd_emu_t emu;
+static blk_dev_t *disk;
+static uint64_t now_us;
+static const sd_emu_profile_t *profile;
+static uint32_t fat_reads;
+
+static FATFS fs;
+static uint8_t work[32768];
+static uint8_t data[WRITE_SIZE];
+
+/*******************************************************************************
+* Function Name: file_read, file_write, file_block_size
+********************************************************************************
+* Summary:
+*   Image file backend, in 512-byte sectors as the SD card.
+*
+*******************************************************************************/
+static blk_dev_result_t file_read(blk_dev_t *dev, uint32_t block, uint8_t *buf, uint32_t *count)
+{
+    size_t size = (size_t) *count * SECTOR_SIZE;
+
+    return (pread(((file_dev_t *) dev)->fd, buf, size, (off_t) block * SECTOR_SIZE) == (ssize_t) size) ?
+           BLK_DEV_OK : BLK_DEV_ERR_IO;
+}
+
+static blk_dev_result_t file_write(blk_dev_t *dev, uint32_t block, const uint8_t *buf, uint32_t *count)
+{
+    size_t size = (size_t) *count * SECTOR_SIZE;
+
+    return (pwrite(((file_dev_t *) dev)->fd, buf, size, (off_t) block * SECTOR_SIZE) == (ssize_t) size) ?
+           BLK_DEV_OK : BLK_DEV_ERR_IO;
+}
+
+static uint32_t file_block_size(blk_dev_t *dev)
+{
+    (void) dev;
+    return SECTOR_SIZE;
+}
+
+static uint32_t file_block_num(blk_dev_t *dev)
+{
+    (void) dev;
+    return (uint32_t) (IMAGE_SIZE / SECTOR_SIZE);
+}
+
+static const blk_dev_ops_t file_ops =
+{
+    .block_size = file_block_size,
+    .block_num = file_block_num,
+    .read = file_read,
+    .write = file_write,
+};
+
+/*******************************************************************************
+* Function Name: clock_advance
+********************************************************************************
+* Summary:
+*   Delay of the emulator: advance the simulated clock.
+*
+*******************************************************************************/
+static void clock_advance(uint32_t us)
+{
+    now_us += us;
+}
+
+/*******************************************************************************
+* FatFs disk interface on the emulated card, counting the FAT reads
+*******************************************************************************/
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    (void) pdrv;
+    return 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    (void) pdrv;
+    return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    uint32_t length = count;
+
+    (void) pdrv;
+    if ((fs.fs_type != 0) && (sector < (fs.fatbase + fs.fsize)) && ((sector + count) > fs.fatbase))
+    {
+        fat_reads += count;
+    }
+    return (blk_dev_read(disk, (uint32_t) sector, buff, &length) == BLK_DEV_OK) ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
+{
+    uint32_t length = count;
+
+    (void) pdrv;
+    return (blk_dev_write(disk, (uint32_t) sector, buff, &length) == BLK_DEV_OK) ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    (void) pdrv;
+    switch (cmd)
+    {
+        case CTRL_SYNC:
+            return (blk_dev_sync(disk) == BLK_DEV_OK) ? RES_OK : RES_ERROR;
+        case GET_SECTOR_COUNT:
+            *(LBA_t *) buff = blk_dev_block_num(disk);
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *) buff = SECTOR_SIZE;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *) buff = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+DWORD get_fattime(void)
+{
+    return ((DWORD) (2021 - 1980) << 25) | (1u << 21) | (1u << 16);
+}
+
+/*******************************************************************************
+* Function Name: prepare
+********************************************************************************
+* Summary:
+*   Format the image and fill it with records, then delete a few in the
+*   middle of the volume. Runs on the image file without the emulator.
+*
+* Return:
+*   Free space in MB, 0 if failed.
+*
+*******************************************************************************/
+static uint32_t prepare(void)
+{
+    const MKFS_PARM param = { FM_FAT32, 1, 0, 0, CLUSTER_SIZE };
+    char name[20];
+    uint32_t num = 0;
+    uint32_t index;
+    DWORD free_clst;
+    FATFS *fs_ptr;
+    FIL fp;
+
+    disk = &file.dev;
+    if ((ftruncate(file.fd, 0) != 0) || (ftruncate(file.fd, (off_t) IMAGE_SIZE) != 0) ||
+        (f_mkfs("", &param, work, sizeof(work)) != FR_OK) || (f_mount(&fs, "", 1) != FR_OK))
+    {
+        return 0;
+    }
+
+    /* Records filling the volume, allocated contiguously */
+    while (1)
+    {
+        snprintf(name, sizeof(name), "rec_%04u.raw", (unsigned) num);
+        if (f_open(&fp, name, FA_CREATE_NEW | FA_WRITE) != FR_OK)
+        {
+            return 0;
+        }
+        if (f_expand(&fp, FILL_SIZE, 1) != FR_OK)
+        {
+            f_close(&fp);
+            f_unlink(name);
+            break;
+        }
+        f_close(&fp);
+        num++;
+    }
+
+    /* The host deletes records in the middle */
+    for (index = num / 2u; index < ((num / 2u) + HOLES); index++)
+    {
+        snprintf(name, sizeof(name), "rec_%04u.raw", (unsigned) index);
+        f_unlink(name);
+    }
+
+    if (f_getfree("", &free_clst, &fs_ptr) != FR_OK)
+    {
+        return 0;
+    }
+    f_mount(NULL, "", 0);
+    memset(&fs, 0, sizeof(fs));
+
+    return (uint32_t) (((uint64_t) free_clst * CLUSTER_SIZE) >> 20);
+}
+
+/*******************************************************************************
+* Function Name: step_begin, step_end
+********************************************************************************
+* Summary:
+*   Count the FAT reads and the emulated time of a step.
+*
+*******************************************************************************/
+static void step_begin(step_t *step)
+{
+    memset(step, 0, sizeof(*step));
+    step->fat_reads = fat_reads;
+    step->time_us = now_us;
+}
+
+static void step_end(step_t *step)
+{
+    step->fat_reads = fat_reads - step->fat_reads;
+    step->time_us = now_us - step->time_us;
+}
+
+/*******************************************************************************
+* Function Name: record
+********************************************************************************
+* Summary:
+*   Write a record of the given size, a cluster per write followed by
+*   f_sync(), as a raw record is written.
+*
+* Return:
+*   True if the whole record was written.
+*
+*******************************************************************************/
+static bool record(uint32_t mb, step_t *step)
+{
+    uint32_t writes = (mb * 1024u * 1024u) / WRITE_SIZE;
+    uint32_t index;
+    uint64_t start;
+    UINT count;
+    FIL fp;
+
+    step_begin(step);
+    if (f_open(&fp, "rec_new.raw", FA_CREATE_NEW | FA_WRITE) != FR_OK)
+    {
+        return false;
+    }
+    for (index = 0; index < writes; index++)
+    {
+        start = now_us;
+        if ((f_write(&fp, data, WRITE_SIZE, &count) != FR_OK) || (count != WRITE_SIZE) || (f_sync(&fp) != FR_OK))
+        {
+            f_close(&fp);
+            return false;
+        }
+        if (index == 0u)
+        {
+            step->first_us = now_us - start;
+        }
+    }
+    f_close(&fp);
+    step_end(step);
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: mount
+********************************************************************************
+* Summary:
+*   Mount the prepared volume behind the emulator, as at boot.
+*
+*******************************************************************************/
+static bool mount(void)
+{
+    disk = sd_emu_init(&emu, &file.dev, profile, clock_advance, 1u);
+    return (f_mount(&fs, "", 1) == FR_OK);
+}
+
+/*******************************************************************************
+* Function Name: map_mode
+********************************************************************************
+* Summary:
+*   Name of the map mode the volume got.
+*
+*******************************************************************************/
+static const char *map_mode(void)
+{
+#if FF_USE_FREEMAP
+    static const char *const names[] = { "none", "bits", "count", "off" };
+
+    return (fs.fmap_mode < 4u) ? names[fs.fmap_mode] : "?";
+#else
+    return "disabled";
+#endif
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*   Measure the mount, f_getfree() and record steps on freshly prepared
+*   volumes, and print the results.
+*
+*******************************************************************************/
+int main(int argc, char **argv)
+{
+    uint32_t record_mb = DEFAULT_RECORD_MB;
+    uint32_t free_mb;
+    step_t getfree;
+    step_t warm;
+    step_t cold;
+    DWORD free_clst;
+    FATFS *fs_ptr;
+    int opt;
+
+    profile = &sd_emu_profiles[SD_EMU_TYPICAL];
+    while ((opt = getopt(argc, argv, "p:m:i:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p':
+                profile = sd_emu_find_profile(optarg);
+                if (profile == NULL)
+                {
+                    printf("unknown profile %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'm': record_mb = (uint32_t) atoi(optarg); break;
+            case 'i': image = optarg; break;
+            default:
+                printf("usage: %s [-p profile] [-m record MB] [-i image]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    file.dev.ops = &file_ops;
+    file.fd = open(image, O_RDWR | O_CREAT, 0644);
+    if (file.fd < 0)
+    {
+        printf("can't open %s\n", image);
+        return 1;
+    }
+
+    /* f_getfree() after the mount, then a record */
+    free_mb = prepare();
+    if ((free_mb == 0u) || !mount())
+    {
+        printf("can't prepare the image\n");
+        return 1;
+    }
+    step_begin(&getfree);
+    if (f_getfree("", &free_clst, &fs_ptr) != FR_OK)
+    {
+        printf("f_getfree failed\n");
+        return 1;
+    }
+    step_end(&getfree);
+    if (!record(record_mb, &warm))
+    {
+        printf("record failed\n");
+        return 1;
+    }
+
+    /* A record right after the mount */
+    if ((prepare() == 0u) || !mount() || !record(record_mb, &cold))
+    {
+        printf("record failed\n");
+        return 1;
+    }
+
+    printf("FF_USE_FREEMAP %u, FF_FREEMAP_SIZE %u, map %s, profile %s\n", (unsigned) FF_USE_FREEMAP,
+           (unsigned) FF_FREEMAP_SIZE, map_mode(), profile->name);
+    printf("32000 MB FAT32, %u KB clusters, %u MB free in the middle, record of %u MB\n",
+           CLUSTER_SIZE / 1024u, free_mb, record_mb);
+    printf("%-24s %10s %10s %14s\n", "step", "FAT reads", "ms", "first write ms");
+    printf("%-24s %10u %10.1f %14s\n", "f_getfree", getfree.fat_reads, getfree.time_us / 1000.0, "-");
+    printf("%-24s %10u %10.1f %14.1f\n", "record after f_getfree", warm.fat_reads, warm.time_us / 1000.0,
+           warm.first_us / 1000.0);
+    printf("%-24s %10u %10.1f %14.1f\n", "record after mount", cold.fat_reads, cold.time_us / 1000.0,
+           cold.first_us / 1000.0);
+
+    close(file.fd);
+    unlink(image);
+    return 0;
+}
+
+/* [] END OF FILE */
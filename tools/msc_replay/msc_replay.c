@@ -0,0 +1,1328 @@
+/*****************************************************************************
+* File Name: msc_replay.c
+*
+* Description:
+*  This file contains a host replay of USB mass storage captures against
+*  the transport of the firmware. The bulk transfers of endpoints 0x02 and
+*  0x81 are read from a usbmon capture (pcap or pcapng, link types
+*  LINUX_USB and LINUX_USB_MMAPPED) and grouped in commands: CBW, data and
+*  CSW. Each command is fed packet by packet to the endpoint callbacks of
+*  usb_comm.c, which serve it from an image file per logical unit through
+*  the block device stack, and the data and status sent back are compared
+*  with the capture. The images are sized from the captured READ CAPACITY
+*  answers and seeded with the captured READ(10) data of the blocks not
+*  written before in the capture.
+*
+*  The replay time is modeled: the host delays between commands are taken
+*  from the capture, the full-speed bus carries one 64-byte packet every
+*  1000/19 us, and the storage time is added by the SD card emulator when a
+*  profile is given. For each capture, normally one per host OS, the tool
+*  reports the mount latency (commands until the first idle gap of the host)
+*  and the copy throughput of the WRITE(10) and READ(10) commands, captured
+*  and replayed. The event trace of the firmware (source/trace.c) runs on
+*  the model clock, in microseconds, and can be saved per capture in the
+*  format of TRACE.BIN, to compare with a trace of the device with
+*  tools/trace_to_chrome.py.
+*
+*  Build on Linux from this folder:
+*    gcc -O2 -Ishim -I../../source -I../../usb_msc -DTRACE_ENABLE
+*        -D'TRACE_CLOCK()=host_trace_clock()' -DTRACE_CLOCK_HZ=1000000u
+*        -o msc_replay msc_replay.c usb_shim.c ../../source/usb_comm.c
+*        ../../source/usb_scsi.c ../../source/buf_arena.c
+*        ../../source/blk_dev.c ../../source/sd_emu.c ../../source/trace.c
+*        ../../usb_msc/cy_usb_dev_msc.c
+*
+*  Usage: msc_replay [-p profile] [-d bus.dev] [-g gap ms] [-i image prefix]
+*                    [-t trace prefix] [-v] capture...
+*    -t writes the trace of each capture to <trace prefix>_<capture>.bin.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "usb_shim.h"
+#include "usb_comm.h"
+#include "storage.h"
+#include "sd_emu.h"
+#include "trace.h"
+#include "virt_file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Capture formats */
+#define PCAP_MAGIC_US           0xA1B2C3D4u
+#define PCAP_MAGIC_NS           0xA1B23C4Du
+#define PCAPNG_SHB              0x0A0D0D0Au
+#define PCAPNG_BYTE_ORDER       0x1A2B3C4Du
+#define PCAPNG_IDB              1u
+#define PCAPNG_SPB              3u
+#define PCAPNG_EPB              6u
+#define PCAPNG_IF_MAX           16u
+
+#define LINKTYPE_USB_LINUX      189u
+#define LINKTYPE_USB_LINUX_MMAP 220u
+#define USBMON_HDR_SIZE         48u
+#define USBMON_MMAP_HDR_SIZE    64u
+#define USBMON_XFER_BULK        3u
+#define USBMON_EPIPE            (-32)
+
+/* Bulk-only transport */
+#define CBW_SIZE                CY_USB_DEV_MSC_CMD_BLOCK_SIZE
+#define CSW_SIZE                CY_USB_DEV_MSC_CMD_STATUS_SIZE
+#define CBW_FLAG_DIR_IN         0x80u
+
+/* Model of the full-speed bus: 19 bulk packets of 64 bytes per frame */
+#define PACKET_US               (1000.0 / 19.0)
+#define TIMER_PERIOD_US         10000.0
+
+#define DEFAULT_GAP_MS          500u
+#define DEFAULT_BLOCK_SIZE      512u
+#define DEFAULT_BLOCK_NUM       2048u
+#define MISMATCH_PRINT_MAX      10u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Bulk transfer of the capture, on the OUT or IN endpoint */
+typedef struct
+{
+    uint64_t time_us;
+    uint8_t ep;
+    uint8_t bus;
+    uint8_t devnum;
+    bool stall;
+    bool truncated;
+    uint32_t len;
+    uint8_t *data;
+} xfer_t;
+
+/* Command of the capture: CBW, data and CSW */
+typedef struct
+{
+    uint8_t cbw[CBW_SIZE];
+    uint8_t csw[CSW_SIZE];
+    bool has_csw;
+    bool stall;
+    bool truncated;
+    uint64_t start_us;
+    uint64_t end_us;
+    uint8_t *out;
+    uint32_t out_len;
+    uint8_t *in;
+    uint32_t in_len;
+} cmd_t;
+
+/* Image file backend of a storage unit, connected when its logical unit is
+*  found in the capture */
+typedef struct
+{
+    blk_dev_t dev;
+    int fd;
+    bool connected;
+    uint32_t block_size;
+    uint32_t block_num;
+} file_dev_t;
+
+typedef struct
+{
+    file_dev_t file;
+    sd_emu_t emu;
+    blk_dev_t *top;
+} unit_t;
+
+/* Geometry and seeding state of a logical unit of the capture */
+typedef struct
+{
+    bool used;
+    uint32_t block_size;
+    uint32_t block_num;
+    uint8_t *written;       /* Bitmap of the blocks written in the capture */
+    unit_t *unit;
+} lun_t;
+
+/* Results of a capture */
+typedef struct
+{
+    uint32_t cmds;
+    uint32_t mismatches;
+    uint32_t stalls;
+    uint32_t resets;
+    double capt_mount_us;
+    double repl_mount_us;
+    uint64_t write_bytes;
+    double capt_write_us;
+    double repl_write_us;
+    uint64_t read_bytes;
+    double capt_read_us;
+    double repl_read_us;
+    double capt_total_us;
+    double repl_total_us;
+} report_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+extern cy_stc_usb_dev_msc_context_t usb_mscContext;
+extern cy_stc_usb_dev_msc_lun_t usb_luns[];
+
+static unit_t units[STORAGE_UNIT_NUM];
+static lun_t luns[CY_USB_DEV_MSC_LUN_MAX];
+
+static xfer_t *xfers;
+static uint32_t xfer_num;
+static uint32_t xfer_cap;
+static cmd_t *cmds;
+static uint32_t cmd_num;
+
+static const sd_emu_profile_t *profile;
+static const char *image_prefix = "msc_replay";
+static const char *trace_prefix;
+static uint32_t gap_ms = DEFAULT_GAP_MS;
+static int opt_bus = -1;
+static int opt_dev = -1;
+static int sel_bus;
+static int sel_dev;
+static bool verbose;
+
+static double model_us;
+static double next_tick_us;
+
+/* Transfers and storage time at the last model clock step, for the trace */
+static uint32_t trace_packets;
+static double trace_storage_us;
+
+/*******************************************************************************
+* Function Name: rd16, rd32, rd64, be32
+********************************************************************************
+* Summary:
+*   Read the little-endian fields of the captures and the big-endian fields
+*   of the SCSI commands.
+*
+*******************************************************************************/
+static uint16_t rd16(const uint8_t *p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t rd64(const uint8_t *p)
+{
+    return (uint64_t) rd32(p) | ((uint64_t) rd32(p + 4) << 32);
+}
+
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+/*******************************************************************************
+* Function Name: storage_get_dev
+********************************************************************************
+* Summary:
+*   Block device stack of a storage unit, taken by usb_comm_init(): the image
+*   file, behind the SD card emulator when a profile is given.
+*
+*******************************************************************************/
+blk_dev_t *storage_get_dev(storage_unit_t unit)
+{
+    return units[unit].top;
+}
+
+/*******************************************************************************
+* Stand-ins of the firmware statistics and virtual files. The virtual file
+* blocks are served from the image, seeded with what the device sent.
+*******************************************************************************/
+void stats_scsi_begin(uint8_t opcode)
+{
+    (void) opcode;
+}
+
+void stats_scsi_end(uint8_t opcode, uint32_t bytes)
+{
+    (void) opcode;
+    (void) bytes;
+}
+
+bool virt_file_register(const char *name, uint32_t size, virt_file_read_t read)
+{
+    (void) name;
+    (void) size;
+    (void) read;
+    return true;
+}
+
+bool virt_file_covers(uint32_t blk_addr, uint32_t blk_len)
+{
+    (void) blk_addr;
+    (void) blk_len;
+    return false;
+}
+
+void virt_file_overlay(uint32_t blk_addr, uint32_t blk_len, uint32_t block_size, uint8_t *buf)
+{
+    (void) blk_addr;
+    (void) blk_len;
+    (void) block_size;
+    (void) buf;
+}
+
+void virt_file_invalidate(uint32_t blk_addr, uint32_t blk_len)
+{
+    (void) blk_addr;
+    (void) blk_len;
+}
+
+/*******************************************************************************
+* Image file backend
+*******************************************************************************/
+static bool file_is_connected(blk_dev_t *dev)
+{
+    return ((file_dev_t *) dev)->connected;
+}
+
+static uint32_t file_block_size(blk_dev_t *dev)
+{
+    return ((file_dev_t *) dev)->block_size;
+}
+
+static uint32_t file_block_num(blk_dev_t *dev)
+{
+    return ((file_dev_t *) dev)->block_num;
+}
+
+static blk_dev_result_t file_read(blk_dev_t *dev, uint32_t block, uint8_t *data, uint32_t *count)
+{
+    file_dev_t *file = (file_dev_t *) dev;
+    size_t size = (size_t) *count * file->block_size;
+
+    if (pread(file->fd, data, size, (off_t) block * file->block_size) != (ssize_t) size)
+    {
+        *count = 0;
+        return BLK_DEV_ERR_IO;
+    }
+    return BLK_DEV_OK;
+}
+
+static blk_dev_result_t file_write(blk_dev_t *dev, uint32_t block, const uint8_t *data, uint32_t *count)
+{
+    file_dev_t *file = (file_dev_t *) dev;
+    size_t size = (size_t) *count * file->block_size;
+
+    if (pwrite(file->fd, data, size, (off_t) block * file->block_size) != (ssize_t) size)
+    {
+        *count = 0;
+        return BLK_DEV_ERR_IO;
+    }
+    return BLK_DEV_OK;
+}
+
+static blk_dev_result_t file_sync(blk_dev_t *dev)
+{
+    (void) dev;
+    return BLK_DEV_OK;
+}
+
+static const blk_dev_ops_t file_ops =
+{
+    .is_connected = file_is_connected,
+    .block_size = file_block_size,
+    .block_num = file_block_num,
+    .read = file_read,
+    .write = file_write,
+    .sync = file_sync,
+};
+
+/*******************************************************************************
+* Function Name: emu_delay
+********************************************************************************
+* Summary:
+*   Delay of the SD card emulator: the time is read from its counters.
+*
+*******************************************************************************/
+static void emu_delay(uint32_t us)
+{
+    (void) us;
+}
+
+/*******************************************************************************
+* Function Name: units_init
+********************************************************************************
+* Summary:
+*   Build the stacks of the storage units, disconnected.
+*
+*******************************************************************************/
+static void units_init(void)
+{
+    uint32_t index;
+
+    for (index = 0; index < STORAGE_UNIT_NUM; index++)
+    {
+        units[index].file.dev.ops = &file_ops;
+        units[index].file.dev.lower = NULL;
+        units[index].file.fd = -1;
+        units[index].top = &units[index].file.dev;
+        if (profile != NULL)
+        {
+            units[index].top = sd_emu_init(&units[index].emu, units[index].top, profile, emu_delay, index + 1u);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: storage_time_us
+********************************************************************************
+* Summary:
+*   Total time emulated by the SD card emulators.
+*
+*******************************************************************************/
+static double storage_time_us(void)
+{
+    double time = 0;
+    uint32_t index;
+
+    if (profile != NULL)
+    {
+        for (index = 0; index < STORAGE_UNIT_NUM; index++)
+        {
+            time += (double) units[index].emu.time_us;
+        }
+    }
+    return time;
+}
+
+/*******************************************************************************
+* Function Name: xfer_add
+********************************************************************************
+* Summary:
+*   Append a bulk transfer of the capture.
+*
+*******************************************************************************/
+static void xfer_add(const xfer_t *xfer, const uint8_t *data, uint32_t len)
+{
+    xfer_t *entry;
+
+    if (xfer_num == xfer_cap)
+    {
+        xfer_cap = (xfer_cap == 0) ? 4096u : (xfer_cap * 2u);
+        xfers = realloc(xfers, xfer_cap * sizeof(xfer_t));
+    }
+    entry = &xfers[xfer_num++];
+    *entry = *xfer;
+    entry->len = len;
+    entry->data = NULL;
+    if (len > 0)
+    {
+        entry->data = malloc(len);
+        memcpy(entry->data, data, len);
+    }
+}
+
+/*******************************************************************************
+* Function Name: usbmon_packet
+********************************************************************************
+* Summary:
+*   Parse a usbmon packet: the OUT data is taken from the submissions, the IN
+*   data and the stalls from the completions.
+*
+* Parameters:
+*   pkt: packet, starting with the usbmon header
+*   len: captured length
+*   hdr_size: size of the usbmon header
+*
+*******************************************************************************/
+static void usbmon_packet(const uint8_t *pkt, uint32_t len, uint32_t hdr_size)
+{
+    xfer_t xfer;
+    uint8_t type;
+    uint32_t length;
+    uint32_t len_cap;
+    int32_t status;
+
+    if ((len < hdr_size) || (pkt[9] != USBMON_XFER_BULK))
+    {
+        return;
+    }
+
+    type = pkt[8];
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.ep = pkt[10];
+    xfer.devnum = pkt[11];
+    xfer.bus = (uint8_t) rd16(&pkt[12]);
+    xfer.time_us = rd64(&pkt[16]) * 1000000u + rd32(&pkt[24]);
+    status = (int32_t) rd32(&pkt[28]);
+    length = rd32(&pkt[32]);
+    len_cap = rd32(&pkt[36]);
+    if (len_cap > (len - hdr_size))
+    {
+        len_cap = len - hdr_size;
+    }
+    xfer.truncated = (len_cap < length);
+
+    if ((xfer.ep == MSC_OUT_ENDPOINT_ADDR) && (type == 'S'))
+    {
+        xfer_add(&xfer, &pkt[hdr_size], len_cap);
+    }
+    else if ((type == 'C') && (status == USBMON_EPIPE) &&
+             ((xfer.ep == MSC_OUT_ENDPOINT_ADDR) || (xfer.ep == MSC_IN_ENDPOINT_ADDR)))
+    {
+        xfer.stall = true;
+        xfer_add(&xfer, NULL, 0);
+    }
+    else if ((xfer.ep == MSC_IN_ENDPOINT_ADDR) && (type == 'C') && (status == 0))
+    {
+        xfer_add(&xfer, &pkt[hdr_size], len_cap);
+    }
+}
+
+/*******************************************************************************
+* Function Name: hdr_size_of
+********************************************************************************
+* Summary:
+*   Size of the usbmon header of a link type, 0 if not supported.
+*
+*******************************************************************************/
+static uint32_t hdr_size_of(uint32_t linktype)
+{
+    if (linktype == LINKTYPE_USB_LINUX)
+    {
+        return USBMON_HDR_SIZE;
+    }
+    if (linktype == LINKTYPE_USB_LINUX_MMAP)
+    {
+        return USBMON_MMAP_HDR_SIZE;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: load_capture
+********************************************************************************
+* Summary:
+*   Read the bulk transfers of a pcap or pcapng capture.
+*
+* Return:
+*   False if the file cannot be read or has no usbmon packets.
+*
+*******************************************************************************/
+static bool load_capture(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    uint8_t *file;
+    long size;
+    uint32_t hdr_sizes[PCAPNG_IF_MAX] = { 0 };
+    uint32_t if_num = 0;
+    uint32_t pos;
+    uint32_t block_len;
+    uint32_t cap_len;
+    uint32_t hdr_size;
+    uint32_t magic;
+
+    if ((fp == NULL) || (fseek(fp, 0, SEEK_END) != 0) || ((size = ftell(fp)) < 24))
+    {
+        printf("%s: cannot read\n", path);
+        if (fp != NULL)
+        {
+            fclose(fp);
+        }
+        return false;
+    }
+    rewind(fp);
+    file = malloc((size_t) size);
+    if (fread(file, 1, (size_t) size, fp) != (size_t) size)
+    {
+        printf("%s: cannot read\n", path);
+        fclose(fp);
+        free(file);
+        return false;
+    }
+    fclose(fp);
+
+    magic = rd32(file);
+    if ((magic == PCAP_MAGIC_US) || (magic == PCAP_MAGIC_NS))
+    {
+        hdr_size = hdr_size_of(rd32(&file[20]));
+        for (pos = 24; (hdr_size != 0) && ((pos + 16u) <= (uint32_t) size); pos += 16u + cap_len)
+        {
+            cap_len = rd32(&file[pos + 8u]);
+            if ((pos + 16u + cap_len) > (uint32_t) size)
+            {
+                break;
+            }
+            usbmon_packet(&file[pos + 16u], cap_len, hdr_size);
+        }
+    }
+    else if ((magic == PCAPNG_SHB) && (rd32(&file[8]) == PCAPNG_BYTE_ORDER))
+    {
+        for (pos = 0; (pos + 12u) <= (uint32_t) size; pos += block_len)
+        {
+            block_len = rd32(&file[pos + 4u]);
+            if ((block_len < 12u) || ((pos + block_len) > (uint32_t) size))
+            {
+                break;
+            }
+            switch (rd32(&file[pos]))
+            {
+                case PCAPNG_SHB:
+                    if_num = 0;
+                    break;
+                case PCAPNG_IDB:
+                    if (if_num < PCAPNG_IF_MAX)
+                    {
+                        hdr_sizes[if_num++] = hdr_size_of(rd16(&file[pos + 8u]));
+                    }
+                    break;
+                case PCAPNG_EPB:
+                    hdr_size = (rd32(&file[pos + 8u]) < if_num) ? hdr_sizes[rd32(&file[pos + 8u])] : 0;
+                    cap_len = rd32(&file[pos + 20u]);
+                    if ((hdr_size != 0) && ((28u + cap_len) <= block_len))
+                    {
+                        usbmon_packet(&file[pos + 28u], cap_len, hdr_size);
+                    }
+                    break;
+                case PCAPNG_SPB:
+                    cap_len = rd32(&file[pos + 8u]);
+                    if (cap_len > (block_len - 16u))
+                    {
+                        cap_len = block_len - 16u;
+                    }
+                    if ((if_num > 0) && (hdr_sizes[0] != 0))
+                    {
+                        usbmon_packet(&file[pos + 12u], cap_len, hdr_sizes[0]);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    else
+    {
+        printf("%s: not a little-endian pcap or pcapng file\n", path);
+        free(file);
+        return false;
+    }
+
+    free(file);
+    if (xfer_num == 0)
+    {
+        printf("%s: no usbmon bulk transfers on endpoints 0x%02x/0x%02x\n", path,
+               MSC_OUT_ENDPOINT_ADDR, MSC_IN_ENDPOINT_ADDR);
+        return false;
+    }
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: is_cbw, is_csw
+********************************************************************************
+* Summary:
+*   Check the signature of a command block or status wrapper.
+*
+*******************************************************************************/
+static bool is_cbw(const xfer_t *xfer)
+{
+    return (xfer->len == CBW_SIZE) && (rd32(xfer->data) == MSC_CBW_SIGNATURE);
+}
+
+static bool is_csw(const uint8_t *data, uint32_t len)
+{
+    return (len == CSW_SIZE) && (rd32(data) == MSC_CSW_SIGNATURE);
+}
+
+/*******************************************************************************
+* Function Name: append
+********************************************************************************
+* Summary:
+*   Append data to a buffer of a command.
+*
+*******************************************************************************/
+static void append(uint8_t **buf, uint32_t *len, const uint8_t *data, uint32_t size)
+{
+    *buf = realloc(*buf, *len + size);
+    memcpy(&(*buf)[*len], data, size);
+    *len += size;
+}
+
+/*******************************************************************************
+* Function Name: group_commands
+********************************************************************************
+* Summary:
+*   Select the device, the first one sending a CBW unless given with -d, and
+*   group its transfers in commands. A transfer on the OUT endpoint is data
+*   while the command expects more, otherwise a new CBW.
+*
+*******************************************************************************/
+static void group_commands(void)
+{
+    cmd_t *cmd = NULL;
+    xfer_t *xfer;
+    uint32_t index;
+    uint32_t expected;
+
+    sel_bus = opt_bus;
+    sel_dev = opt_dev;
+    for (index = 0; (sel_bus < 0) && (index < xfer_num); index++)
+    {
+        if ((xfers[index].ep == MSC_OUT_ENDPOINT_ADDR) && is_cbw(&xfers[index]))
+        {
+            sel_bus = xfers[index].bus;
+            sel_dev = xfers[index].devnum;
+        }
+    }
+
+    cmds = calloc(xfer_num, sizeof(cmd_t));
+    cmd_num = 0;
+    for (index = 0; index < xfer_num; index++)
+    {
+        xfer = &xfers[index];
+        if ((xfer->bus != sel_bus) || (xfer->devnum != sel_dev))
+        {
+            continue;
+        }
+
+        expected = (cmd != NULL) ? rd32(&cmd->cbw[8]) : 0;
+        if (xfer->stall)
+        {
+            if (cmd != NULL)
+            {
+                cmd->stall = true;
+                cmd->end_us = xfer->time_us;
+            }
+        }
+        else if (xfer->ep == MSC_OUT_ENDPOINT_ADDR)
+        {
+            if ((cmd != NULL) && !cmd->has_csw && !cmd->stall && ((cmd->cbw[12] & CBW_FLAG_DIR_IN) == 0) &&
+                (cmd->out_len < expected))
+            {
+                append(&cmd->out, &cmd->out_len, xfer->data, xfer->len);
+                cmd->truncated |= xfer->truncated;
+                cmd->end_us = xfer->time_us;
+            }
+            else if (is_cbw(xfer) && !xfer->truncated)
+            {
+                cmd = &cmds[cmd_num++];
+                memcpy(cmd->cbw, xfer->data, CBW_SIZE);
+                cmd->start_us = xfer->time_us;
+                cmd->end_us = xfer->time_us;
+            }
+        }
+        else if ((cmd != NULL) && !cmd->has_csw)
+        {
+            if (is_csw(xfer->data, xfer->len) && (rd32(&xfer->data[4]) == rd32(&cmd->cbw[4])))
+            {
+                memcpy(cmd->csw, xfer->data, CSW_SIZE);
+                cmd->has_csw = true;
+            }
+            else
+            {
+                append(&cmd->in, &cmd->in_len, xfer->data, xfer->len);
+                cmd->truncated |= xfer->truncated;
+            }
+            cmd->end_us = xfer->time_us;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: prepare_luns
+********************************************************************************
+* Summary:
+*   Size the logical units from the READ CAPACITY answers, or from the
+*   highest block accessed, or with a default size, then open their images and seed them with the
+*   READ(10) data of the blocks not written before in the capture.
+*
+* Return:
+*   False if a logical unit of the capture does not exist in the firmware.
+*
+*******************************************************************************/
+static bool prepare_luns(const char *name)
+{
+    cmd_t *cmd;
+    lun_t *lun;
+    unit_t *unit;
+    char path[512];
+    uint32_t index;
+    uint32_t block;
+    uint32_t count;
+    uint32_t end;
+    uint32_t lun_index;
+    uint32_t unit_index;
+
+    memset(luns, 0, sizeof(luns));
+    for (index = 0; index < cmd_num; index++)
+    {
+        cmd = &cmds[index];
+        lun = &luns[cmd->cbw[13] % CY_USB_DEV_MSC_LUN_MAX];
+        lun->used = true;
+        if ((cmd->cbw[15] == CY_USB_DEV_MSC_SCSI_READ_CAPACITY) && (cmd->in_len >= 8u) && (lun->block_num == 0))
+        {
+            lun->block_num = be32(&cmd->in[0]) + 1u;
+            lun->block_size = be32(&cmd->in[4]);
+        }
+    }
+    for (index = 0; index < cmd_num; index++)
+    {
+        cmd = &cmds[index];
+        lun = &luns[cmd->cbw[13] % CY_USB_DEV_MSC_LUN_MAX];
+        if ((cmd->cbw[15] == CY_USB_DEV_MSC_SCSI_READ10) || (cmd->cbw[15] == CY_USB_DEV_MSC_SCSI_WRITE10))
+        {
+            if (lun->block_size == 0)
+            {
+                lun->block_size = DEFAULT_BLOCK_SIZE;
+            }
+            end = be32(&cmd->cbw[17]) + ((cmd->cbw[22] << 8) | cmd->cbw[23]);
+            if (end > lun->block_num)
+            {
+                lun->block_num = end;
+            }
+        }
+    }
+
+    for (lun_index = 0; lun_index < CY_USB_DEV_MSC_LUN_MAX; lun_index++)
+    {
+        lun = &luns[lun_index];
+        if (!lun->used)
+        {
+            continue;
+        }
+        if (lun->block_num == 0)
+        {
+            printf("%s: no geometry for LUN %u, %u blocks of %u bytes used\n", name, lun_index,
+                   DEFAULT_BLOCK_NUM, DEFAULT_BLOCK_SIZE);
+            lun->block_size = DEFAULT_BLOCK_SIZE;
+            lun->block_num = DEFAULT_BLOCK_NUM;
+        }
+        if (lun_index >= usb_mscContext.lun_num)
+        {
+            printf("%s: LUN %u not exposed by the firmware (%u LUNs)\n", name, lun_index, usb_mscContext.lun_num);
+            return false;
+        }
+        for (unit_index = 0; unit_index < STORAGE_UNIT_NUM; unit_index++)
+        {
+            if (units[unit_index].top == usb_luns[lun_index].dev)
+            {
+                lun->unit = &units[unit_index];
+            }
+        }
+        unit = lun->unit;
+        snprintf(path, sizeof(path), "%s_lun%u.img", image_prefix, lun_index);
+        unit->file.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if ((unit->file.fd < 0) || (ftruncate(unit->file.fd, (off_t) lun->block_num * lun->block_size) != 0))
+        {
+            perror(path);
+            exit(1);
+        }
+        unit->file.block_size = lun->block_size;
+        unit->file.block_num = lun->block_num;
+        lun->written = calloc((lun->block_num + 7u) / 8u, 1);
+    }
+
+    for (index = 0; index < cmd_num; index++)
+    {
+        cmd = &cmds[index];
+        lun = &luns[cmd->cbw[13] % CY_USB_DEV_MSC_LUN_MAX];
+        if ((lun->unit == NULL) ||
+            ((cmd->cbw[15] != CY_USB_DEV_MSC_SCSI_READ10) && (cmd->cbw[15] != CY_USB_DEV_MSC_SCSI_WRITE10)))
+        {
+            continue;
+        }
+        block = be32(&cmd->cbw[17]);
+        count = (cmd->cbw[22] << 8) | cmd->cbw[23];
+        for (end = block + count; block < end; block++)
+        {
+            if (cmd->cbw[15] == CY_USB_DEV_MSC_SCSI_WRITE10)
+            {
+                lun->written[block / 8u] |= (uint8_t) (1u << (block % 8u));
+            }
+            else if (((lun->written[block / 8u] & (1u << (block % 8u))) == 0) &&
+                     (cmd->in_len >= ((block - be32(&cmd->cbw[17]) + 1u) * lun->block_size)))
+            {
+                if (pwrite(lun->unit->file.fd, &cmd->in[(block - be32(&cmd->cbw[17])) * lun->block_size],
+                           lun->block_size, (off_t) block * lun->block_size) != (ssize_t) lun->block_size)
+                {
+                    perror(path);
+                    exit(1);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: advance
+********************************************************************************
+* Summary:
+*   Advance the model clock, firing the 10-ms activity timer.
+*
+*******************************************************************************/
+static void advance(double us)
+{
+    trace_packets = usb_shim_packets();
+    trace_storage_us = storage_time_us();
+    model_us += us;
+    while (next_tick_us <= model_us)
+    {
+        usb_shim_tick();
+        next_tick_us += TIMER_PERIOD_US;
+    }
+}
+
+/*******************************************************************************
+* Function Name: host_trace_clock
+********************************************************************************
+* Summary:
+*   Trace clock: the model clock, plus the bus and storage time of the
+*   command in progress.
+*
+*******************************************************************************/
+uint32_t host_trace_clock(void)
+{
+    return (uint32_t) (model_us + (usb_shim_packets() - trace_packets) * PACKET_US +
+                       (storage_time_us() - trace_storage_us));
+}
+
+/*******************************************************************************
+* Function Name: save_trace
+********************************************************************************
+* Summary:
+*   Write the trace of a capture as the TRACE.BIN file of the device.
+*
+*******************************************************************************/
+static void save_trace(const char *name)
+{
+#if defined(TRACE_ENABLE)
+    static uint8_t data[TRACE_FILE_SIZE];
+    char path[512];
+    FILE *file;
+
+    trace_stop();
+    snprintf(path, sizeof(path), "%s_%s.bin", trace_prefix, name);
+    file = fopen(path, "wb");
+    if ((file == NULL) || (fwrite(data, 1, trace_read(0, data, sizeof(data)), file) != sizeof(data)))
+    {
+        perror(path);
+    }
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+#else
+    (void) name;
+    printf("  no trace, built without TRACE_ENABLE\n");
+#endif
+}
+
+/*******************************************************************************
+* Function Name: recover
+********************************************************************************
+* Summary:
+*   Reset recovery of the host after a command without status.
+*
+*******************************************************************************/
+static void recover(report_t *report)
+{
+    usb_shim_reset();
+    usb_comm_process();
+    report->resets++;
+}
+
+/*******************************************************************************
+* Function Name: pump_in
+********************************************************************************
+* Summary:
+*   Read the IN packets sent by the transport, keeping the last one apart
+*   as it may be the CSW.
+*
+*******************************************************************************/
+static void pump_in(uint8_t *buf, uint32_t size, uint32_t *len, uint8_t *last, uint32_t *last_len)
+{
+    uint8_t packet[USB_SHIM_PACKET_SIZE];
+    uint32_t packet_len;
+
+    while (((*len + *last_len) <= size) && usb_shim_in(packet, &packet_len))
+    {
+        memcpy(&buf[*len], last, *last_len);
+        *len += *last_len;
+        memcpy(last, packet, packet_len);
+        *last_len = packet_len;
+    }
+}
+
+/*******************************************************************************
+* Function Name: mismatch
+********************************************************************************
+* Summary:
+*   Count and print a difference between the capture and the replay.
+*
+*******************************************************************************/
+static void mismatch(report_t *report, uint32_t index, const cmd_t *cmd, const char *what)
+{
+    if (verbose || (report->mismatches < MISMATCH_PRINT_MAX))
+    {
+        printf("  #%u opcode 0x%02x LUN %u tag 0x%08x: %s\n", index, cmd->cbw[15], cmd->cbw[13],
+               rd32(&cmd->cbw[4]), what);
+    }
+    report->mismatches++;
+}
+
+/*******************************************************************************
+* Function Name: replay_command
+********************************************************************************
+* Summary:
+*   Feed a command to the transport and compare its answer with the capture.
+*
+* Return:
+*   Modeled device time of the command in microseconds.
+*
+*******************************************************************************/
+static double replay_command(report_t *report, uint32_t index, const cmd_t *cmd)
+{
+    static uint8_t *buf;
+    static uint32_t buf_size;
+    uint8_t last[USB_SHIM_PACKET_SIZE];
+    char what[96];
+    uint32_t last_len = 0;
+    uint32_t len = 0;
+    uint32_t size = rd32(&cmd->cbw[8]) + USB_SHIM_PACKET_SIZE;
+    uint32_t packets = usb_shim_packets();
+    double storage_us = storage_time_us();
+    double time_us;
+    uint32_t pos;
+    bool stall = false;
+    bool ok = true;
+
+    if (size > buf_size)
+    {
+        buf_size = size;
+        buf = realloc(buf, buf_size);
+    }
+
+    if (!usb_shim_out_ready())
+    {
+        recover(report);
+    }
+    usb_shim_out(cmd->cbw, CBW_SIZE);
+    pump_in(buf, size, &len, last, &last_len);
+    for (pos = 0; pos < cmd->out_len; pos += USB_SHIM_PACKET_SIZE)
+    {
+        if (!usb_shim_out_ready())
+        {
+            break;
+        }
+        usb_shim_out(&cmd->out[pos], ((cmd->out_len - pos) < USB_SHIM_PACKET_SIZE) ?
+                                     (cmd->out_len - pos) : USB_SHIM_PACKET_SIZE);
+        pump_in(buf, size, &len, last, &last_len);
+    }
+    if (usb_shim_stalled())
+    {
+        /* The host clears the halt and reads the CSW */
+        stall = true;
+        report->stalls++;
+        usb_shim_clear_halt();
+        pump_in(buf, size, &len, last, &last_len);
+    }
+
+    if (stall != cmd->stall)
+    {
+        mismatch(report, index, cmd, stall ? "stalled, not in the capture" : "stall of the capture missing");
+        ok = false;
+    }
+    if (!is_csw(last, last_len))
+    {
+        /* Data without status */
+        memcpy(&buf[len], last, last_len);
+        len += last_len;
+        last_len = 0;
+    }
+    if (((cmd->cbw[12] & CBW_FLAG_DIR_IN) != 0) && !cmd->truncated && cmd->has_csw &&
+        ((len != cmd->in_len) || (memcmp(buf, cmd->in, len) != 0)))
+    {
+        mismatch(report, index, cmd, (cmd->cbw[15] == CY_USB_DEV_MSC_SCSI_READ10) ? "read data differs" :
+                                                                                   "response differs");
+        ok = false;
+    }
+    if (cmd->has_csw != (last_len != 0))
+    {
+        if (ok)
+        {
+            mismatch(report, index, cmd, cmd->has_csw ? "no CSW" : "CSW where the host reset");
+        }
+        recover(report);
+    }
+    else if (cmd->has_csw && ok)
+    {
+        if ((rd32(&last[4]) != rd32(&cmd->csw[4])) || (last[12] != cmd->csw[12]) ||
+            (rd32(&last[8]) != rd32(&cmd->csw[8])))
+        {
+            snprintf(what, sizeof(what), "CSW tag 0x%08x status %u residue %u, captured 0x%08x %u %u",
+                     rd32(&last[4]), last[12], rd32(&last[8]), rd32(&cmd->csw[4]), cmd->csw[12], rd32(&cmd->csw[8]));
+            mismatch(report, index, cmd, what);
+        }
+    }
+    else if (!cmd->has_csw)
+    {
+        recover(report);
+    }
+    usb_comm_process();
+
+    time_us = (usb_shim_packets() - packets) * PACKET_US + (storage_time_us() - storage_us);
+    return time_us;
+}
+
+/*******************************************************************************
+* Function Name: replay_capture
+********************************************************************************
+* Summary:
+*   Replay the commands of a capture and collect the report.
+*
+*******************************************************************************/
+static void replay_capture(report_t *report)
+{
+    const cmd_t *cmd;
+    uint64_t prev_end = cmds[0].start_us;
+    double capt_us;
+    double repl_us;
+    bool mounted = false;
+    uint32_t index;
+    uint32_t bytes;
+
+    model_us = 0;
+    next_tick_us = TIMER_PERIOD_US;
+    for (index = 0; index < cmd_num; index++)
+    {
+        cmd = &cmds[index];
+        if (!mounted && (cmd->start_us >= (prev_end + (uint64_t) gap_ms * 1000u)))
+        {
+            mounted = true;
+            report->capt_mount_us = (double) (prev_end - cmds[0].start_us);
+            report->repl_mount_us = model_us;
+        }
+        advance((cmd->start_us > prev_end) ? (double) (cmd->start_us - prev_end) : 0.0);
+
+        capt_us = (double) (cmd->end_us - cmd->start_us);
+        repl_us = replay_command(report, index, cmd);
+        advance(repl_us);
+        report->cmds++;
+
+        bytes = rd32(&cmd->cbw[8]);
+        if (cmd->cbw[15] == CY_USB_DEV_MSC_SCSI_WRITE10)
+        {
+            report->write_bytes += bytes;
+            report->capt_write_us += capt_us;
+            report->repl_write_us += repl_us;
+        }
+        else if (cmd->cbw[15] == CY_USB_DEV_MSC_SCSI_READ10)
+        {
+            report->read_bytes += bytes;
+            report->capt_read_us += capt_us;
+            report->repl_read_us += repl_us;
+        }
+        prev_end = (cmd->end_us > prev_end) ? cmd->end_us : prev_end;
+    }
+    if (!mounted)
+    {
+        report->capt_mount_us = (double) (prev_end - cmds[0].start_us);
+        report->repl_mount_us = model_us;
+    }
+    report->capt_total_us = (double) (prev_end - cmds[0].start_us);
+    report->repl_total_us = model_us;
+}
+
+/*******************************************************************************
+* Function Name: kbps
+********************************************************************************
+* Summary:
+*   Throughput in KB/s, 0 without time.
+*
+*******************************************************************************/
+static double kbps(uint64_t bytes, double us)
+{
+    return (us > 0) ? ((double) bytes * 1000000.0 / 1024.0 / us) : 0.0;
+}
+
+/*******************************************************************************
+* Function Name: release
+********************************************************************************
+* Summary:
+*   Free the transfers and commands of a capture, and close and disconnect
+*   the images.
+*
+*******************************************************************************/
+static void release(void)
+{
+    uint32_t index;
+
+    for (index = 0; index < xfer_num; index++)
+    {
+        free(xfers[index].data);
+    }
+    for (index = 0; index < cmd_num; index++)
+    {
+        free(cmds[index].out);
+        free(cmds[index].in);
+    }
+    free(cmds);
+    cmds = NULL;
+    xfer_num = 0;
+    cmd_num = 0;
+    for (index = 0; index < CY_USB_DEV_MSC_LUN_MAX; index++)
+    {
+        free(luns[index].written);
+    }
+    for (index = 0; index < STORAGE_UNIT_NUM; index++)
+    {
+        if (units[index].file.fd >= 0)
+        {
+            close(units[index].file.fd);
+            units[index].file.fd = -1;
+        }
+        units[index].file.connected = false;
+    }
+    usb_comm_process();
+}
+
+int main(int argc, char **argv)
+{
+    report_t report;
+    const char *name;
+    uint32_t index;
+    uint32_t unit;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:d:g:i:t:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p':
+                profile = sd_emu_find_profile(optarg);
+                if (profile == NULL)
+                {
+                    printf("unknown profile %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'd':
+                if (sscanf(optarg, "%d.%d", &opt_bus, &opt_dev) != 2)
+                {
+                    printf("device: bus.dev\n");
+                    return 1;
+                }
+                break;
+            case 'g': gap_ms = (uint32_t) atoi(optarg); break;
+            case 'i': image_prefix = optarg; break;
+            case 't': trace_prefix = optarg; break;
+            case 'v': verbose = true; break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if (optind >= argc)
+    {
+        printf("usage: %s [-p profile] [-d bus.dev] [-g gap ms] [-i image prefix] [-t trace prefix] [-v] capture...\n",
+               argv[0]);
+        return 1;
+    }
+
+    units_init();
+    TRACE_INIT();
+    usb_comm_init();
+    usb_comm_connect();
+
+    printf("storage %s, mount ends at the first %u-ms host gap\n", (profile != NULL) ? profile->name : "none", gap_ms);
+    for (index = (uint32_t) optind; index < (uint32_t) argc; index++)
+    {
+        name = strrchr(argv[index], '/');
+        name = (name != NULL) ? (name + 1) : argv[index];
+        memset(&report, 0, sizeof(report));
+        if (!load_capture(argv[index]))
+        {
+            failed = 1;
+            continue;
+        }
+        group_commands();
+        if ((cmd_num == 0) || !prepare_luns(name))
+        {
+            printf("%s: no command to replay\n", name);
+            release();
+            failed = 1;
+            continue;
+        }
+        for (unit = 0; unit < STORAGE_UNIT_NUM; unit++)
+        {
+            units[unit].file.connected = (units[unit].file.fd >= 0);
+        }
+        usb_shim_reset();
+        usb_comm_process();
+
+        printf("%s: device %d.%d\n", name, sel_bus, sel_dev);
+        TRACE_START();
+        replay_capture(&report);
+        if (trace_prefix != NULL)
+        {
+            save_trace(name);
+        }
+        printf("  %u commands, %u mismatches, %u stalls, %u resets\n", report.cmds, report.mismatches,
+               report.stalls, report.resets);
+        printf("  %-20s %12s %12s\n", "", "captured", "replayed");
+        printf("  %-20s %12.1f %12.1f\n", "mount ms", report.capt_mount_us / 1000.0, report.repl_mount_us / 1000.0);
+        printf("  %-20s %12.1f %12.1f\n", "total ms", report.capt_total_us / 1000.0, report.repl_total_us / 1000.0);
+        printf("  %-20s %12.1f %12.1f   (%llu KB)\n", "write KB/s", kbps(report.write_bytes, report.capt_write_us),
+               kbps(report.write_bytes, report.repl_write_us), (unsigned long long) (report.write_bytes / 1024u));
+        printf("  %-20s %12.1f %12.1f   (%llu KB)\n", "read KB/s", kbps(report.read_bytes, report.capt_read_us),
+               kbps(report.read_bytes, report.repl_read_us), (unsigned long long) (report.read_bytes / 1024u));
+        if (report.mismatches != 0)
+        {
+            failed = 1;
+        }
+        release();
+    }
+    return failed;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,2 @@
+/* Host stand-in, see host_shim.h */
+#include "host_shim.h"
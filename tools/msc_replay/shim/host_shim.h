@@ -0,0 +1,241 @@
+/*****************************************************************************
+* File Name: host_shim.h
+*
+* Description:
+*  This file contains the host declarations standing for the PDL, HAL and
+*  FreeRTOS parts used by the USB mass storage transport (usb_comm.c,
+*  usb_scsi.c, cy_usb_dev_msc.c and buf_arena.c), so msc_replay builds them
+*  on Linux. The other headers of this folder include this one.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef HOST_SHIM_H_
+#define HOST_SHIM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+/*******************************************************************************
+* PDL utilities
+********************************************************************************/
+#define CY_IP_MXUSBFS
+#define __STATIC_INLINE             static inline
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint32_t cy_rslt_t;
+
+#define CY_RSLT_SUCCESS             0u
+#define CY_LO8(x)                   ((uint8_t) ((x) & 0xFFu))
+#define CY_HI8(x)                   ((uint8_t) (((uint16_t) (x) >> 8u) & 0xFFu))
+#define CY_LO16(x)                  ((uint16_t) ((x) & 0xFFFFu))
+#define CY_HI16(x)                  ((uint16_t) (((uint32_t) (x) >> 16u) & 0xFFFFu))
+
+/*******************************************************************************
+* Interrupts
+********************************************************************************/
+typedef int IRQn_Type;
+
+typedef struct
+{
+    IRQn_Type intrSrc;
+    uint32_t intrPriority;
+} cy_stc_sysint_t;
+
+#define usb_interrupt_hi_IRQn       0
+#define usb_interrupt_med_IRQn      1
+#define usb_interrupt_lo_IRQn       2
+
+cy_rslt_t Cy_SysInt_Init(const cy_stc_sysint_t *config, void (*handler)(void));
+void      NVIC_EnableIRQ(IRQn_Type irq);
+uint32_t  __get_IPSR(void);
+
+/*******************************************************************************
+* Core, for the event trace: the exclusive accesses always succeed, and the
+* trace clock is the replay model (TRACE_CLOCK on the command line)
+********************************************************************************/
+#define CoreDebug_DEMCR_TRCENA_Msk  (1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      1u
+#define CoreDebug                   (&host_core_debug)
+#define DWT                         (&host_dwt)
+#define __LDREXW(addr)              (*(addr))
+#define __STREXW(value, addr)       ((*(addr) = (value)), 0u)
+
+typedef struct
+{
+    uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct
+{
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+} DWT_Type;
+
+extern CoreDebug_Type host_core_debug;
+extern DWT_Type host_dwt;
+
+uint32_t  host_trace_clock(void);
+
+/*******************************************************************************
+* USB device middleware
+********************************************************************************/
+/* Same codes as the PDL: their low byte is sent as the CSW status */
+#define CY_USB_DEV_ID               (0x49u << 18)
+#define CY_PDL_STATUS_ERROR         (2u << 16)
+
+typedef enum
+{
+    CY_USB_DEV_SUCCESS = 0,
+    CY_USB_DEV_BAD_PARAM = (CY_USB_DEV_ID | CY_PDL_STATUS_ERROR | 1u),
+    CY_USB_DEV_REQUEST_NOT_HANDLED = (CY_USB_DEV_ID | CY_PDL_STATUS_ERROR | 2u),
+    CY_USB_DEV_TIMEOUT = (CY_USB_DEV_ID | CY_PDL_STATUS_ERROR | 3u),
+    CY_USB_DEV_DRV_HW_ERROR = (CY_USB_DEV_ID | CY_PDL_STATUS_ERROR | 4u),
+} cy_en_usb_dev_status_t;
+
+#define CY_USB_DEV_CLASS_TYPE       1u
+#define CY_USB_DEV_WAIT_FOREVER     0
+
+typedef struct { int unused; } USBFS_Type;
+typedef struct { int unused; } cy_stc_usb_dev_context_t;
+typedef struct { int unused; } cy_stc_usb_dev_class_t;
+typedef struct { int unused; } cy_stc_usb_dev_class_ll_item_t;
+
+typedef struct
+{
+    struct
+    {
+        struct
+        {
+            uint8_t type;
+        } bmRequestType;
+        uint8_t bRequest;
+    } setup;
+    uint8_t *ptr;
+    uint32_t remaining;
+    bool notify;
+} cy_stc_usb_dev_control_transfer_t;
+
+typedef struct cy_stc_usbfs_dev_drv_context
+{
+    cy_stc_usb_dev_context_t *devConext;
+} cy_stc_usbfs_dev_drv_context_t;
+
+typedef void (*cy_cb_usbfs_dev_drv_ep_callback_t)(USBFS_Type *base, uint32_t endpointAddr, uint32_t errorType,
+                                                  struct cy_stc_usbfs_dev_drv_context *context);
+typedef cy_en_usb_dev_status_t (*cy_cb_usb_dev_request_received_t)(cy_stc_usb_dev_control_transfer_t *transfer,
+                                                                   void *classContext,
+                                                                   cy_stc_usb_dev_context_t *devContext);
+typedef cy_en_usb_dev_status_t (*cy_cb_usb_dev_request_cmplt_t)(cy_stc_usb_dev_control_transfer_t *transfer,
+                                                                void *classContext,
+                                                                cy_stc_usb_dev_context_t *devContext);
+
+extern USBFS_Type *CYBSP_USBDEV_HW;
+extern const int CYBSP_USBDEV_config;
+extern const int usb_devices[];
+extern const int usb_devConfig;
+
+cy_en_usb_dev_status_t Cy_USB_Dev_Init(USBFS_Type *base, const void *drvConfig, cy_stc_usbfs_dev_drv_context_t *drvContext,
+                                       const void *device, const void *config, cy_stc_usb_dev_context_t *context);
+cy_en_usb_dev_status_t Cy_USB_Dev_RegisterClass(cy_stc_usb_dev_class_ll_item_t *classItem, cy_stc_usb_dev_class_t *classObj,
+                                                void *classContext, cy_stc_usb_dev_context_t *context);
+void     Cy_USB_Dev_RegisterClassRequestRcvdCallback(cy_cb_usb_dev_request_received_t callback, cy_stc_usb_dev_class_t *classObj);
+void     Cy_USB_Dev_RegisterClassRequestCmpltCallback(cy_cb_usb_dev_request_cmplt_t callback, cy_stc_usb_dev_class_t *classObj);
+void     Cy_USB_Dev_OverwriteHandleTimeout(int32_t (*handler)(int32_t ms), cy_stc_usb_dev_context_t *context);
+cy_en_usb_dev_status_t Cy_USB_Dev_Connect(bool blocking, int32_t timeout, cy_stc_usb_dev_context_t *context);
+uint32_t Cy_USB_Dev_GetConfiguration(cy_stc_usb_dev_context_t *context);
+bool     Cy_USB_Dev_IsConfigurationChanged(cy_stc_usb_dev_context_t *context);
+cy_en_usb_dev_status_t Cy_USB_Dev_StartReadEp(uint32_t endpoint, cy_stc_usb_dev_context_t *context);
+cy_en_usb_dev_status_t Cy_USB_Dev_ReadEpNonBlocking(uint32_t endpoint, uint8_t *buffer, uint32_t size,
+                                                    uint32_t *actSize, cy_stc_usb_dev_context_t *context);
+cy_en_usb_dev_status_t Cy_USB_Dev_WriteEpNonBlocking(uint32_t endpoint, const uint8_t *buffer, uint32_t size,
+                                                     cy_stc_usb_dev_context_t *context);
+void     Cy_USBFS_Dev_Drv_RegisterEndpointCallback(USBFS_Type *base, uint32_t endpoint,
+                                                   cy_cb_usbfs_dev_drv_ep_callback_t callback,
+                                                   cy_stc_usbfs_dev_drv_context_t *context);
+void     Cy_USBFS_Dev_Drv_StallEndpoint(USBFS_Type *base, uint32_t endpoint, cy_stc_usbfs_dev_drv_context_t *context);
+uint32_t Cy_USBFS_Dev_Drv_CheckActivity(USBFS_Type *base);
+void     Cy_USBFS_Dev_Drv_Interrupt(USBFS_Type *base, uint32_t cause, cy_stc_usbfs_dev_drv_context_t *context);
+uint32_t Cy_USBFS_Dev_Drv_GetInterruptCauseHi(USBFS_Type *base);
+uint32_t Cy_USBFS_Dev_Drv_GetInterruptCauseMed(USBFS_Type *base);
+uint32_t Cy_USBFS_Dev_Drv_GetInterruptCauseLo(USBFS_Type *base);
+
+/*******************************************************************************
+* HAL timer
+********************************************************************************/
+#define NC                          (-1)
+#define CYHAL_ISR_PRIORITY_DEFAULT  7u
+#define CYHAL_TIMER_IRQ_TERMINAL_COUNT 1
+
+typedef int cyhal_timer_event_t;
+typedef struct { int unused; } cyhal_timer_t;
+typedef struct
+{
+    bool is_continuous;
+    uint32_t period;
+} cyhal_timer_cfg_t;
+
+cy_rslt_t cyhal_timer_init(cyhal_timer_t *obj, int pin, const void *clk);
+cy_rslt_t cyhal_timer_configure(cyhal_timer_t *obj, const cyhal_timer_cfg_t *cfg);
+void      cyhal_timer_register_callback(cyhal_timer_t *obj, void (*callback)(void *arg, cyhal_timer_event_t event),
+                                        void *arg);
+void      cyhal_timer_enable_event(cyhal_timer_t *obj, int event, uint32_t priority, bool enable);
+cy_rslt_t cyhal_timer_start(cyhal_timer_t *obj);
+
+/*******************************************************************************
+* FreeRTOS, the transport runs single-threaded on the host
+********************************************************************************/
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+
+#define tskIDLE_PRIORITY            0u
+#define portTICK_PERIOD_MS          1u
+#define pdMS_TO_TICKS(ms)           (ms)
+#define taskENTER_CRITICAL()        do { } while (0)
+#define taskEXIT_CRITICAL()         do { } while (0)
+#define taskENTER_CRITICAL_FROM_ISR()   0u
+#define taskEXIT_CRITICAL_FROM_ISR(x)   ((void) (x))
+
+void vTaskDelay(uint32_t ticks);
+
+#endif /* HOST_SHIM_H_ */
+
+/* [] END OF FILE */
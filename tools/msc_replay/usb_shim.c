@@ -0,0 +1,432 @@
+/*****************************************************************************
+* File Name: usb_shim.c
+*
+* Description:
+*  This file contains the host USB device stand-in used by msc_replay. It
+*  implements the endpoint functions of the USB device middleware with one
+*  packet buffer per direction: the replay puts the host OUT packets and
+*  takes the IN packets written by the transport, calling the endpoint
+*  callbacks registered by usb_comm.c as the USBFS interrupt would. The
+*  other PDL, HAL and FreeRTOS functions do nothing.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "usb_shim.h"
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define USB_SHIM_EP_NUM             16u
+#define USB_SHIM_EP_DIR_IN          0x80u
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static USBFS_Type usb_shim_hw;
+USBFS_Type *CYBSP_USBDEV_HW = &usb_shim_hw;
+const int CYBSP_USBDEV_config = 0;
+const int usb_devices[1] = { 0 };
+const int usb_devConfig = 0;
+
+CoreDebug_Type host_core_debug;
+DWT_Type host_dwt;
+
+static cy_stc_usbfs_dev_drv_context_t *usb_shim_drv;
+static cy_cb_usbfs_dev_drv_ep_callback_t usb_shim_ep_cb[USB_SHIM_EP_NUM];
+static void (*usb_shim_timer_cb)(void *arg, cyhal_timer_event_t event);
+
+/* Host OUT packet, and the endpoint armed by Cy_USB_Dev_StartReadEp() */
+static const uint8_t *usb_shim_out_data;
+static uint32_t usb_shim_out_len;
+static bool usb_shim_out_armed;
+
+/* IN packet written by the transport, waiting for the host */
+static uint8_t usb_shim_in_data[USB_SHIM_PACKET_SIZE];
+static uint32_t usb_shim_in_len;
+static bool usb_shim_in_full;
+
+static bool usb_shim_stall;
+static bool usb_shim_config_changed = true;
+static uint32_t usb_shim_packet_count;
+
+/*******************************************************************************
+* Function Name: usb_shim_out_ready
+********************************************************************************
+* Summary:
+*   Check if the OUT endpoint accepts a packet, otherwise the host gets NAK.
+*
+*******************************************************************************/
+bool usb_shim_out_ready(void)
+{
+    return usb_shim_out_armed && !usb_shim_stall;
+}
+
+/*******************************************************************************
+* Function Name: usb_shim_out
+********************************************************************************
+* Summary:
+*   Deliver a host OUT packet to the transport.
+*
+*******************************************************************************/
+void usb_shim_out(const uint8_t *data, uint32_t len)
+{
+    usb_shim_out_data = data;
+    usb_shim_out_len = len;
+    usb_shim_out_armed = false;
+    usb_shim_packet_count++;
+    usb_shim_ep_cb[2](CYBSP_USBDEV_HW, 2u, 0u, usb_shim_drv);
+}
+
+/*******************************************************************************
+* Function Name: usb_shim_in
+********************************************************************************
+* Summary:
+*   Take the IN packet written by the transport, and signal its completion.
+*
+* Return:
+*   False if the transport has nothing to send.
+*
+*******************************************************************************/
+bool usb_shim_in(uint8_t *data, uint32_t *len)
+{
+    if (!usb_shim_in_full || usb_shim_stall)
+    {
+        return false;
+    }
+
+    memcpy(data, usb_shim_in_data, usb_shim_in_len);
+    *len = usb_shim_in_len;
+    usb_shim_in_full = false;
+    usb_shim_packet_count++;
+    usb_shim_ep_cb[1](CYBSP_USBDEV_HW, USB_SHIM_EP_DIR_IN | 1u, 0u, usb_shim_drv);
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: usb_shim_stalled
+********************************************************************************
+* Summary:
+*   Check if the transport stalled an endpoint.
+*
+*******************************************************************************/
+bool usb_shim_stalled(void)
+{
+    return usb_shim_stall;
+}
+
+/*******************************************************************************
+* Function Name: usb_shim_clear_halt
+********************************************************************************
+* Summary:
+*   Clear the stalls, as the host does with CLEAR_FEATURE(ENDPOINT_HALT).
+*
+*******************************************************************************/
+void usb_shim_clear_halt(void)
+{
+    usb_shim_stall = false;
+}
+
+/*******************************************************************************
+* Function Name: usb_shim_reset
+********************************************************************************
+* Summary:
+*   Recover as after a host reset: clear the stalls and the IN packet, and
+*   report a configuration change so usb_comm_process() restarts the
+*   transport.
+*
+*******************************************************************************/
+void usb_shim_reset(void)
+{
+    usb_shim_stall = false;
+    usb_shim_in_full = false;
+    usb_shim_config_changed = true;
+}
+
+/*******************************************************************************
+* Function Name: usb_shim_tick
+********************************************************************************
+* Summary:
+*   Fire the 10-ms activity timer of usb_comm.c.
+*
+*******************************************************************************/
+void usb_shim_tick(void)
+{
+    if (usb_shim_timer_cb != NULL)
+    {
+        usb_shim_timer_cb(NULL, CYHAL_TIMER_IRQ_TERMINAL_COUNT);
+    }
+}
+
+/*******************************************************************************
+* Function Name: usb_shim_packets
+********************************************************************************
+* Summary:
+*   Number of packets exchanged on the bulk endpoints.
+*
+*******************************************************************************/
+uint32_t usb_shim_packets(void)
+{
+    return usb_shim_packet_count;
+}
+
+/*******************************************************************************
+* USB device middleware
+*******************************************************************************/
+cy_en_usb_dev_status_t Cy_USB_Dev_Init(USBFS_Type *base, const void *drvConfig, cy_stc_usbfs_dev_drv_context_t *drvContext,
+                                       const void *device, const void *config, cy_stc_usb_dev_context_t *context)
+{
+    (void) base;
+    (void) drvConfig;
+    (void) device;
+    (void) config;
+
+    drvContext->devConext = context;
+    usb_shim_drv = drvContext;
+    return CY_USB_DEV_SUCCESS;
+}
+
+cy_en_usb_dev_status_t Cy_USB_Dev_RegisterClass(cy_stc_usb_dev_class_ll_item_t *classItem, cy_stc_usb_dev_class_t *classObj,
+                                                void *classContext, cy_stc_usb_dev_context_t *context)
+{
+    (void) classItem;
+    (void) classObj;
+    (void) classContext;
+    (void) context;
+
+    return CY_USB_DEV_SUCCESS;
+}
+
+void Cy_USB_Dev_RegisterClassRequestRcvdCallback(cy_cb_usb_dev_request_received_t callback, cy_stc_usb_dev_class_t *classObj)
+{
+    (void) callback;
+    (void) classObj;
+}
+
+void Cy_USB_Dev_RegisterClassRequestCmpltCallback(cy_cb_usb_dev_request_cmplt_t callback, cy_stc_usb_dev_class_t *classObj)
+{
+    (void) callback;
+    (void) classObj;
+}
+
+void Cy_USB_Dev_OverwriteHandleTimeout(int32_t (*handler)(int32_t ms), cy_stc_usb_dev_context_t *context)
+{
+    (void) handler;
+    (void) context;
+}
+
+cy_en_usb_dev_status_t Cy_USB_Dev_Connect(bool blocking, int32_t timeout, cy_stc_usb_dev_context_t *context)
+{
+    (void) blocking;
+    (void) timeout;
+    (void) context;
+
+    return CY_USB_DEV_SUCCESS;
+}
+
+uint32_t Cy_USB_Dev_GetConfiguration(cy_stc_usb_dev_context_t *context)
+{
+    (void) context;
+
+    return 1u;
+}
+
+bool Cy_USB_Dev_IsConfigurationChanged(cy_stc_usb_dev_context_t *context)
+{
+    (void) context;
+
+    bool changed = usb_shim_config_changed;
+
+    usb_shim_config_changed = false;
+    return changed;
+}
+
+cy_en_usb_dev_status_t Cy_USB_Dev_StartReadEp(uint32_t endpoint, cy_stc_usb_dev_context_t *context)
+{
+    (void) endpoint;
+    (void) context;
+
+    usb_shim_out_armed = true;
+    return CY_USB_DEV_SUCCESS;
+}
+
+cy_en_usb_dev_status_t Cy_USB_Dev_ReadEpNonBlocking(uint32_t endpoint, uint8_t *buffer, uint32_t size,
+                                                    uint32_t *actSize, cy_stc_usb_dev_context_t *context)
+{
+    (void) endpoint;
+    (void) context;
+
+    *actSize = (usb_shim_out_len < size) ? usb_shim_out_len : size;
+    memcpy(buffer, usb_shim_out_data, *actSize);
+    return CY_USB_DEV_SUCCESS;
+}
+
+cy_en_usb_dev_status_t Cy_USB_Dev_WriteEpNonBlocking(uint32_t endpoint, const uint8_t *buffer, uint32_t size,
+                                                     cy_stc_usb_dev_context_t *context)
+{
+    (void) endpoint;
+    (void) context;
+
+    if (usb_shim_in_full || (size > USB_SHIM_PACKET_SIZE))
+    {
+        return CY_USB_DEV_DRV_HW_ERROR;
+    }
+
+    memcpy(usb_shim_in_data, buffer, size);
+    usb_shim_in_len = size;
+    usb_shim_in_full = true;
+    return CY_USB_DEV_SUCCESS;
+}
+
+void Cy_USBFS_Dev_Drv_RegisterEndpointCallback(USBFS_Type *base, uint32_t endpoint,
+                                               cy_cb_usbfs_dev_drv_ep_callback_t callback,
+                                               cy_stc_usbfs_dev_drv_context_t *context)
+{
+    (void) base;
+    (void) context;
+
+    usb_shim_ep_cb[endpoint % USB_SHIM_EP_NUM] = callback;
+}
+
+void Cy_USBFS_Dev_Drv_StallEndpoint(USBFS_Type *base, uint32_t endpoint, cy_stc_usbfs_dev_drv_context_t *context)
+{
+    (void) base;
+    (void) endpoint;
+    (void) context;
+
+    usb_shim_stall = true;
+}
+
+uint32_t Cy_USBFS_Dev_Drv_CheckActivity(USBFS_Type *base)
+{
+    (void) base;
+
+    return 1u;
+}
+
+void Cy_USBFS_Dev_Drv_Interrupt(USBFS_Type *base, uint32_t cause, cy_stc_usbfs_dev_drv_context_t *context)
+{
+    (void) base;
+    (void) cause;
+    (void) context;
+}
+
+uint32_t Cy_USBFS_Dev_Drv_GetInterruptCauseHi(USBFS_Type *base)
+{
+    (void) base;
+
+    return 0u;
+}
+
+uint32_t Cy_USBFS_Dev_Drv_GetInterruptCauseMed(USBFS_Type *base)
+{
+    (void) base;
+
+    return 0u;
+}
+
+uint32_t Cy_USBFS_Dev_Drv_GetInterruptCauseLo(USBFS_Type *base)
+{
+    (void) base;
+
+    return 0u;
+}
+
+/*******************************************************************************
+* Interrupts, HAL timer and FreeRTOS
+*******************************************************************************/
+cy_rslt_t Cy_SysInt_Init(const cy_stc_sysint_t *config, void (*handler)(void))
+{
+    (void) config;
+    (void) handler;
+
+    return CY_RSLT_SUCCESS;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+    (void) irq;
+}
+
+uint32_t __get_IPSR(void)
+{
+    return 0u;
+}
+
+cy_rslt_t cyhal_timer_init(cyhal_timer_t *obj, int pin, const void *clk)
+{
+    (void) obj;
+    (void) pin;
+    (void) clk;
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_configure(cyhal_timer_t *obj, const cyhal_timer_cfg_t *cfg)
+{
+    (void) obj;
+    (void) cfg;
+
+    return CY_RSLT_SUCCESS;
+}
+
+void cyhal_timer_register_callback(cyhal_timer_t *obj, void (*callback)(void *arg, cyhal_timer_event_t event), void *arg)
+{
+    (void) obj;
+    (void) arg;
+
+    usb_shim_timer_cb = callback;
+}
+
+void cyhal_timer_enable_event(cyhal_timer_t *obj, int event, uint32_t priority, bool enable)
+{
+    (void) obj;
+    (void) event;
+    (void) priority;
+    (void) enable;
+}
+
+cy_rslt_t cyhal_timer_start(cyhal_timer_t *obj)
+{
+    (void) obj;
+
+    return CY_RSLT_SUCCESS;
+}
+
+void vTaskDelay(uint32_t ticks)
+{
+    (void) ticks;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,66 @@
+/*****************************************************************************
+* File Name: usb_shim.h
+*
+* Description:
+*  This file contains the interface of the host USB device stand-in used
+*  by msc_replay to move the bulk packets in and out of the transport.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#ifndef USB_SHIM_H_
+#define USB_SHIM_H_
+
+#include "host_shim.h"
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define USB_SHIM_PACKET_SIZE        64u
+
+/*******************************************************************************
+* Function prototypes
+********************************************************************************/
+bool     usb_shim_out_ready(void);
+void     usb_shim_out(const uint8_t *data, uint32_t len);
+bool     usb_shim_in(uint8_t *data, uint32_t *len);
+bool     usb_shim_stalled(void);
+void     usb_shim_clear_halt(void);
+void     usb_shim_reset(void);
+void     usb_shim_tick(void);
+uint32_t usb_shim_packets(void);
+
+#endif /* USB_SHIM_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,387 @@
+/*****************************************************************************
+* File Name: ftl_sim.c
+*
+* Description:
+*  This file contains a host program running the FTL (source/ftl.c) on the
+*  NOR flash simulator. The "fuzz" mode runs random writes, reads, syncs
+*  and power cuts, and checks that every sector reads back its last synced
+*  content or a later one. The "bench" mode writes a recording pattern
+*  several times over the capacity, and reports the write amplification,
+*  the wear spread and the write latency.
+*  
+*  Build:
+*    gcc -O2 -I../../source -o ftl_sim ftl_sim.c nor_sim.c ../../source/ftl.c
+*  Run:
+*    ./ftl_sim fuzz [seed] [operations]
+*    ./ftl_sim bench [sector size] [background steps per write]
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "ftl.h"
+#include "nor_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define FUZZ_FLASH_SIZE         (2u * 1024u * 1024u)
+#define FUZZ_ERASE_SIZE         (64u * 1024u)
+#define FUZZ_SECTOR_SIZE        512u
+#define FUZZ_RUN_MAX            24u
+
+#define BENCH_FLASH_SIZE        (64u * 1024u * 1024u)
+#define BENCH_ERASE_SIZE        (256u * 1024u)
+#define BENCH_CHUNK_SIZE        (4u * 1024u)
+#define BENCH_SYNC_SIZE         (64u * 1024u)
+#define BENCH_META_SECTORS      2048u
+#define BENCH_PASSES            3u
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static const ftl_nor_t sim_nor =
+{
+    0, 0, nor_sim_read, nor_sim_program, nor_sim_erase
+};
+
+static ftl_nor_t nor;
+static uint8_t buf[FUZZ_RUN_MAX * FUZZ_SECTOR_SIZE];
+
+/*******************************************************************************
+* Function Name: fill_sector
+********************************************************************************
+* Summary:
+*   Fill a sector with its number and a version.
+*
+*******************************************************************************/
+static void fill_sector(uint8_t *data, uint32_t size, uint32_t sector, uint32_t version)
+{
+    uint32_t index;
+
+    for (index = 0; index < size; index += 8u)
+    {
+        memcpy(&data[index], &sector, 4);
+        memcpy(&data[index + 4u], &version, 4);
+    }
+}
+
+/*******************************************************************************
+* Function Name: check_sector
+********************************************************************************
+* Summary:
+*   Get the version held by a sector.
+*
+* Return:
+*   Version, 0 if never written, 0xFFFFFFFF if the content is not valid.
+*
+*******************************************************************************/
+static uint32_t check_sector(const uint8_t *data, uint32_t size, uint32_t sector)
+{
+    uint32_t version;
+    uint32_t index;
+    uint8_t expect[8];
+
+    memcpy(&version, &data[4], 4);
+    memcpy(&expect[0], &sector, 4);
+    memcpy(&expect[4], &version, 4);
+    if (version == 0)
+    {
+        memset(expect, 0, sizeof(expect));
+    }
+    for (index = 0; index < size; index += 8u)
+    {
+        if (memcmp(&data[index], expect, 8) != 0)
+        {
+            return 0xFFFFFFFFu;
+        }
+    }
+
+    return version;
+}
+
+/*******************************************************************************
+* Function Name: fuzz
+********************************************************************************
+* Summary:
+*   Run random operations with power cuts against a model of the content.
+*
+*******************************************************************************/
+static int fuzz(uint32_t seed, uint32_t ops)
+{
+    uint32_t *durable;
+    uint32_t *latest;
+    uint32_t sectors;
+    uint32_t version = 1;
+    uint32_t cuts = 0;
+    uint32_t op;
+    uint32_t sector;
+    uint32_t count;
+    uint32_t index;
+    uint32_t found;
+    int failed;
+
+    srand(seed);
+    nor = sim_nor;
+    nor.size = FUZZ_FLASH_SIZE;
+    nor.erase_size = FUZZ_ERASE_SIZE;
+    if ((nor_sim_init(nor.size, nor.erase_size) != 0) || (ftl_mount(&nor, FUZZ_SECTOR_SIZE) != FTL_OK))
+    {
+        printf("mount failed\n");
+        return 1;
+    }
+    sectors = ftl_sector_num();
+    durable = calloc(sectors, sizeof(uint32_t));
+    latest = calloc(sectors, sizeof(uint32_t));
+
+    for (op = 0; op < ops; op++)
+    {
+        if ((rand() % 200) == 0)
+        {
+            nor_sim_cut_after(1u + ((uint32_t) rand() % 40u));
+        }
+
+        sector = (uint32_t) rand() % sectors;
+        count = 1u + ((uint32_t) rand() % FUZZ_RUN_MAX);
+        if (count > (sectors - sector))
+        {
+            count = sectors - sector;
+        }
+
+        failed = 0;
+        switch (rand() % 8)
+        {
+            case 0:
+            case 1:
+            case 2:
+                for (index = 0; index < count; index++)
+                {
+                    fill_sector(&buf[index * FUZZ_SECTOR_SIZE], FUZZ_SECTOR_SIZE, sector + index, version);
+                    latest[sector + index] = version;
+                }
+                version++;
+                failed = (ftl_write(sector, buf, count) != FTL_OK);
+                break;
+            case 3:
+                failed = (ftl_sync() != FTL_OK);
+                if (!failed)
+                {
+                    memcpy(durable, latest, sectors * sizeof(uint32_t));
+                }
+                break;
+            case 4:
+                ftl_gc_step();
+                break;
+            default:
+                if (ftl_read(sector, buf, count) != FTL_OK)
+                {
+                    failed = 1;
+                    break;
+                }
+                for (index = 0; index < count; index++)
+                {
+                    if (check_sector(&buf[index * FUZZ_SECTOR_SIZE], FUZZ_SECTOR_SIZE, sector + index) != latest[sector + index])
+                    {
+                        printf("op %u: sector %u reads a wrong version\n", op, sector + index);
+                        return 1;
+                    }
+                }
+                break;
+        }
+
+        if (!nor_sim_is_off())
+        {
+            if (failed)
+            {
+                printf("op %u: operation failed without a power cut\n", op);
+                return 1;
+            }
+            continue;
+        }
+
+        /* Power cut: remount and check that no synced data was lost */
+        cuts++;
+        nor_sim_power_on();
+        if (ftl_mount(&nor, FUZZ_SECTOR_SIZE) != FTL_OK)
+        {
+            printf("op %u: remount failed\n", op);
+            return 1;
+        }
+        for (sector = 0; sector < sectors; sector++)
+        {
+            if (ftl_read(sector, buf, 1) != FTL_OK)
+            {
+                printf("op %u: read failed\n", op);
+                return 1;
+            }
+            found = check_sector(buf, FUZZ_SECTOR_SIZE, sector);
+            if ((found == 0xFFFFFFFFu) || ((found != durable[sector]) &&
+                ((found < durable[sector]) || (found > latest[sector]))))
+            {
+                printf("op %u: sector %u lost its content after a power cut (%u, synced %u, last %u)\n",
+                       op, sector, found, durable[sector], latest[sector]);
+                return 1;
+            }
+            durable[sector] = found;
+            latest[sector] = found;
+        }
+    }
+
+    printf("fuzz: seed %u, %u operations, %u power cuts, %u program violations: %s\n",
+           seed, ops, cuts, nor_sim_violations(), (nor_sim_violations() == 0) ? "pass" : "FAIL");
+
+    free(durable);
+    free(latest);
+    nor_sim_free();
+
+    return (nor_sim_violations() == 0) ? 0 : 1;
+}
+
+/*******************************************************************************
+* Function Name: compare_u64
+********************************************************************************
+* Summary:
+*   Sort helper.
+*
+*******************************************************************************/
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*******************************************************************************
+* Function Name: bench
+********************************************************************************
+* Summary:
+*   Record several times over the capacity: 4 KB chunks of audio, and every
+*   64 KB a rewrite of two metadata sectors and a sync, as f_sync() does.
+*   Background steps are run between the writes to model the idle time.
+*
+*******************************************************************************/
+static int bench(uint32_t sector_size, uint32_t steps)
+{
+    static uint8_t chunk[BENCH_CHUNK_SIZE];
+    ftl_stats_t stats;
+    uint64_t *lat;
+    uint64_t host = 0;
+    uint64_t start;
+    uint32_t per_chunk = BENCH_CHUNK_SIZE / sector_size;
+    uint32_t sectors;
+    uint32_t sector;
+    uint32_t writes;
+    uint32_t n = 0;
+    uint32_t pass;
+    uint32_t step;
+
+    nor = sim_nor;
+    nor.size = BENCH_FLASH_SIZE;
+    nor.erase_size = BENCH_ERASE_SIZE;
+    if ((nor_sim_init(nor.size, nor.erase_size) != 0) || (ftl_mount(&nor, sector_size) != FTL_OK))
+    {
+        printf("mount failed\n");
+        return 1;
+    }
+    sectors = ftl_sector_num();
+    writes = BENCH_PASSES * ((sectors - BENCH_META_SECTORS) / per_chunk);
+    lat = malloc(writes * sizeof(uint64_t));
+    memset(chunk, 0x5A, sizeof(chunk));
+
+    for (pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (sector = BENCH_META_SECTORS; (sector + per_chunk) <= sectors; sector += per_chunk)
+        {
+            start = nor_sim_time_ns();
+            if (ftl_write(sector, chunk, per_chunk) != FTL_OK)
+            {
+                printf("write failed\n");
+                return 1;
+            }
+            host += BENCH_CHUNK_SIZE;
+            if (((sector * sector_size) % BENCH_SYNC_SIZE) == 0)
+            {
+                ftl_write((uint32_t) rand() % BENCH_META_SECTORS, chunk, 1);
+                ftl_write((uint32_t) rand() % BENCH_META_SECTORS, chunk, 1);
+                ftl_sync();
+                host += 2u * sector_size;
+            }
+            lat[n++] = nor_sim_time_ns() - start;
+
+            for (step = 0; (step < steps) && ftl_gc_step(); step++)
+            {
+            }
+        }
+    }
+
+    ftl_get_stats(&stats);
+    qsort(lat, n, sizeof(uint64_t), compare_u64);
+    printf("bench: %u-byte sectors, %u background steps per write, %u MB exported\n",
+           sector_size, steps, (unsigned) (((uint64_t) sectors * sector_size) >> 20));
+    printf("  host %llu MB, flash programmed %llu MB, write amplification %.2f\n",
+           (unsigned long long) (host >> 20), (unsigned long long) (nor_sim_programmed_bytes() >> 20),
+           (double) nor_sim_programmed_bytes() / (double) host);
+    printf("  pages: host %u, moved %u; erases %u, erase count %u..%u\n",
+           stats.host_pages, stats.gc_pages, stats.erases, stats.erase_min, stats.erase_max);
+    printf("  write latency: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+           lat[n / 2u] / 1e6, lat[(n * 99u) / 100u] / 1e6, lat[n - 1u] / 1e6);
+
+    free(lat);
+    nor_sim_free();
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc >= 2) && (strcmp(argv[1], "fuzz") == 0))
+    {
+        return fuzz((argc > 2) ? (uint32_t) strtoul(argv[2], NULL, 0) : 1u,
+                    (argc > 3) ? (uint32_t) strtoul(argv[3], NULL, 0) : 200000u);
+    }
+    if ((argc >= 2) && (strcmp(argv[1], "bench") == 0))
+    {
+        return bench((argc > 2) ? (uint32_t) strtoul(argv[2], NULL, 0) : 512u,
+                     (argc > 3) ? (uint32_t) strtoul(argv[3], NULL, 0) : 4u);
+    }
+
+    printf("usage: %s fuzz [seed] [operations] | bench [sector size] [background steps per write]\n", argv[0]);
+    return 2;
+}
+
+/* [] END OF FILE */
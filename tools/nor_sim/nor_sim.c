@@ -0,0 +1,327 @@
+/*****************************************************************************
+* File Name: nor_sim.c
+*
+* Description:
+*  This file contains a RAM simulator of a NOR flash for host builds of the
+*  FTL. Programming only clears bits and erasing sets a whole block to 0xFF,
+*  as on the device. It counts the erases of each block and the time spent
+*  with typical datasheet timings, and can cut the power in the middle of a
+*  program or erase to check the recovery of the FTL.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#include "nor_sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static uint8_t  *nor_sim_mem = NULL;
+static uint32_t *nor_sim_erases = NULL;
+static uint32_t  nor_sim_size;
+static uint32_t  nor_sim_erase_size;
+
+/* Power cut: operations left before the cut, zero if none is armed */
+static uint32_t  nor_sim_cut_ops = 0;
+static int       nor_sim_off = 0;
+
+static uint64_t  nor_sim_ns = 0;
+static uint64_t  nor_sim_prog_bytes = 0;
+static uint32_t  nor_sim_bad_bits = 0;
+
+/*******************************************************************************
+* Function Name: nor_sim_init
+********************************************************************************
+* Summary:
+*   Allocate a blank flash.
+*
+* Parameters:
+*   size: flash size in bytes
+*   erase_size: erase block size in bytes
+*
+*******************************************************************************/
+int nor_sim_init(uint32_t size, uint32_t erase_size)
+{
+    nor_sim_free();
+
+    nor_sim_mem = malloc(size);
+    nor_sim_erases = calloc(size / erase_size, sizeof(uint32_t));
+    if ((nor_sim_mem == NULL) || (nor_sim_erases == NULL))
+    {
+        nor_sim_free();
+        return -1;
+    }
+
+    memset(nor_sim_mem, 0xFF, size);
+    nor_sim_size = size;
+    nor_sim_erase_size = erase_size;
+    nor_sim_cut_ops = 0;
+    nor_sim_off = 0;
+    nor_sim_ns = 0;
+    nor_sim_prog_bytes = 0;
+    nor_sim_bad_bits = 0;
+
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_free
+********************************************************************************
+* Summary:
+*   Release the flash.
+*
+*******************************************************************************/
+void nor_sim_free(void)
+{
+    free(nor_sim_mem);
+    free(nor_sim_erases);
+    nor_sim_mem = NULL;
+    nor_sim_erases = NULL;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_cut
+********************************************************************************
+* Summary:
+*   Count a program or erase operation against the armed power cut.
+*
+* Return:
+*   1 if the power is cut during this operation.
+*
+*******************************************************************************/
+static int nor_sim_cut(void)
+{
+    if (nor_sim_cut_ops == 0)
+    {
+        return 0;
+    }
+    if (--nor_sim_cut_ops == 0)
+    {
+        nor_sim_off = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_read
+********************************************************************************
+* Summary:
+*   Read the flash.
+*
+*******************************************************************************/
+int nor_sim_read(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    if (nor_sim_off || (addr >= nor_sim_size) || (len > (nor_sim_size - addr)))
+    {
+        return -1;
+    }
+
+    memcpy(buf, &nor_sim_mem[addr], len);
+    nor_sim_ns += NOR_SIM_READ_SETUP_NS + ((uint64_t) len * NOR_SIM_READ_BYTE_NS);
+
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_program
+********************************************************************************
+* Summary:
+*   Program the flash. Bits can only be cleared: setting a cleared bit is
+*   counted as a violation. A power cut programs the first half only.
+*
+*******************************************************************************/
+int nor_sim_program(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    uint32_t index;
+    uint32_t done;
+
+    if (nor_sim_off || (addr >= nor_sim_size) || (len > (nor_sim_size - addr)))
+    {
+        return -1;
+    }
+
+    done = nor_sim_cut() ? (len / 2u) : len;
+    for (index = 0; index < done; index++)
+    {
+        if ((buf[index] & ~nor_sim_mem[addr + index]) != 0)
+        {
+            nor_sim_bad_bits++;
+        }
+        nor_sim_mem[addr + index] &= buf[index];
+    }
+    nor_sim_prog_bytes += done;
+    nor_sim_ns += (uint64_t) NOR_SIM_PROG_PAGE_NS * ((len + NOR_SIM_PROG_PAGE_SIZE - 1u) / NOR_SIM_PROG_PAGE_SIZE);
+
+    return nor_sim_off ? -1 : 0;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_erase
+********************************************************************************
+* Summary:
+*   Erase the block holding an address. A power cut leaves random content.
+*
+*******************************************************************************/
+int nor_sim_erase(uint32_t addr)
+{
+    uint32_t block = addr / nor_sim_erase_size;
+    uint32_t index;
+
+    if (nor_sim_off || (addr >= nor_sim_size))
+    {
+        return -1;
+    }
+
+    addr = block * nor_sim_erase_size;
+    if (nor_sim_cut())
+    {
+        for (index = 0; index < nor_sim_erase_size; index++)
+        {
+            nor_sim_mem[addr + index] |= (uint8_t) rand();
+        }
+        return -1;
+    }
+
+    memset(&nor_sim_mem[addr], 0xFF, nor_sim_erase_size);
+    nor_sim_erases[block]++;
+    nor_sim_ns += NOR_SIM_ERASE_NS;
+
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_cut_after
+********************************************************************************
+* Summary:
+*   Arm a power cut during the given program or erase operation (1: next).
+*   Every access fails after the cut until nor_sim_power_on().
+*
+*******************************************************************************/
+void nor_sim_cut_after(uint32_t ops)
+{
+    nor_sim_cut_ops = ops;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_power_on
+********************************************************************************
+* Summary:
+*   Restore the power after a cut.
+*
+*******************************************************************************/
+void nor_sim_power_on(void)
+{
+    nor_sim_cut_ops = 0;
+    nor_sim_off = 0;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_is_off
+********************************************************************************
+* Summary:
+*   Check if the power has been cut.
+*
+*******************************************************************************/
+int nor_sim_is_off(void)
+{
+    return nor_sim_off;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_time_ns
+********************************************************************************
+* Summary:
+*   Get the simulated time spent in the flash operations.
+*
+*******************************************************************************/
+uint64_t nor_sim_time_ns(void)
+{
+    return nor_sim_ns;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_programmed_bytes
+********************************************************************************
+* Summary:
+*   Get the number of bytes programmed.
+*
+*******************************************************************************/
+uint64_t nor_sim_programmed_bytes(void)
+{
+    return nor_sim_prog_bytes;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_violations
+********************************************************************************
+* Summary:
+*   Get the number of bytes programmed over cleared bits.
+*
+*******************************************************************************/
+uint32_t nor_sim_violations(void)
+{
+    return nor_sim_bad_bits;
+}
+
+/*******************************************************************************
+* Function Name: nor_sim_erase_counts
+********************************************************************************
+* Summary:
+*   Get the lowest and highest erase counts of the blocks.
+*
+*******************************************************************************/
+void nor_sim_erase_counts(uint32_t *min, uint32_t *max)
+{
+    uint32_t block;
+
+    *min = 0xFFFFFFFFu;
+    *max = 0;
+    for (block = 0; block < (nor_sim_size / nor_sim_erase_size); block++)
+    {
+        if (nor_sim_erases[block] < *min)
+        {
+            *min = nor_sim_erases[block];
+        }
+        if (nor_sim_erases[block] > *max)
+        {
+            *max = nor_sim_erases[block];
+        }
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,76 @@
+/*****************************************************************************
+* File Name: nor_sim.h
+*
+* Description:
+*  This file contains the function prototypes and constants used in
+*  the nor_sim.c.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+
+#ifndef NOR_SIM_H_
+#define NOR_SIM_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+/* Typical timings of a S25FL512S on a 50 MHz quad SPI bus */
+#define NOR_SIM_READ_SETUP_NS       1000u
+#define NOR_SIM_READ_BYTE_NS        40u
+#define NOR_SIM_PROG_PAGE_SIZE      512u
+#define NOR_SIM_PROG_PAGE_NS        340000u
+#define NOR_SIM_ERASE_NS            520000000u
+
+/*******************************************************************************
+* Function prototypes
+********************************************************************************/
+int      nor_sim_init(uint32_t size, uint32_t erase_size);
+void     nor_sim_free(void);
+int      nor_sim_read(uint32_t addr, uint8_t *buf, uint32_t len);
+int      nor_sim_program(uint32_t addr, const uint8_t *buf, uint32_t len);
+int      nor_sim_erase(uint32_t addr);
+void     nor_sim_cut_after(uint32_t ops);
+void     nor_sim_power_on(void);
+int      nor_sim_is_off(void);
+uint64_t nor_sim_time_ns(void);
+uint64_t nor_sim_programmed_bytes(void);
+uint32_t nor_sim_violations(void);
+void     nor_sim_erase_counts(uint32_t *min, uint32_t *max);
+
+#endif /* NOR_SIM_H_ */
+
+/* [] END OF FILE */
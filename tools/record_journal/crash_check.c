@@ -0,0 +1,650 @@
+/*****************************************************************************
+* File Name: crash_check.c
+*
+* Description:
+*  This file contains a host check of the record recovery
+*  (source/record_journal.c). FatFs (fatfs/) runs on a RAM image. A record
+*  is encoded and written as audio_in_task() and audio_fs_write() do, with
+*  the journal and the commit interval, while each sector write to the image
+*  is logged. The free space holds random bytes, as stale data, or zeros, as
+*  an erased memory. The image is then cut at random points of the log, even within
+*  a multi-sector write, as a reset would; each cut image is mounted and
+*  recovered, and the record is checked: its data must be a prefix of the
+*  written stream ending on a frame or block, its header must match, and the
+*  committed audio must be kept. The check reports the audio lost per cut.
+*
+*  Build on Linux from this folder:
+*    gcc -O2 -I.. -I../../source -I../../fatfs -o crash_check crash_check.c \
+*        ../../source/record_journal.c ../../source/audio_enc.c \
+*        ../../source/audio_flac.c ../../fatfs/ff.c ../../fatfs/ffunicode.c \
+*        ../../fatfs/ffsystem.c -lm
+*
+*  Usage: crash_check [-e raw|adpcm|flac] [-x] [-z] [-r rate] [-c channels]
+*                     [-s seconds] [-n cuts] [-S seed] [-v]
+*    -x formats the image in exFAT, where the record is preallocated.
+*    -z fills the free space with zeros.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "record_journal.h"
+#include "record_cat.h"
+#include "audio_fs.h"
+#include "audio_enc.h"
+#include "ff.h"
+#include "diskio.h"
+#include "audio_in.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define SECTOR_SIZE             512u
+#define IMAGE_SIZE              (64u * 1024u * 1024u)
+#define RECORD_PATH             RECORD_FOLDER_NAME "/" RECORD_FILE_NAME "0001."
+#define DIRTY_MAX               65536u
+
+#define DEFAULT_SAMPLE_RATE     48000u      /* CONFIG_DEFAULT_SAMPLE_RATE */
+#define DEFAULT_CHANNELS        2u
+#define DEFAULT_SECONDS         20u
+#define DEFAULT_CUTS            200u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Sector write to the image, with the state of the record when it was made */
+typedef struct
+{
+    uint32_t sector;
+    uint32_t count;
+    size_t data;                /* Offset of the sectors in the log data */
+    uint32_t issued;            /* Stream bytes given to FatFs */
+    uint32_t committed;         /* Stream bytes committed */
+} log_write_t;
+
+/* Sectors changed by a cut and its recovery, restored from the base image */
+typedef struct
+{
+    uint32_t sector;
+    uint32_t count;
+} dirty_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+static uint8_t *image;
+static uint8_t *base;
+static bool verbose = false;
+
+static bool logging = false;
+static log_write_t *log_writes;
+static uint32_t log_num;
+static uint32_t log_max;
+static uint8_t *log_data;
+static size_t log_data_len;
+static size_t log_data_max;
+static uint32_t stream_issued;
+static uint32_t stream_committed;
+
+static dirty_t dirty[DIRTY_MAX];
+static uint32_t dirty_num;
+static bool dirty_overflow = false;
+
+static FATFS fs;
+static uint8_t work[RECORD_JOURNAL_WORK_SIZE];
+
+/*******************************************************************************
+* Function Name: log_write
+********************************************************************************
+* Summary:
+*   Messages of the recovery, printed with -v.
+*
+*******************************************************************************/
+void log_write(const char *format, ...)
+{
+    va_list args;
+
+    if (verbose)
+    {
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+    }
+}
+
+/*******************************************************************************
+* FatFs disk interface on the RAM image
+*******************************************************************************/
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    (void) pdrv;
+    return 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    (void) pdrv;
+    return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    (void) pdrv;
+    memcpy(buff, &image[(size_t) sector * SECTOR_SIZE], (size_t) count * SECTOR_SIZE);
+    return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
+{
+    size_t size = (size_t) count * SECTOR_SIZE;
+
+    (void) pdrv;
+    memcpy(&image[(size_t) sector * SECTOR_SIZE], buff, size);
+
+    if (logging)
+    {
+        if (log_num == log_max)
+        {
+            log_max = (log_max == 0u) ? 4096u : (log_max * 2u);
+            log_writes = realloc(log_writes, log_max * sizeof(log_write_t));
+        }
+        while ((log_data_len + size) > log_data_max)
+        {
+            log_data_max = (log_data_max == 0u) ? (4u << 20) : (log_data_max * 2u);
+            log_data = realloc(log_data, log_data_max);
+        }
+        log_writes[log_num].sector = (uint32_t) sector;
+        log_writes[log_num].count = count;
+        log_writes[log_num].data = log_data_len;
+        log_writes[log_num].issued = stream_issued;
+        log_writes[log_num].committed = stream_committed;
+        memcpy(&log_data[log_data_len], buff, size);
+        log_data_len += size;
+        log_num++;
+    }
+    else if (dirty_num < DIRTY_MAX)
+    {
+        dirty[dirty_num].sector = (uint32_t) sector;
+        dirty[dirty_num].count = count;
+        dirty_num++;
+    }
+    else
+    {
+        dirty_overflow = true;
+    }
+
+    return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    (void) pdrv;
+    switch (cmd)
+    {
+        case CTRL_SYNC:
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *(LBA_t *) buff = IMAGE_SIZE / SECTOR_SIZE;
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *) buff = SECTOR_SIZE;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *) buff = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+DWORD get_fattime(void)
+{
+    return ((DWORD) (2021 - 1980) << 25) | (1u << 21) | (1u << 16);
+}
+
+/*******************************************************************************
+* Function Name: random_next
+********************************************************************************
+* Summary:
+*   xorshift64 generator of the cut points.
+*
+*******************************************************************************/
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/*******************************************************************************
+* Function Name: record
+********************************************************************************
+* Summary:
+*   Format the image and write a record as audio_fs_new_record() and
+*   audio_fs_write() do, logging the sector writes once the record is created.
+*   The record is left open, as by a reset.
+*
+* Return:
+*   Length of the encoded stream written.
+*
+*******************************************************************************/
+static uint32_t record(audio_enc_format_t format, bool exfat, const int16_t *pcm, uint32_t pcm_len,
+                       uint32_t rate, uint32_t channels, uint8_t *stream)
+{
+    MKFS_PARM parm = { (BYTE) (exfat ? FM_EXFAT : FM_FAT32), 1, 0, 0, 0 };
+    static audio_enc_t enc;
+    static uint8_t buf[PCM_BLOCK_SIZE];
+    uint8_t header[AUDIO_ENC_HEADER_SIZE_MAX];
+    char name[RECORD_CAT_NAME_SIZE];
+    uint32_t header_len;
+    uint32_t commit_size;
+    uint32_t uncommitted = 0;
+    uint32_t pos;
+    uint32_t len;
+    uint32_t out;
+    bool is_prealloc = false;
+    bool is_hidden = true;
+    FSIZE_t size;
+    UINT count;
+    FIL fp;
+
+    snprintf(name, sizeof(name), "%s%s", RECORD_PATH, audio_enc_ext(format));
+
+    if ((f_mkfs("", &parm, work, sizeof(work)) != FR_OK) || (f_mount(&fs, "", 1) != FR_OK) ||
+        (f_mkdir(RECORD_FOLDER_NAME) != FR_OK))
+    {
+        printf("can't format the image\n");
+        exit(1);
+    }
+    record_journal_mount();
+
+    /* Record created ahead, with its header, and hidden */
+    audio_enc_init(&enc, format, rate, channels);
+    header_len = audio_enc_header(&enc, header);
+    commit_size = (header_len > 0u) ? RECORD_JOURNAL_COMMIT_SIZE : 0u;
+    if (f_open(&fp, name, FA_CREATE_NEW | FA_WRITE) != FR_OK)
+    {
+        printf("can't create %s\n", name);
+        exit(1);
+    }
+    for (size = RECORD_PREALLOC_SIZE; exfat && !is_prealloc && (size >= RECORD_PREALLOC_MIN); size /= 2u)
+    {
+        is_prealloc = (f_expand(&fp, size, 1) == FR_OK);
+    }
+    if (((header_len > 0u) && (f_write(&fp, header, header_len, &count) != FR_OK)) ||
+        (f_sync(&fp) != FR_OK) || (f_chmod(name, AM_HID, AM_HID) != FR_OK))
+    {
+        printf("can't write %s\n", name);
+        exit(1);
+    }
+
+    memcpy(base, image, IMAGE_SIZE);
+    logging = true;
+
+    /* Ring blocks encoded in place and written */
+    for (pos = 0; pos < pcm_len; pos += len)
+    {
+        len = ((pcm_len - pos) < PCM_BLOCK_SIZE) ? (pcm_len - pos) : PCM_BLOCK_SIZE;
+        memcpy(buf, (const uint8_t *) pcm + pos, len);
+        out = audio_enc_process(&enc, buf, len);
+        if (out == 0u)
+        {
+            continue;
+        }
+
+        if (is_hidden)
+        {
+            record_journal_begin(name, is_prealloc, f_tell(&fp));
+        }
+        memcpy(&stream[stream_issued], buf, out);
+        stream_issued += out;
+        if ((f_write(&fp, buf, out, &count) != FR_OK) || (count != out))
+        {
+            printf("image full\n");
+            exit(1);
+        }
+
+        uncommitted += out;
+        if (is_hidden || (uncommitted >= commit_size))
+        {
+            f_sync(&fp);
+            if (is_prealloc)
+            {
+                record_journal_commit(f_tell(&fp));
+            }
+            stream_committed = stream_issued;
+            uncommitted = 0;
+        }
+        if (is_hidden)
+        {
+            f_chmod(name, 0, AM_HID);
+            is_hidden = false;
+        }
+    }
+
+    logging = false;
+    memcpy(image, base, IMAGE_SIZE);
+    printf("%s record, %s%s: %u KB written in %u sector writes\n", audio_enc_name(format),
+           exfat ? "exFAT" : "FAT32", is_prealloc ? " preallocated" : "", stream_issued >> 10, log_num);
+
+    return stream_issued;
+}
+
+/*******************************************************************************
+* Function Name: flac_bounds
+********************************************************************************
+* Summary:
+*   Ends of the FLAC frames of the stream, from the same samples encoded one
+*   frame at a time.
+*
+* Return:
+*   Number of frames.
+*
+*******************************************************************************/
+static uint32_t flac_bounds(const int16_t *pcm, uint32_t frames, uint32_t rate, uint32_t channels,
+                            uint32_t *bounds)
+{
+    static uint8_t frame[AUDIO_FLAC_FRAME_SIZE_MAX];
+    audio_flac_t flac;
+    uint32_t num;
+    uint32_t end = 0;
+
+    audio_flac_init(&flac, rate, channels);
+    for (num = 0; ((num + 1u) * AUDIO_FLAC_BLOCK_FRAMES) <= frames; num++)
+    {
+        end += audio_flac_frame(&flac, &pcm[num * AUDIO_FLAC_BLOCK_FRAMES * channels], AUDIO_FLAC_BLOCK_FRAMES,
+                                frame);
+        bounds[num] = end;
+    }
+    return num;
+}
+
+/*******************************************************************************
+* Function Name: main
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    audio_enc_format_t format = AUDIO_ENC_FLAC;
+    uint32_t rate = DEFAULT_SAMPLE_RATE;
+    uint32_t channels = DEFAULT_CHANNELS;
+    uint32_t seconds = DEFAULT_SECONDS;
+    uint32_t cuts = DEFAULT_CUTS;
+    uint64_t seed = 1;
+    bool exfat = false;
+    bool zeros = false;
+    static audio_enc_t expect;
+    int16_t *pcm;
+    uint8_t *stream;
+    uint8_t *file;
+    uint32_t *bounds;
+    uint32_t bound_num = 0;
+    uint32_t frames;
+    uint32_t stream_len;
+    uint64_t sectors = 0;
+    uint64_t point;
+    uint32_t cut;
+    uint32_t index;
+    uint32_t applied;
+    uint32_t data_start;
+    uint32_t len;
+    uint32_t frame_bytes;
+    uint32_t bad = 0;
+    uint32_t empty = 0;
+    double lost_ms;
+    double lost_sum = 0;
+    double lost_max = 0;
+    uint8_t header[AUDIO_ENC_HEADER_SIZE_MAX];
+    char name[RECORD_CAT_NAME_SIZE];
+    const char *fault;
+    FILINFO info;
+    UINT count;
+    FIL fp;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:xzr:c:s:n:S:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'e':
+                if (!audio_enc_parse(optarg, &format))
+                {
+                    printf("encoding: raw, adpcm or flac\n");
+                    return 1;
+                }
+                break;
+            case 'x': exfat = true; break;
+            case 'z': zeros = true; break;
+            case 'r': rate = (uint32_t) atoi(optarg); break;
+            case 'c': channels = (uint32_t) atoi(optarg); break;
+            case 's': seconds = (uint32_t) atoi(optarg); break;
+            case 'n': cuts = (uint32_t) atoi(optarg); break;
+            case 'S': seed = (uint64_t) strtoull(optarg, NULL, 10) | 1u; break;
+            case 'v': verbose = true; break;
+            default:
+                printf("usage: %s [-e raw|adpcm|flac] [-x] [-z] [-r rate] [-c channels] [-s seconds] [-n cuts] "
+                       "[-S seed] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    if ((channels < 1u) || (channels > AUDIO_ENC_CHANNELS_MAX))
+    {
+        printf("channels: 1 or 2\n");
+        return 1;
+    }
+
+    image = calloc(IMAGE_SIZE, 1);
+    base = malloc(IMAGE_SIZE);
+    frames = rate * seconds;
+    pcm = malloc((size_t) frames * channels * sizeof(int16_t));
+    stream = malloc(((size_t) frames * channels * sizeof(int16_t)) + AUDIO_ENC_FLAC_PENDING_SIZE);
+    file = malloc(IMAGE_SIZE);
+    bounds = malloc(((frames / AUDIO_FLAC_BLOCK_FRAMES) + 1u) * sizeof(uint32_t));
+    bench_signal(pcm, frames, rate, channels);
+    for (index = 0; !zeros && (index < (IMAGE_SIZE / sizeof(uint64_t))); index++)
+    {
+        ((uint64_t *) image)[index] = random_next(&seed);
+    }
+
+    stream_len = record(format, exfat, pcm, frames * channels * sizeof(int16_t), rate, channels, stream);
+    snprintf(name, sizeof(name), "%s%s", RECORD_PATH, audio_enc_ext(format));
+    audio_enc_init(&expect, format, rate, channels);
+    if (format == AUDIO_ENC_FLAC)
+    {
+        bound_num = flac_bounds(pcm, frames, rate, channels, bounds);
+    }
+    frame_bytes = (format == AUDIO_ENC_FLAC) ? (2u * AUDIO_FLAC_FRAME_SIZE_MAX) :
+                  (format == AUDIO_ENC_IMA_ADPCM) ? expect.block_align : 4u;
+    for (index = 0; index < log_num; index++)
+    {
+        sectors += log_writes[index].count;
+    }
+
+    for (cut = 0; cut < cuts; cut++)
+    {
+        /* Image as left by a reset after some of the logged sectors */
+        point = random_next(&seed) % (sectors + 1u);
+        for (index = 0; (index < log_num) && (point >= log_writes[index].count); index++)
+        {
+            point -= log_writes[index].count;
+            memcpy(&image[(size_t) log_writes[index].sector * SECTOR_SIZE], &log_data[log_writes[index].data],
+                   (size_t) log_writes[index].count * SECTOR_SIZE);
+        }
+        applied = index;
+        if (index < log_num)
+        {
+            memcpy(&image[(size_t) log_writes[index].sector * SECTOR_SIZE], &log_data[log_writes[index].data],
+                   (size_t) point * SECTOR_SIZE);
+        }
+
+        /* Boot */
+        dirty_num = 0;
+        memset(&fs, 0, sizeof(fs));
+        fault = NULL;
+        len = 0;
+        if (f_mount(&fs, "", 1) != FR_OK)
+        {
+            fault = "mount";
+        }
+        else
+        {
+            record_journal_recover(work, sizeof(work));
+        }
+
+        /* Check the record */
+        if (fault != NULL)
+        {
+        }
+        else if ((f_stat(name, &info) != FR_OK) || (f_open(&fp, name, FA_READ) != FR_OK))
+        {
+            fault = "record missing";
+        }
+        else if ((info.fattrib & AM_HID) != 0u)
+        {
+            /* No audio yet, deleted at boot by audio_fs_drop_ready() */
+            f_close(&fp);
+            fault = ((applied < log_num) && (log_writes[applied].committed > 0u)) ? "committed record hidden" : NULL;
+            empty++;
+        }
+        else if ((f_read(&fp, file, (UINT) f_size(&fp), &count) != FR_OK) || (count != f_size(&fp)))
+        {
+            f_close(&fp);
+            fault = "read";
+        }
+        else
+        {
+            f_close(&fp);
+            data_start = (format == AUDIO_ENC_RAW) ? 0u : audio_enc_parse_header(&expect, format, file, count);
+            len = count - data_start;
+
+            if ((format != AUDIO_ENC_RAW) && (data_start == 0u))
+            {
+                fault = "header";
+            }
+            else if ((len > stream_len) || (memcmp(&file[data_start], stream, len) != 0))
+            {
+                fault = "data not a prefix of the stream";
+            }
+            else
+            {
+                /* Header expected for the units kept */
+                audio_enc_init(&expect, format, rate, channels);
+                expect.data_size = len;
+                if (format == AUDIO_ENC_IMA_ADPCM)
+                {
+                    expect.frames = (len / expect.block_align) * expect.block_frames;
+                    fault = ((len % expect.block_align) != 0u) ? "partial block" : NULL;
+                }
+                else if (format == AUDIO_ENC_FLAC)
+                {
+                    for (index = 0; (index < bound_num) && (bounds[index] < len); index++)
+                    {
+                    }
+                    fault = ((len != 0u) && ((index >= bound_num) || (bounds[index] != len))) ? "partial frame" : NULL;
+                    expect.frames = (len == 0u) ? 0u : ((index + 1u) * AUDIO_FLAC_BLOCK_FRAMES);
+                    expect.flac.frames = expect.frames;
+                }
+                else
+                {
+                    fault = ((len % (channels * sizeof(int16_t))) != 0u) ? "partial frame" : NULL;
+                }
+
+                if ((fault == NULL) && (data_start > 0u) &&
+                    ((audio_enc_header(&expect, header) != data_start) || (memcmp(header, file, data_start) != 0)))
+                {
+                    fault = "header sizes";
+                }
+                if ((fault == NULL) && (applied < log_num) &&
+                    ((len + frame_bytes) < log_writes[applied].committed))
+                {
+                    fault = "committed audio lost";
+                }
+            }
+        }
+
+        /* Audio written before the cut and not kept */
+        lost_ms = 0;
+        if ((fault == NULL) && (applied < log_num) && (log_writes[applied].issued > len))
+        {
+            lost_ms = ((double) (log_writes[applied].issued - len) * seconds * 1000.0) / stream_len;
+        }
+        lost_sum += lost_ms;
+        lost_max = (lost_ms > lost_max) ? lost_ms : lost_max;
+
+        if (fault != NULL)
+        {
+            bad++;
+            printf("cut %u (write %u/%u): %s\n", cut, applied, log_num, fault);
+        }
+        else if (verbose)
+        {
+            printf("cut %u (write %u/%u): kept %u KB, lost %.0f ms\n", cut, applied, log_num, len >> 10, lost_ms);
+        }
+
+        /* Back to the image before the record */
+        f_mount(NULL, "", 0);
+        for (index = 0; index <= applied && (index < log_num); index++)
+        {
+            memcpy(&image[(size_t) log_writes[index].sector * SECTOR_SIZE],
+                   &base[(size_t) log_writes[index].sector * SECTOR_SIZE],
+                   (size_t) log_writes[index].count * SECTOR_SIZE);
+        }
+        for (index = 0; index < dirty_num; index++)
+        {
+            memcpy(&image[(size_t) dirty[index].sector * SECTOR_SIZE], &base[(size_t) dirty[index].sector * SECTOR_SIZE],
+                   (size_t) dirty[index].count * SECTOR_SIZE);
+        }
+        if (dirty_overflow)
+        {
+            memcpy(image, base, IMAGE_SIZE);
+            dirty_overflow = false;
+        }
+    }
+
+    printf("%u cuts: %u recovered, %u without audio, %u failed\n", cuts, cuts - bad - empty, empty, bad);
+    printf("audio lost: %.0f ms average, %.0f ms max\n", (cuts > 0u) ? (lost_sum / cuts) : 0.0, lost_max);
+
+    return (bad == 0u) ? 0 : 1;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,492 @@
+/*****************************************************************************
+* File Name: rec_bench.c
+*
+* Description:
+*  This file contains a host benchmark of the recorder against the SD card
+*  emulator (source/sd_emu.c). FatFs (fatfs/) runs on an image file behind
+*  the emulator, with a simulated clock advanced by the emulated command
+*  times. The PCM ring of audio_in.c is filled at the sample rate and
+*  written as audio_in_task() and audio_fs_write() do: contiguous blocks in
+*  one f_write() followed by f_sync(). For each ring configuration, the
+*  benchmark reports the ring high-water mark, the dropped block ratio, the
+*  share of runs with drops and the write latency.
+*
+*  Build:
+*    gcc -O2 -I../../source -I../../fatfs -o rec_bench rec_bench.c \
+*        ../../source/sd_emu.c ../../source/blk_dev.c ../../fatfs/ff.c \
+*        ../../fatfs/ffunicode.c ../../fatfs/ffsystem.c
+*  Run:
+*    ./rec_bench [-p fast|typical|slow] [-t trace file] [-b size x blocks]
+*                [-r sample rate] [-c channels] [-s seconds] [-n runs]
+*                [-i image file]
+*    The trace file holds measured writes, "sectors microseconds" per line,
+*    as written by tools/trace_to_chrome.py --sd-writes.
+*
+* Note:
+*
+******************************************************************************
+* Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include "sd_emu.h"
+#include "ff.h"
+#include "diskio.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+* Constants
+********************************************************************************/
+#define SECTOR_SIZE             512u
+#define IMAGE_SIZE              (2ull * 1024ull * 1024ull * 1024ull)
+#define TRACE_MAX               65536u
+#define LATENCY_MAX             65536u
+
+#define DEFAULT_SAMPLE_RATE     48000u      /* CONFIG_DEFAULT_SAMPLE_RATE */
+#define DEFAULT_CHANNELS        2u
+#define DEFAULT_SECONDS         300u
+#define DEFAULT_RUNS            4u
+
+/*******************************************************************************
+* Data types
+********************************************************************************/
+/* Image file backend */
+typedef struct
+{
+    blk_dev_t dev;
+    int fd;
+} file_dev_t;
+
+/* PCM ring configuration */
+typedef struct
+{
+    uint32_t block_size;
+    uint32_t blocks;
+} ring_cfg_t;
+
+/* Results of a ring configuration */
+typedef struct
+{
+    uint64_t blocks;
+    uint64_t drops;
+    uint32_t runs_with_drops;
+    uint32_t high_water;
+    uint32_t latency_num;
+    uint32_t latency[LATENCY_MAX];  /* audio_fs_write() times, us */
+} ring_result_t;
+
+/*******************************************************************************
+* Global variables
+********************************************************************************/
+/* The PCM_BLOCK_SIZE x PCM_RING_BLOCKS ring of audio_in.c first */
+static const ring_cfg_t ring_cfgs[] =
+{
+    { 16384u, 4u },
+    { 4096u, 4u },
+    { 8192u, 4u },
+    { 16384u, 8u },
+    { 32768u, 4u },
+    { 32768u, 8u },
+};
+
+static const char *image = "rec_bench.img";
+static file_dev_t file;
+static sd_emu_t emu;
+static blk_dev_t *disk;
+static uint64_t now_us;
+static sd_emu_profile_t profile;
+static sd_emu_sample_t trace[TRACE_MAX];
+static ring_result_t result;
+
+/*******************************************************************************
+* Function Name: file_read, file_write, file_block_size
+********************************************************************************
+* Summary:
+*   Image file backend, in 512-byte sectors as the SD card.
+*
+*******************************************************************************/
+static blk_dev_result_t file_read(blk_dev_t *dev, uint32_t block, uint8_t *data, uint32_t *count)
+{
+    size_t size = (size_t) *count * SECTOR_SIZE;
+
+    return (pread(((file_dev_t *) dev)->fd, data, size, (off_t) block * SECTOR_SIZE) == (ssize_t) size) ?
+           BLK_DEV_OK : BLK_DEV_ERR_IO;
+}
+
+static blk_dev_result_t file_write(blk_dev_t *dev, uint32_t block, const uint8_t *data, uint32_t *count)
+{
+    size_t size = (size_t) *count * SECTOR_SIZE;
+
+    return (pwrite(((file_dev_t *) dev)->fd, data, size, (off_t) block * SECTOR_SIZE) == (ssize_t) size) ?
+           BLK_DEV_OK : BLK_DEV_ERR_IO;
+}
+
+static uint32_t file_block_size(blk_dev_t *dev)
+{
+    (void) dev;
+    return SECTOR_SIZE;
+}
+
+static uint32_t file_block_num(blk_dev_t *dev)
+{
+    (void) dev;
+    return (uint32_t) (IMAGE_SIZE / SECTOR_SIZE);
+}
+
+static const blk_dev_ops_t file_ops =
+{
+    .block_size = file_block_size,
+    .block_num = file_block_num,
+    .read = file_read,
+    .write = file_write,
+};
+
+/*******************************************************************************
+* Function Name: clock_advance
+********************************************************************************
+* Summary:
+*   Delay of the emulator: advance the simulated clock.
+*
+*******************************************************************************/
+static void clock_advance(uint32_t us)
+{
+    now_us += us;
+}
+
+/*******************************************************************************
+* FatFs disk interface on the emulated card
+*******************************************************************************/
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    (void) pdrv;
+    return 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    (void) pdrv;
+    return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    uint32_t length = count;
+
+    (void) pdrv;
+    return (blk_dev_read(disk, (uint32_t) sector, buff, &length) == BLK_DEV_OK) ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
+{
+    uint32_t length = count;
+
+    (void) pdrv;
+    return (blk_dev_write(disk, (uint32_t) sector, buff, &length) == BLK_DEV_OK) ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    (void) pdrv;
+    switch (cmd)
+    {
+        case CTRL_SYNC:
+            return (blk_dev_sync(disk) == BLK_DEV_OK) ? RES_OK : RES_ERROR;
+        case GET_SECTOR_COUNT:
+            *(LBA_t *) buff = blk_dev_block_num(disk);
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *) buff = SECTOR_SIZE;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *) buff = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+DWORD get_fattime(void)
+{
+    return ((DWORD) (2021 - 1980) << 25) | (1u << 21) | (1u << 16);
+}
+
+/*******************************************************************************
+* Function Name: load_trace
+********************************************************************************
+* Summary:
+*   Load the measured writes replayed by the emulator.
+*
+*******************************************************************************/
+static void load_trace(const char *path)
+{
+    FILE *in = fopen(path, "r");
+    unsigned int sectors;
+    unsigned int time_us;
+
+    if (in == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    profile.trace = trace;
+    profile.trace_num = 0;
+    while ((profile.trace_num < TRACE_MAX) && (fscanf(in, "%u %u", &sectors, &time_us) == 2))
+    {
+        trace[profile.trace_num].sectors = sectors;
+        trace[profile.trace_num].time_us = time_us;
+        profile.trace_num++;
+    }
+    fclose(in);
+    if (profile.trace_num == 0)
+    {
+        printf("%s: no write\n", path);
+        exit(1);
+    }
+}
+
+/*******************************************************************************
+* Function Name: record
+********************************************************************************
+* Summary:
+*   Format the emulated card and record to a new file, as the recorder does.
+*   A PCM block is captured every block period; when the ring is full, the
+*   block is dropped as in audio_in_pdm_pcm_callback().
+*
+*******************************************************************************/
+static void record(const ring_cfg_t *cfg, uint32_t rate, uint32_t channels, uint32_t seconds, uint32_t seed)
+{
+    static FATFS fs;
+    static FIL fp;
+    static BYTE work[32768];
+    static uint8_t ring[32u * 32768u];
+    const MKFS_PARM fs_param = { FM_FAT32 | FM_EXFAT, 1, 0, 0, 0 };
+    uint64_t period_us = ((uint64_t) cfg->block_size * 1000000u) / ((uint64_t) rate * channels * 2u);
+    uint64_t total = ((uint64_t) seconds * 1000000u) / period_us;
+    uint64_t produced = 0;
+    uint64_t arrived;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    uint32_t count;
+    uint32_t to_end;
+    uint64_t start;
+    uint64_t drops = 0;
+    UINT written;
+
+    file.fd = open(image, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if ((file.fd < 0) || (ftruncate(file.fd, (off_t) IMAGE_SIZE) != 0))
+    {
+        perror(image);
+        exit(1);
+    }
+    file.dev.ops = &file_ops;
+    disk = sd_emu_init(&emu, &file.dev, &profile, clock_advance, seed);
+
+    if ((f_mkfs("", &fs_param, work, sizeof(work)) != FR_OK) || (f_mount(&fs, "", 1) != FR_OK) ||
+        (f_mkdir("REC") != FR_OK) || (f_open(&fp, "REC/REC_0001.WAV", FA_CREATE_NEW | FA_WRITE) != FR_OK))
+    {
+        printf("cannot create the record\n");
+        exit(1);
+    }
+
+    /* The recording starts now, with the first block ignored */
+    now_us = 0;
+    while (produced < total)
+    {
+        /* Capture the blocks due by now */
+        arrived = now_us / period_us;
+        while ((produced < arrived) && (produced < total))
+        {
+            produced++;
+            if (((head + 1u) - tail) < cfg->blocks)
+            {
+                head++;
+                if ((head - tail) > result.high_water)
+                {
+                    result.high_water = head - tail;
+                }
+            }
+            else
+            {
+                drops++;
+            }
+        }
+        if (produced == 1u)
+        {
+            tail = head;
+        }
+
+        if (tail == head)
+        {
+            now_us = (produced + 1u) * period_us;
+            continue;
+        }
+
+        /* Write the contiguous filled blocks */
+        count = head - tail;
+        to_end = cfg->blocks - (tail % cfg->blocks);
+        if (count > to_end)
+        {
+            count = to_end;
+        }
+        start = now_us;
+        if ((f_write(&fp, &ring[(tail % cfg->blocks) * cfg->block_size], count * cfg->block_size, &written) != FR_OK) ||
+            (f_sync(&fp) != FR_OK))
+        {
+            printf("write error\n");
+            exit(1);
+        }
+        if (result.latency_num < LATENCY_MAX)
+        {
+            result.latency[result.latency_num++] = (uint32_t) (now_us - start);
+        }
+        tail += count;
+    }
+
+    f_close(&fp);
+    f_mount(NULL, "", 0);
+    close(file.fd);
+
+    result.blocks += total;
+    result.drops += drops;
+    if (drops != 0)
+    {
+        result.runs_with_drops++;
+    }
+}
+
+/*******************************************************************************
+* Function Name: compare_u32
+********************************************************************************
+* Summary:
+*   qsort() comparison of the latencies.
+*
+*******************************************************************************/
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*   Run the recording for each ring configuration and print the results.
+*
+*******************************************************************************/
+int main(int argc, char **argv)
+{
+    const sd_emu_profile_t *preset = &sd_emu_profiles[SD_EMU_TYPICAL];
+    const char *trace_path = NULL;
+    ring_cfg_t single;
+    const ring_cfg_t *cfgs = ring_cfgs;
+    uint32_t cfg_num = sizeof(ring_cfgs) / sizeof(ring_cfgs[0]);
+    uint32_t rate = DEFAULT_SAMPLE_RATE;
+    uint32_t channels = DEFAULT_CHANNELS;
+    uint32_t seconds = DEFAULT_SECONDS;
+    uint32_t runs = DEFAULT_RUNS;
+    uint32_t index;
+    uint32_t run;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:t:b:r:c:s:n:i:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p':
+                preset = sd_emu_find_profile(optarg);
+                if (preset == NULL)
+                {
+                    printf("unknown profile %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't': trace_path = optarg; break;
+            case 'b':
+                if ((sscanf(optarg, "%ux%u", &single.block_size, &single.blocks) != 2) ||
+                    (single.block_size > 32768u) || (single.blocks < 2u) || (single.blocks > 32u))
+                {
+                    printf("ring: size x blocks, up to 32768 x 32\n");
+                    return 1;
+                }
+                cfgs = &single;
+                cfg_num = 1;
+                break;
+            case 'r': rate = (uint32_t) atoi(optarg); break;
+            case 'c': channels = (uint32_t) atoi(optarg); break;
+            case 's': seconds = (uint32_t) atoi(optarg); break;
+            case 'n': runs = (uint32_t) atoi(optarg); break;
+            case 'i': image = optarg; break;
+            default:
+                printf("usage: %s [-p profile] [-t trace] [-b size x blocks] [-r rate] [-c channels] "
+                       "[-s seconds] [-n runs] [-i image]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    profile = *preset;
+    if (trace_path != NULL)
+    {
+        load_trace(trace_path);
+    }
+
+    printf("profile %s%s, %u Hz x %u, %u s x %u runs\n", profile.name, (trace_path != NULL) ? " + trace" : "",
+           rate, channels, seconds, runs);
+    printf("%-12s %6s %8s %10s %8s %10s %10s\n", "ring", "KB", "high", "drop prob", "runs", "p99 ms", "max ms");
+    for (index = 0; index < cfg_num; index++)
+    {
+        memset(&result, 0, sizeof(result));
+        for (run = 0; run < runs; run++)
+        {
+            record(&cfgs[index], rate, channels, seconds, run + 1u);
+        }
+        qsort(result.latency, result.latency_num, sizeof(uint32_t), compare_u32);
+        printf("%6u x %-3u %6u %4u/%-3u %10.2e %4u/%-3u %10.1f %10.1f\n",
+               cfgs[index].block_size, cfgs[index].blocks, (cfgs[index].block_size * cfgs[index].blocks) / 1024u,
+               result.high_water, cfgs[index].blocks - 1u, (double) result.drops / (double) result.blocks,
+               result.runs_with_drops, runs,
+               result.latency[(result.latency_num * 99u) / 100u] / 1000.0,
+               result.latency[result.latency_num - 1u] / 1000.0);
+    }
+
+    unlink(image);
+    return 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+Convert an event trace captured by source/trace.c into the Chrome trace JSON
+format, which can be opened with chrome://tracing or https://ui.perfetto.dev.
+
+The trace is either the TRACE.BIN file copied from the USB drive, or a UART
+log containing the "TRC" lines printed by trace_dump() (the last dump in the
+log is used).
+
+Usage:
+    trace_to_chrome.py TRACE.BIN -o trace.json
+    trace_to_chrome.py uart.log --summary
+    trace_to_chrome.py TRACE.BIN --sd-writes card.txt
+
+Copyright 2021, Cypress Semiconductor Corporation (an Infineon company) or
+an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+This software is provided under the license agreement accompanying the
+software package from which you obtained this software.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+TRACE_MAGIC = 0x45435254
+TRACE_HEADER = struct.Struct("<8I")
+TRACE_RECORD = struct.Struct("<IBBH")
+
+TYPE_BEGIN = 0
+TYPE_END = 1
+TYPE_INSTANT = 2
+
+# Keep in sync with trace_id_t in source/trace.h: (name, thread, argument)
+TRACE_IDS = [
+    ("USB ISR",     "USB interrupts", "level"),
+    ("SCSI",        "SCSI commands",  "opcode"),
+    ("SD read",     "SD card",        "blocks"),
+    ("SD write",    "SD card",        "blocks"),
+    ("PDM block",   "PDM/PCM",        "occupancy"),
+    ("PDM overrun", "PDM/PCM",        "occupancy"),
+    ("Audio write", "Audio task",     "KB"),
+    ("Audio DSP",   "Audio task",     "KB"),
+    ("Audio SRC",   "Audio task",     "KB"),
+    ("Audio VAD",   "Audio task",     "KB"),
+    ("Audio start", "Audio task",     "created now"),
+    ("Audio peak",  "Audio task",     "KB"),
+]
+ID_SD_WRITE = 3
+
+
+def load_image(path):
+    """Return the raw trace image from a binary dump or a UART log."""
+    with open(path, "rb") as file:
+        data = file.read()
+
+    if len(data) >= 4 and struct.unpack_from("<I", data)[0] == TRACE_MAGIC:
+        return data
+
+    image = None
+    for line in data.decode("ascii", "replace").splitlines():
+        line = line.strip()
+        if not line.startswith("TRC "):
+            continue
+        payload = line[4:]
+        if payload.startswith("BEGIN"):
+            image = bytearray()
+        elif payload.startswith("END"):
+            pass
+        elif image is not None:
+            image += bytes.fromhex(payload)
+
+    if not image:
+        sys.exit("%s: no trace found" % path)
+    return bytes(image)
+
+
+def parse(image):
+    """Return the clock frequency and the records in time order."""
+    (magic, version, clock_hz, ring_size, head, latch_time,
+     _running, _reserved) = TRACE_HEADER.unpack_from(image)
+    if magic != TRACE_MAGIC or version != 1:
+        sys.exit("unsupported trace (magic 0x%08x, version %d)" % (magic, version))
+
+    count = min(head, ring_size)
+    records = []
+    for index in range(head - count, head):
+        slot = index % ring_size
+        offset = TRACE_HEADER.size + slot * TRACE_RECORD.size
+        records.append(TRACE_RECORD.unpack_from(image, offset))
+
+    # Slots overwritten while the dump was read are newer than the latch time
+    records = [r for r in records
+               if ((r[0] - latch_time) & 0xFFFFFFFF) == 0
+               or ((r[0] - latch_time) & 0xFFFFFFFF) >= 0x80000000]
+
+    # Extend the 32-bit cycle counter
+    result = []
+    last = None
+    total = 0
+    for time, event_id, event_type, arg in records:
+        if last is not None:
+            total += (time - last) & 0xFFFFFFFF
+        last = time
+        result.append((total, event_id, event_type, arg))
+
+    return clock_hz, result
+
+
+def to_chrome(clock_hz, records):
+    """Build the Chrome trace event list."""
+    threads = {}
+    events = []
+    for _, thread, _ in TRACE_IDS:
+        if thread not in threads:
+            threads[thread] = len(threads) + 1
+            events.append({"name": "thread_name", "ph": "M", "pid": 1,
+                           "tid": threads[thread], "args": {"name": thread}})
+
+    for cycles, event_id, event_type, arg in records:
+        if event_id >= len(TRACE_IDS):
+            continue
+        name, thread, arg_name = TRACE_IDS[event_id]
+        event = {"name": name, "pid": 1, "tid": threads[thread],
+                 "ts": cycles * 1e6 / clock_hz, "args": {arg_name: arg}}
+        if event_type == TYPE_BEGIN:
+            event["ph"] = "B"
+        elif event_type == TYPE_END:
+            event["ph"] = "E"
+        else:
+            event["ph"] = "i"
+            event["s"] = "t"
+        events.append(event)
+
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def summary(clock_hz, records):
+    """Print the duration statistics of each event, to compare builds."""
+    open_events = {}
+    durations = {}
+    instants = {}
+    for cycles, event_id, event_type, _ in records:
+        if event_type == TYPE_BEGIN:
+            open_events.setdefault(event_id, []).append(cycles)
+        elif event_type == TYPE_END and open_events.get(event_id):
+            start = open_events[event_id].pop()
+            durations.setdefault(event_id, []).append((cycles - start) * 1e6 / clock_hz)
+        elif event_type == TYPE_INSTANT:
+            instants[event_id] = instants.get(event_id, 0) + 1
+
+    print("%-12s %8s %10s %10s %10s" % ("event", "count", "mean us", "p99 us", "max us"))
+    for event_id, values in sorted(durations.items()):
+        values.sort()
+        p99 = values[min(len(values) - 1, (len(values) * 99) // 100)]
+        print("%-12s %8d %10.1f %10.1f %10.1f" % (TRACE_IDS[event_id][0], len(values),
+                                                  sum(values) / len(values), p99, values[-1]))
+    for event_id, count in sorted(instants.items()):
+        print("%-12s %8d" % (TRACE_IDS[event_id][0], count))
+
+
+def sd_writes(clock_hz, records, path):
+    """Write the sectors and the duration in us of each SD card write, one
+    per line, the trace replayed by the SD card emulator (tools/sd_emu)."""
+    start = None
+    with open(path, "w") as file:
+        for cycles, event_id, event_type, arg in records:
+            if event_id != ID_SD_WRITE:
+                continue
+            if event_type == TYPE_BEGIN:
+                start = cycles
+            elif event_type == TYPE_END and start is not None:
+                file.write("%d %d\n" % (arg, round((cycles - start) * 1e6 / clock_hz)))
+                start = None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("input", help="TRACE.BIN or UART log")
+    parser.add_argument("-o", "--output", help="Chrome trace JSON file")
+    parser.add_argument("--summary", action="store_true", help="print duration statistics")
+    parser.add_argument("--sd-writes", help="SD card write latency file for tools/sd_emu")
+    args = parser.parse_args()
+
+    clock_hz, records = parse(load_image(args.input))
+
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(to_chrome(clock_hz, records), file)
+    if args.sd_writes:
+        sd_writes(clock_hz, records, args.sd_writes)
+    if args.summary or not (args.output or args.sd_writes):
+        summary(clock_hz, records)
+
+
+if __name__ == "__main__":
+    main()
@@ -26,6 +26,7 @@
 #define CY_USB_DEV_MSC_H
 
 #include "cy_usb_dev.h"
+#include "blk_dev.h"
 
 #if defined(CY_IP_MXUSBFS)
 
@@ -36,8 +37,7 @@ extern "C" {
 
 #define CY_USB_DEV_MSC_CMD_SIZE         0x10
 #define CY_USB_DEV_MSC_EP_BUF_SIZE      64u
-/* MSC Class Config */
-#define CY_USB_DEV_MSC_MEDIA_PACKET     8192
+#define CY_USB_DEV_MSC_LUN_MAX          16u
 
 /*******************************************************************************
 *                          Enumerated Types
@@ -83,6 +83,30 @@ typedef struct
     uint8_t  status;
 } cy_stc_usb_dev_msc_cmd_status_t;
 
+/** Mass Storage logical unit: a storage device with its own geometry and
+* sense state. The host addresses it by its index in the LUN array.
+*/
+typedef struct
+{
+    /* Block device stack of the storage */
+    blk_dev_t *dev;
+
+    /* Blocks mapped to the virtual files are generated (see virt_file.h) */
+    bool virt_files;
+
+    /* Geometry, read when the device is connected */
+    uint32_t block_num;
+    uint32_t block_size;
+    uint64_t mem_size;
+
+    /* Sense state */
+    volatile bool removed;
+    bool ejected;
+    bool command_failed;
+    bool force_os;
+    uint8_t status_timer;
+} cy_stc_usb_dev_msc_lun_t;
+
 /** Mass Storage class context structure.
 * All fields for the MSC context structure are internal. Firmware never reads or
 * writes these values. Firmware allocates the structure and provides the
@@ -127,8 +151,8 @@ typedef struct
     /* Bytes to transfer */
     uint32_t bytes_to_transfer;
 
-    /* Start location */
-    uint32_t start_location;
+    /* Start location (byte offset in the memory) */
+    uint64_t start_location;
 
     /* IN Endpoint Buffer */
     uint8_t in_buffer[CY_USB_DEV_MSC_EP_BUF_SIZE];
@@ -138,16 +162,22 @@ typedef struct
 
     void *p_user_data;
 
-    /* Mass storage device informatiom */
+    /* Logical units, the current one selected by the command block */
+    cy_stc_usb_dev_msc_lun_t *luns;
+    uint8_t lun_num;
+    cy_stc_usb_dev_msc_lun_t *lun;
+
+    /* Mass storage device informatiom of the current logical unit */
     uint32_t block_num;
     uint32_t block_size;
     uint64_t mem_size;
 
-    /* Mass storage device data buffer  */
-    uint32_t dev_data_addr;
+    /* Mass storage device data buffer, leased for each command */
+    uint64_t dev_data_addr;
     uint32_t dev_data_len;
     uint32_t dev_data_wr_len;
-    uint8_t dev_data_buf[CY_USB_DEV_MSC_MEDIA_PACKET];
+    uint32_t dev_data_size;
+    uint8_t *dev_data_buf;
 
     /** \endcond */
 
@@ -157,19 +187,6 @@ typedef struct
 /** \} group_usb_dev_msc_data_structures */
 
 
-/** Mass Storage device structure.
-*/
-typedef struct
-{
-    bool      (* is_connected)(void);
-    cy_rslt_t (* init)(void);
-    uint32_t  (* get_block_size)(void);
-    uint32_t  (* get_block_num)(void);
-    uint64_t  (* get_mem_size)(void);
-    cy_rslt_t (* read)(uint32_t blk_addr, uint8_t *buf, uint32_t *blk_len);
-    cy_rslt_t (* write)(uint32_t blk_addr, const uint8_t *buf, uint32_t *blk_len);
-} cy_stc_mass_storage_dev_t;
-
 /*******************************************************************************
 *                          Function Prototypes
 *******************************************************************************/